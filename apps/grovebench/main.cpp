@@ -0,0 +1,628 @@
+/**
+ * grovebench: main.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <boost/chrono.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+namespace bf = boost::filesystem;
+namespace po = boost::program_options;
+
+#include <grove/clustering/cpu/ExampleClusterer_CPU.tpp>
+#include <grove/clustering/interface/ExampleClusterer.tpp>
+#include <grove/features/FeatureCalculatorFactory.h>
+#include <grove/forests/cpu/DecisionForest_CPU.tpp>
+#include <grove/forests/interface/DecisionForest.tpp>
+#include <grove/reservoirs/cpu/ExampleReservoirs_CPU.tpp>
+#include <grove/reservoirs/interface/ExampleReservoirs.tpp>
+#include <grove/scoreforests/ScorePrediction.h>
+using namespace grove;
+
+#include <itmx/base/ITMImagePtrTypes.h>
+#include <itmx/base/MemoryBlockFactory.h>
+using namespace itmx;
+
+#include <tvgutil/numbers/RandomNumberGenerator.h>
+using namespace tvgutil;
+
+//#################### CONSTANTS ####################
+
+/** The number of trees in a synthetic forest (this matches the forests used by the relocaliser). */
+enum { SYNTHETIC_TREE_COUNT = 5 };
+
+//#################### TYPEDEFS ####################
+
+typedef ExampleClusterer_CPU<Keypoint3DColour,Keypoint3DColourCluster,ScorePrediction::Capacity> Clusterer;
+typedef ExampleReservoirs_CPU<Keypoint3DColour> Reservoirs;
+
+/**
+ * The configuration with which a benchmark was run (as key -> value pairs). Results are only comparable with a baseline
+ * that was run with the same configuration.
+ */
+typedef std::map<std::string,std::string> BenchmarkConfig;
+
+//#################### TYPES ####################
+
+struct CommandLineArguments
+{
+  //~~~~~~~~~~~~~~~~~~~~ PUBLIC VARIABLES ~~~~~~~~~~~~~~~~~~~~
+
+  std::string baselineFilename;
+  int clustersPerIteration;
+  std::string forestFilename;
+  int frameHeight;
+  int frameWidth;
+  int iterations;
+  std::string outputFilename;
+  std::string reservoirInsertion;
+  int reservoirCapacity;
+  unsigned int seed;
+  float tolerance;
+  int treeDepth;
+  int warmupIterations;
+};
+
+/**
+ * \brief An instance of this struct records the results of benchmarking a single stage of the pipeline.
+ */
+struct StageResult
+{
+  //~~~~~~~~~~~~~~~~~~~~ PUBLIC VARIABLES ~~~~~~~~~~~~~~~~~~~~
+
+  /** The number of items (e.g. descriptors or examples) processed by each run of the stage. */
+  double itemsPerRun;
+
+  /** The maximum latency of a run (in microseconds). */
+  double maxLatency;
+
+  /** The mean latency of a run (in microseconds). */
+  double meanLatency;
+
+  /** The 50th, 90th and 99th percentile latencies of a run (in microseconds). */
+  double p50Latency, p90Latency, p99Latency;
+
+  /** The number of timed runs. */
+  int runs;
+
+  /** The number of items processed per second. */
+  double throughput;
+};
+
+//#################### FUNCTIONS ####################
+
+/**
+ * \brief Computes the latency statistics for a stage from the times taken by its runs.
+ *
+ * \param latencies   The times taken by the runs (in microseconds).
+ * \param itemsPerRun The number of items processed by each run.
+ * \return            The statistics for the stage.
+ */
+StageResult compute_stage_result(std::vector<double> latencies, double itemsPerRun)
+{
+  StageResult result;
+  result.itemsPerRun = itemsPerRun;
+  result.runs = static_cast<int>(latencies.size());
+
+  std::sort(latencies.begin(), latencies.end());
+
+  double total = 0.0;
+  for(size_t i = 0, size = latencies.size(); i < size; ++i) total += latencies[i];
+
+  // Use the nearest-rank definition of the percentiles, so that each reported percentile is an actual measurement.
+  const int n = result.runs;
+  const int p50Idx = std::max(0, static_cast<int>(std::ceil(0.50 * n)) - 1);
+  const int p90Idx = std::max(0, static_cast<int>(std::ceil(0.90 * n)) - 1);
+  const int p99Idx = std::max(0, static_cast<int>(std::ceil(0.99 * n)) - 1);
+
+  result.maxLatency = latencies.back();
+  result.meanLatency = total / n;
+  result.p50Latency = latencies[p50Idx];
+  result.p90Latency = latencies[p90Idx];
+  result.p99Latency = latencies[p99Idx];
+  result.throughput = total > 0.0 ? itemsPerRun * n / (total * 1e-6) : 0.0;
+
+  return result;
+}
+
+/**
+ * \brief Makes a synthetic RGB-D frame.
+ *
+ * The depth image shows a tilted, bumpy surface between roughly 1m and 3m from the camera, with a scattering of invalid pixels,
+ * and the colour image shows a smoothly-varying pattern with some per-pixel noise. This gives the features a realistic spread of values.
+ *
+ * \param size        The size of the frame.
+ * \param phase       A phase offset used to make successive frames differ.
+ * \param rng         The random number generator to use.
+ * \param rgbImage    An image into which to write the colour image.
+ * \param depthImage  An image into which to write the depth image.
+ */
+void make_synthetic_frame(const Vector2i& size, float phase, RandomNumberGenerator& rng, const ITMUChar4Image_Ptr& rgbImage, const ITMFloatImage_Ptr& depthImage)
+{
+  Vector4u *rgb = rgbImage->GetData(MEMORYDEVICE_CPU);
+  float *depths = depthImage->GetData(MEMORYDEVICE_CPU);
+
+  for(int y = 0; y < size.y; ++y)
+  {
+    for(int x = 0; x < size.x; ++x)
+    {
+      const int i = y * size.x + x;
+      const float u = static_cast<float>(x) / size.x, v = static_cast<float>(y) / size.y;
+
+      const float depth = 1.0f + 1.5f * u + 0.5f * v + 0.1f * sinf(20.0f * u + phase) * cosf(15.0f * v);
+      depths[i] = rng.generate_int_from_uniform(0, 99) < 5 ? -1.0f : depth;
+
+      const int noise = rng.generate_int_from_uniform(-10, 10);
+      for(int c = 0; c < 3; ++c)
+      {
+        const float value = 127.5f + 100.0f * sinf((c + 1) * 7.0f * u + (3 - c) * 5.0f * v + phase);
+        rgb[i][c] = static_cast<unsigned char>(std::min(std::max(static_cast<int>(value) + noise, 0), 255));
+      }
+      rgb[i].w = 255;
+    }
+  }
+}
+
+/**
+ * \brief Writes the structure of a synthetic forest to a file in the text format.
+ *
+ * Each tree is a complete binary tree of the specified depth. The features and thresholds of the branch nodes are drawn
+ * from distributions that mimic those found in a forest pre-trained on a real scene (the office scene from 7-Scenes).
+ *
+ * \param filename  The path to the file.
+ * \param treeCount The number of trees in the forest.
+ * \param treeDepth The depth of each tree (each tree will have 2^treeDepth leaves).
+ * \param rng       The random number generator to use.
+ *
+ * \throws std::runtime_error If the file cannot be written.
+ */
+void write_synthetic_forest(const std::string& filename, int treeCount, int treeDepth, RandomNumberGenerator& rng)
+{
+  std::ofstream fs(filename.c_str());
+  if(!fs) throw std::runtime_error("Error: Could not write the synthetic forest to " + filename);
+
+  const int nbLeaves = 1 << treeDepth;
+  const int nbNodes = 2 * nbLeaves - 1;
+  const int firstLeafNode = nbLeaves - 1;
+
+  fs << treeCount << '\n';
+  for(int treeIdx = 0; treeIdx < treeCount; ++treeIdx)
+  {
+    fs << nbNodes << ' ' << nbLeaves << '\n';
+  }
+
+  // The nodes are stored in breadth-first order, so the children of node i are nodes 2i+1 and 2i+2. The leaf indices are global.
+  fs << std::setprecision(9);
+  for(int treeIdx = 0; treeIdx < treeCount; ++treeIdx)
+  {
+    for(int nodeIdx = 0; nodeIdx < nbNodes; ++nodeIdx)
+    {
+      if(nodeIdx >= firstLeafNode)
+      {
+        fs << "-1 " << treeIdx * nbLeaves + nodeIdx - firstLeafNode << " 0 0\n";
+      }
+      else if(rng.generate_real_from_uniform(0.0f, 1.0f) < 0.3886f)
+      {
+        fs << 2 * nodeIdx + 1 << " -1 " << rng.generate_int_from_uniform(0, 127) << ' ' << rng.generate_from_gaussian(20.09f, 947.24f) << '\n';
+      }
+      else
+      {
+        fs << 2 * nodeIdx + 1 << " -1 " << rng.generate_int_from_uniform(128, 255) << ' ' << rng.generate_from_gaussian(-2.85f, 72.98f) << '\n';
+      }
+    }
+  }
+
+  if(!fs) throw std::runtime_error("Error: Could not write the synthetic forest to " + filename);
+}
+
+/**
+ * \brief Loads a set of benchmark results from a file.
+ *
+ * \param filename  The path to the file.
+ * \param config    A place in which to store the configuration with which the benchmark was run.
+ * \return          The results, indexed by stage name.
+ *
+ * \throws std::runtime_error If the file cannot be read.
+ */
+std::map<std::string,StageResult> load_results(const std::string& filename, BenchmarkConfig& config)
+{
+  std::ifstream fs(filename.c_str());
+  if(!fs) throw std::runtime_error("Error: Could not read the benchmark results from " + filename);
+
+  std::map<std::string,StageResult> results;
+  std::string line;
+  while(std::getline(fs, line))
+  {
+    if(line.empty()) continue;
+
+    // The configuration is stored in comment lines of the form "# config <key> <value>". Other comments are ignored.
+    if(line[0] == '#')
+    {
+      std::istringstream is(line.substr(1));
+      std::string tag, key, value;
+      if(is >> tag >> key >> value && tag == "config") config[key] = value;
+      continue;
+    }
+
+    std::istringstream is(line);
+    std::string stage;
+    StageResult r;
+    if(!(is >> stage >> r.runs >> r.itemsPerRun >> r.meanLatency >> r.p50Latency >> r.p90Latency >> r.p99Latency >> r.maxLatency >> r.throughput))
+    {
+      throw std::runtime_error("Error: Malformed line in " + filename + ": " + line);
+    }
+
+    results[stage] = r;
+  }
+
+  return results;
+}
+
+/**
+ * \brief Outputs a set of benchmark results to a stream in a machine-readable (whitespace-separated) format.
+ *
+ * \param os      The stream.
+ * \param config  The configuration with which the benchmark was run.
+ * \param stages  The names of the stages, in the order in which they should be output.
+ * \param results The results, indexed by stage name.
+ */
+void output_results(std::ostream& os, const BenchmarkConfig& config, const std::vector<std::string>& stages, const std::map<std::string,StageResult>& results)
+{
+  for(BenchmarkConfig::const_iterator it = config.begin(), iend = config.end(); it != iend; ++it)
+  {
+    os << "# config " << it->first << ' ' << it->second << '\n';
+  }
+
+  os << "# stage runs itemsPerRun meanUs p50Us p90Us p99Us maxUs itemsPerSecond\n";
+  os << std::fixed << std::setprecision(1);
+  for(size_t i = 0, size = stages.size(); i < size; ++i)
+  {
+    const StageResult& r = results.find(stages[i])->second;
+    os << stages[i] << ' ' << r.runs << ' ' << r.itemsPerRun << ' ' << r.meanLatency << ' ' << r.p50Latency << ' '
+       << r.p90Latency << ' ' << r.p99Latency << ' ' << r.maxLatency << ' ' << r.throughput << '\n';
+  }
+}
+
+/**
+ * \brief Checks that a baseline was run with the same configuration as the current benchmark, so that the two can be compared.
+ *
+ * \param config            The configuration with which the current benchmark was run.
+ * \param baselineConfig    The configuration with which the baseline was run.
+ * \param baselineFilename  The path to the file containing the baseline (used in error messages).
+ *
+ * \throws std::runtime_error If the configurations differ, or the baseline does not record its configuration.
+ */
+void check_baseline_config(const BenchmarkConfig& config, const BenchmarkConfig& baselineConfig, const std::string& baselineFilename)
+{
+  if(baselineConfig.empty())
+  {
+    throw std::runtime_error("Error: Cannot compare with the baseline in " + baselineFilename + ", since it does not record the configuration with which it was run");
+  }
+
+  std::string differences;
+  for(BenchmarkConfig::const_iterator it = config.begin(), iend = config.end(); it != iend; ++it)
+  {
+    BenchmarkConfig::const_iterator jt = baselineConfig.find(it->first);
+    const std::string baselineValue = jt != baselineConfig.end() ? jt->second : "<none>";
+    if(baselineValue != it->second)
+    {
+      differences += (differences.empty() ? "" : ", ") + it->first + " " + baselineValue + " -> " + it->second;
+    }
+  }
+
+  for(BenchmarkConfig::const_iterator it = baselineConfig.begin(), iend = baselineConfig.end(); it != iend; ++it)
+  {
+    if(config.find(it->first) == config.end())
+    {
+      differences += (differences.empty() ? "" : ", ") + it->first + " " + it->second + " -> <none>";
+    }
+  }
+
+  if(!differences.empty())
+  {
+    throw std::runtime_error("Error: Cannot compare with the baseline in " + baselineFilename + ", since it was run with a different configuration (" + differences + ")");
+  }
+}
+
+/**
+ * \brief Compares a set of benchmark results against a baseline, and reports any regressions.
+ *
+ * The comparison uses the median latency of each stage, since it is much less sensitive to scheduling noise than the mean.
+ *
+ * \param stages    The names of the stages, in the order in which they should be compared.
+ * \param results   The results, indexed by stage name.
+ * \param baseline  The baseline results, indexed by stage name.
+ * \param tolerance The fractional increase in median latency beyond which a stage is considered to have regressed.
+ * \return          true, if any stage regressed, or false otherwise.
+ */
+bool compare_with_baseline(const std::vector<std::string>& stages, const std::map<std::string,StageResult>& results,
+                           const std::map<std::string,StageResult>& baseline, float tolerance)
+{
+  bool regressed = false;
+
+  std::cout << "Comparison with baseline (median latency):\n";
+  for(size_t i = 0, size = stages.size(); i < size; ++i)
+  {
+    std::map<std::string,StageResult>::const_iterator jt = baseline.find(stages[i]);
+    if(jt == baseline.end())
+    {
+      std::cout << "  " << std::setw(12) << std::left << stages[i] << "not in baseline\n";
+      continue;
+    }
+
+    const double current = results.find(stages[i])->second.p50Latency;
+    const double previous = jt->second.p50Latency;
+    const double change = previous > 0.0 ? current / previous - 1.0 : 0.0;
+    const bool stageRegressed = change > tolerance;
+    regressed = regressed || stageRegressed;
+
+    std::cout << "  " << std::setw(12) << std::left << stages[i] << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << previous << "us -> " << std::setw(12) << current << "us ("
+              << std::showpos << 100.0 * change << std::noshowpos << "%)" << (stageRegressed ? "  REGRESSION" : "") << '\n';
+  }
+
+  return regressed;
+}
+
+/**
+ * \brief Parses any command-line arguments passed in by the user.
+ *
+ * \param argc  The command-line argument count.
+ * \param argv  The raw command-line arguments.
+ * \param args  The parsed command-line arguments.
+ * \return      true, if the program should continue after parsing the command-line arguments, or false otherwise.
+ */
+bool parse_command_line(int argc, char *argv[], CommandLineArguments& args)
+{
+  po::options_description options("Options");
+  options.add_options()
+    ("help", "produce help message")
+    ("baseline,b", po::value<std::string>(&args.baselineFilename)->default_value(""), "the file containing the baseline results with which to compare")
+    ("clustersPerIteration", po::value<int>(&args.clustersPerIteration)->default_value(256), "the number of reservoirs to cluster in each iteration")
+    ("forest", po::value<std::string>(&args.forestFilename)->default_value(""), "a forest structure file to use instead of a synthetic forest")
+    ("height", po::value<int>(&args.frameHeight)->default_value(480), "the height of the synthetic frames")
+    ("iterations,n", po::value<int>(&args.iterations)->default_value(50), "the number of timed iterations")
+    ("output,o", po::value<std::string>(&args.outputFilename)->default_value(""), "the file to which to write the results (e.g. to use as a baseline later)")
+    ("reservoirCapacity", po::value<int>(&args.reservoirCapacity)->default_value(1024), "the capacity of each example reservoir")
+    ("reservoirInsertion", po::value<std::string>(&args.reservoirInsertion)->default_value("sharded"), "the reservoir insertion mode (atomic|sharded)")
+    ("seed", po::value<unsigned int>(&args.seed)->default_value(12345), "the seed for the random number generators")
+    ("tolerance", po::value<float>(&args.tolerance)->default_value(0.1f), "the fractional increase in median latency that counts as a regression")
+    ("treeDepth", po::value<int>(&args.treeDepth)->default_value(10), "the depth of each tree in the synthetic forest")
+    ("warmup", po::value<int>(&args.warmupIterations)->default_value(3), "the number of untimed iterations to run first")
+    ("width", po::value<int>(&args.frameWidth)->default_value(640), "the width of the synthetic frames")
+  ;
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, options), vm);
+  po::notify(vm);
+
+  if(vm.count("help"))
+  {
+    std::cout << "Usage: grovebench [options]\n";
+    std::cout << "Benchmarks the CPU implementations of grove's feature, forest, reservoir and clustering kernels on synthetic data.\n\n";
+    std::cout << options << '\n';
+    return false;
+  }
+
+  if(args.iterations <= 0) throw std::invalid_argument("Error: The number of iterations must be positive");
+  if(args.treeDepth < 1 || args.treeDepth > 20) throw std::invalid_argument("Error: The tree depth must be in the range [1,20]");
+  if(args.reservoirInsertion != "atomic" && args.reservoirInsertion != "sharded")
+  {
+    throw std::invalid_argument("Error: Unknown reservoir insertion mode: " + args.reservoirInsertion);
+  }
+
+  return true;
+}
+
+/**
+ * \brief Gets the time that has elapsed since the specified time point (in microseconds).
+ *
+ * \param t0  The time point.
+ * \return    The time that has elapsed since t0 (in microseconds).
+ */
+double microseconds_since(const boost::chrono::high_resolution_clock::time_point& t0)
+{
+  return boost::chrono::duration_cast<boost::chrono::duration<double,boost::micro> >(boost::chrono::high_resolution_clock::now() - t0).count();
+}
+
+/**
+ * \brief Runs the benchmark using a forest with the specified number of trees.
+ *
+ * \param args            The parsed command-line arguments.
+ * \param forestFilename  The path to the forest structure file.
+ * \param stages          The names of the stages to benchmark, in pipeline order.
+ * \param rng             The random number generator to use.
+ * \param config          The configuration of the benchmark, to which the number of trees and leaves will be added.
+ * \return                The results, indexed by stage name.
+ */
+template <int TreeCount>
+std::map<std::string,StageResult> run_benchmark(const CommandLineArguments& args, const std::string& forestFilename, const std::vector<std::string>& stages,
+                                                RandomNumberGenerator& rng, BenchmarkConfig& config)
+{
+  typedef boost::chrono::high_resolution_clock Clock;
+  typedef DecisionForest_CPU<RGBDPatchDescriptor,TreeCount> Forest;
+
+  const ITMLib::ITMLibSettings::DeviceType deviceType = ITMLib::ITMLibSettings::DEVICE_CPU;
+  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
+
+  // Load the forest.
+  Forest forest(forestFilename);
+  const uint32_t reservoirCount = forest.get_nb_leaves();
+  config["leaves"] = boost::lexical_cast<std::string>(reservoirCount);
+  config["trees"] = boost::lexical_cast<std::string>(forest.get_nb_trees());
+
+  // Construct the other components.
+  DA_RGBDPatchFeatureCalculator_Ptr featureCalculator = FeatureCalculatorFactory::make_da_rgbd_patch_feature_calculator(deviceType);
+  Reservoirs reservoirs(reservoirCount, args.reservoirCapacity, args.seed, args.reservoirInsertion == "atomic" ? Reservoirs::INSERTION_ATOMIC : Reservoirs::INSERTION_SHARDED);
+  Clusterer clusterer(0.1f, 0.05f, ScorePrediction::Capacity, 20);
+
+  // Make a few synthetic frames to cycle through (so that the reservoirs see some variety), and the images for the intermediate results.
+  const Vector2i frameSize(args.frameWidth, args.frameHeight);
+  const Vector4f intrinsics(525.0f * frameSize.x / 640.0f, 525.0f * frameSize.y / 480.0f, 0.5f * frameSize.x, 0.5f * frameSize.y);
+  const int frameCount = 4;
+  std::vector<ITMUChar4Image_Ptr> rgbImages(frameCount);
+  std::vector<ITMFloatImage_Ptr> depthImages(frameCount);
+  for(int i = 0; i < frameCount; ++i)
+  {
+    rgbImages[i] = mbf.make_image<Vector4u>(frameSize);
+    depthImages[i] = mbf.make_image<float>(frameSize);
+    make_synthetic_frame(frameSize, i * 0.7f, rng, rgbImages[i], depthImages[i]);
+  }
+
+  Keypoint3DColourImage_Ptr keypointsImage = mbf.make_image<Keypoint3DColour>();
+  RGBDPatchDescriptorImage_Ptr descriptorsImage = mbf.make_image<RGBDPatchDescriptor>();
+  typename Forest::LeafIndicesImage_Ptr leafIndicesImage = mbf.make_image<typename Forest::LeafIndices>();
+  ScorePredictionsMemoryBlock_Ptr predictions = mbf.make_block<ScorePrediction>(reservoirCount);
+
+  // Run the pipeline stage by stage, timing each stage separately.
+  std::vector<std::vector<double> > latencies(stages.size());
+  std::vector<double> itemsPerRun(stages.size(), 0.0);
+
+  const uint32_t clustersPerIteration = std::min<uint32_t>(std::max(args.clustersPerIteration, 1), reservoirCount);
+  uint32_t clusterStartIdx = 0;
+
+  for(int iteration = -args.warmupIterations; iteration < args.iterations; ++iteration)
+  {
+    const int frameIdx = (iteration + args.warmupIterations) % frameCount;
+
+    // Move the camera slightly between iterations, so that the examples added to the reservoirs are spread out in world space.
+    Matrix4f cameraPose;
+    cameraPose.setIdentity();
+    cameraPose.m[12] = 0.01f * (iteration + args.warmupIterations);
+
+    double stageLatencies[4];
+
+    Clock::time_point t0 = Clock::now();
+    featureCalculator->compute_keypoints_and_features(
+      rgbImages[frameIdx].get(), depthImages[frameIdx].get(), cameraPose, intrinsics, keypointsImage.get(), descriptorsImage.get()
+    );
+    stageLatencies[0] = microseconds_since(t0);
+
+    t0 = Clock::now();
+    forest.find_leaves(descriptorsImage, leafIndicesImage);
+    stageLatencies[1] = microseconds_since(t0);
+
+    t0 = Clock::now();
+    reservoirs.add_examples(keypointsImage, leafIndicesImage);
+    stageLatencies[2] = microseconds_since(t0);
+
+    const uint32_t clusterCount = std::min(clustersPerIteration, reservoirCount - clusterStartIdx);
+    t0 = Clock::now();
+    clusterer.cluster_examples(reservoirs.get_reservoirs(), reservoirs.get_reservoir_sizes(), clusterStartIdx, clusterCount, predictions);
+    stageLatencies[3] = microseconds_since(t0);
+    clusterStartIdx = (clusterStartIdx + clusterCount) % reservoirCount;
+
+    if(iteration < 0) continue;
+
+    const double keypointCount = static_cast<double>(keypointsImage->noDims.x) * keypointsImage->noDims.y;
+    itemsPerRun[0] = itemsPerRun[1] = itemsPerRun[2] = keypointCount;
+    itemsPerRun[3] = clusterCount;
+    for(size_t i = 0; i < stages.size(); ++i)
+    {
+      latencies[i].push_back(stageLatencies[i]);
+    }
+  }
+
+  // Compute the results.
+  std::map<std::string,StageResult> results;
+  for(size_t i = 0; i < stages.size(); ++i)
+  {
+    results[stages[i]] = compute_stage_result(latencies[i], itemsPerRun[i]);
+  }
+
+  return results;
+}
+
+int main(int argc, char *argv[])
+try
+{
+  CommandLineArguments args;
+  if(!parse_command_line(argc, argv, args)) return EXIT_SUCCESS;
+
+  RandomNumberGenerator rng(args.seed);
+
+  // Record the configuration of the benchmark, so that it can be checked against that of any baseline.
+  BenchmarkConfig config;
+  config["frameHeight"] = boost::lexical_cast<std::string>(args.frameHeight);
+  config["frameWidth"] = boost::lexical_cast<std::string>(args.frameWidth);
+  config["reservoirCapacity"] = boost::lexical_cast<std::string>(args.reservoirCapacity);
+
+  // Make a synthetic forest if necessary, and determine the number of trees in the forest we are using.
+  std::string forestFilename = args.forestFilename;
+  uint32_t treeCount;
+  if(forestFilename.empty())
+  {
+    forestFilename = (bf::temp_directory_path() / bf::unique_path("grovebench-%%%%-%%%%.txt")).string();
+    write_synthetic_forest(forestFilename, SYNTHETIC_TREE_COUNT, args.treeDepth, rng);
+    treeCount = SYNTHETIC_TREE_COUNT;
+    config["forest"] = "synthetic";
+    config["treeDepth"] = boost::lexical_cast<std::string>(args.treeDepth);
+  }
+  else
+  {
+    // Note: A quantised forest will be rejected when it is loaded, since the benchmark uses floating-point descriptors.
+    bool quantised;
+    treeCount = DecisionForest<RGBDPatchDescriptor,1>::read_tree_count(forestFilename, quantised);
+    config["forest"] = bf::path(forestFilename).filename().string();
+  }
+
+  // Since the number of trees in a forest is fixed at compile time, dispatch to the right instantiation of the benchmark.
+  const char *stageNames[] = { "features", "forest", "reservoirs", "clustering" };
+  const std::vector<std::string> stages(stageNames, stageNames + sizeof(stageNames) / sizeof(const char*));
+  std::map<std::string,StageResult> results;
+  switch(treeCount)
+  {
+    case 1: results = run_benchmark<1>(args, forestFilename, stages, rng, config); break;
+    case 2: results = run_benchmark<2>(args, forestFilename, stages, rng, config); break;
+    case 3: results = run_benchmark<3>(args, forestFilename, stages, rng, config); break;
+    case 4: results = run_benchmark<4>(args, forestFilename, stages, rng, config); break;
+    case 5: results = run_benchmark<5>(args, forestFilename, stages, rng, config); break;
+    case 6: results = run_benchmark<6>(args, forestFilename, stages, rng, config); break;
+    case 7: results = run_benchmark<7>(args, forestFilename, stages, rng, config); break;
+    case 8: results = run_benchmark<8>(args, forestFilename, stages, rng, config); break;
+    default:
+      throw std::runtime_error("Error: Unsupported number of trees (" + boost::lexical_cast<std::string>(treeCount) + "): only forests with 1-8 trees are supported");
+  }
+
+  if(args.forestFilename.empty()) bf::remove(forestFilename);
+
+  // Output the results.
+  std::cout << "Benchmarked " << config["trees"] << " trees (" << config["leaves"] << " leaves), "
+            << args.frameWidth << "x" << args.frameHeight << " frames, " << args.iterations << " iterations\n";
+  output_results(std::cout, config, stages, results);
+
+  if(!args.outputFilename.empty())
+  {
+    std::ofstream fs(args.outputFilename.c_str());
+    output_results(fs, config, stages, results);
+    if(!fs) throw std::runtime_error("Error: Could not write the benchmark results to " + args.outputFilename);
+  }
+
+  // If a baseline was specified, check that it was run with the same configuration, compare the results against it,
+  // and signal any regressions via the exit code.
+  if(!args.baselineFilename.empty())
+  {
+    BenchmarkConfig baselineConfig;
+    const std::map<std::string,StageResult> baseline = load_results(args.baselineFilename, baselineConfig);
+    check_baseline_config(config, baselineConfig, args.baselineFilename);
+    if(compare_with_baseline(stages, results, baseline, args.tolerance)) return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+catch(std::exception& e)
+{
+  std::cerr << e.what() << '\n';
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,195 @@
+/**
+ * groveconvert: main.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <grove/features/FeatureCalculatorFactory.h>
+#include <grove/forests/cpu/DecisionForest_CPU.tpp>
+#include <grove/forests/interface/DecisionForest.tpp>
+using namespace grove;
+
+#include <itmx/base/MemoryBlockFactory.h>
+using namespace itmx;
+
+#include <tvgutil/numbers/RandomNumberGenerator.h>
+#include <tvgutil/timing/Timer.h>
+using namespace tvgutil;
+
+//#################### FUNCTIONS ####################
+
+/**
+ * \brief Compares the leaves reached by a forest and its quantised counterpart, and the time taken to find them.
+ *
+ * Since no real descriptors are available to the converter, the comparison is made using synthetic descriptors whose features
+ * are drawn uniformly from the ranges covered by the quantised features (+/- 2048mm for depth features, +/- 256 for colour ones).
+ *
+ * \param forest            The original forest.
+ * \param quantisedForest   The quantised forest.
+ * \param quantisationSteps The quantisation step for each feature.
+ */
+template <int TreeCount>
+void report_quantisation(const DecisionForest_CPU<RGBDPatchDescriptor,TreeCount>& forest,
+                         const DecisionForest_CPU<QuantisedRGBDPatchDescriptor,TreeCount>& quantisedForest,
+                         const std::vector<float>& quantisationSteps)
+{
+  typedef DecisionForest_CPU<RGBDPatchDescriptor,TreeCount> Forest;
+  typedef typename Forest::LeafIndices LeafIndices;
+  typedef typename Forest::LeafIndicesImage_Ptr LeafIndicesImage_Ptr;
+
+  // Make matching images of synthetic floating-point and quantised descriptors.
+  const Vector2i imgSize(640, 480);
+  const int descriptorCount = imgSize.x * imgSize.y;
+  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
+  RGBDPatchDescriptorImage_Ptr descriptors = mbf.make_image<RGBDPatchDescriptor>(imgSize);
+  QuantisedRGBDPatchDescriptorImage_Ptr quantisedDescriptors = mbf.make_image<QuantisedRGBDPatchDescriptor>(imgSize);
+
+  RandomNumberGenerator rng(12345);
+  RGBDPatchDescriptor *descriptorsPtr = descriptors->GetData(MEMORYDEVICE_CPU);
+  QuantisedRGBDPatchDescriptor *quantisedDescriptorsPtr = quantisedDescriptors->GetData(MEMORYDEVICE_CPU);
+  for(int i = 0; i < descriptorCount; ++i)
+  {
+    for(int j = 0; j < RGBDPatchDescriptor::FEATURE_COUNT; ++j)
+    {
+      const float step = quantisationSteps[j];
+      const float value = rng.generate_real_from_uniform<float>(-128.0f * step, 128.0f * step);
+      descriptorsPtr[i].data[j] = value;
+      quantisedDescriptorsPtr[i].data[j] = quantise_feature(value, step);
+    }
+  }
+
+  // Find the leaves reached by the descriptors in both forests, timing each evaluation.
+  LeafIndicesImage_Ptr leafIndices = mbf.make_image<LeafIndices>(imgSize);
+  LeafIndicesImage_Ptr quantisedLeafIndices = mbf.make_image<LeafIndices>(imgSize);
+
+  Timer<boost::chrono::microseconds> floatTimer("Float");
+  forest.find_leaves(descriptors, leafIndices);
+  floatTimer.stop();
+
+  Timer<boost::chrono::microseconds> quantisedTimer("Quantised");
+  quantisedForest.find_leaves(quantisedDescriptors, quantisedLeafIndices);
+  quantisedTimer.stop();
+
+  // Count the descriptors that reach the same leaf in each tree of both forests.
+  const LeafIndices *leafIndicesPtr = leafIndices->GetData(MEMORYDEVICE_CPU);
+  const LeafIndices *quantisedLeafIndicesPtr = quantisedLeafIndices->GetData(MEMORYDEVICE_CPU);
+  std::cout << "Quantisation report (" << descriptorCount << " synthetic descriptors):\n";
+  for(int treeIdx = 0; treeIdx < TreeCount; ++treeIdx)
+  {
+    int agreementCount = 0;
+    for(int i = 0; i < descriptorCount; ++i)
+    {
+      if(leafIndicesPtr[i][treeIdx] == quantisedLeafIndicesPtr[i][treeIdx]) ++agreementCount;
+    }
+    std::cout << "  Tree " << treeIdx << ": " << std::fixed << std::setprecision(2) << 100.0 * agreementCount / descriptorCount << "% of leaves unchanged\n";
+  }
+  std::cout << "  Descriptor size: " << sizeof(RGBDPatchDescriptor) << " bytes -> " << sizeof(QuantisedRGBDPatchDescriptor) << " bytes\n";
+  std::cout << "  Evaluation time: " << floatTimer << " -> " << quantisedTimer << '\n';
+}
+
+/**
+ * \brief Converts a forest structure file from the text format to the binary format, or vice versa.
+ *
+ * \param inputPath   The path to the input file.
+ * \param outputPath  The path to the output file.
+ * \param quantise    Whether or not to quantise the thresholds of the forest so that it can be evaluated on quantised descriptors.
+ *
+ * \tparam DescriptorType  The type of descriptor for which the input forest is intended (quantised iff the input forest is).
+ */
+template <typename DescriptorType, int TreeCount>
+void convert(const std::string& inputPath, const std::string& outputPath, bool quantise)
+{
+  typedef DecisionForest_CPU<DescriptorType,TreeCount> Forest;
+  const bool inputIsBinary = Forest::is_binary_structure_file(inputPath);
+
+  Timer<boost::chrono::milliseconds> loadTimer("Load");
+  Forest forest(inputPath);
+  loadTimer.stop();
+  std::cout << "Loaded the forest from " << inputPath << " (" << loadTimer << ")\n";
+
+  // If requested, quantise the forest using the steps employed by the calculator that computes the quantised descriptors.
+  // The quantised forest is marked as such when it is saved, so that it can only be loaded for use with quantised descriptors.
+  std::vector<float> quantisationSteps;
+  if(quantise)
+  {
+    quantisationSteps = FeatureCalculatorFactory::make_quantised_da_rgbd_patch_feature_calculator(ITMLib::ITMLibSettings::DEVICE_CPU)->get_quantisation_steps();
+    forest.quantise_thresholds(quantisationSteps);
+  }
+
+  if(inputIsBinary) forest.save_structure_to_file(outputPath);
+  else forest.save_structure_to_binary_file(outputPath);
+  std::cout << "Saved the " << (forest.is_quantised() ? "quantised " : "") << "forest to " << outputPath << " in " << (inputIsBinary ? "text" : "binary") << " format\n";
+
+  // If the forest has been quantised, report on how it compares to the original one. The quantised forest is loaded back
+  // from the output file, which also checks that it was saved in a form that is usable with quantised descriptors.
+  if(quantise)
+  {
+    const DecisionForest_CPU<RGBDPatchDescriptor,TreeCount> originalForest(inputPath);
+    const DecisionForest_CPU<QuantisedRGBDPatchDescriptor,TreeCount> quantisedForest(outputPath);
+    report_quantisation(originalForest, quantisedForest, quantisationSteps);
+  }
+}
+
+/**
+ * \brief Converts a forest structure file from the text format to the binary format, or vice versa.
+ *
+ * \param inputPath         The path to the input file.
+ * \param outputPath        The path to the output file.
+ * \param inputIsQuantised  Whether or not the thresholds of the input forest have already been quantised.
+ * \param quantise          Whether or not to quantise the thresholds of the forest so that it can be evaluated on quantised descriptors.
+ *
+ * \throws std::runtime_error If quantise is true, but the thresholds of the input forest have already been quantised.
+ */
+template <int TreeCount>
+void convert(const std::string& inputPath, const std::string& outputPath, bool inputIsQuantised, bool quantise)
+{
+  if(inputIsQuantised)
+  {
+    if(quantise) throw std::runtime_error("Error: The thresholds of the forest in " + inputPath + " have already been quantised");
+    convert<QuantisedRGBDPatchDescriptor,TreeCount>(inputPath, outputPath, false);
+  }
+  else convert<RGBDPatchDescriptor,TreeCount>(inputPath, outputPath, quantise);
+}
+
+int main(int argc, char *argv[])
+try
+{
+  if(argc < 3 || argc > 4 || (argc == 4 && std::string(argv[3]) != "--quantise"))
+  {
+    std::cerr << "Usage: groveconvert <input forest file> <output forest file> [--quantise]\n";
+    std::cerr << "Converts a text forest structure file to the binary forest structure format, or vice versa.\n";
+    std::cerr << "If --quantise is specified, the thresholds are also quantised so that the forest can be evaluated on quantised descriptors.\n";
+    return EXIT_FAILURE;
+  }
+
+  const std::string inputPath = argv[1];
+  const std::string outputPath = argv[2];
+  const bool quantise = argc == 4;
+
+  // Since the number of trees in a forest is fixed at compile time, dispatch to the right instantiation of the converter.
+  bool inputIsQuantised = false;
+  const uint32_t treeCount = DecisionForest<RGBDPatchDescriptor,1>::read_tree_count(inputPath, inputIsQuantised);
+  switch(treeCount)
+  {
+    case 1: convert<1>(inputPath, outputPath, inputIsQuantised, quantise); break;
+    case 2: convert<2>(inputPath, outputPath, inputIsQuantised, quantise); break;
+    case 3: convert<3>(inputPath, outputPath, inputIsQuantised, quantise); break;
+    case 4: convert<4>(inputPath, outputPath, inputIsQuantised, quantise); break;
+    case 5: convert<5>(inputPath, outputPath, inputIsQuantised, quantise); break;
+    case 6: convert<6>(inputPath, outputPath, inputIsQuantised, quantise); break;
+    case 7: convert<7>(inputPath, outputPath, inputIsQuantised, quantise); break;
+    case 8: convert<8>(inputPath, outputPath, inputIsQuantised, quantise); break;
+    default:
+      throw std::runtime_error("Error: Unsupported number of trees (" + boost::lexical_cast<std::string>(treeCount) + "): only forests with 1-8 trees are supported");
+  }
+
+  return EXIT_SUCCESS;
+}
+catch(std::exception& e)
+{
+  std::cerr << e.what() << '\n';
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,51 @@
+/**
+ * raflconvert: main.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2015. All rights reserved.
+ */
+
+#include <cstdlib>
+#include <iostream>
+
+#include <rafl/examples/ExampleUtil.h>
+using namespace rafl;
+
+#include <tvgutil/timing/Timer.h>
+using namespace tvgutil;
+
+//#################### TYPEDEFS ####################
+
+typedef int Label;
+typedef boost::shared_ptr<const Example<Label> > Example_CPtr;
+
+//#################### FUNCTIONS ####################
+
+int main(int argc, char *argv[])
+try
+{
+  if(argc != 3)
+  {
+    std::cerr << "Usage: raflconvert <input example file> <output example file>\n";
+    std::cerr << "Converts a text example file to the binary example format, or vice versa.\n";
+    return EXIT_FAILURE;
+  }
+
+  const std::string inputPath = argv[1];
+  const std::string outputPath = argv[2];
+  const bool inputIsBinary = ExampleUtil::is_binary_example_file(inputPath);
+
+  Timer<boost::chrono::milliseconds> loadTimer("Load");
+  std::vector<Example_CPtr> examples = ExampleUtil::load_examples<Label>(inputPath);
+  loadTimer.stop();
+  std::cout << "Loaded " << examples.size() << " examples from " << inputPath << " (" << loadTimer << ")\n";
+
+  if(inputIsBinary) ExampleUtil::save_text_examples(examples, outputPath);
+  else ExampleUtil::save_binary_examples(examples, outputPath);
+  std::cout << "Saved the examples to " << outputPath << " in " << (inputIsBinary ? "text" : "binary") << " format\n";
+
+  return EXIT_SUCCESS;
+}
+catch(std::exception& e)
+{
+  std::cerr << e.what() << '\n';
+  return EXIT_FAILURE;
+}
@@ -88,9 +88,12 @@ int main(int argc, char *argv[])
       .add_param("decisionFunctionGeneratorType", list_of<std::string>("FeatureThresholding"))
       .add_param("gainThreshold", list_of<float>(0.0f))
       .add_param("maxClassSize", list_of<size_t>(1000))
+      .add_param("maxStoredExamples", list_of<size_t>(0))
       .add_param("maxTreeHeight", list_of<size_t>(20))
+      .add_param("parallelSplitting", list_of<bool>(false))
       .add_param("randomSeed", list_of<unsigned int>(seed))
       .add_param("seenExamplesThreshold", list_of<size_t>(50))
+      .add_param("splitBinCount", list_of<size_t>(0)(32))
       .add_param("splittabilityThreshold", list_of<float>(0.8f))
       .add_param("usePMFReweighting", list_of<bool>(false)(true))
       .generate_param_sets();
@@ -121,9 +124,12 @@ int main(int argc, char *argv[])
       .add_param("decisionFunctionGeneratorType", list_of<std::string>("FeatureThresholding"))
       .add_param("gainThreshold", list_of<float>(0.0f))
       .add_param("maxClassSize", list_of<size_t>(100000))
+      .add_param("maxStoredExamples", list_of<size_t>(0))
       .add_param("maxTreeHeight", list_of<size_t>(1000000))
+      .add_param("parallelSplitting", list_of<bool>(false))
       .add_param("randomSeed", list_of<unsigned int>(seed))
       .add_param("seenExamplesThreshold", list_of<size_t>(512))
+      .add_param("splitBinCount", list_of<size_t>(0)(32))
       .add_param("splittabilityThreshold", list_of<float>(0.8f))
       .add_param("usePMFReweighting", list_of<bool>(false)(true))
       .generate_param_sets();
@@ -218,9 +218,12 @@ int main(int argc, char *argv[])
     .add_param("decisionFunctionGeneratorType", list_of<std::string>(PairwiseOpAndThresholdDecisionFunctionGenerator<Label>::get_static_type()))
     .add_param("gainThreshold", list_of<float>(0.0f))
     .add_param("maxClassSize", list_of<size_t>(10000))
+    .add_param("maxStoredExamples", list_of<size_t>(0))
     .add_param("maxTreeHeight", list_of<size_t>(20))
+    .add_param("parallelSplitting", list_of<bool>(false))
     .add_param("randomSeed", list_of<unsigned int>(seed))
     .add_param("seenExamplesThreshold", list_of<size_t>(50))
+    .add_param("splitBinCount", list_of<size_t>(0))
     .add_param("splittabilityThreshold", list_of<float>(0.5f))
     .add_param("usePMFReweighting", list_of<bool>(true))
     .generate_param_sets();
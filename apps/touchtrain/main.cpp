@@ -94,9 +94,12 @@ int main(int argc, char *argv[])
     .add_param("decisionFunctionGeneratorType", list_of<std::string>("FeatureThresholding"))
     .add_param("gainThreshold", list_of<float>(0.0f))
     .add_param("maxClassSize", list_of<size_t>(1000))
+    .add_param("maxStoredExamples", list_of<size_t>(0))
     .add_param("maxTreeHeight", list_of<size_t>(20))
+    .add_param("parallelSplitting", list_of<bool>(false))
     .add_param("randomSeed", list_of<unsigned int>(seed))
     .add_param("seenExamplesThreshold", list_of<size_t>(32)(64)(128))
+    .add_param("splitBinCount", list_of<size_t>(0))
     .add_param("splittabilityThreshold", list_of<float>(0.3f)(0.5f)(0.8f))
     .add_param("usePMFReweighting", list_of<bool>(false)(true))
     .generate_param_sets();
@@ -154,5 +157,17 @@ int main(int argc, char *argv[])
   std::cout << "[touchtrain] Saving the forest to: " << forestPath << "\n";
   SerializationUtil::save_text(forestPath, *randomForest);
 
+  // Also output a flat version of the forest, which TouchSettings will load in preference to the text archive.
+  std::string flatForestPath = dataset.get_models_directory() + "/randomForest-" + timestamp + ".rff";
+  std::cout << "[touchtrain] Saving the flat forest to: " << flatForestPath << "\n";
+  try
+  {
+    randomForest->save_compiled(flatForestPath);
+  }
+  catch(std::exception& e)
+  {
+    std::cout << "[touchtrain] Warning could not save the flat forest: " << e.what() << "\n";
+  }
+
   return 0;
 }
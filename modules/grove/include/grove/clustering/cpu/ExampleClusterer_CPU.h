@@ -6,6 +6,8 @@
 #ifndef H_GROVE_EXAMPLECLUSTERER_CPU
 #define H_GROVE_EXAMPLECLUSTERER_CPU
 
+#include <vector>
+
 #include "../interface/ExampleClusterer.h"
 
 namespace grove {
@@ -15,6 +17,12 @@ namespace grove {
  *
  * See the base class template for additional documentation.
  *
+ * \note  Unlike the CUDA implementation, which compares every example in a set with every other example, this implementation
+ *        bins the examples in each set into a uniform 3D grid whose cells are at least as large as the radius of interest
+ *        (3 * sigma when computing densities, tau when linking neighbours), and only compares each example with the examples
+ *        in the neighbouring cells. This makes clustering roughly linear rather than quadratic in the size of each set. The
+ *        candidate examples are visited in the same order as the exhaustive search would visit them, so the results are the same.
+ *
  * \param ExampleType  The type of example to cluster.
  * \param ClusterType  The type of cluster being generated.
  * \param MaxClusters  The maximum number of clusters being generated for each set of examples.
@@ -31,6 +39,49 @@ public:
   using typename Base::ExampleImage;
   using typename Base::ExampleImage_CPtr;
 
+  //#################### NESTED TYPES ####################
+private:
+  /**
+   * \brief An instance of this struct represents a uniform 3D grid into which the examples in a set have been binned.
+   */
+  struct ExampleGrid
+  {
+    /** Scratch space used to keep track of the next free position in each cell whilst sorting the examples by cell. */
+    std::vector<int> cellCursors;
+
+    /** The offset in exampleIndices of the first example in each cell (there is an extra element at the end, to make lookups easier). */
+    std::vector<int> cellStarts;
+
+    /** The cell containing each example in the set. */
+    std::vector<Vector3i> exampleCells;
+
+    /** The indices of the examples in the set, ordered by cell (and within each cell, in ascending order). */
+    std::vector<int> exampleIndices;
+
+    /** The size of the grid (in cells) along each axis. */
+    Vector3i size;
+  };
+
+  //#################### PREDICATES ####################
+private:
+  /**
+   * \brief An instance of this predicate can be used to order clusters in non-increasing order of size, breaking ties by cluster index.
+   */
+  struct LargerCluster
+  {
+    /** The sizes of the clusters. */
+    const int *clusterSizes;
+
+    explicit LargerCluster(const int *clusterSizes_)
+    : clusterSizes(clusterSizes_)
+    {}
+
+    bool operator()(int lhs, int rhs) const
+    {
+      return clusterSizes[lhs] > clusterSizes[rhs] || (clusterSizes[lhs] == clusterSizes[rhs] && lhs < rhs);
+    }
+  };
+
   //#################### CONSTRUCTORS ####################
 public:
   /**
@@ -65,6 +116,10 @@ private:
   virtual void create_selected_clusters(const ExampleType *exampleSets, const int *exampleSetSizes, uint32_t exampleSetCapacity,
                                         uint32_t exampleSetCount, ClusterContainer *clusterContainers);
 
+  /** Override */
+  virtual void gather_changed_example_sets(const ExampleImage_CPtr& exampleSets, const ITMIntMemoryBlock_CPtr& exampleSetSizes,
+                                           uint32_t changedExampleSetCount);
+
   /** Override */
   virtual ClusterContainer *get_pointer_to_cluster_container(const ClusterContainers_Ptr& clusterContainers, uint32_t exampleSetIdx) const;
 
@@ -80,8 +135,36 @@ private:
   /** Override */
   virtual void reset_temporaries(uint32_t exampleSetCapacity, uint32_t exampleSetCount);
 
+  /** Override */
+  virtual void scatter_changed_cluster_containers(const ClusterContainers_Ptr& clusterContainers, uint32_t changedExampleSetCount);
+
   /** Override */
   virtual void select_clusters(uint32_t exampleSetCapacity, uint32_t exampleSetCount);
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Bins the examples in a set into a uniform 3D grid.
+   *
+   * The cells of the grid are made at least as large as the specified radius, so that any two examples that are within that
+   * radius of each other are guaranteed to be in the same or neighbouring cells. (They may be made larger than that to bound
+   * the number of cells when the examples are very spread out.)
+   *
+   * \param exampleSet    The examples in the set.
+   * \param exampleCount  The number of examples in the set.
+   * \param radius        The radius of the neighbourhoods that will be searched using the grid.
+   * \param grid          The grid into which to bin the examples (any existing storage in this will be reused).
+   */
+  static void build_grid(const ExampleType *exampleSet, int exampleCount, float radius, ExampleGrid& grid);
+
+  /**
+   * \brief Finds the examples in the cells neighbouring (and including) the cell containing the specified example.
+   *
+   * \param grid        The grid into which the examples in the set have been binned.
+   * \param exampleIdx  The index of the example within its set.
+   * \param candidates  A vector into which to write the indices of the examples that were found, in ascending order.
+   */
+  static void find_candidates(const ExampleGrid& grid, int exampleIdx, std::vector<int>& candidates);
 };
 
 }
@@ -5,6 +5,9 @@
 
 #include "ExampleClusterer_CPU.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "../shared/ExampleClusterer_Shared.h"
 
 namespace grove {
@@ -40,36 +43,65 @@ void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::compute_cluster_
 template <typename ExampleType, typename ClusterType, int MaxClusters>
 void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::compute_cluster_size_histograms(uint32_t exampleSetCapacity, uint32_t exampleSetCount)
 {
-  int *clusterSizeHistograms = this->m_clusterSizeHistograms->GetData(MEMORYDEVICE_CPU);
-  int *clusterSizes = this->m_clusterSizes->GetData(MEMORYDEVICE_CPU);
-  int *nbClustersPerExampleSet = this->m_nbClustersPerExampleSet->GetData(MEMORYDEVICE_CPU);
-
-#ifdef WITH_OPENMP
-  #pragma omp parallel for
-#endif
-  for(int exampleSetIdx = 0; exampleSetIdx < static_cast<int>(exampleSetCount); ++exampleSetIdx)
-  {
-    for(int clusterIdx = 0; clusterIdx < nbClustersPerExampleSet[exampleSetIdx]; ++clusterIdx)
-    {
-      update_cluster_size_histogram(exampleSetIdx, clusterIdx, clusterSizes, clusterSizeHistograms, exampleSetCapacity);
-    }
-  }
+  // No-op: the CPU implementation of select_clusters finds the largest clusters directly, so it does not need the histograms.
 }
 
 template <typename ExampleType, typename ClusterType, int MaxClusters>
-void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::compute_densities(const ExampleType *examples, const int *exampleSetSizes,
+void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::compute_densities(const ExampleType *exampleSets, const int *exampleSetSizes,
                                                                                   uint32_t exampleSetCapacity, uint32_t exampleSetCount)
 {
   float *densities = this->m_densities->GetData(MEMORYDEVICE_CPU);
 
+  const float sigma = Base::m_sigma;
+  const float threeSigmaSq = (3.0f * sigma) * (3.0f * sigma);
+  const float minusOneOverTwoSigmaSq = -1.0f / (2.0f * sigma * sigma);
+
 #ifdef WITH_OPENMP
-  #pragma omp parallel for
+  #pragma omp parallel
 #endif
-  for(int exampleSetIdx = 0; exampleSetIdx < static_cast<int>(exampleSetCount); ++exampleSetIdx)
   {
-    for(uint32_t exampleIdx = 0; exampleIdx < exampleSetCapacity; ++exampleIdx)
+    // Each thread reuses its own grid and candidate list for all of the example sets it processes.
+    ExampleGrid grid;
+    std::vector<int> candidates;
+
+#ifdef WITH_OPENMP
+    #pragma omp for
+#endif
+    for(int exampleSetIdx = 0; exampleSetIdx < static_cast<int>(exampleSetCount); ++exampleSetIdx)
     {
-      compute_density(exampleSetIdx, exampleIdx, examples, exampleSetSizes, exampleSetCapacity, Base::m_sigma, densities);
+      const int exampleSetOffset = exampleSetIdx * exampleSetCapacity;
+      const ExampleType *exampleSet = exampleSets + exampleSetOffset;
+      const int exampleSetSize = exampleSetSizes[exampleSetIdx];
+
+      // Bin the examples into a grid whose cells are large enough that all of the examples within 3 * sigma
+      // of each example are in its neighbouring cells (examples further away would only make a small
+      // contribution to the density).
+      build_grid(exampleSet, exampleSetSize, 3.0f * sigma, grid);
+
+      for(uint32_t exampleIdx = 0; exampleIdx < exampleSetCapacity; ++exampleIdx)
+      {
+        float density = 0.0f;
+
+        // If the example is valid, compute the density based on the examples that are within 3 * sigma of it.
+        // Note that the candidates are in ascending order of index, so the density is accumulated in the same
+        // order (and thus has exactly the same value) as in compute_density.
+        if(static_cast<int>(exampleIdx) < exampleSetSize)
+        {
+          find_candidates(grid, exampleIdx, candidates);
+
+          const ExampleType& centreExample = exampleSet[exampleIdx];
+          for(size_t i = 0, size = candidates.size(); i < size; ++i)
+          {
+            const float normSq = distance_squared(centreExample, exampleSet[candidates[i]]);
+            if(normSq < threeSigmaSq)
+            {
+              density += expf(normSq * minusOneOverTwoSigmaSq);
+            }
+          }
+        }
+
+        densities[exampleSetOffset + exampleIdx] = density;
+      }
     }
   }
 }
@@ -84,16 +116,69 @@ void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::compute_parents(
   int *parents = this->m_parents->GetData(MEMORYDEVICE_CPU);
 
 #ifdef WITH_OPENMP
-  #pragma omp parallel for
+  #pragma omp parallel
 #endif
-  for(int exampleSetIdx = 0; exampleSetIdx < static_cast<int>(exampleSetCount); ++exampleSetIdx)
   {
-    for(uint32_t exampleIdx = 0; exampleIdx < exampleSetCapacity; ++exampleIdx)
+    // Each thread reuses its own grid and candidate list for all of the example sets it processes.
+    ExampleGrid grid;
+    std::vector<int> candidates;
+
+#ifdef WITH_OPENMP
+    #pragma omp for
+#endif
+    for(int exampleSetIdx = 0; exampleSetIdx < static_cast<int>(exampleSetCount); ++exampleSetIdx)
     {
-      compute_parent(
-        exampleSetIdx, exampleIdx, exampleSets, exampleSetCapacity, exampleSetSizes,
-        densities, tauSq, parents, clusterIndices, nbClustersPerExampleSet
-      );
+      const int exampleSetOffset = exampleSetIdx * exampleSetCapacity;
+      const ExampleType *exampleSet = exampleSets + exampleSetOffset;
+      const float *exampleSetDensities = densities + exampleSetOffset;
+      const int exampleSetSize = exampleSetSizes[exampleSetIdx];
+
+      // Bin the examples into a grid whose cells are large enough that all of the examples that can be linked to
+      // each example (i.e. that are within tau of it) are in its neighbouring cells.
+      build_grid(exampleSet, exampleSetSize, sqrtf(tauSq), grid);
+
+      for(uint32_t exampleIdx = 0; exampleIdx < exampleSetCapacity; ++exampleIdx)
+      {
+        // Unless it becomes part of a subtree, each example starts as its own parent.
+        int parentIdx = exampleIdx;
+
+        // The index of the cluster associated with the example (-1 except for subtree roots).
+        int clusterIdx = -1;
+
+        // If the example is valid, look for the closest example with a higher density that is within tau of it.
+        // As in compute_parent, ties are broken in favour of the example with the lowest index.
+        if(static_cast<int>(exampleIdx) < exampleSetSize)
+        {
+          find_candidates(grid, exampleIdx, candidates);
+
+          const ExampleType& centreExample = exampleSet[exampleIdx];
+          const float centreDensity = exampleSetDensities[exampleIdx];
+          float minDistanceSq = tauSq;
+
+          for(size_t i = 0, size = candidates.size(); i < size; ++i)
+          {
+            const int otherIdx = candidates[i];
+            if(otherIdx == static_cast<int>(exampleIdx)) continue;
+
+            const float otherDistSq = distance_squared(centreExample, exampleSet[otherIdx]);
+            if(exampleSetDensities[otherIdx] > centreDensity && otherDistSq < minDistanceSq)
+            {
+              minDistanceSq = otherDistSq;
+              parentIdx = otherIdx;
+            }
+          }
+
+          // If the example is a subtree root, grab a unique cluster index for it. Since each example set is
+          // processed by a single thread, there is no need for this to be done atomically.
+          if(parentIdx == static_cast<int>(exampleIdx))
+          {
+            clusterIdx = nbClustersPerExampleSet[exampleSetIdx]++;
+          }
+        }
+
+        parents[exampleSetOffset + exampleIdx] = parentIdx;
+        clusterIndices[exampleSetOffset + exampleIdx] = clusterIdx;
+      }
     }
   }
 }
@@ -121,6 +206,31 @@ void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::create_selected_
   }
 }
 
+template <typename ExampleType, typename ClusterType, int MaxClusters>
+void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::gather_changed_example_sets(const ExampleImage_CPtr& exampleSets, const ITMIntMemoryBlock_CPtr& exampleSetSizes,
+                                                                                            uint32_t changedExampleSetCount)
+{
+  const int exampleSetCapacity = exampleSets->noDims.width;
+  const ExampleType *exampleSetsData = exampleSets->GetData(MEMORYDEVICE_CPU);
+  const int *exampleSetSizesData = exampleSetSizes->GetData(MEMORYDEVICE_CPU);
+  const int *changedExampleSetIndices = this->m_changedExampleSetIndices->GetData(MEMORYDEVICE_CPU);
+  ExampleType *gatheredExampleSets = this->m_gatheredExampleSets->GetData(MEMORYDEVICE_CPU);
+  int *gatheredExampleSetSizes = this->m_gatheredExampleSetSizes->GetData(MEMORYDEVICE_CPU);
+
+#ifdef WITH_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < static_cast<int>(changedExampleSetCount); ++i)
+  {
+    // Note that only the valid examples in each set are copied (the clustering never looks at the others).
+    const int exampleSetIdx = changedExampleSetIndices[i];
+    const int exampleSetSize = exampleSetSizesData[exampleSetIdx];
+    const ExampleType *exampleSet = exampleSetsData + exampleSetIdx * exampleSetCapacity;
+    std::copy(exampleSet, exampleSet + exampleSetSize, gatheredExampleSets + i * exampleSetCapacity);
+    gatheredExampleSetSizes[i] = exampleSetSize;
+  }
+}
+
 template <typename ExampleType, typename ClusterType, int MaxClusters>
 typename ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::ClusterContainer *
 ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::get_pointer_to_cluster_container(const ClusterContainers_Ptr& clusterContainers, uint32_t exampleSetIdx) const
@@ -169,24 +279,163 @@ void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::reset_temporarie
   }
 }
 
+template <typename ExampleType, typename ClusterType, int MaxClusters>
+void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::scatter_changed_cluster_containers(const ClusterContainers_Ptr& clusterContainers, uint32_t changedExampleSetCount)
+{
+  ClusterContainer *clusterContainersData = clusterContainers->GetData(MEMORYDEVICE_CPU);
+  const int *changedExampleSetIndices = this->m_changedExampleSetIndices->GetData(MEMORYDEVICE_CPU);
+  const ClusterContainer *gatheredClusterContainers = this->m_gatheredClusterContainers->GetData(MEMORYDEVICE_CPU);
+
+  for(uint32_t i = 0; i < changedExampleSetCount; ++i)
+  {
+    clusterContainersData[changedExampleSetIndices[i]] = gatheredClusterContainers[i];
+  }
+}
+
 template <typename ExampleType, typename ClusterType, int MaxClusters>
 void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::select_clusters(uint32_t exampleSetCapacity, uint32_t exampleSetCount)
 {
-  const int *clusterSizeHistograms = this->m_clusterSizeHistograms->GetData(MEMORYDEVICE_CPU);
   const int *clusterSizes = this->m_clusterSizes->GetData(MEMORYDEVICE_CPU);
   const int *nbClustersPerExampleSet = this->m_nbClustersPerExampleSet->GetData(MEMORYDEVICE_CPU);
   int *selectedClusters = this->m_selectedClusters->GetData(MEMORYDEVICE_CPU);
 
+  const int maxSelectedClusters = static_cast<int>(this->m_maxClusterCount);
+  const int minClusterSize = static_cast<int>(this->m_minClusterSize);
+
 #ifdef WITH_OPENMP
-  #pragma omp parallel for
+  #pragma omp parallel
 #endif
-  for(int exampleSetIdx = 0; exampleSetIdx < static_cast<int>(exampleSetCount); ++exampleSetIdx)
   {
-    select_clusters_for_set(
-      exampleSetIdx, clusterSizes, clusterSizeHistograms, nbClustersPerExampleSet,
-      exampleSetCapacity, this->m_maxClusterCount, this->m_minClusterSize, selectedClusters
-    );
+    std::vector<int> candidates;
+
+#ifdef WITH_OPENMP
+    #pragma omp for
+#endif
+    for(int exampleSetIdx = 0; exampleSetIdx < static_cast<int>(exampleSetCount); ++exampleSetIdx)
+    {
+      const int *exampleSetClusterSizes = clusterSizes + exampleSetIdx * exampleSetCapacity;
+      int *exampleSetSelectedClusters = selectedClusters + exampleSetIdx * maxSelectedClusters;
+
+      // Collect all of the clusters that are large enough to keep.
+      candidates.clear();
+      for(int clusterIdx = 0; clusterIdx < nbClustersPerExampleSet[exampleSetIdx]; ++clusterIdx)
+      {
+        if(exampleSetClusterSizes[clusterIdx] >= minClusterSize) candidates.push_back(clusterIdx);
+      }
+
+      // Partially sort them to find the largest ones. Ties are broken in favour of the clusters with the lowest
+      // indices, so the clusters selected are the same as the ones that select_clusters_for_set would select.
+      const int nbSelectedClusters = std::min(static_cast<int>(candidates.size()), maxSelectedClusters);
+      std::partial_sort(candidates.begin(), candidates.begin() + nbSelectedClusters, candidates.end(), LargerCluster(exampleSetClusterSizes));
+
+      // Write the selected clusters into the selected clusters image in ascending order of index, and then order them
+      // in exactly the same way as select_clusters_for_set does (its sort is not stable, so this affects equal-sized clusters).
+      std::sort(candidates.begin(), candidates.begin() + nbSelectedClusters);
+      for(int i = 0; i < maxSelectedClusters; ++i)
+      {
+        exampleSetSelectedClusters[i] = i < nbSelectedClusters ? candidates[i] : -1;
+      }
+
+      sort_selected_clusters(exampleSetClusterSizes, exampleSetSelectedClusters, nbSelectedClusters);
+    }
+  }
+}
+
+//#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+
+template <typename ExampleType, typename ClusterType, int MaxClusters>
+void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::build_grid(const ExampleType *exampleSet, int exampleCount, float radius, ExampleGrid& grid)
+{
+  grid.exampleCells.resize(exampleCount);
+  grid.exampleIndices.resize(exampleCount);
+
+  // Compute the bounding box of the examples.
+  Vector3f minPos(0.0f, 0.0f, 0.0f), maxPos(0.0f, 0.0f, 0.0f);
+  for(int i = 0; i < exampleCount; ++i)
+  {
+    const Vector3f pos = example_position(exampleSet[i]);
+    if(i == 0) minPos = maxPos = pos;
+    for(int j = 0; j < 3; ++j)
+    {
+      minPos[j] = std::min(minPos[j], pos[j]);
+      maxPos[j] = std::max(maxPos[j], pos[j]);
+    }
   }
+
+  // Choose the cell size. This is made very slightly larger than the radius, so that examples that are within the radius
+  // of each other cannot end up two cells apart due to rounding errors. If that would produce an excessive number of cells
+  // (e.g. because the examples are very spread out), the cell size is increased until the number of cells is reasonable.
+  const float maxCellCount = 8.0f * std::max(exampleCount, 1);
+  float cellSize = std::max(radius * 1.001f, 1e-6f);
+  for(;;)
+  {
+    float cellCount = 1.0f;
+    for(int j = 0; j < 3; ++j)
+    {
+      grid.size[j] = static_cast<int>((maxPos[j] - minPos[j]) / cellSize) + 1;
+      cellCount *= grid.size[j];
+    }
+
+    if(cellCount <= maxCellCount) break;
+    cellSize *= 2.0f;
+  }
+
+  // Compute the cell containing each example, and count the number of examples in each cell.
+  const int cellCount = grid.size.x * grid.size.y * grid.size.z;
+  grid.cellStarts.assign(cellCount + 1, 0);
+
+  const float invCellSize = 1.0f / cellSize;
+  for(int i = 0; i < exampleCount; ++i)
+  {
+    const Vector3f pos = example_position(exampleSet[i]);
+    Vector3i& cell = grid.exampleCells[i];
+    for(int j = 0; j < 3; ++j)
+    {
+      cell[j] = std::min(std::max(static_cast<int>((pos[j] - minPos[j]) * invCellSize), 0), grid.size[j] - 1);
+    }
+
+    ++grid.cellStarts[(cell.z * grid.size.y + cell.y) * grid.size.x + cell.x + 1];
+  }
+
+  // Turn the counts into offsets, and then use them to sort the examples by cell (this is a counting sort,
+  // so the examples within each cell end up in ascending order of index).
+  for(int i = 0; i < cellCount; ++i)
+  {
+    grid.cellStarts[i + 1] += grid.cellStarts[i];
+  }
+
+  std::vector<int>& cellCursors = grid.cellCursors;
+  cellCursors.assign(grid.cellStarts.begin(), grid.cellStarts.end() - 1);
+  for(int i = 0; i < exampleCount; ++i)
+  {
+    const Vector3i& cell = grid.exampleCells[i];
+    grid.exampleIndices[cellCursors[(cell.z * grid.size.y + cell.y) * grid.size.x + cell.x]++] = i;
+  }
+}
+
+template <typename ExampleType, typename ClusterType, int MaxClusters>
+void ExampleClusterer_CPU<ExampleType,ClusterType,MaxClusters>::find_candidates(const ExampleGrid& grid, int exampleIdx, std::vector<int>& candidates)
+{
+  candidates.clear();
+
+  const Vector3i& cell = grid.exampleCells[exampleIdx];
+  for(int z = std::max(cell.z - 1, 0), zEnd = std::min(cell.z + 1, grid.size.z - 1); z <= zEnd; ++z)
+  {
+    for(int y = std::max(cell.y - 1, 0), yEnd = std::min(cell.y + 1, grid.size.y - 1); y <= yEnd; ++y)
+    {
+      // The cells in a row of the grid are contiguous, so their examples can be copied across together.
+      const int rowOffset = (z * grid.size.y + y) * grid.size.x;
+      const int xBegin = std::max(cell.x - 1, 0), xEnd = std::min(cell.x + 1, grid.size.x - 1);
+      candidates.insert(
+        candidates.end(),
+        grid.exampleIndices.begin() + grid.cellStarts[rowOffset + xBegin],
+        grid.exampleIndices.begin() + grid.cellStarts[rowOffset + xEnd + 1]
+      );
+    }
+  }
+
+  // Put the candidates into ascending order of index, so that they are visited in the same order as in an exhaustive search.
+  std::sort(candidates.begin(), candidates.end());
 }
 
 }
@@ -6,6 +6,8 @@
 #ifndef H_GROVE_EXAMPLECLUSTERER
 #define H_GROVE_EXAMPLECLUSTERER
 
+#include <vector>
+
 #include <itmx/base/ITMImagePtrTypes.h>
 #include <itmx/base/ITMMemoryBlockPtrTypes.h>
 
@@ -35,6 +37,15 @@ namespace grove {
  *
  *           Aggregates all the examples in the examples array that have a certain key into a single cluster.
  *
+ *        3) _CPU_AND_GPU_CODE_ inline Vector3f example_position(const ExampleType& example);
+ *
+ *           Returns the position of an example in 3D space. This is used by the CPU clusterer to bin the examples
+ *           into a spatial grid, and so distance_squared must be the squared Euclidean distance between positions.
+ *
+ * \note  The clusterer can also be used incrementally (see cluster_changed_examples). In that mode, it remembers a version
+ *        number (e.g. the number of add calls made for the corresponding example reservoir) for each example set it
+ *        has clustered, and only reclusters the sets whose version numbers have changed since.
+ *
  * \param ExampleType  The type of example to cluster.
  * \param ClusterType  The type of cluster being generated.
  * \param MaxClusters  The maximum number of clusters being generated for each set of examples.
@@ -48,6 +59,7 @@ protected:
   typedef ORUtils::MemoryBlock<ClusterContainer> ClusterContainers;
   typedef boost::shared_ptr<ClusterContainers> ClusterContainers_Ptr;
   typedef ORUtils::Image<ExampleType> ExampleImage;
+  typedef boost::shared_ptr<ExampleImage> ExampleImage_Ptr;
   typedef boost::shared_ptr<const ExampleImage> ExampleImage_CPtr;
 
   //#################### PROTECTED VARIABLES ####################
@@ -103,6 +115,34 @@ protected:
   /** An image storing the indices of the selected clusters in each example set. Has exampleSetCount rows and m_maxClusterCount columns. */
   ITMIntImage_Ptr m_selectedClusters;
 
+  //##################### CLUSTER CHANGED EXAMPLES VARIABLES #####################
+  //                                                                            //
+  // These variables are used to store the state needed when invoking:          //
+  //                                                                            //
+  // cluster_changed_examples(exampleSets, exampleSetSizes, exampleSetVersions, //
+  //                          exampleSetStart, exampleSetCount,                 //
+  //                          clusterContainers);                               //
+  //                                                                            //
+  //##############################################################################
+protected:
+  /** The indices of the example sets that have changed since they were last clustered (only the first changedExampleSetCount elements are valid). */
+  ITMIntMemoryBlock_Ptr m_changedExampleSetIndices;
+
+  /**
+   * The version of each example set at the point at which it was last clustered by cluster_changed_examples
+   * (or -1 if it has not yet been clustered). Has an element for each example set that has been seen so far.
+   */
+  std::vector<int> m_clusteredExampleSetVersions;
+
+  /** The cluster containers for the changed example sets (one element per changed set), prior to being scattered back to the caller's containers. */
+  ClusterContainers_Ptr m_gatheredClusterContainers;
+
+  /** The changed example sets, gathered into consecutive rows of an image so that they can be clustered in a single pass. */
+  ExampleImage_Ptr m_gatheredExampleSets;
+
+  /** The sizes of the changed example sets (one element per changed set). */
+  ITMIntMemoryBlock_Ptr m_gatheredExampleSetSizes;
+
   //#################### CONSTRUCTORS ####################
 public:
   /**
@@ -142,6 +182,40 @@ public:
   void cluster_examples(const ExampleImage_CPtr& exampleSets, const ITMIntMemoryBlock_CPtr& exampleSetSizes,
                         uint32_t exampleSetStart, uint32_t exampleSetCount, ClusterContainers_Ptr& clusterContainers);
 
+  /**
+   * \brief Reclusters those of the specified example sets that have changed since they were last clustered by this function.
+   *
+   * An example set is deemed to have changed if its current version differs from the version it had when it was last
+   * clustered. The clusters of the other example sets are left untouched in the output containers, so the caller must
+   * pass in the same cluster containers each time. The changed example sets are gathered together and clustered in a
+   * single pass, so the cost of a call is proportional to the number of changed sets rather than to exampleSetCount.
+   *
+   * \note The clustering is a deterministic function of the examples in each set, so the result is the same as if
+   *       cluster_examples had been called, provided that an example set's version changes whenever its contents do.
+   *       When the example sets are the rows of a set of example reservoirs, their add call counts can be used as the
+   *       versions, but forget_example_set_versions must then be called whenever the reservoirs are reset.
+   *
+   * \param exampleSets         An image containing the sets of examples to be clustered (one set per row). The width of
+   *                            the image specifies the maximum number of examples that can be contained in each set.
+   * \param exampleSetSizes     The number of valid examples in each example set.
+   * \param exampleSetVersions  The current version of each example set (must be non-negative).
+   * \param exampleSetStart     The index of the first example set to consider.
+   * \param exampleSetCount     The number of example sets to consider.
+   * \param clusterContainers   Output containers that hold the clusters computed for each example set.
+   * \return                    The number of example sets that were reclustered.
+   *
+   * \throws std::invalid_argument If exampleSetStart + exampleSetCount would result in out-of-bounds access in exampleSets.
+   */
+  uint32_t cluster_changed_examples(const ExampleImage_CPtr& exampleSets, const ITMIntMemoryBlock_CPtr& exampleSetSizes,
+                                    const ITMIntMemoryBlock_CPtr& exampleSetVersions, uint32_t exampleSetStart,
+                                    uint32_t exampleSetCount, ClusterContainers_Ptr& clusterContainers);
+
+  /**
+   * \brief Forgets the versions of the example sets that have been clustered by cluster_changed_examples,
+   *        so that every example set will be reclustered the next time it is considered.
+   */
+  void forget_example_set_versions();
+
   //#################### PRIVATE ABSTRACT MEMBER FUNCTIONS ####################
 private:
   /**
@@ -200,6 +274,19 @@ private:
   virtual void create_selected_clusters(const ExampleType *exampleSets, const int *exampleSetSizes, uint32_t exampleSetCapacity,
                                         uint32_t exampleSetCount, ClusterContainer *clusterContainers) = 0;
 
+  /**
+   * \brief Copies the example sets whose indices are stored in m_changedExampleSetIndices (and their sizes) into
+   *        consecutive rows of m_gatheredExampleSets (and consecutive elements of m_gatheredExampleSetSizes).
+   *
+   * \note Only the valid examples in each set need to be copied.
+   *
+   * \param exampleSets             An image containing the sets of examples to be clustered (one set per row).
+   * \param exampleSetSizes         The number of valid examples in each example set.
+   * \param changedExampleSetCount  The number of changed example sets.
+   */
+  virtual void gather_changed_example_sets(const ExampleImage_CPtr& exampleSets, const ITMIntMemoryBlock_CPtr& exampleSetSizes,
+                                           uint32_t changedExampleSetCount) = 0;
+
   /**
    * \brief Gets a raw pointer to the cluster container for the specified example set.
    *
@@ -244,6 +331,15 @@ private:
    */
   virtual void reset_temporaries(uint32_t exampleSetCapacity, uint32_t exampleSetCount) = 0;
 
+  /**
+   * \brief Copies the cluster containers in m_gatheredClusterContainers back to the elements of the specified cluster
+   *        containers that correspond to the example sets whose indices are stored in m_changedExampleSetIndices.
+   *
+   * \param clusterContainers       The cluster containers for all of the example sets.
+   * \param changedExampleSetCount  The number of changed example sets.
+   */
+  virtual void scatter_changed_cluster_containers(const ClusterContainers_Ptr& clusterContainers, uint32_t changedExampleSetCount) = 0;
+
   /**
    * \brief Selects the largest clusters for each example set (up to a maximum limit).
    *
@@ -254,6 +350,18 @@ private:
 
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
+  /**
+   * \brief Clusters a number of consecutive example sets.
+   *
+   * \param exampleSets         A pointer to the first example of the first example set to cluster.
+   * \param exampleSetSizes     A pointer to the size of the first example set to cluster.
+   * \param exampleSetCapacity  The maximum size of each example set.
+   * \param exampleSetCount     The number of example sets to cluster.
+   * \param clusterContainers   A pointer to the cluster container for the first example set to cluster.
+   */
+  void cluster_example_sets(const ExampleType *exampleSets, const int *exampleSetSizes, uint32_t exampleSetCapacity,
+                            uint32_t exampleSetCount, ClusterContainer *clusterContainers);
+
   /**
    * \brief Reallocates the temporary variables needed during a cluster_examples call as necessary.
    *
@@ -261,6 +369,14 @@ private:
    * \param exampleSetCount    The number of example sets being clustered.
    */
   void reallocate_temporaries(uint32_t exampleSetCapacity, uint32_t exampleSetCount);
+
+  /**
+   * \brief Reallocates the variables used to gather the changed example sets during a cluster_changed_examples call as necessary.
+   *
+   * \param exampleSetCapacity      The maximum size of each example set.
+   * \param changedExampleSetCount  The number of changed example sets.
+   */
+  void reallocate_gathered_example_sets(uint32_t exampleSetCapacity, uint32_t changedExampleSetCount);
 };
 
 }
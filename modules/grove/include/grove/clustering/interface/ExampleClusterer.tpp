@@ -5,6 +5,7 @@
 
 #include "ExampleClusterer.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include <itmx/base/MemoryBlockFactory.h>
@@ -34,6 +35,12 @@ ExampleClusterer<ExampleType, ClusterType, MaxClusters>::ExampleClusterer(float
   m_nbClustersPerExampleSet = mbf.make_block<int>();
   m_parents = mbf.make_image<int>();
   m_selectedClusters = mbf.make_image<int>();
+
+  // Likewise for the variables used as part of a cluster_changed_examples call.
+  m_changedExampleSetIndices = mbf.make_block<int>();
+  m_gatheredClusterContainers = mbf.make_block<ClusterContainer>();
+  m_gatheredExampleSets = mbf.make_image<ExampleType>();
+  m_gatheredExampleSetSizes = mbf.make_block<int>();
 }
 
 //#################### DESTRUCTOR ####################
@@ -56,6 +63,119 @@ void ExampleClusterer<ExampleType,ClusterType,MaxClusters>::cluster_examples(con
     throw std::invalid_argument("Error: exampleSetStart + exampleSetCount > nbExampleSets");
   }
 
+  // Cluster the example sets of interest.
+  const ExampleType *exampleSetsData = get_pointer_to_example_set(exampleSets, exampleSetStart);
+  const int *exampleSetSizesData = get_pointer_to_example_set_size(exampleSetSizes, exampleSetStart);
+  ClusterContainer *clusterContainersPtr = get_pointer_to_cluster_container(clusterContainers, exampleSetStart);
+  cluster_example_sets(exampleSetsData, exampleSetSizesData, exampleSetCapacity, exampleSetCount, clusterContainersPtr);
+
+#if 0
+  // For debugging purposes only.
+  m_nbClustersPerExampleSet->UpdateHostFromDevice();
+  m_clusterSizes->UpdateHostFromDevice();
+  exampleSetSizes->UpdateHostFromDevice();
+
+  for(uint32_t i = 0; i < exampleSetCount; ++i)
+  {
+    std::cout << "Example set " << i + exampleSetStart << " has "
+              << m_nbClustersPerExampleSet->GetData(MEMORYDEVICE_CPU)[i + exampleSetStart] << " clusters and "
+              << m_clusterSizes->GetData(MEMORYDEVICE_CPU)[i + exampleSetStart] << " elements.\n";
+
+    for(int j = 0; j < m_nbClustersPerExampleSet->GetData(MEMORYDEVICE_CPU)[i + exampleSetStart]; ++j)
+    {
+      std::cout << "\tCluster " << j << ": "
+                << m_clusterSizes->GetData(MEMORYDEVICE_CPU)[(i + exampleSetStart) * exampleSetCapacity + j] << " elements.\n";
+    }
+  }
+#endif
+}
+
+template <typename ExampleType, typename ClusterType, int MaxClusters>
+uint32_t ExampleClusterer<ExampleType,ClusterType,MaxClusters>::cluster_changed_examples(const ExampleImage_CPtr& exampleSets, const ITMIntMemoryBlock_CPtr& exampleSetSizes,
+                                                                                         const ITMIntMemoryBlock_CPtr& exampleSetVersions, uint32_t exampleSetStart,
+                                                                                         uint32_t exampleSetCount, ClusterContainers_Ptr& clusterContainers)
+{
+  const uint32_t nbExampleSets = exampleSets->noDims.height;
+  const uint32_t exampleSetCapacity = exampleSets->noDims.width;
+
+  if(exampleSetStart + exampleSetCount > nbExampleSets)
+  {
+    throw std::invalid_argument("Error: exampleSetStart + exampleSetCount > nbExampleSets");
+  }
+
+  // Make sure that we have a recorded version for every example set (initially, none of them has been clustered).
+  if(m_clusteredExampleSetVersions.size() < nbExampleSets)
+  {
+    m_clusteredExampleSetVersions.resize(nbExampleSets, -1);
+  }
+
+  if(m_changedExampleSetIndices->dataSize < exampleSetCount)
+  {
+    m_changedExampleSetIndices->Resize(exampleSetCount);
+  }
+
+  // Find the example sets of interest whose versions have changed since they were last clustered.
+  // Note that the versions are compared on the CPU, since the number of example sets is small.
+  exampleSetVersions->UpdateHostFromDevice();
+  const int *exampleSetVersionsData = exampleSetVersions->GetData(MEMORYDEVICE_CPU);
+  int *changedExampleSetIndices = m_changedExampleSetIndices->GetData(MEMORYDEVICE_CPU);
+
+  uint32_t changedExampleSetCount = 0;
+  for(uint32_t exampleSetIdx = exampleSetStart, end = exampleSetStart + exampleSetCount; exampleSetIdx < end; ++exampleSetIdx)
+  {
+    if(exampleSetVersionsData[exampleSetIdx] != m_clusteredExampleSetVersions[exampleSetIdx])
+    {
+      changedExampleSetIndices[changedExampleSetCount++] = static_cast<int>(exampleSetIdx);
+    }
+  }
+
+  // If none of the example sets of interest has changed, their existing clusters are still valid, so early out.
+  if(changedExampleSetCount == 0) return 0;
+
+  if(changedExampleSetCount == exampleSetCount)
+  {
+    // If all of the example sets of interest have changed, they are already contiguous, so cluster them in place.
+    cluster_examples(exampleSets, exampleSetSizes, exampleSetStart, exampleSetCount, clusterContainers);
+  }
+  else
+  {
+    // Otherwise, gather the changed example sets together, cluster them, and scatter the resulting clusters back
+    // to the corresponding cluster containers. The clusters of the unchanged example sets are left as they are.
+    reallocate_gathered_example_sets(exampleSetCapacity, changedExampleSetCount);
+    gather_changed_example_sets(exampleSets, exampleSetSizes, changedExampleSetCount);
+
+    cluster_example_sets(
+      get_pointer_to_example_set(m_gatheredExampleSets, 0),
+      get_pointer_to_example_set_size(m_gatheredExampleSetSizes, 0),
+      exampleSetCapacity, changedExampleSetCount,
+      get_pointer_to_cluster_container(m_gatheredClusterContainers, 0)
+    );
+
+    scatter_changed_cluster_containers(clusterContainers, changedExampleSetCount);
+  }
+
+  // Record the versions of the example sets that have just been clustered.
+  for(uint32_t i = 0; i < changedExampleSetCount; ++i)
+  {
+    const int exampleSetIdx = changedExampleSetIndices[i];
+    m_clusteredExampleSetVersions[exampleSetIdx] = exampleSetVersionsData[exampleSetIdx];
+  }
+
+  return changedExampleSetCount;
+}
+
+template <typename ExampleType, typename ClusterType, int MaxClusters>
+void ExampleClusterer<ExampleType,ClusterType,MaxClusters>::forget_example_set_versions()
+{
+  std::fill(m_clusteredExampleSetVersions.begin(), m_clusteredExampleSetVersions.end(), -1);
+}
+
+//#################### PRIVATE MEMBER FUNCTIONS ####################
+
+template <typename ExampleType, typename ClusterType, int MaxClusters>
+void ExampleClusterer<ExampleType,ClusterType,MaxClusters>::cluster_example_sets(const ExampleType *exampleSets, const int *exampleSetSizes, uint32_t exampleSetCapacity,
+                                                                                 uint32_t exampleSetCount, ClusterContainer *clusterContainers)
+{
   // Reallocate the temporary variables needed for the call as necessary. In practice, this tends to be a no-op for
   // all calls to cluster_examples except the first, since we only need to reallocate if more memory is required,
   // and the way in which cluster_examples is usually called tends not to cause this to happen.
@@ -65,18 +185,15 @@ void ExampleClusterer<ExampleType,ClusterType,MaxClusters>::cluster_examples(con
   reset_temporaries(exampleSetCapacity, exampleSetCount);
 
   // Reset the cluster containers for each example set of interest.
-  ClusterContainer *clusterContainersPtr = get_pointer_to_cluster_container(clusterContainers, exampleSetStart);
-  reset_cluster_containers(clusterContainersPtr, exampleSetCount);
+  reset_cluster_containers(clusterContainers, exampleSetCount);
 
   // Compute the density of examples around each example in the example sets of interest.
-  const ExampleType *exampleSetsData = get_pointer_to_example_set(exampleSets, exampleSetStart);
-  const int *exampleSetSizesData = get_pointer_to_example_set_size(exampleSetSizes, exampleSetStart);
-  compute_densities(exampleSetsData, exampleSetSizesData, exampleSetCapacity, exampleSetCount);
+  compute_densities(exampleSets, exampleSetSizes, exampleSetCapacity, exampleSetCount);
 
   // Compute the parent and initial cluster indices to assign to each example as part of the neighbour-linking
   // step of the really quick shift (RQS) algorithm. The algorithm links neighbouring examples in a tree structure,
   // separating example clusters based on a distance tau.
-  compute_parents(exampleSetsData, exampleSetSizesData, exampleSetCapacity, exampleSetCount, m_tau * m_tau);
+  compute_parents(exampleSets, exampleSetSizes, exampleSetCapacity, exampleSetCount, m_tau * m_tau);
 
   // Compute the final cluster indices to assign to each example by following the parent links just computed.
   compute_cluster_indices(exampleSetCapacity, exampleSetCount);
@@ -88,31 +205,9 @@ void ExampleClusterer<ExampleType,ClusterType,MaxClusters>::cluster_examples(con
   select_clusters(exampleSetCapacity, exampleSetCount);
 
   // Finally, compute the parameters for and store each selected cluster for each example set.
-  create_selected_clusters(exampleSetsData, exampleSetSizesData, exampleSetCapacity, exampleSetCount, clusterContainersPtr);
-
-#if 0
-  // For debugging purposes only.
-  m_nbClustersPerExampleSet->UpdateHostFromDevice();
-  m_clusterSizes->UpdateHostFromDevice();
-  exampleSetSizes->UpdateHostFromDevice();
-
-  for(uint32_t i = 0; i < exampleSetCount; ++i)
-  {
-    std::cout << "Example set " << i + exampleSetStart << " has "
-              << m_nbClustersPerExampleSet->GetData(MEMORYDEVICE_CPU)[i + exampleSetStart] << " clusters and "
-              << m_clusterSizes->GetData(MEMORYDEVICE_CPU)[i + exampleSetStart] << " elements.\n";
-
-    for(int j = 0; j < m_nbClustersPerExampleSet->GetData(MEMORYDEVICE_CPU)[i + exampleSetStart]; ++j)
-    {
-      std::cout << "\tCluster " << j << ": "
-                << m_clusterSizes->GetData(MEMORYDEVICE_CPU)[(i + exampleSetStart) * exampleSetCapacity + j] << " elements.\n";
-    }
-  }
-#endif
+  create_selected_clusters(exampleSets, exampleSetSizes, exampleSetCapacity, exampleSetCount, clusterContainers);
 }
 
-//#################### PRIVATE MEMBER FUNCTIONS ####################
-
 template <typename ExampleType, typename ClusterType, int MaxClusters>
 void ExampleClusterer<ExampleType,ClusterType,MaxClusters>::reallocate_temporaries(uint32_t exampleSetCapacity, uint32_t exampleSetCount)
 {
@@ -143,4 +238,22 @@ void ExampleClusterer<ExampleType,ClusterType,MaxClusters>::reallocate_temporari
   }
 }
 
+template <typename ExampleType, typename ClusterType, int MaxClusters>
+void ExampleClusterer<ExampleType,ClusterType,MaxClusters>::reallocate_gathered_example_sets(uint32_t exampleSetCapacity, uint32_t changedExampleSetCount)
+{
+  // As in reallocate_temporaries, we only reallocate if more memory is required (or if the capacity of the example sets has changed,
+  // since the width of the image of gathered example sets must match it).
+  const Vector2i oldImgSize = m_gatheredExampleSets->noDims;
+  if(oldImgSize.width != static_cast<int>(exampleSetCapacity) || oldImgSize.height < static_cast<int>(changedExampleSetCount))
+  {
+    m_gatheredExampleSets->ChangeDims(Vector2i(static_cast<int>(exampleSetCapacity), static_cast<int>(changedExampleSetCount)));
+  }
+
+  if(m_gatheredExampleSetSizes->dataSize < changedExampleSetCount)
+  {
+    m_gatheredClusterContainers->Resize(changedExampleSetCount);
+    m_gatheredExampleSetSizes->Resize(changedExampleSetCount);
+  }
+}
+
 }
@@ -321,6 +321,47 @@ inline void reset_temporaries_for_set(int exampleSetIdx, int exampleSetCapacity,
   }
 }
 
+/**
+ * \brief Sorts the clusters selected for an example set in non-increasing order of size.
+ *
+ * \note Selection sort is quadratic, but the number of selected clusters is small enough for now that it doesn't matter.
+ *       It is not stable, so the order of clusters of equal size depends on the order in which they were selected:
+ *       callers that need to produce the same output as select_clusters_for_set should pass in the selected clusters
+ *       in ascending order of cluster index.
+ *
+ * \param clusterSizes       The sizes of the clusters extracted from the example set.
+ * \param selectedClusters   The indices of the clusters selected for the example set.
+ * \param nbSelectedClusters The number of clusters selected for the example set.
+ */
+_CPU_AND_GPU_CODE_
+inline void sort_selected_clusters(const int *clusterSizes, int *selectedClusters, int nbSelectedClusters)
+{
+  for(int i = 0; i < nbSelectedClusters; ++i)
+  {
+    // Find a cluster with maximum size in selectedClusters[i..nbSelectedClusters).
+    int maxSize = clusterSizes[selectedClusters[i]];
+    int maxIdx = i;
+
+    for(int j = i + 1; j < nbSelectedClusters; ++j)
+    {
+      int size = clusterSizes[selectedClusters[j]];
+      if(size > maxSize)
+      {
+        maxSize = size;
+        maxIdx = j;
+      }
+    }
+
+    // If selectedClusters[i] wasn't the maximal cluster, swap it with the cluster that was.
+    if(maxIdx != i)
+    {
+      int temp = selectedClusters[i];
+      selectedClusters[i] = selectedClusters[maxIdx];
+      selectedClusters[maxIdx] = temp;
+    }
+  }
+}
+
 /**
  * \brief Selects the largest clusters for the specified example set and writes their indices into the selected clusters image.
  *
@@ -384,32 +425,8 @@ inline void select_clusters_for_set(int exampleSetIdx, const int *clusterSizes,
     }
   }
 
-  // Sort the selected clusters in non-increasing order of size using a simple selection sort.
-  // Note: Selection sort is quadratic, but the number of clusters is small enough for now that it doesn't matter.
-  for(int i = 0; i < nbSelectedClusters; ++i)
-  {
-    // Find a cluster with maximum size in selectedClusters[i..nbSelectedClusters).
-    int maxSize = clusterSizes[exampleSetOffset + selectedClusters[selectedClustersOffset + i]];
-    int maxIdx = i;
-
-    for(int j = i + 1; j < nbSelectedClusters; ++j)
-    {
-      int size = clusterSizes[exampleSetOffset + selectedClusters[selectedClustersOffset + j]];
-      if(size > maxSize)
-      {
-        maxSize = size;
-        maxIdx = j;
-      }
-    }
-
-    // If selectedClusters[i] wasn't the maximal cluster, swap it with the cluster that was.
-    if(maxIdx != i)
-    {
-      int temp = selectedClusters[selectedClustersOffset + i];
-      selectedClusters[selectedClustersOffset + i] = selectedClusters[selectedClustersOffset + maxIdx];
-      selectedClusters[selectedClustersOffset + maxIdx] = temp;
-    }
-  }
+  // Sort the selected clusters in non-increasing order of size.
+  sort_selected_clusters(clusterSizes + exampleSetOffset, selectedClusters + selectedClustersOffset, nbSelectedClusters);
 }
 
 /**
@@ -61,6 +61,28 @@ struct FeatureCalculatorFactory
    * \return            The feature calculator.
    */
   static RGBPatchFeatureCalculator_Ptr make_rgb_patch_feature_calculator(ITMLib::ITMLibSettings::DeviceType deviceType);
+
+  /**
+   * \brief Makes a DA-RGBD patch feature calculator that computes quantised (8-bit) descriptors.
+   *
+   * The features are the same as those computed by the calculator returned by make_da_rgbd_patch_feature_calculator,
+   * but are stored in fixed point (see QuantisedDescriptor).
+   *
+   * \param deviceType  The device on which the feature calculator should operate.
+   * \return            The feature calculator.
+   */
+  static Quantised_DA_RGBDPatchFeatureCalculator_Ptr make_quantised_da_rgbd_patch_feature_calculator(ITMLib::ITMLibSettings::DeviceType deviceType);
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Makes a DA-RGBD patch feature calculator that computes descriptors of the specified type.
+   *
+   * \param deviceType  The device on which the feature calculator should operate.
+   * \return            The feature calculator.
+   */
+  template <typename DescriptorType>
+  static boost::shared_ptr<RGBDPatchFeatureCalculator<Keypoint3DColour,DescriptorType> > make_da_rgbd_patch_feature_calculator_for(ITMLib::ITMLibSettings::DeviceType deviceType);
 };
 
 }
@@ -21,6 +21,9 @@ struct Descriptor
   /** The length of the descriptor. */
   static const int FEATURE_COUNT = N;
 
+  /** Whether or not the descriptor's features are quantised (see QuantisedDescriptor). */
+  static const bool IS_QUANTISED = false;
+
   //#################### PUBLIC VARIABLES ####################
 
   /** The descriptor's features are stored in this array. */
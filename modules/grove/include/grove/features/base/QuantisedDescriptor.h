@@ -0,0 +1,68 @@
+/**
+ * grove: QuantisedDescriptor.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_GROVE_QUANTISEDDESCRIPTOR
+#define H_GROVE_QUANTISEDDESCRIPTOR
+
+#include <cmath>
+
+#include <ORUtils/PlatformIndependence.h>
+
+namespace grove {
+
+/**
+ * \brief An instance of an instantiation of this struct template represents a fixed-length feature descriptor whose features
+ *        have each been quantised to a signed 8-bit fixed-point value.
+ *
+ * A quantised descriptor is a quarter of the size of the corresponding floating-point descriptor (see Descriptor), which
+ * substantially reduces the memory traffic involved in evaluating a decision forest on a descriptors image. Each feature
+ * value v is stored as clamp(floor(v / step), -128, 127), where step is the quantisation step for the feature. A forest
+ * whose thresholds have been quantised using the same steps (see DecisionForest::quantise_thresholds) can then be used to
+ * evaluate quantised descriptors directly.
+ *
+ * \tparam N The length of the descriptor.
+ */
+template <int N>
+struct QuantisedDescriptor
+{
+  //#################### CONSTANTS ####################
+
+  /** The length of the descriptor. */
+  static const int FEATURE_COUNT = N;
+
+  /** Whether or not the descriptor's features are quantised. */
+  static const bool IS_QUANTISED = true;
+
+  /** The quantisation step used for depth difference features (in mm): this lets them cover a range of roughly +/- 2m. */
+  static const int DEPTH_STEP = 16;
+
+  /** The quantisation step used for colour difference features: this lets them cover the full range of +/- 255. */
+  static const int COLOUR_STEP = 2;
+
+  //#################### PUBLIC VARIABLES ####################
+
+  /** The descriptor's (quantised) features are stored in this array. */
+  signed char data[FEATURE_COUNT];
+};
+
+//#################### FUNCTIONS ####################
+
+/**
+ * \brief Quantises a feature value to a signed 8-bit fixed-point value.
+ *
+ * \param value The feature value.
+ * \param step  The quantisation step for the feature.
+ * \return      The quantised feature value, i.e. clamp(floor(value / step), -128, 127).
+ */
+_CPU_AND_GPU_CODE_
+inline signed char quantise_feature(float value, float step)
+{
+  const float q = floorf(value / step);
+  return static_cast<signed char>(q < -128.0f ? -128.0f : q > 127.0f ? 127.0f : q);
+}
+
+}
+
+#endif
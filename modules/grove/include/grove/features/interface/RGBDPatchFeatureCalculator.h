@@ -6,12 +6,15 @@
 #ifndef H_GROVE_RGBDPATCHFEATURECALCULATOR
 #define H_GROVE_RGBDPATCHFEATURECALCULATOR
 
+#include <vector>
+
 #include <itmx/base/ITMImagePtrTypes.h>
 #include <itmx/base/ITMMemoryBlockPtrTypes.h>
 
 #include <tvgutil/numbers/RandomNumberGenerator.h>
 
 #include "../base/Descriptor.h"
+#include "../base/QuantisedDescriptor.h"
 #include "../base/RGBDPatchFeatureDifferenceType.h"
 #include "../../keypoints/Keypoint2D.h"
 #include "../../keypoints/Keypoint3DColour.h"
@@ -177,6 +180,16 @@ public:
    */
   uint32_t get_feature_step() const;
 
+  /**
+   * \brief Gets the quantisation steps used for the features when this calculator computes quantised descriptors (see QuantisedDescriptor).
+   *
+   * These can be used to quantise the thresholds of a pre-trained forest (see DecisionForest::quantise_thresholds), so that
+   * it can be used to evaluate quantised descriptors.
+   *
+   * \return  The quantisation steps (one per feature in the descriptor). Features that are not computed have a step of 1.
+   */
+  std::vector<float> get_quantisation_steps() const;
+
   /**
    * \brief Sets the step used when selecting keypoints and computing the features.
    *
@@ -241,6 +254,16 @@ typedef RGBDPatchFeatureCalculator<Keypoint3DColour,RGBDPatchDescriptor> DA_RGBD
 typedef boost::shared_ptr<DA_RGBDPatchFeatureCalculator> DA_RGBDPatchFeatureCalculator_Ptr;
 typedef boost::shared_ptr<const DA_RGBDPatchFeatureCalculator> DA_RGBDPatchFeatureCalculator_CPtr;
 
+typedef QuantisedDescriptor<256> QuantisedRGBDPatchDescriptor;
+
+typedef ORUtils::Image<QuantisedRGBDPatchDescriptor> QuantisedRGBDPatchDescriptorImage;
+typedef boost::shared_ptr<QuantisedRGBDPatchDescriptorImage> QuantisedRGBDPatchDescriptorImage_Ptr;
+typedef boost::shared_ptr<const QuantisedRGBDPatchDescriptorImage> QuantisedRGBDPatchDescriptorImage_CPtr;
+
+typedef RGBDPatchFeatureCalculator<Keypoint3DColour,QuantisedRGBDPatchDescriptor> Quantised_DA_RGBDPatchFeatureCalculator;
+typedef boost::shared_ptr<Quantised_DA_RGBDPatchFeatureCalculator> Quantised_DA_RGBDPatchFeatureCalculator_Ptr;
+typedef boost::shared_ptr<const Quantised_DA_RGBDPatchFeatureCalculator> Quantised_DA_RGBDPatchFeatureCalculator_CPtr;
+
 }
 
 #endif
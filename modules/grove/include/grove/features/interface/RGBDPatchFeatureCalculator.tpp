@@ -5,6 +5,7 @@
 
 #include "RGBDPatchFeatureCalculator.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include <itmx/base/MemoryBlockFactory.h>
@@ -80,6 +81,17 @@ uint32_t RGBDPatchFeatureCalculator<KeypointType,DescriptorType>::get_feature_st
   return m_featureStep;
 }
 
+template <typename KeypointType, typename DescriptorType>
+std::vector<float> RGBDPatchFeatureCalculator<KeypointType,DescriptorType>::get_quantisation_steps() const
+{
+  typedef QuantisedDescriptor<DescriptorType::FEATURE_COUNT> QD;
+
+  std::vector<float> steps(DescriptorType::FEATURE_COUNT, 1.0f);
+  std::fill(steps.begin() + m_depthFeatureOffset, steps.begin() + m_depthFeatureOffset + m_depthFeatureCount, static_cast<float>(QD::DEPTH_STEP));
+  std::fill(steps.begin() + m_rgbFeatureOffset, steps.begin() + m_rgbFeatureOffset + m_rgbFeatureCount, static_cast<float>(QD::COLOUR_STEP));
+  return steps;
+}
+
 template <typename KeypointType, typename DescriptorType>
 void RGBDPatchFeatureCalculator<KeypointType,DescriptorType>::set_feature_step(uint32_t featureStep)
 {
@@ -10,12 +10,70 @@
 
 #include <ORUtils/MathUtils.h>
 
+#include "../base/Descriptor.h"
+#include "../base/QuantisedDescriptor.h"
 #include "../base/RGBDPatchFeatureDifferenceType.h"
 #include "../../keypoints/Keypoint2D.h"
 #include "../../keypoints/Keypoint3DColour.h"
 
 namespace grove {
 
+/**
+ * \brief Writes a colour feature into a floating-point descriptor.
+ *
+ * \param descriptor  The descriptor.
+ * \param featureIdx  The index of the feature in the descriptor.
+ * \param value       The value of the feature.
+ */
+template <int N>
+_CPU_AND_GPU_CODE_TEMPLATE_
+inline void write_colour_feature(Descriptor<N>& descriptor, uint32_t featureIdx, float value)
+{
+  descriptor.data[featureIdx] = value;
+}
+
+/**
+ * \brief Writes a colour feature into a quantised descriptor.
+ *
+ * \param descriptor  The descriptor.
+ * \param featureIdx  The index of the feature in the descriptor.
+ * \param value       The (unquantised) value of the feature.
+ */
+template <int N>
+_CPU_AND_GPU_CODE_TEMPLATE_
+inline void write_colour_feature(QuantisedDescriptor<N>& descriptor, uint32_t featureIdx, float value)
+{
+  descriptor.data[featureIdx] = quantise_feature(value, static_cast<float>(QuantisedDescriptor<N>::COLOUR_STEP));
+}
+
+/**
+ * \brief Writes a depth feature into a floating-point descriptor.
+ *
+ * \param descriptor  The descriptor.
+ * \param featureIdx  The index of the feature in the descriptor.
+ * \param value       The value of the feature (in mm).
+ */
+template <int N>
+_CPU_AND_GPU_CODE_TEMPLATE_
+inline void write_depth_feature(Descriptor<N>& descriptor, uint32_t featureIdx, float value)
+{
+  descriptor.data[featureIdx] = value;
+}
+
+/**
+ * \brief Writes a depth feature into a quantised descriptor.
+ *
+ * \param descriptor  The descriptor.
+ * \param featureIdx  The index of the feature in the descriptor.
+ * \param value       The (unquantised) value of the feature (in mm).
+ */
+template <int N>
+_CPU_AND_GPU_CODE_TEMPLATE_
+inline void write_depth_feature(QuantisedDescriptor<N>& descriptor, uint32_t featureIdx, float value)
+{
+  descriptor.data[featureIdx] = quantise_feature(value, static_cast<float>(QuantisedDescriptor<N>::DEPTH_STEP));
+}
+
 /**
  * \brief Calculates the raster position(s) of the secondary point(s) to use when computing a feature.
  *
@@ -142,12 +200,12 @@ inline void compute_colour_features(const Vector2i& xyDepth, const Vector2i& xyR
     if(DifferenceType == PAIRWISE_DIFFERENCE)
     {
       // This is the "correct" definition, but the SCoRe Forests code uses the other one.
-      descriptor.data[rgbFeatureOffset + featIdx] = static_cast<float>(rgb[raster1][channel] - rgb[raster2][channel]);
+      write_colour_feature(descriptor, rgbFeatureOffset + featIdx, static_cast<float>(rgb[raster1][channel] - rgb[raster2][channel]));
     }
     else
     {
       // This is the definition used in the SCoRe Forests code.
-      descriptor.data[rgbFeatureOffset + featIdx] = static_cast<float>(rgb[raster1][channel] - rgb[rasterIdxRgb][channel]);
+      write_colour_feature(descriptor, rgbFeatureOffset + featIdx, static_cast<float>(rgb[raster1][channel] - rgb[rasterIdxRgb][channel]));
     }
   }
 }
@@ -211,7 +269,7 @@ inline void compute_depth_features(const Vector2i& xyDepth, const Vector2i& xyOu
     {
       // This is the "correct" definition, but the SCoRe Forests code uses the other one.
       const float depth2Mm = fmaxf(depths[raster2] * 1000.0f, 0.0f);
-      descriptor.data[depthFeatureOffset + featIdx] = depth1Mm - depth2Mm;
+      write_depth_feature(descriptor, depthFeatureOffset + featIdx, depth1Mm - depth2Mm);
     }
     else
     {
@@ -219,7 +277,7 @@ inline void compute_depth_features(const Vector2i& xyDepth, const Vector2i& xyOu
       const float depthMm = depth * 1000.0f;
 
       // This is the definition used in the SCoRe Forests code.
-      descriptor.data[depthFeatureOffset + featIdx] = depth1Mm - depthMm;
+      write_depth_feature(descriptor, depthFeatureOffset + featIdx, depth1Mm - depthMm);
     }
   }
 }
@@ -15,7 +15,8 @@ namespace grove {
 /**
  * \brief This struct can be used to construct decision forests.
  *
- * \tparam DescriptorType The type of descriptor used to find the leaves. Must have a floating-point member array named "data".
+ * \tparam DescriptorType The type of descriptor used to find the leaves. Must have a member array named "data" and a constant named
+ *                        IS_QUANTISED (see Descriptor and QuantisedDescriptor).
  * \tparam TreeCount      The number of trees in the forest. Fixed at compilation time to allow the definition of a data type
  *                        representing the leaf indices.
  */
@@ -17,7 +17,8 @@ namespace grove {
  * \note  Training is not performed by this class. We use the node indexing technique described in:
  *        "Implementing Decision Trees and Forests on a GPU" (Toby Sharp, 2008).
  *
- * \tparam DescriptorType The type of descriptor used to find the leaves. Must have a floating-point member array named "data".
+ * \tparam DescriptorType The type of descriptor used to find the leaves. Must have a member array named "data" and a constant named
+ *                        IS_QUANTISED (see Descriptor and QuantisedDescriptor).
  * \tparam TreeCount      The number of trees in the forest. Fixed at compilation time to allow the definition of a data type
  *                        representing the leaf indices.
  */
@@ -38,6 +39,11 @@ public:
   using typename Base::LeafIndicesImage_CPtr;
   using typename Base::NodeEntry;
 
+  //#################### ENUMERATIONS ####################
+private:
+  // The number of consecutive descriptors that are routed through the trees together by find_leaves.
+  enum { TILE_SIZE = 64 };
+
   //#################### CONSTRUCTORS ####################
 public:
   /**
@@ -64,6 +70,23 @@ public:
 public:
   /** Override */
   virtual void find_leaves(const DescriptorImage_CPtr& descriptors, LeafIndicesImage_Ptr& leafIndices) const;
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Finds the leaf indices associated with a tile of consecutive descriptors.
+   *
+   * The descriptors in the tile are routed through each tree together, one level at a time: on each pass, every descriptor
+   * that has not yet reached a leaf descends by one level. This keeps the upper levels of the tree (which are visited by every
+   * descriptor) in cache, and makes the inner loop free of data-dependent branches, so that the compiler can vectorise it.
+   * The leaf indices produced are exactly the same as those produced by compute_leaf_indices.
+   *
+   * \param descriptors The descriptors in the tile.
+   * \param tileSize    The number of descriptors in the tile (at most TILE_SIZE).
+   * \param nodeImage   The forest indexing structure.
+   * \param leafIndices The location into which to write the leaf indices computed for the descriptors in the tile.
+   */
+  static void find_leaves_in_tile(const DescriptorType *descriptors, int tileSize, const NodeEntry *nodeImage, LeafIndices *leafIndices);
 };
 
 }
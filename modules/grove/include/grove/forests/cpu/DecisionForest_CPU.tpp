@@ -5,7 +5,7 @@
 
 #include "DecisionForest_CPU.h"
 
-#include "../shared/DecisionForest_Shared.h"
+#include <algorithm>
 
 namespace grove {
 
@@ -32,19 +32,64 @@ void DecisionForest_CPU<DescriptorType,TreeCount>::find_leaves(const DescriptorI
   const Vector2i imgSize = descriptors->noDims;
   leafIndices->ChangeDims(imgSize);
 
-  // Compute the leaf indices associated with each descriptor in the descriptors image.
+  // Compute the leaf indices associated with each descriptor in the descriptors image. To do this, we divide the
+  // (raster-ordered) descriptors into tiles, and route the descriptors in each tile through the trees together.
   const DescriptorType *descriptorsPtr = descriptors->GetData(MEMORYDEVICE_CPU);
   const NodeEntry *nodeImage = this->m_nodeImage->GetData(MEMORYDEVICE_CPU);
   LeafIndices *leafIndicesPtr = leafIndices->GetData(MEMORYDEVICE_CPU);
 
+  const int descriptorCount = imgSize.x * imgSize.y;
+  const int tileCount = (descriptorCount + TILE_SIZE - 1) / TILE_SIZE;
+
 #ifdef WITH_OPENMP
 #pragma omp parallel for
 #endif
-  for(int y = 0; y < imgSize.y; ++y)
+  for(int tileIdx = 0; tileIdx < tileCount; ++tileIdx)
   {
-    for(int x = 0; x < imgSize.x; ++x)
+    const int tileBegin = tileIdx * TILE_SIZE;
+    const int tileSize = std::min<int>(TILE_SIZE, descriptorCount - tileBegin);
+    find_leaves_in_tile(descriptorsPtr + tileBegin, tileSize, nodeImage, leafIndicesPtr + tileBegin);
+  }
+}
+
+//#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+
+template <typename DescriptorType, int TreeCount>
+void DecisionForest_CPU<DescriptorType,TreeCount>::find_leaves_in_tile(const DescriptorType *descriptors, int tileSize,
+                                                                       const NodeEntry *nodeImage, LeafIndices *leafIndices)
+{
+  // The index of the node that each descriptor in the tile has currently reached in the tree being evaluated.
+  int nodeIndices[TILE_SIZE];
+
+  // For each tree in the forest:
+  for(int treeIdx = 0; treeIdx < TreeCount; ++treeIdx)
+  {
+    // Start all of the descriptors at the root node.
+    std::fill(nodeIndices, nodeIndices + tileSize, 0);
+
+    // Repeatedly move every descriptor that is still at a branch node down by one level, until all of them have reached leaves.
+    // Note that the child index is computed (but then discarded) even for descriptors that are already at leaves, since this
+    // avoids the need to branch inside the loop. The feature index of a leaf is not meaningful (and is not validated when the
+    // forest is loaded), so we mask it to 0 to make sure that the discarded computation never reads outside the descriptor.
+    int branchCount = tileSize;
+    while(branchCount > 0)
+    {
+      branchCount = 0;
+      for(int i = 0; i < tileSize; ++i)
+      {
+        const NodeEntry& node = nodeImage[nodeIndices[i] * TreeCount + treeIdx];
+        const int isBranch = static_cast<int>(node.leafIdx < 0);
+        const int featureIdx = isBranch ? node.featureIdx : 0;
+        const int childIdx = node.leftChildIdx + static_cast<int>(descriptors[i].data[featureIdx] > node.featureThreshold);
+        nodeIndices[i] = isBranch ? childIdx : nodeIndices[i];
+        branchCount += isBranch;
+      }
+    }
+
+    // Write the indices of the leaves that have been reached into the leaf indices image.
+    for(int i = 0; i < tileSize; ++i)
     {
-      compute_leaf_indices(x, y, descriptorsPtr, imgSize, nodeImage, leafIndicesPtr);
+      leafIndices[i][treeIdx] = nodeImage[nodeIndices[i] * TreeCount + treeIdx].leafIdx;
     }
   }
 }
@@ -17,7 +17,8 @@ namespace grove {
  * \note  Training is not performed by this class. We use the node indexing technique described in:
  *        "Implementing Decision Trees and Forests on a GPU" (Toby Sharp, 2008).
  *
- * \tparam DescriptorType The type of descriptor used to find the leaves. Must have a floating-point member array named "data".
+ * \tparam DescriptorType The type of descriptor used to find the leaves. Must have a member array named "data" and a constant named
+ *                        IS_QUANTISED (see Descriptor and QuantisedDescriptor).
  * \tparam TreeCount      The number of trees in the forest. Fixed at compilation time to allow the definition of a data type
  *                        representing the leaf indices.
  */
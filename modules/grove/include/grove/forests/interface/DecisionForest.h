@@ -6,6 +6,7 @@
 #ifndef H_GROVE_DECISIONFOREST
 #define H_GROVE_DECISIONFOREST
 
+#include <istream>
 #include <vector>
 
 #include <boost/shared_ptr.hpp>
@@ -28,7 +29,8 @@ namespace grove {
  * \note  Training is not performed by this class. We use the node indexing technique described in
  *        "Implementing Decision Trees and Forests on a GPU" (Toby Sharp, 2008).
  *
- * \tparam DescriptorType The type of descriptor used to find the leaves. Must have a floating-point member array named "data".
+ * \tparam DescriptorType The type of descriptor used to find the leaves. Must have a member array named "data" and a constant named
+ *                        IS_QUANTISED (see Descriptor and QuantisedDescriptor).
  * \tparam TreeCount      The number of trees in the forest. Fixed at compilation time to allow the definition of a data type
  *                        representing the leaf indices.
  */
@@ -40,6 +42,13 @@ public:
   // Expose the tree count to client code.
   enum { TREE_COUNT = TreeCount };
 
+private:
+  // The size of the magic number at the start of a file in the binary format, and the version of the binary format.
+  enum { BINARY_MAGIC_SIZE = 8, BINARY_VERSION = 1 };
+
+  // The flags that can be set in the header of a file in the binary format.
+  enum { BINARY_FLAG_QUANTISED = 1 };
+
   //#################### NESTED TYPES ####################
 public:
   /**
@@ -99,6 +108,9 @@ protected:
   /** An image storing the indexing structure of the forest. See the paper by Toby Sharp for details. */
   NodeImage_Ptr m_nodeImage;
 
+  /** Whether or not the thresholds of the forest have been quantised (see quantise_thresholds). */
+  bool m_quantised;
+
   //#################### CONSTRUCTORS ####################
 protected:
   /**
@@ -179,15 +191,48 @@ public:
    */
   uint32_t get_nb_trees() const;
 
+  /**
+   * \brief Determines whether or not the specified file contains a forest structure in the binary format.
+   *
+   * \param filename  The path to the file.
+   * \return          true, if the file starts with the magic number of the binary format, or false otherwise.
+   */
+  static bool is_binary_structure_file(const std::string& filename);
+
+  /**
+   * \brief Reads the number of trees in a forest structure file (in either format), without loading the forest itself.
+   *
+   * This makes it possible to choose the right instantiation of the class template with which to load the forest.
+   *
+   * \param filename  The path to the file containing the forest.
+   * \param quantised A place in which to store whether or not the thresholds of the forest have been quantised.
+   * \return          The number of trees in the forest.
+   *
+   * \throws std::runtime_error If the header of the file cannot be read or is invalid.
+   */
+  static uint32_t read_tree_count(const std::string& filename, bool& quantised);
+
+  /**
+   * \brief Gets whether or not the thresholds of the forest have been quantised (see quantise_thresholds).
+   *
+   * \return true, if the thresholds of the forest have been quantised, or false otherwise.
+   */
+  bool is_quantised() const;
+
   /**
    * \brief Loads the branching structure of a pre-trained decision forest from a file on disk.
    *
+   * The file can be in either the text format (see below) or the binary format (see save_structure_to_binary_file):
+   * the format is detected automatically.
+   *
    * \param filename  The path to the file containing the forest.
    *
-   * \throws std::runtime_error If the forest cannot be loaded.
+   * \throws std::runtime_error If the forest cannot be loaded, or if its thresholds are quantised and DescriptorType is not
+   *                            (or vice versa).
    *
    * \note File format (text mode):
    *
+   * [quantised] (only present if the thresholds of the forest have been quantised)
    * nbTrees
    * tree1_nbNodes tree1_nbLeaves
    * ...
@@ -202,6 +247,23 @@ public:
    */
   void load_structure_from_file(const std::string& filename);
 
+  /**
+   * \brief Rewrites the thresholds of the branch nodes so that the forest can be evaluated on quantised descriptors.
+   *
+   * A quantised descriptor stores floor(value / step) for each feature (see QuantisedDescriptor), where the step depends on
+   * the kind of the feature. Each threshold t is replaced by floor(t / step) + 0.5 (clamped to the range of a signed byte), so
+   * that a quantised feature q is routed to the left child iff q <= floor(t / step), i.e. iff the original feature value was
+   * below the first multiple of the step that exceeds t. After calling this, the forest should only be evaluated on quantised
+   * descriptors, and it is marked as quantised when saved, so that it can only be loaded back into a forest whose DescriptorType
+   * is quantised. The forest is updated on both the CPU and (if relevant) the GPU.
+   *
+   * \param quantisationSteps The quantisation step for each feature (see RGBDPatchFeatureCalculator::get_quantisation_steps).
+   *
+   * \throws std::invalid_argument If any branch node tests a feature for which no (positive) quantisation step has been specified.
+   * \throws std::runtime_error    If the thresholds of the forest have already been quantised.
+   */
+  void quantise_thresholds(const std::vector<float>& quantisationSteps);
+
   /**
    * \brief Saves the branching structure of the decision forest to a file on disk.
    *
@@ -211,8 +273,55 @@ public:
    */
   void save_structure_to_file(const std::string& filename) const;
 
+  /**
+   * \brief Saves the branching structure of the decision forest to a file on disk in a (lossless) binary format.
+   *
+   * Files in this format are much faster to load than ones in the text format, since the nodes can be read straight into the node image.
+   *
+   * \param filename  The path to the file to which to save the forest.
+   *
+   * \throws std::runtime_error If the forest cannot be saved.
+   *
+   * \note File format (binary mode, native byte order):
+   *
+   * magic (8 bytes: "GROVEDFB")
+   * version (uint32) byteOrderMark (uint32) nodeEntrySize (uint32) nbTrees (uint32)
+   * flags (uint32: bit 0 is set iff the thresholds of the forest have been quantised)
+   * tree1_nbNodes (uint32) tree1_nbLeaves (uint32)
+   * ...
+   * treeN_nbNodes (uint32) treeN_nbLeaves (uint32)
+   * checksum (uint64: the 64-bit FNV-1a hash of the node data)
+   * node data (the entire node image, i.e. maxNbNodes * nbTrees NodeEntry structs, stored row by row)
+   */
+  void save_structure_to_binary_file(const std::string& filename) const;
+
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
+  /**
+   * \brief Allocates and clears a node image that is large enough to hold the nodes of all of the trees in the forest.
+   *
+   * \pre m_nbNodesPerTree has already been filled in.
+   */
+  void allocate_node_image();
+
+  /**
+   * \brief Loads the branching structure of a pre-trained decision forest from a file in the binary format.
+   *
+   * \param filename  The path to the file containing the forest.
+   *
+   * \throws std::runtime_error If the forest cannot be loaded.
+   */
+  void load_structure_from_binary_file(const std::string& filename);
+
+  /**
+   * \brief Loads the branching structure of a pre-trained decision forest from a file in the text format.
+   *
+   * \param filename  The path to the file containing the forest.
+   *
+   * \throws std::runtime_error If the forest cannot be loaded.
+   */
+  void load_structure_from_text_file(const std::string& filename);
+
 #ifdef WITH_SCOREFORESTS
   /**
    * \brief Converts a single node from a tree that was pre-trained with ScoreForests.
@@ -233,6 +342,48 @@ private:
   int convert_node(const Learner *learner, uint32_t nodeIdx, uint32_t treeIdx, uint32_t nbTrees, uint32_t outputIdx,
                    uint32_t outputFirstFreeIdx, NodeEntry *outputNodes, uint32_t& outputNbLeaves);
 #endif
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Gets the magic number that identifies a file in the binary format.
+   *
+   * \return  The magic number (the first BINARY_MAGIC_SIZE characters of the returned string).
+   */
+  static const char *binary_magic();
+
+  /**
+   * \brief Calculates the 64-bit FNV-1a hash of a block of memory.
+   *
+   * \param data  The block of memory.
+   * \param size  The size of the block of memory (in bytes).
+   * \return      The hash.
+   */
+  static uint64_t calculate_checksum(const void *data, size_t size);
+
+  /**
+   * \brief Reads and checks the header of a forest structure file in the binary format.
+   *
+   * \param in        The stream from which to read the header (positioned at the start of the file).
+   * \param filename  The path to the file (used in error messages).
+   * \param quantised A place in which to store whether or not the thresholds of the forest have been quantised.
+   * \return          The number of trees in the forest.
+   *
+   * \throws std::runtime_error If the header cannot be read or is invalid.
+   */
+  static uint32_t read_binary_header(std::istream& in, const std::string& filename, bool& quantised);
+
+  /**
+   * \brief Reads the header (the optional quantisation marker and the number of trees) of a forest structure file in the text format.
+   *
+   * \param in        The stream from which to read the header (positioned at the start of the file).
+   * \param filename  The path to the file (used in error messages).
+   * \param quantised A place in which to store whether or not the thresholds of the forest have been quantised.
+   * \return          The number of trees in the forest.
+   *
+   * \throws std::runtime_error If the header cannot be read.
+   */
+  static uint32_t read_text_header(std::istream& in, const std::string& filename, bool& quantised);
 };
 
 }
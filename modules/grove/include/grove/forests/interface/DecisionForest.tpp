@@ -5,7 +5,10 @@
 
 #include "DecisionForest.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <iomanip>
 
 #include <boost/lexical_cast.hpp>
 
@@ -26,11 +29,12 @@ namespace grove {
 
 template <typename DescriptorType, int TreeCount>
 DecisionForest<DescriptorType,TreeCount>::DecisionForest()
-: m_nbTotalLeaves(0)
+: m_nbTotalLeaves(0), m_quantised(false)
 {}
 
 template <typename DescriptorType, int TreeCount>
 DecisionForest<DescriptorType,TreeCount>::DecisionForest(const std::string& filename)
+: m_nbTotalLeaves(0), m_quantised(false)
 {
   load_structure_from_file(filename);
 }
@@ -38,6 +42,7 @@ DecisionForest<DescriptorType,TreeCount>::DecisionForest(const std::string& file
 #ifdef WITH_SCOREFORESTS
 template <typename DescriptorType, int TreeCount>
 DecisionForest<DescriptorType, TreeCount>::DecisionForest(const EnsembleLearner& pretrainedForest)
+: m_nbTotalLeaves(0), m_quantised(false)
 {
   // Convert list of nodes into an appropriate image.
   const uint32_t nbTrees = pretrainedForest.GetNbTrees();
@@ -125,6 +130,36 @@ uint32_t DecisionForest<DescriptorType,TreeCount>::get_nb_trees() const
   return TREE_COUNT;
 }
 
+template <typename DescriptorType, int TreeCount>
+bool DecisionForest<DescriptorType,TreeCount>::is_binary_structure_file(const std::string& filename)
+{
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  char magic[BINARY_MAGIC_SIZE];
+  return in.read(magic, BINARY_MAGIC_SIZE) && std::equal(magic, magic + BINARY_MAGIC_SIZE, binary_magic());
+}
+
+template <typename DescriptorType, int TreeCount>
+uint32_t DecisionForest<DescriptorType,TreeCount>::read_tree_count(const std::string& filename, bool& quantised)
+{
+  if(is_binary_structure_file(filename))
+  {
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    return read_binary_header(in, filename, quantised);
+  }
+  else
+  {
+    std::ifstream in(filename.c_str());
+    if(!in) throw std::runtime_error("Couldn't load a forest from: " + filename);
+    return read_text_header(in, filename, quantised);
+  }
+}
+
+template <typename DescriptorType, int TreeCount>
+bool DecisionForest<DescriptorType,TreeCount>::is_quantised() const
+{
+  return m_quantised;
+}
+
 template <typename DescriptorType, int TreeCount>
 void DecisionForest<DescriptorType,TreeCount>::load_structure_from_file(const std::string& filename)
 {
@@ -133,14 +168,220 @@ void DecisionForest<DescriptorType,TreeCount>::load_structure_from_file(const st
   m_nbNodesPerTree.clear();
   m_nbLeavesPerTree.clear();
   m_nbTotalLeaves = 0;
+  m_quantised = false;
+
+  // Load the new forest, using the appropriate loader for the file's format.
+  if(is_binary_structure_file(filename)) load_structure_from_binary_file(filename);
+  else load_structure_from_text_file(filename);
+
+  // Check that the forest is being loaded for use with the right kind of descriptor: evaluating quantised descriptors using
+  // floating-point thresholds (or vice versa) would silently send almost every descriptor to the wrong leaf.
+  if(m_quantised != DescriptorType::IS_QUANTISED)
+  {
+    throw std::runtime_error(
+      "Error: The forest in " + filename + (m_quantised ? " has quantised thresholds, but is being loaded for use with floating-point descriptors"
+                                                        : " has floating-point thresholds, but is being loaded for use with quantised descriptors")
+    );
+  }
+
+  const uint32_t nbTrees = get_nb_trees();
+  std::cout << "Loaded a forest with " << nbTrees << " trees.\n";
+  for(uint32_t i = 0; i < nbTrees; ++i)
+  {
+    std::cout << "\tTree " << i << ": " << m_nbNodesPerTree[i] << " nodes and " << m_nbLeavesPerTree[i] << " leaves.\n";
+  }
+
+  // Ensure that the node image is available on the GPU (if we're using it).
+  m_nodeImage->UpdateDeviceFromHost();
+}
+
+template <typename DescriptorType, int TreeCount>
+void DecisionForest<DescriptorType,TreeCount>::quantise_thresholds(const std::vector<float>& quantisationSteps)
+{
+  if(m_quantised) throw std::runtime_error("Error: The thresholds of the forest have already been quantised");
+
+  const uint32_t nbTrees = get_nb_trees();
+  NodeEntry *forestNodes = m_nodeImage->GetData(MEMORYDEVICE_CPU);
+
+  // Check that all of the branch nodes test features for which a valid quantisation step has been specified
+  // before modifying anything, so that the forest is left untouched if the steps are invalid.
+  for(uint32_t treeIdx = 0; treeIdx < nbTrees; ++treeIdx)
+  {
+    for(uint32_t nodeIdx = 0; nodeIdx < m_nbNodesPerTree[treeIdx]; ++nodeIdx)
+    {
+      const NodeEntry& node = forestNodes[nodeIdx * nbTrees + treeIdx];
+      if(node.leafIdx >= 0) continue;
+
+      if(node.featureIdx >= quantisationSteps.size() || quantisationSteps[node.featureIdx] <= 0.0f)
+      {
+        throw std::invalid_argument("Error: No valid quantisation step for feature " + boost::lexical_cast<std::string>(node.featureIdx));
+      }
+    }
+  }
+
+  // Replace the threshold of each branch node with one that splits the quantised features in the same place.
+  for(uint32_t treeIdx = 0; treeIdx < nbTrees; ++treeIdx)
+  {
+    for(uint32_t nodeIdx = 0; nodeIdx < m_nbNodesPerTree[treeIdx]; ++nodeIdx)
+    {
+      NodeEntry& node = forestNodes[nodeIdx * nbTrees + treeIdx];
+      if(node.leafIdx >= 0) continue;
+
+      const float boundary = floorf(node.featureThreshold / quantisationSteps[node.featureIdx]);
+      node.featureThreshold = std::min(std::max(boundary, -129.0f), 127.0f) + 0.5f;
+    }
+  }
+
+  m_quantised = true;
+  m_nodeImage->UpdateDeviceFromHost();
+}
+
+template <typename DescriptorType, int TreeCount>
+void DecisionForest<DescriptorType,TreeCount>::save_structure_to_file(const std::string& filename) const
+{
+  std::ofstream out(filename.c_str());
+
+  // If the thresholds have been quantised, write a marker to say so.
+  if(m_quantised) out << "quantised\n";
+
+  // Write the number of trees.
+  const uint32_t nbTrees = get_nb_trees();
+  out << nbTrees << '\n';
+
+  // For each tree, first write the number of nodes, then the number of leaves.
+  for(uint32_t i = 0; i < nbTrees; ++i)
+  {
+    out << m_nbNodesPerTree[i] << ' ' << m_nbLeavesPerTree[i] << '\n';
+  }
+
+  // Then, for each tree, dump its nodes.
+  const NodeEntry *forestNodes = m_nodeImage->GetData(MEMORYDEVICE_CPU);
+  for(uint32_t treeIdx = 0; treeIdx < nbTrees; ++treeIdx)
+  {
+    for(uint32_t nodeIdx = 0; nodeIdx < m_nbNodesPerTree[treeIdx]; ++nodeIdx)
+    {
+      const NodeEntry& node = forestNodes[nodeIdx * nbTrees + treeIdx];
+      out << node.leftChildIdx << ' ' << node.leafIdx << ' ' << node.featureIdx << ' ' << std::setprecision(9) << node.featureThreshold << '\n';
+    }
+  }
+
+  if(!out) throw std::runtime_error("Error saving the forest to a file: " + filename);
+}
+
+template <typename DescriptorType, int TreeCount>
+void DecisionForest<DescriptorType,TreeCount>::save_structure_to_binary_file(const std::string& filename) const
+{
+  std::ofstream out(filename.c_str(), std::ios::binary);
+
+  // Write the header.
+  const uint32_t nbTrees = get_nb_trees();
+  const uint32_t flags = m_quantised ? BINARY_FLAG_QUANTISED : 0;
+  const uint32_t header[] = { BINARY_VERSION, 0x01020304, sizeof(NodeEntry), nbTrees, flags };
+  out.write(binary_magic(), BINARY_MAGIC_SIZE);
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+  // For each tree, write the number of nodes and the number of leaves.
+  for(uint32_t i = 0; i < nbTrees; ++i)
+  {
+    const uint32_t treeSize[] = { m_nbNodesPerTree[i], m_nbLeavesPerTree[i] };
+    out.write(reinterpret_cast<const char*>(treeSize), sizeof(treeSize));
+  }
+
+  // Write the checksum, followed by the contents of the entire node image.
+  const NodeEntry *forestNodes = m_nodeImage->GetData(MEMORYDEVICE_CPU);
+  const size_t nodeDataSize = m_nodeImage->dataSize * sizeof(NodeEntry);
+  const uint64_t checksum = calculate_checksum(forestNodes, nodeDataSize);
+  out.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+  out.write(reinterpret_cast<const char*>(forestNodes), nodeDataSize);
+
+  if(!out) throw std::runtime_error("Error saving the forest to a file: " + filename);
+}
+
+//#################### PRIVATE MEMBER FUNCTIONS ####################
+
+template <typename DescriptorType, int TreeCount>
+void DecisionForest<DescriptorType,TreeCount>::allocate_node_image()
+{
+  // The node image has one column per tree, and as many rows as there are nodes in the largest tree.
+  const uint32_t maxNbNodes = *std::max_element(m_nbNodesPerTree.begin(), m_nbNodesPerTree.end());
+
+  const itmx::MemoryBlockFactory& mbf = itmx::MemoryBlockFactory::instance();
+  m_nodeImage = mbf.make_image<NodeEntry>(Vector2i(get_nb_trees(), maxNbNodes));
+  m_nodeImage->Clear();
+}
+
+template <typename DescriptorType, int TreeCount>
+void DecisionForest<DescriptorType,TreeCount>::load_structure_from_binary_file(const std::string& filename)
+{
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if(!in) throw std::runtime_error("Couldn't load a forest from: " + filename);
+
+  // Read and check the header, and check that the number of trees is the same as the template instantiation.
+  const uint32_t nbTrees = read_binary_header(in, filename, m_quantised);
+  if(nbTrees != get_nb_trees())
+  {
+    throw std::runtime_error(
+      "Number of trees of the loaded forest is incorrect. Should be " +
+      boost::lexical_cast<std::string>(get_nb_trees()) + " - Read: " +
+      boost::lexical_cast<std::string>(nbTrees)
+    );
+  }
+
+  // For each tree, read the number of nodes and the number of leaves.
+  for(uint32_t i = 0; i < nbTrees; ++i)
+  {
+    uint32_t treeSize[2];
+    in.read(reinterpret_cast<char*>(treeSize), sizeof(treeSize));
+    if(!in) throw std::runtime_error("Error reading the dimensions of tree: " + boost::lexical_cast<std::string>(i));
+
+    if(treeSize[0] == 0 || treeSize[1] > treeSize[0])
+    {
+      throw std::runtime_error("The dimensions of tree " + boost::lexical_cast<std::string>(i) + " in " + filename + " are invalid");
+    }
+
+    m_nbNodesPerTree.push_back(treeSize[0]);
+    m_nbLeavesPerTree.push_back(treeSize[1]);
+    m_nbTotalLeaves += treeSize[1];
+  }
 
+  // Check that the rest of the file contains exactly the checksum and the node image implied by the tree dimensions,
+  // before allocating anything: this stops a corrupt (or malicious) header from triggering a huge allocation.
+  const uint64_t maxNbNodes = *std::max_element(m_nbNodesPerTree.begin(), m_nbNodesPerTree.end());
+  const uint64_t expectedNodeDataSize = maxNbNodes * nbTrees * sizeof(NodeEntry);
+  const std::streampos nodeDataPos = in.tellg();
+  in.seekg(0, std::ios::end);
+  const uint64_t remainingSize = static_cast<uint64_t>(in.tellg() - nodeDataPos);
+  in.seekg(nodeDataPos);
+  if(!in || remainingSize != sizeof(uint64_t) + expectedNodeDataSize)
+  {
+    throw std::runtime_error("The size of the forest in " + filename + " does not match the dimensions of its trees");
+  }
+
+  // Read the nodes straight into the node image, and check that they match the checksum.
+  allocate_node_image();
+
+  uint64_t checksum;
+  NodeEntry *forestNodes = m_nodeImage->GetData(MEMORYDEVICE_CPU);
+  const size_t nodeDataSize = m_nodeImage->dataSize * sizeof(NodeEntry);
+  in.read(reinterpret_cast<char*>(&checksum), sizeof(checksum));
+  in.read(reinterpret_cast<char*>(forestNodes), nodeDataSize);
+  if(!in) throw std::runtime_error("Error reading the nodes of the forest in: " + filename);
+
+  if(calculate_checksum(forestNodes, nodeDataSize) != checksum)
+  {
+    throw std::runtime_error("The forest in " + filename + " is corrupt (checksum mismatch)");
+  }
+}
+
+template <typename DescriptorType, int TreeCount>
+void DecisionForest<DescriptorType,TreeCount>::load_structure_from_text_file(const std::string& filename)
+{
   std::ifstream in(filename.c_str());
   if(!in) throw std::runtime_error("Couldn't load a forest from: " + filename);
 
-  // Check that the number of trees is the same as the template instantiation.
-  uint32_t nbTrees;
-  in >> nbTrees;
-  if(!in || nbTrees != get_nb_trees())
+  // Read the header, and check that the number of trees is the same as the template instantiation.
+  const uint32_t nbTrees = read_text_header(in, filename, m_quantised);
+  if(nbTrees != get_nb_trees())
   {
     throw std::runtime_error(
       "Number of trees of the loaded forest is incorrect. Should be " +
@@ -149,8 +390,12 @@ void DecisionForest<DescriptorType,TreeCount>::load_structure_from_file(const st
     );
   }
 
-  // Used to allocate the indexing texture (height = the maximum number of nodes, width = nbTrees).
-  uint32_t maxNbNodes = 0;
+  // Determine the size of the file. Each node takes up at least 8 characters (four single-digit fields, each followed
+  // by a separator), which lets us reject impossible tree dimensions before allocating the node image.
+  const std::streampos headerPos = in.tellg();
+  in.seekg(0, std::ios::end);
+  const uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+  in.seekg(headerPos);
 
   // For each tree, first read the number of nodes, then the number of leaves.
   for(uint32_t i = 0; i < nbTrees; ++i)
@@ -160,23 +405,19 @@ void DecisionForest<DescriptorType,TreeCount>::load_structure_from_file(const st
 
     if(!in) throw std::runtime_error("Error reading the dimensions of tree: " + boost::lexical_cast<std::string>(i));
 
+    if(nbNodes == 0 || nbLeaves > nbNodes || nbNodes > fileSize / 8)
+    {
+      throw std::runtime_error("The dimensions of tree " + boost::lexical_cast<std::string>(i) + " in " + filename + " are invalid");
+    }
+
     m_nbNodesPerTree.push_back(nbNodes);
     m_nbLeavesPerTree.push_back(nbLeaves);
 
-    maxNbNodes = std::max(nbNodes, maxNbNodes);
     m_nbTotalLeaves += nbLeaves;
   }
 
-  std::cout << "Loading a forest with " << nbTrees << " trees.\n";
-  for(uint32_t i = 0; i < nbTrees; ++i)
-  {
-    std::cout << "\tTree " << i << ": " << m_nbNodesPerTree[i] << " nodes and " << m_nbLeavesPerTree[i] << " leaves.\n";
-  }
-
   // Allocate and clear the node image.
-  const itmx::MemoryBlockFactory& mbf = itmx::MemoryBlockFactory::instance();
-  m_nodeImage = mbf.make_image<NodeEntry>(Vector2i(nbTrees, maxNbNodes));
-  m_nodeImage->Clear();
+  allocate_node_image();
 
 #if RANDOM_FEATURES
   tvgutil::RandomNumberGenerator rng(42);
@@ -236,42 +477,8 @@ void DecisionForest<DescriptorType,TreeCount>::load_structure_from_file(const st
 #endif
     }
   }
-
-  // Ensure that the node image is available on the GPU (if we're using it).
-  m_nodeImage->UpdateDeviceFromHost();
-}
-
-template <typename DescriptorType, int TreeCount>
-void DecisionForest<DescriptorType,TreeCount>::save_structure_to_file(const std::string& filename) const
-{
-  std::ofstream out(filename.c_str());
-
-  // Write the number of trees.
-  const uint32_t nbTrees = get_nb_trees();
-  out << nbTrees << '\n';
-
-  // For each tree, first write the number of nodes, then the number of leaves.
-  for(uint32_t i = 0; i < nbTrees; ++i)
-  {
-    out << m_nbNodesPerTree[i] << ' ' << m_nbLeavesPerTree[i] << '\n';
-  }
-
-  // Then, for each tree, dump its nodes.
-  const NodeEntry *forestNodes = m_nodeImage->GetData(MEMORYDEVICE_CPU);
-  for(uint32_t treeIdx = 0; treeIdx < nbTrees; ++treeIdx)
-  {
-    for(uint32_t nodeIdx = 0; nodeIdx < m_nbNodesPerTree[treeIdx]; ++nodeIdx)
-    {
-      const NodeEntry& node = forestNodes[nodeIdx * nbTrees + treeIdx];
-      out << node.leftChildIdx << ' ' << node.leafIdx << ' ' << node.featureIdx << ' ' << std::setprecision(7) << node.featureThreshold << '\n';
-    }
-  }
-
-  if(!out) throw std::runtime_error("Error saving the forest to a file: " + filename);
 }
 
-//#################### PRIVATE MEMBER FUNCTIONS ####################
-
 #ifdef WITH_SCOREFORESTS
 template <typename DescriptorType, int TreeCount>
 int DecisionForest<DescriptorType,TreeCount>::convert_node(const Learner *tree, uint32_t nodeIdx, uint32_t treeIdx, uint32_t nbTrees, uint32_t outputIdx,
@@ -336,4 +543,65 @@ int DecisionForest<DescriptorType,TreeCount>::convert_node(const Learner *tree,
 }
 #endif
 
+//#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+
+template <typename DescriptorType, int TreeCount>
+const char *DecisionForest<DescriptorType,TreeCount>::binary_magic()
+{
+  return "GROVEDFB";
+}
+
+template <typename DescriptorType, int TreeCount>
+uint64_t DecisionForest<DescriptorType,TreeCount>::calculate_checksum(const void *data, size_t size)
+{
+  const unsigned char *bytes = static_cast<const unsigned char*>(data);
+  uint64_t hash = 14695981039346656037ULL;
+  for(size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+template <typename DescriptorType, int TreeCount>
+uint32_t DecisionForest<DescriptorType,TreeCount>::read_binary_header(std::istream& in, const std::string& filename, bool& quantised)
+{
+  char magic[BINARY_MAGIC_SIZE];
+  uint32_t header[5];
+  in.read(magic, BINARY_MAGIC_SIZE);
+  in.read(reinterpret_cast<char*>(header), sizeof(header));
+  if(!in) throw std::runtime_error("Error reading the header of the forest in: " + filename);
+
+  if(!std::equal(magic, magic + BINARY_MAGIC_SIZE, binary_magic())) throw std::runtime_error("The file " + filename + " does not contain a forest in the binary format");
+  if(header[0] != BINARY_VERSION) throw std::runtime_error("Unsupported forest file version in: " + filename);
+  if(header[1] != 0x01020304) throw std::runtime_error("The forest in " + filename + " was saved on a machine with a different byte order");
+  if(header[2] != sizeof(NodeEntry)) throw std::runtime_error("The forest in " + filename + " was saved with an incompatible node layout");
+
+  const uint32_t flags = header[4];
+  if(flags & ~static_cast<uint32_t>(BINARY_FLAG_QUANTISED)) throw std::runtime_error("Unsupported forest flags in: " + filename);
+  quantised = (flags & BINARY_FLAG_QUANTISED) != 0;
+
+  return header[3];
+}
+
+template <typename DescriptorType, int TreeCount>
+uint32_t DecisionForest<DescriptorType,TreeCount>::read_text_header(std::istream& in, const std::string& filename, bool& quantised)
+{
+  // Check whether the file starts with the marker that indicates that the thresholds have been quantised.
+  std::string firstToken;
+  in >> firstToken;
+  quantised = firstToken == "quantised";
+  if(!quantised)
+  {
+    in.clear();
+    in.seekg(0);
+  }
+
+  // Read the number of trees.
+  uint32_t nbTrees;
+  if(!(in >> nbTrees)) throw std::runtime_error("Error reading the number of trees in the forest in: " + filename);
+  return nbTrees;
+}
+
 }
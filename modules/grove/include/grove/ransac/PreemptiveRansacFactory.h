@@ -0,0 +1,37 @@
+/**
+ * grove: PreemptiveRansacFactory.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_GROVE_PREEMPTIVERANSACFACTORY
+#define H_GROVE_PREEMPTIVERANSACFACTORY
+
+#include <ITMLib/Utils/ITMLibSettings.h>
+
+#include "interface/PreemptiveRansac.h"
+
+namespace grove {
+
+/**
+ * \brief This struct can be used to construct preemptive RANSAC instances.
+ */
+struct PreemptiveRansacFactory
+{
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+
+  /**
+   * \brief Makes a preemptive RANSAC instance.
+   *
+   * \note  There is currently only a CPU implementation of preemptive RANSAC, so the instance will always operate on the CPU.
+   *        When the rest of the pipeline runs on the GPU, the inputs must be copied across to the CPU before estimating a pose.
+   *
+   * \param settings    The settings used to configure the instance.
+   * \param deviceType  The device on which the instance should operate.
+   * \return            The preemptive RANSAC instance.
+   */
+  static PreemptiveRansac_Ptr make_preemptive_ransac(const tvgutil::SettingsContainer_CPtr& settings, ITMLib::ITMLibSettings::DeviceType deviceType);
+};
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * grove: PreemptiveRansac_CPU.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_GROVE_PREEMPTIVERANSAC_CPU
+#define H_GROVE_PREEMPTIVERANSAC_CPU
+
+#include "../interface/PreemptiveRansac.h"
+#include "../../numbers/CPURNG.h"
+
+namespace grove {
+
+/**
+ * \brief An instance of this class can be used to estimate a camera pose using preemptive RANSAC on the CPU.
+ *
+ * The pose candidates are generated, scored and refined in parallel using OpenMP (if available). Each candidate is generated
+ * using its own random number generator, and inliers are sampled serially, so the results do not depend on the number of
+ * threads that happen to be used. The input images must be available on the CPU.
+ */
+class PreemptiveRansac_CPU : public PreemptiveRansac
+{
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The random number generators used to generate the pose candidates and sample the inliers. */
+  CPURNGMemoryBlock_Ptr m_randomGenerators;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a CPU-based preemptive RANSAC instance.
+   *
+   * \param settings  The settings used to configure the instance.
+   */
+  explicit PreemptiveRansac_CPU(const tvgutil::SettingsContainer_CPtr& settings);
+
+  //#################### PROTECTED MEMBER FUNCTIONS ####################
+protected:
+  /** Override */
+  virtual void compute_energies_and_sort(uint32_t firstInlierIdx);
+
+  /** Override */
+  virtual void generate_pose_candidates();
+
+  /** Override */
+  virtual void init_random();
+
+  /** Override */
+  virtual void sample_inliers();
+};
+
+}
+
+#endif
@@ -0,0 +1,210 @@
+/**
+ * grove: PreemptiveRansac.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_GROVE_PREEMPTIVERANSAC
+#define H_GROVE_PREEMPTIVERANSAC
+
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include <itmx/base/ITMImagePtrTypes.h>
+#include <itmx/base/ITMMemoryBlockPtrTypes.h>
+
+#include <tvgutil/misc/SettingsContainer.h>
+
+#include "../shared/PoseCandidate.h"
+#include "../../keypoints/Keypoint3DColour.h"
+#include "../../scoreforests/ScorePrediction.h"
+
+namespace grove {
+
+/**
+ * \brief An instance of a class deriving from this one can be used to estimate a camera pose from a set of 3D keypoints
+ *        and the modal clusters predicted for them by a SCoRe forest, using the preemptive RANSAC algorithm described in
+ *        "Exploiting Uncertainty in Regression Forests for Accurate Camera Relocalization" (Valentin et al., CVPR 2015).
+ *
+ * The algorithm works as follows:
+ *
+ * 1) A large number of pose candidates are generated by sampling triples of keypoint/mode correspondences and estimating
+ *    the rigid transformation between them using the Kabsch algorithm.
+ * 2) A batch of inlier pixels is sampled, and the candidates are scored according to how well they explain the modes predicted
+ *    for the inliers. If there are more than a fixed number of candidates, only the best ones are kept.
+ * 3) Until only one candidate remains, a further batch of inliers is sampled, the candidates are rescored, and the worse half of
+ *    them are discarded. If requested, the surviving candidates are then refined using all of the inliers they explain.
+ */
+class PreemptiveRansac
+{
+  //#################### PROTECTED VARIABLES ####################
+protected:
+  /** The number of inliers to sample in each iteration of the algorithm. */
+  uint32_t m_batchSizeRansac;
+
+  /** Whether or not to require the keypoints used to generate a pose candidate to be a minimum distance apart. */
+  bool m_checkMinDistanceBetweenSampledModes;
+
+  /** Whether or not to require the pairwise distances between the keypoints used to generate a pose candidate to match those between their modes. */
+  bool m_checkRigidTransformationConstraint;
+
+  /**
+   * Whether or not to reseed the random number generators at the start of every call to estimate_pose. In this mode, the
+   * pose that is estimated depends only on the inputs (and the seed), which makes the results reproducible (e.g. for tests).
+   */
+  bool m_deterministic;
+
+  /** The raster indices of the inliers that have been sampled so far (only the first m_nbInliers elements are valid). */
+  ITMIntMemoryBlock_Ptr m_inlierRasterIndices;
+
+  /** A mask recording which pixels have already been sampled as inliers (this is used to avoid sampling the same pixel twice). */
+  ITMIntImage_Ptr m_inliersMaskImage;
+
+  /** The keypoints (in camera space) for the current call to estimate_pose. */
+  Keypoint3DColourImage_CPtr m_keypointsImage;
+
+  /** The maximum number of pixels that may be sampled whilst trying to generate each pose candidate. */
+  uint32_t m_maxCandidateGenerationIterations;
+
+  /** The maximum number of pose candidates to generate. */
+  uint32_t m_maxPoseCandidates;
+
+  /** The maximum number of pose candidates to keep after the initial scoring step. */
+  uint32_t m_maxPoseCandidatesAfterCull;
+
+  /** The maximum difference there can be between the pairwise distances of the keypoints and modes used to generate a pose candidate. */
+  float m_maxTranslationErrorForCorrectPose;
+
+  /** The minimum squared distance there can be between the keypoints used to generate a pose candidate. */
+  float m_minSquaredDistanceBetweenSampledModes;
+
+  /** The number of pose candidates that were generated in the most recent call to estimate_pose. */
+  uint32_t m_nbGeneratedPoseCandidates;
+
+  /** The number of inliers that have been sampled so far. */
+  uint32_t m_nbInliers;
+
+  /** The number of pose candidates that are still under consideration (these are stored at the start of m_poseCandidates). */
+  uint32_t m_nbPoseCandidates;
+
+  /** The pose candidates. */
+  PoseCandidateMemoryBlock_Ptr m_poseCandidates;
+
+  /** Whether or not to refine the surviving pose candidates after each culling step. */
+  bool m_poseUpdate;
+
+  /** The maximum squared distance there can be between a transformed inlier and a mode for them to be used when refining a pose candidate. */
+  float m_poseUpdateInlierThresholdSquared;
+
+  /** The modes predicted for each pixel for the current call to estimate_pose. */
+  ScorePredictionsImage_CPtr m_predictionsImage;
+
+  /** The seed used to initialise the random number generators. */
+  uint32_t m_rngSeed;
+
+  /** Whether to choose a random mode for each pixel sampled when generating a pose candidate, rather than always choosing the first one. */
+  bool m_useAllModesPerLeafInPoseHypothesisGeneration;
+
+  //#################### CONSTRUCTORS ####################
+protected:
+  /**
+   * \brief Constructs a preemptive RANSAC instance.
+   *
+   * \param settings  The settings used to configure the instance (these are looked up in the "PreemptiveRansac." namespace).
+   */
+  explicit PreemptiveRansac(const tvgutil::SettingsContainer_CPtr& settings);
+
+  //#################### DESTRUCTOR ####################
+public:
+  /**
+   * \brief Destroys the preemptive RANSAC instance.
+   */
+  virtual ~PreemptiveRansac();
+
+  //#################### PROTECTED ABSTRACT MEMBER FUNCTIONS ####################
+protected:
+  /**
+   * \brief Updates the energies of the pose candidates using the inliers that have been sampled since the specified one,
+   *        and then sorts the candidates into non-decreasing order of energy.
+   *
+   * After this function returns, the energy of each candidate is its average energy over all of the inliers sampled so far.
+   *
+   * \param firstInlierIdx  The index of the first inlier whose energy has not yet been accounted for (0 to recompute the energies from scratch).
+   */
+  virtual void compute_energies_and_sort(uint32_t firstInlierIdx) = 0;
+
+  /**
+   * \brief Generates up to m_maxPoseCandidates pose candidates by sampling keypoint/mode correspondences.
+   *
+   * This should fill in the correspondences for the generated candidates (the poses themselves are estimated by the caller),
+   * store the candidates at the start of m_poseCandidates and set m_nbPoseCandidates accordingly.
+   */
+  virtual void generate_pose_candidates() = 0;
+
+  /**
+   * \brief Initialises the random number generators using m_rngSeed.
+   */
+  virtual void init_random() = 0;
+
+  /**
+   * \brief Samples up to m_batchSizeRansac new inliers and appends their raster indices to m_inlierRasterIndices.
+   */
+  virtual void sample_inliers() = 0;
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Estimates a camera pose from a set of keypoints and the modes predicted for them.
+   *
+   * \param keypointsImage    An image containing the keypoints (in camera space) for the pixels of the input frame.
+   * \param predictionsImage  An image containing the modes (in world space) predicted for the pixels of the input frame.
+   * \return                  The best pose candidate, if one could be found, or boost::none otherwise.
+   *
+   * \throws std::invalid_argument If the keypoints and predictions images have different sizes.
+   */
+  boost::optional<PoseCandidate> estimate_pose(const Keypoint3DColourImage_CPtr& keypointsImage, const ScorePredictionsImage_CPtr& predictionsImage);
+
+  /**
+   * \brief Gets the best pose candidates found by the most recent call to estimate_pose, in order of decreasing quality.
+   *
+   * The first candidate is always the one returned by estimate_pose. The others are ranked first by the culling step in which
+   * they were eliminated (candidates that survived for longer come first), and then by their energy in that step (energies
+   * from different steps are computed on different sets of inliers, so are not directly comparable).
+   *
+   * \param poseCandidates  A vector into which to write the pose candidates (any existing contents will be discarded).
+   * \param maxPoseCount    The maximum number of pose candidates to return.
+   */
+  void get_best_poses(std::vector<PoseCandidate>& poseCandidates, uint32_t maxPoseCount) const;
+
+  /**
+   * \brief Gets the minimum number of keypoints that must be valid for there to be a chance of estimating a pose.
+   *
+   * \return  The minimum number of keypoints that must be valid.
+   */
+  int get_min_nb_required_points() const;
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Estimates the poses of the pose candidates from their keypoint/mode correspondences using the Kabsch algorithm.
+   */
+  void compute_candidate_poses_kabsch();
+
+  /**
+   * \brief Refines the poses of the surviving pose candidates using all of the sampled inliers that they explain.
+   *
+   * For each candidate, every inlier is paired with its closest mode under the candidate's current pose (provided that the mode
+   * is close enough), and the pose is re-estimated from all such correspondences using the Kabsch algorithm. Candidates that
+   * do not explain enough inliers are left unchanged.
+   */
+  void update_candidate_poses();
+};
+
+//#################### TYPEDEFS ####################
+
+typedef boost::shared_ptr<PreemptiveRansac> PreemptiveRansac_Ptr;
+typedef boost::shared_ptr<const PreemptiveRansac> PreemptiveRansac_CPtr;
+
+}
+
+#endif
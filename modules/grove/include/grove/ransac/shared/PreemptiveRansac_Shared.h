@@ -0,0 +1,253 @@
+/**
+ * grove: PreemptiveRansac_Shared.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_GROVE_PREEMPTIVERANSAC_SHARED
+#define H_GROVE_PREEMPTIVERANSAC_SHARED
+
+#include <ORUtils/MathUtils.h>
+#include <ORUtils/PlatformIndependence.h>
+
+#include "PoseCandidate.h"
+#include "../../keypoints/Keypoint3DColour.h"
+#include "../../scoreforests/ScorePrediction.h"
+
+namespace grove {
+
+//#################### CONSTANTS ####################
+
+enum
+{
+  /** The maximum difference (per channel) there can be between the colour of a keypoint and the colour of a mode for them to be used together. */
+  PREEMPTIVERANSAC_MAX_COLOUR_DELTA = 30,
+
+  /** The maximum number of attempts that will be made to find a suitable pixel when sampling an inlier. */
+  PREEMPTIVERANSAC_SAMPLE_INLIER_ITERATIONS = 50
+};
+
+/** The likelihood below which the energy of a keypoint under a pose candidate is capped (to stop a single outlier from dominating the energy). */
+#define PREEMPTIVERANSAC_MIN_LIKELIHOOD 1e-6f
+
+//#################### FUNCTIONS ####################
+
+/**
+ * \brief Checks whether or not the colour of a keypoint is similar enough to the colour of a mode for the two to be used together.
+ *
+ * \param keypoint  The keypoint.
+ * \param mode      The mode.
+ * \return          true, if the colours are similar enough, or false otherwise.
+ */
+_CPU_AND_GPU_CODE_
+inline bool colours_are_compatible(const Keypoint3DColour& keypoint, const Keypoint3DColourCluster& mode)
+{
+  for(int i = 0; i < 3; ++i)
+  {
+    const int delta = static_cast<int>(keypoint.colour.v[i]) - static_cast<int>(mode.colour.v[i]);
+    if(delta > PREEMPTIVERANSAC_MAX_COLOUR_DELTA || delta < -PREEMPTIVERANSAC_MAX_COLOUR_DELTA) return false;
+  }
+
+  return true;
+}
+
+/**
+ * \brief Computes the energy of a keypoint under a pose candidate.
+ *
+ * The keypoint is transformed into world space using the candidate pose, and the energy is the negative log-likelihood of
+ * the transformed point under the Gaussian mixture defined by the modes predicted for the keypoint's pixel (each mode is
+ * weighted by the number of examples that support it).
+ *
+ * \param cameraPose  The candidate pose (a transformation from camera space to world space).
+ * \param keypoint    The keypoint (in camera space).
+ * \param prediction  The modes predicted for the keypoint's pixel.
+ * \return            The energy of the keypoint under the pose candidate.
+ */
+_CPU_AND_GPU_CODE_
+inline float compute_energy_for_keypoint(const Matrix4f& cameraPose, const Keypoint3DColour& keypoint, const ScorePrediction& prediction)
+{
+  const Vector3f pointWorld = (cameraPose * Vector4f(keypoint.position, 1.0f)).toVector3();
+
+  int totalInliers = 0;
+  for(int modeIdx = 0; modeIdx < prediction.size; ++modeIdx)
+  {
+    totalInliers += prediction.elts[modeIdx].nbInliers;
+  }
+
+  float likelihood = 0.0f;
+  for(int modeIdx = 0; modeIdx < prediction.size; ++modeIdx)
+  {
+    const Keypoint3DColourCluster& mode = prediction.elts[modeIdx];
+
+    // Modes with a degenerate covariance matrix cannot contribute a meaningful density, so skip them.
+    if(mode.determinant <= 0.0f) continue;
+
+    const Vector3f diff = pointWorld - mode.position;
+    const float mahalanobisSquared = dot(diff, mode.positionInvCovariance * diff);
+    const float normalisation = 1.0f / sqrtf(248.050213442f * mode.determinant); // 248.05... = (2 * pi)^3
+    const float weight = static_cast<float>(mode.nbInliers) / static_cast<float>(totalInliers);
+    likelihood += weight * normalisation * expf(-0.5f * mahalanobisSquared);
+  }
+
+  return -logf(MAX(likelihood, PREEMPTIVERANSAC_MIN_LIKELIHOOD));
+}
+
+/**
+ * \brief Finds the mode predicted for a keypoint's pixel that is closest to the keypoint once it has been transformed into world space.
+ *
+ * \param cameraPose              The candidate pose (a transformation from camera space to world space).
+ * \param keypoint                The keypoint (in camera space).
+ * \param prediction              The modes predicted for the keypoint's pixel.
+ * \param maxSquaredDistance      The maximum squared distance there can be between the transformed keypoint and the chosen mode.
+ * \param transformedKeypoint     A location into which to write the transformed keypoint.
+ * \return                        The index of the closest mode, if it is within the maximum distance, or -1 otherwise.
+ */
+_CPU_AND_GPU_CODE_
+inline int find_closest_mode(const Matrix4f& cameraPose, const Keypoint3DColour& keypoint, const ScorePrediction& prediction,
+                             float maxSquaredDistance, Vector3f& transformedKeypoint)
+{
+  transformedKeypoint = (cameraPose * Vector4f(keypoint.position, 1.0f)).toVector3();
+
+  int bestModeIdx = -1;
+  float bestSquaredDistance = maxSquaredDistance;
+  for(int modeIdx = 0; modeIdx < prediction.size; ++modeIdx)
+  {
+    const Vector3f diff = transformedKeypoint - prediction.elts[modeIdx].position;
+    const float squaredDistance = dot(diff, diff);
+    if(squaredDistance < bestSquaredDistance)
+    {
+      bestModeIdx = modeIdx;
+      bestSquaredDistance = squaredDistance;
+    }
+  }
+
+  return bestModeIdx;
+}
+
+/**
+ * \brief Attempts to generate a pose candidate by sampling three keypoint/mode correspondences.
+ *
+ * \note  This function only chooses the correspondences: the camera pose itself is estimated from them afterwards using the Kabsch algorithm.
+ *
+ * \param keypoints                                     The keypoints (one per pixel).
+ * \param predictions                                   The modes predicted for each pixel.
+ * \param imgSize                                       The size of the keypoints and predictions images.
+ * \param rng                                           The random number generator to use when sampling.
+ * \param poseCandidate                                 The pose candidate whose correspondences should be filled in.
+ * \param maxCandidateGenerationIterations              The maximum number of pixels that may be sampled whilst trying to find the correspondences.
+ * \param useAllModesPerLeafInPoseHypothesisGeneration  Whether to choose a random mode for each sampled pixel, rather than always choosing the first (i.e. largest) one.
+ * \param checkMinDistanceBetweenSampledModes           Whether or not to require the sampled keypoints to be a minimum distance apart.
+ * \param minSquaredDistanceBetweenSampledModes         The minimum squared distance there can be between the sampled keypoints (if checked).
+ * \param checkRigidTransformationConstraint            Whether or not to require the pairwise distances between the sampled keypoints to match those between their modes.
+ * \param maxTranslationErrorForCorrectPose             The maximum difference there can be between corresponding pairwise distances (if checked).
+ * \return                                              true, if suitable correspondences were found, or false otherwise.
+ */
+template <typename RNG>
+_CPU_AND_GPU_CODE_TEMPLATE_
+inline bool generate_pose_candidate(const Keypoint3DColour *keypoints, const ScorePrediction *predictions, const Vector2i& imgSize, RNG& rng,
+                                    PoseCandidate& poseCandidate, int maxCandidateGenerationIterations, bool useAllModesPerLeafInPoseHypothesisGeneration,
+                                    bool checkMinDistanceBetweenSampledModes, float minSquaredDistanceBetweenSampledModes,
+                                    bool checkRigidTransformationConstraint, float maxTranslationErrorForCorrectPose)
+{
+  int selectedCount = 0;
+  int selectedPixels[PoseCandidate::KABSCH_POINTS];
+  int selectedModes[PoseCandidate::KABSCH_POINTS];
+
+  for(int iteration = 0; selectedCount < PoseCandidate::KABSCH_POINTS && iteration < maxCandidateGenerationIterations; ++iteration)
+  {
+    // Sample a pixel, and check that it has both a valid keypoint and at least one mode.
+    const int x = rng.generate_int_from_uniform(0, imgSize.width - 1);
+    const int y = rng.generate_int_from_uniform(0, imgSize.height - 1);
+    const int linearIdx = y * imgSize.width + x;
+
+    const Keypoint3DColour& keypoint = keypoints[linearIdx];
+    const ScorePrediction& prediction = predictions[linearIdx];
+    if(!keypoint.valid || prediction.size == 0) continue;
+
+    // Choose a mode for the pixel, and check that its colour is consistent with that of the keypoint.
+    const int modeIdx = useAllModesPerLeafInPoseHypothesisGeneration ? rng.generate_int_from_uniform(0, prediction.size - 1) : 0;
+    const Keypoint3DColourCluster& mode = prediction.elts[modeIdx];
+    if(!colours_are_compatible(keypoint, mode)) continue;
+
+    // Check the new correspondence against those that have already been selected.
+    bool valid = true;
+    for(int i = 0; i < selectedCount && valid; ++i)
+    {
+      const Vector3f cameraDiff = keypoint.position - keypoints[selectedPixels[i]].position;
+      const float cameraDistanceSquared = dot(cameraDiff, cameraDiff);
+
+      // If requested, check that the keypoints are far enough apart for the Kabsch algorithm to be well-conditioned.
+      if(checkMinDistanceBetweenSampledModes && cameraDistanceSquared < minSquaredDistanceBetweenSampledModes) valid = false;
+
+      // If requested, check that the distance between the keypoints is similar to the distance between their modes
+      // (since the transformation we are estimating is rigid, it must preserve distances).
+      if(checkRigidTransformationConstraint)
+      {
+        const Vector3f worldDiff = mode.position - predictions[selectedPixels[i]].elts[selectedModes[i]].position;
+        const float distanceDelta = sqrtf(cameraDistanceSquared) - length(worldDiff);
+        if(distanceDelta > maxTranslationErrorForCorrectPose || distanceDelta < -maxTranslationErrorForCorrectPose) valid = false;
+      }
+    }
+
+    if(!valid) continue;
+
+    selectedPixels[selectedCount] = linearIdx;
+    selectedModes[selectedCount] = modeIdx;
+    ++selectedCount;
+  }
+
+  if(selectedCount < PoseCandidate::KABSCH_POINTS) return false;
+
+  for(int i = 0; i < PoseCandidate::KABSCH_POINTS; ++i)
+  {
+    poseCandidate.pointsCamera[i] = keypoints[selectedPixels[i]].position;
+    poseCandidate.pointsWorld[i] = predictions[selectedPixels[i]].elts[selectedModes[i]].position;
+  }
+
+  poseCandidate.energy = 0.0f;
+  return true;
+}
+
+/**
+ * \brief Attempts to sample a pixel that can be used as an inlier when evaluating pose candidates.
+ *
+ * \param keypoints       The keypoints (one per pixel).
+ * \param predictions     The modes predicted for each pixel.
+ * \param imgSize         The size of the keypoints and predictions images.
+ * \param rng             The random number generator to use when sampling.
+ * \param inlierMask      An optional mask (one element per pixel) that is used to avoid sampling the same pixel twice (may be NULL).
+ * \return                The raster index of the sampled pixel, if a suitable pixel was found, or -1 otherwise.
+ */
+template <typename RNG>
+_CPU_AND_GPU_CODE_TEMPLATE_
+inline int sample_inlier(const Keypoint3DColour *keypoints, const ScorePrediction *predictions, const Vector2i& imgSize, RNG& rng, int *inlierMask)
+{
+  for(int iteration = 0; iteration < PREEMPTIVERANSAC_SAMPLE_INLIER_ITERATIONS; ++iteration)
+  {
+    const int x = rng.generate_int_from_uniform(0, imgSize.width - 1);
+    const int y = rng.generate_int_from_uniform(0, imgSize.height - 1);
+    const int linearIdx = y * imgSize.width + x;
+
+    if(!keypoints[linearIdx].valid || predictions[linearIdx].size == 0) continue;
+    if(!inlierMask) return linearIdx;
+
+    // Atomically mark the pixel as used, and accept it only if nobody else had already done so.
+    int oldMaskValue;
+
+#if defined(__CUDACC__) && defined(__CUDA_ARCH__)
+    oldMaskValue = atomicAdd(&inlierMask[linearIdx], 1);
+#else
+  #ifdef WITH_OPENMP
+    #pragma omp atomic capture
+  #endif
+    oldMaskValue = inlierMask[linearIdx]++;
+#endif
+
+    if(oldMaskValue == 0) return linearIdx;
+  }
+
+  return -1;
+}
+
+}
+
+#endif
@@ -0,0 +1,38 @@
+/**
+ * grove: ScoreRelocaliserFactory.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_GROVE_SCORERELOCALISERFACTORY
+#define H_GROVE_SCORERELOCALISERFACTORY
+
+#include <ITMLib/Utils/ITMLibSettings.h>
+
+#include "interface/ScoreRelocaliser.h"
+
+namespace grove {
+
+/**
+ * \brief This struct can be used to construct SCoRe relocalisers.
+ */
+struct ScoreRelocaliserFactory
+{
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+
+  /**
+   * \brief Makes a SCoRe relocaliser.
+   *
+   * \note  There is currently only a CPU implementation of the relocaliser, so it will always operate on the CPU.
+   *
+   * \param settings        The settings used to configure the relocaliser.
+   * \param forestFilename  The name of the file from which to load the structure of the SCoRe forest.
+   * \param deviceType      The device on which the relocaliser should operate.
+   * \return                The relocaliser.
+   */
+  static ScoreRelocaliser_Ptr make_score_relocaliser(const tvgutil::SettingsContainer_CPtr& settings, const std::string& forestFilename,
+                                                     ITMLib::ITMLibSettings::DeviceType deviceType);
+};
+
+}
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ * grove: ScoreRelocaliser_CPU.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_GROVE_SCORERELOCALISER_CPU
+#define H_GROVE_SCORERELOCALISER_CPU
+
+#include "../interface/ScoreRelocaliser.h"
+
+namespace grove {
+
+/**
+ * \brief An instance of this class can be used to relocalise a camera in a 3D scene using a SCoRe forest on the CPU.
+ *
+ * All of the components of the relocaliser (the feature calculator, forest, reservoirs, clusterer and preemptive RANSAC)
+ * operate on the CPU, so the relocaliser can be used in builds without CUDA support. The input images are copied across
+ * to the CPU as necessary.
+ */
+class ScoreRelocaliser_CPU : public ScoreRelocaliser
+{
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a CPU-based SCoRe relocaliser.
+   *
+   * \param settings        The settings used to configure the relocaliser.
+   * \param forestFilename  The name of the file from which to load the structure of the SCoRe forest.
+   *
+   * \throws std::runtime_error If the forest cannot be loaded.
+   */
+  ScoreRelocaliser_CPU(const tvgutil::SettingsContainer_CPtr& settings, const std::string& forestFilename);
+
+  //#################### PROTECTED MEMBER FUNCTIONS ####################
+protected:
+  /** Override */
+  virtual void get_predictions_for_leaves(const ScoreForest::LeafIndicesImage_CPtr& leafIndices, const ScorePredictionsMemoryBlock_CPtr& leafPredictions,
+                                          ScorePredictionsImage_Ptr& outputPredictions) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * grove: ScoreRelocaliser.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_GROVE_SCORERELOCALISER
+#define H_GROVE_SCORERELOCALISER
+
+#include <itmx/relocalisation/Relocaliser.h>
+
+#include <tvgutil/misc/SettingsContainer.h>
+
+#include "../../clustering/interface/ExampleClusterer.h"
+#include "../../features/interface/RGBDPatchFeatureCalculator.h"
+#include "../../forests/interface/DecisionForest.h"
+#include "../../keypoints/Keypoint3DColour.h"
+#include "../../ransac/interface/PreemptiveRansac.h"
+#include "../../reservoirs/interface/ExampleReservoirs.h"
+#include "../../scoreforests/Keypoint3DColourCluster.h"
+#include "../../scoreforests/ScorePrediction.h"
+
+namespace grove {
+
+/**
+ * \brief An instance of a class deriving from this one can be used to relocalise a camera in a 3D scene using a SCoRe forest,
+ *        as described in "On-the-Fly Adaptation of Regression Forests for Online Camera Relocalisation" (Cavallari et al., CVPR 2017).
+ *
+ * The relocaliser works as follows:
+ *
+ * 1) The structure of the forest is loaded from disk (it is pre-trained offline, and is not specific to the scene).
+ * 2) During training, RGB-D patch features are computed for a subset of the pixels of each frame, and passed down the forest.
+ *    The corresponding 3D keypoints (in world space) are then added to the example reservoirs associated with the leaves they reach.
+ * 3) Whenever spare time is available (and after each training frame), a few of the reservoirs are clustered to compute the modes
+ *    predicted by their leaves. The reservoirs are visited cyclically, so the cost of keeping the modes up to date is amortised
+ *    over many frames. By default, only those reservoirs that have changed since they were last clustered are reclustered.
+ * 4) When relocalising, the modes of the leaves reached by each pixel of the frame are merged, and preemptive RANSAC is used to
+ *    estimate a camera pose from the keypoints (in camera space) and the modes predicted for them.
+ */
+class ScoreRelocaliser : public itmx::Relocaliser
+{
+  //#################### TYPEDEFS ####################
+public:
+  typedef Keypoint3DColour ExampleType;
+  typedef Keypoint3DColourCluster ClusterType;
+  typedef RGBDPatchDescriptor DescriptorType;
+  enum { TREE_COUNT = 5 };
+
+  typedef ExampleClusterer<ExampleType,ClusterType,ScorePrediction::Capacity> Clusterer;
+  typedef boost::shared_ptr<Clusterer> Clusterer_Ptr;
+
+  typedef ExampleReservoirs<ExampleType> Reservoirs;
+  typedef boost::shared_ptr<Reservoirs> Reservoirs_Ptr;
+
+  typedef DecisionForest<DescriptorType,TREE_COUNT> ScoreForest;
+  typedef boost::shared_ptr<ScoreForest> ScoreForest_Ptr;
+
+  //#################### PROTECTED VARIABLES ####################
+protected:
+  /** The sigma of the Gaussian used when computing the example densities during clustering. */
+  float m_clustererSigma;
+
+  /** The maximum distance there can be between two examples that are part of the same cluster. */
+  float m_clustererTau;
+
+  /** The descriptors computed for the current frame. */
+  mutable RGBDPatchDescriptorImage_Ptr m_descriptorsImage;
+
+  /** The clusterer used to compute the modes predicted by the leaves of the forest. */
+  Clusterer_Ptr m_exampleClusterer;
+
+  /** The reservoirs of examples associated with the leaves of the forest. */
+  Reservoirs_Ptr m_exampleReservoirs;
+
+  /** Whether to only recluster those reservoirs that have changed since they were last clustered. */
+  bool m_incrementalClustering;
+
+  /** The calculator used to compute the keypoints and descriptors for each frame. */
+  DA_RGBDPatchFeatureCalculator_Ptr m_featureCalculator;
+
+  /** The keypoints computed for the current frame (in world space when training, and in camera space when relocalising). */
+  mutable Keypoint3DColourImage_Ptr m_keypointsImage;
+
+  /** The indices of the leaves reached by the descriptors of the current frame. */
+  mutable ScoreForest::LeafIndicesImage_Ptr m_leafIndicesImage;
+
+  /** The maximum number of clusters to store in each leaf of the forest. */
+  uint32_t m_maxClusterCount;
+
+  /** The maximum number of pose candidates to return from a call to relocalise_ranked. */
+  uint32_t m_maxRelocalisationsToOutput;
+
+  /** The maximum number of reservoirs to cluster in each call to update (or train). */
+  uint32_t m_maxReservoirsToUpdate;
+
+  /** The minimum size a cluster must have to be stored in a leaf. */
+  uint32_t m_minClusterSize;
+
+  /** The modes predicted by each leaf of the forest (one element per leaf). */
+  ScorePredictionsMemoryBlock_Ptr m_predictionsBlock;
+
+  /** The modes predicted for each pixel of the current frame. */
+  mutable ScorePredictionsImage_Ptr m_predictionsImage;
+
+  /** The preemptive RANSAC instance used to estimate the camera pose when relocalising. */
+  PreemptiveRansac_Ptr m_preemptiveRansac;
+
+  /** The capacity of each example reservoir. */
+  uint32_t m_reservoirCapacity;
+
+  /** The index of the first reservoir to cluster in the next call to update (or train). */
+  uint32_t m_reservoirUpdateStartIdx;
+
+  /** The seed used to initialise the random number generators used by the example reservoirs. */
+  uint32_t m_rngSeed;
+
+  /** The SCoRe forest. */
+  ScoreForest_Ptr m_scoreForest;
+
+  //#################### CONSTRUCTORS ####################
+protected:
+  /**
+   * \brief Constructs a SCoRe relocaliser.
+   *
+   * \note  The constructor only reads the settings: derived classes are responsible for constructing the forest, reservoirs,
+   *        clusterer, feature calculator and preemptive RANSAC instance, and for calling reset once they have done so.
+   *
+   * \param settings  The settings used to configure the relocaliser (these are looked up in the "ScoreRelocaliser." namespace).
+   */
+  explicit ScoreRelocaliser(const tvgutil::SettingsContainer_CPtr& settings);
+
+  //#################### DESTRUCTOR ####################
+public:
+  /**
+   * \brief Destroys the SCoRe relocaliser.
+   */
+  virtual ~ScoreRelocaliser();
+
+  //#################### PROTECTED ABSTRACT MEMBER FUNCTIONS ####################
+protected:
+  /**
+   * \brief Merges the modes predicted by the leaves reached by each pixel of the current frame into a single prediction per pixel.
+   *
+   * \param leafIndices       The indices of the leaves reached by each pixel.
+   * \param leafPredictions   The modes predicted by each leaf of the forest.
+   * \param outputPredictions An image into which to write the merged predictions (resized as necessary).
+   */
+  virtual void get_predictions_for_leaves(const ScoreForest::LeafIndicesImage_CPtr& leafIndices, const ScorePredictionsMemoryBlock_CPtr& leafPredictions,
+                                          ScorePredictionsImage_Ptr& outputPredictions) const = 0;
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /** Override */
+  virtual boost::optional<Result> relocalise(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage, const Vector4f& depthIntrinsics) const;
+
+  /** Override */
+  virtual std::vector<Result> relocalise_ranked(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage, const Vector4f& depthIntrinsics) const;
+
+  /** Override */
+  virtual void reset();
+
+  /** Override */
+  virtual void train(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage,
+                     const Vector4f& depthIntrinsics, const ORUtils::SE3Pose& cameraPose);
+
+  /** Override */
+  virtual void update();
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Clusters the next m_maxReservoirsToUpdate reservoirs (wrapping around to the first reservoir when the last one is reached),
+   *        and stores the resulting modes in the corresponding leaves.
+   *
+   * \note If incremental clustering is enabled, those of the reservoirs that have not changed since they were last clustered are skipped.
+   */
+  void update_clusters();
+};
+
+//#################### TYPEDEFS ####################
+
+typedef boost::shared_ptr<ScoreRelocaliser> ScoreRelocaliser_Ptr;
+typedef boost::shared_ptr<const ScoreRelocaliser> ScoreRelocaliser_CPtr;
+
+}
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * grove: ScoreRelocaliser_Shared.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_GROVE_SCORERELOCALISER_SHARED
+#define H_GROVE_SCORERELOCALISER_SHARED
+
+#include <ORUtils/PlatformIndependence.h>
+#include <ORUtils/Vector.h>
+
+#include "../../scoreforests/ScorePrediction.h"
+
+namespace grove {
+
+/**
+ * \brief Merges the modes stored in the leaves reached by a pixel in each tree of a SCoRe forest into a single prediction.
+ *
+ * The modes in each leaf are assumed to be sorted into non-increasing order of size (as they are when produced by the
+ * example clusterer). The merged prediction contains the largest modes over all of the leaves, again sorted into
+ * non-increasing order of size.
+ *
+ * \param leafPredictions   The predictions associated with each leaf of the forest (indexed by global leaf index).
+ * \param leafIndices       The leaf indices of the pixels (one element per tree for each pixel).
+ * \param outputPredictions An image into which to write the merged predictions (one per pixel).
+ * \param imgSize           The size of the leaf indices and output predictions images.
+ * \param maxModeCount      The maximum number of modes to store in each merged prediction (must be <= ScorePrediction::Capacity).
+ * \param x                 The x coordinate of the pixel.
+ * \param y                 The y coordinate of the pixel.
+ */
+template <int TreeCount>
+_CPU_AND_GPU_CODE_TEMPLATE_
+inline void merge_predictions_for_keypoint(const ScorePrediction *leafPredictions, const ORUtils::VectorX<int,TreeCount> *leafIndices,
+                                           ScorePrediction *outputPredictions, Vector2i imgSize, int maxModeCount, int x, int y)
+{
+  const int linearIdx = y * imgSize.width + x;
+  const ORUtils::VectorX<int,TreeCount>& pixelLeafIndices = leafIndices[linearIdx];
+  ScorePrediction& outputPrediction = outputPredictions[linearIdx];
+
+  // The index of the next mode to consider in each of the leaves reached by the pixel.
+  int nextModeIdx[TreeCount];
+  for(int treeIdx = 0; treeIdx < TreeCount; ++treeIdx)
+  {
+    nextModeIdx[treeIdx] = 0;
+  }
+
+  // Perform a k-way merge of the leaves' modes, repeatedly taking the largest mode that remains.
+  outputPrediction.size = 0;
+  while(outputPrediction.size < maxModeCount)
+  {
+    int bestTreeIdx = -1;
+    int bestInliers = 0;
+    for(int treeIdx = 0; treeIdx < TreeCount; ++treeIdx)
+    {
+      const ScorePrediction& leafPrediction = leafPredictions[pixelLeafIndices[treeIdx]];
+      const int modeIdx = nextModeIdx[treeIdx];
+      if(modeIdx < leafPrediction.size && leafPrediction.elts[modeIdx].nbInliers > bestInliers)
+      {
+        bestTreeIdx = treeIdx;
+        bestInliers = leafPrediction.elts[modeIdx].nbInliers;
+      }
+    }
+
+    // If all of the leaves have been exhausted, stop.
+    if(bestTreeIdx < 0) break;
+
+    outputPrediction.elts[outputPrediction.size++] = leafPredictions[pixelLeafIndices[bestTreeIdx]].elts[nextModeIdx[bestTreeIdx]++];
+  }
+}
+
+}
+
+#endif
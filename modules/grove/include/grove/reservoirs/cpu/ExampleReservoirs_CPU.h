@@ -6,6 +6,8 @@
 #ifndef H_GROVE_EXAMPLERESERVOIRS_CPU
 #define H_GROVE_EXAMPLERESERVOIRS_CPU
 
+#include <vector>
+
 #include "../interface/ExampleReservoirs.h"
 #include "../../numbers/CPURNG.h"
 
@@ -14,6 +16,16 @@ namespace grove {
 /**
  * \brief An instance of this class can be used to store a number of examples in a set of fixed-size reservoirs using the CPU.
  *
+ * Examples can be added to the reservoirs in one of two ways (see InsertionMode). In atomic mode, each example is added to
+ * its reservoirs straight away, using atomic operations to update the reservoirs' add call counts and sizes (this mirrors
+ * the CUDA implementation). In sharded mode, the reservoirs are divided into a fixed number of shards, which are shared out
+ * between the threads. The examples are first divided into the same number of contiguous ranges, and the (reservoir, example)
+ * pairs for each range are buffered, grouped by shard; each shard is then updated by a single thread, in a single pass over
+ * the pairs for its reservoirs, without the need for any atomic operations. This avoids threads contending for the cache
+ * lines of hot reservoirs, and also means that the examples are added to each reservoir in raster order. Since neither the
+ * shards nor their random number generators depend on the number of threads, the contents of the reservoirs depend only
+ * on the seed.
+ *
  * \param ExampleType The type of example stored in the reservoirs. Must have a member named "valid", convertible to bool.
  */
 template <typename ExampleType>
@@ -25,11 +37,66 @@ public:
   using typename Base::ExampleImage_CPtr;
   using typename Base::Visitor;
 
+  //#################### ENUMERATIONS ####################
+public:
+  /**
+   * \brief The values of this enumeration denote the different ways in which examples can be added to the reservoirs.
+   */
+  enum InsertionMode
+  {
+    /** Add each example to its reservoirs straight away, using atomic operations to update the reservoirs' state. */
+    INSERTION_ATOMIC,
+
+    /** Buffer the examples by shard, and then update each shard of reservoirs using a single thread. */
+    INSERTION_SHARDED
+  };
+
+private:
+  /**
+   * The number of consecutive reservoirs whose add call counts and sizes share a (64-byte) cache line. In sharded mode,
+   * the reservoirs are assigned to shards in blocks of this size, so that threads updating different shards do not
+   * write to the same cache lines.
+   */
+  enum { RESERVOIRS_PER_CACHE_LINE = 16 };
+
+  /**
+   * The number of shards into which the reservoirs are divided in sharded mode. This is fixed (rather than depending on
+   * the number of threads), so that the results are the same on every machine. It is chosen to be comfortably larger
+   * than the number of threads we expect to use, so that the work can still be balanced between them.
+   */
+  enum { SHARD_COUNT = 64 };
+
+  //#################### NESTED TYPES ####################
+private:
+  /**
+   * \brief An instance of this struct represents a pending attempt to add an example to a reservoir.
+   */
+  struct PendingInsertion
+  {
+    /** The index of the example (in the examples image). */
+    int exampleIdx;
+
+    /** The index of the reservoir. */
+    int reservoirIdx;
+  };
+
   //#################### PRIVATE MEMBER VARIABLES ####################
 private:
-  /** A set of random number generators (used when adding examples). */
+  /** The way in which examples are added to the reservoirs. */
+  InsertionMode m_insertionMode;
+
+  /**
+   * The buffers of pending insertions used in sharded mode. The buffer at index (producerIdx * SHARD_COUNT + shardIdx) holds
+   * the pending insertions into reservoirs in the specified shard for the examples in the specified producer's range.
+   */
+  std::vector<std::vector<PendingInsertion> > m_pendingInsertions;
+
+  /** A set of random number generators (used when adding examples in atomic mode). */
   CPURNGMemoryBlock_Ptr m_rngs;
 
+  /** A random number generator for each shard (used when adding examples in sharded mode). */
+  CPURNGMemoryBlock_Ptr m_shardRngs;
+
   //#################### CONSTRUCTORS ####################
 public:
   /**
@@ -38,8 +105,9 @@ public:
    * \param reservoirCount    The number of reservoirs to create.
    * \param reservoirCapacity The capacity of each reservoir.
    * \param rngSeed           The seed for the random number generator.
+   * \param insertionMode     The way in which examples should be added to the reservoirs.
    */
-  ExampleReservoirs_CPU(uint32_t reservoirCount, uint32_t reservoirCapacity, uint32_t rngSeed = 42);
+  ExampleReservoirs_CPU(uint32_t reservoirCount, uint32_t reservoirCapacity, uint32_t rngSeed = 42, InsertionMode insertionMode = INSERTION_SHARDED);
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
@@ -55,6 +123,24 @@ private:
   template <int ReservoirIndexCount>
   void add_examples_sub(const ExampleImage_CPtr& examples, const boost::shared_ptr<const ORUtils::Image<ORUtils::VectorX<int,ReservoirIndexCount> > >& reservoirIndices);
 
+  /**
+   * \brief Adds some examples to the reservoirs, using atomic operations to update the reservoirs' state.
+   *
+   * \param examples         The examples to add to the reservoirs.
+   * \param reservoirIndices The indices of the reservoirs to which to add each element of the examples image.
+   */
+  template <int ReservoirIndexCount>
+  void add_examples_atomic(const ExampleImage_CPtr& examples, const boost::shared_ptr<const ORUtils::Image<ORUtils::VectorX<int,ReservoirIndexCount> > >& reservoirIndices);
+
+  /**
+   * \brief Adds some examples to the reservoirs by buffering them by shard and then updating each shard using a single thread.
+   *
+   * \param examples         The examples to add to the reservoirs.
+   * \param reservoirIndices The indices of the reservoirs to which to add each element of the examples image.
+   */
+  template <int ReservoirIndexCount>
+  void add_examples_sharded(const ExampleImage_CPtr& examples, const boost::shared_ptr<const ORUtils::Image<ORUtils::VectorX<int,ReservoirIndexCount> > >& reservoirIndices);
+
   /**
    * \brief Reinitialises the random number generators using known seeds.
    */
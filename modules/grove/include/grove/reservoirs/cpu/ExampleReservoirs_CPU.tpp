@@ -14,9 +14,11 @@ namespace grove {
 //#################### CONSTRUCTORS ####################
 
 template <typename ExampleType>
-ExampleReservoirs_CPU<ExampleType>::ExampleReservoirs_CPU(uint32_t reservoirCount, uint32_t reservoirCapacity, uint32_t rngSeed)
-: ExampleReservoirs<ExampleType>(reservoirCount, reservoirCapacity, rngSeed)
+ExampleReservoirs_CPU<ExampleType>::ExampleReservoirs_CPU(uint32_t reservoirCount, uint32_t reservoirCapacity, uint32_t rngSeed, InsertionMode insertionMode)
+: ExampleReservoirs<ExampleType>(reservoirCount, reservoirCapacity, rngSeed), m_insertionMode(insertionMode)
 {
+  m_pendingInsertions.resize(SHARD_COUNT * SHARD_COUNT);
+
   reset();
 }
 
@@ -40,6 +42,14 @@ void ExampleReservoirs_CPU<ExampleType>::accept(const Visitor& visitor)
 template <typename ExampleType>
 template <int ReservoirIndexCount>
 void ExampleReservoirs_CPU<ExampleType>::add_examples_sub(const ExampleImage_CPtr& examples, const boost::shared_ptr<const ORUtils::Image<ORUtils::VectorX<int,ReservoirIndexCount> > >& reservoirIndices)
+{
+  if(m_insertionMode == INSERTION_SHARDED) add_examples_sharded(examples, reservoirIndices);
+  else add_examples_atomic(examples, reservoirIndices);
+}
+
+template <typename ExampleType>
+template <int ReservoirIndexCount>
+void ExampleReservoirs_CPU<ExampleType>::add_examples_atomic(const ExampleImage_CPtr& examples, const boost::shared_ptr<const ORUtils::Image<ORUtils::VectorX<int,ReservoirIndexCount> > >& reservoirIndices)
 {
   const Vector2i imgSize = examples->noDims;
   const size_t exampleCount = imgSize.width * imgSize.height;
@@ -76,6 +86,75 @@ void ExampleReservoirs_CPU<ExampleType>::add_examples_sub(const ExampleImage_CPt
   }
 }
 
+template <typename ExampleType>
+template <int ReservoirIndexCount>
+void ExampleReservoirs_CPU<ExampleType>::add_examples_sharded(const ExampleImage_CPtr& examples, const boost::shared_ptr<const ORUtils::Image<ORUtils::VectorX<int,ReservoirIndexCount> > >& reservoirIndices)
+{
+  const Vector2i imgSize = examples->noDims;
+  const int exampleCount = imgSize.width * imgSize.height;
+  const int shardCount = SHARD_COUNT;
+
+  const ExampleType *examplesPtr = examples->GetData(MEMORYDEVICE_CPU);
+  int *reservoirAddCalls = this->m_reservoirAddCalls->GetData(MEMORYDEVICE_CPU);
+  const ORUtils::VectorX<int,ReservoirIndexCount> *reservoirIndicesPtr = reservoirIndices->GetData(MEMORYDEVICE_CPU);
+  int *reservoirSizes = this->m_reservoirSizes->GetData(MEMORYDEVICE_CPU);
+  ExampleType *reservoirs = this->m_reservoirs->GetData(MEMORYDEVICE_CPU);
+  CPURNG *shardRngs = m_shardRngs->GetData(MEMORYDEVICE_CPU);
+
+  // Step 1: Divide the examples into contiguous ranges, one per producer. For each valid example in its range, each producer
+  //         buffers a pending insertion into each of the example's reservoirs, grouped by the shard to which the reservoir belongs.
+#ifdef WITH_OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for(int producerIdx = 0; producerIdx < shardCount; ++producerIdx)
+  {
+    std::vector<PendingInsertion> *producerBuffers = &m_pendingInsertions[producerIdx * shardCount];
+    for(int shardIdx = 0; shardIdx < shardCount; ++shardIdx)
+    {
+      producerBuffers[shardIdx].clear();
+    }
+
+    const int rangeBegin = static_cast<int>(static_cast<int64_t>(exampleCount) * producerIdx / shardCount);
+    const int rangeEnd = static_cast<int>(static_cast<int64_t>(exampleCount) * (producerIdx + 1) / shardCount);
+    for(int exampleIdx = rangeBegin; exampleIdx < rangeEnd; ++exampleIdx)
+    {
+      if(!examplesPtr[exampleIdx].valid) continue;
+
+      for(int i = 0; i < ReservoirIndexCount; ++i)
+      {
+        PendingInsertion insertion;
+        insertion.exampleIdx = exampleIdx;
+        insertion.reservoirIdx = reservoirIndicesPtr[exampleIdx][i];
+        producerBuffers[(insertion.reservoirIdx / RESERVOIRS_PER_CACHE_LINE) % shardCount].push_back(insertion);
+      }
+    }
+  }
+
+  // Step 2: Update each shard of reservoirs using a single thread. Since no other thread touches the reservoirs in the shard,
+  //         there is no need for atomic operations. Visiting the producers in order means that the examples are added to each
+  //         reservoir in raster order.
+#ifdef WITH_OPENMP
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for(int shardIdx = 0; shardIdx < shardCount; ++shardIdx)
+  {
+    CPURNG& rng = shardRngs[shardIdx];
+    for(int producerIdx = 0; producerIdx < shardCount; ++producerIdx)
+    {
+      const std::vector<PendingInsertion>& buffer = m_pendingInsertions[producerIdx * shardCount + shardIdx];
+      for(size_t j = 0, size = buffer.size(); j < size; ++j)
+      {
+        const int reservoirIdx = buffer[j].reservoirIdx;
+        const uint32_t oldAddCallsCount = reservoirAddCalls[reservoirIdx]++;
+        if(store_example_in_reservoir(examplesPtr[buffer[j].exampleIdx], reservoirIdx, oldAddCallsCount, reservoirs, this->m_reservoirCapacity, rng))
+        {
+          ++reservoirSizes[reservoirIdx];
+        }
+      }
+    }
+  }
+}
+
 template <typename ExampleType>
 void ExampleReservoirs_CPU<ExampleType>::reinit_rngs()
 {
@@ -86,6 +165,13 @@ void ExampleReservoirs_CPU<ExampleType>::reinit_rngs()
     m_rngs = mbf.make_block<CPURNG>();
   }
 
+  // Likewise for the memory block that will hold the random number generators for the shards.
+  if(!m_shardRngs)
+  {
+    itmx::MemoryBlockFactory& mbf = itmx::MemoryBlockFactory::instance();
+    m_shardRngs = mbf.make_block<CPURNG>(SHARD_COUNT);
+  }
+
   // Reinitialise each random number generator based on the specified seed.
   CPURNG *rngs = m_rngs->GetData(MEMORYDEVICE_CPU);
   const uint32_t rngCount = static_cast<uint32_t>(m_rngs->dataSize);
@@ -93,6 +179,12 @@ void ExampleReservoirs_CPU<ExampleType>::reinit_rngs()
   {
     rngs[i].reset(this->m_rngSeed + i);
   }
+
+  CPURNG *shardRngs = m_shardRngs->GetData(MEMORYDEVICE_CPU);
+  for(int i = 0; i < SHARD_COUNT; ++i)
+  {
+    shardRngs[i].reset(this->m_rngSeed + i);
+  }
 }
 
 }
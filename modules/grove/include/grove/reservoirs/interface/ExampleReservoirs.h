@@ -136,6 +136,17 @@ public:
   template <int ReservoirIndexCount>
   void add_examples(const ExampleImage_CPtr& examples, const boost::shared_ptr<ORUtils::Image<ORUtils::VectorX<int,ReservoirIndexCount> > >& reservoirIndices);
 
+  /**
+   * \brief Gets the number of times the insertion of an example has been attempted for each reservoir.
+   *
+   * \note Since a reservoir can only change when an example is added to it, these counts can be used as version
+   *       numbers for the reservoirs (e.g. to avoid reclustering reservoirs that have not changed). However,
+   *       they are reset to zero by reset, so any versions recorded before then must be discarded.
+   *
+   * \return A memory block containing the number of add calls made for each reservoir.
+   */
+  ITMIntMemoryBlock_CPtr get_reservoir_add_calls() const;
+
   /**
    * \brief Gets the capacity of each reservoir.
    *
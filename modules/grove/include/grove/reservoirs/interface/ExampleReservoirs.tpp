@@ -52,6 +52,12 @@ void ExampleReservoirs<ExampleType>::add_examples(const ExampleImage_CPtr& examp
   add_examples(examples, reservoirIndicesConst);
 }
 
+template <typename ExampleType>
+ITMIntMemoryBlock_CPtr ExampleReservoirs<ExampleType>::get_reservoir_add_calls() const
+{
+  return m_reservoirAddCalls;
+}
+
 template <typename ExampleType>
 uint32_t ExampleReservoirs<ExampleType>::get_reservoir_capacity() const
 {
@@ -12,6 +12,56 @@
 
 namespace grove {
 
+/**
+ * \brief Stores an example in a reservoir, given the number of add calls that were previously made for the reservoir.
+ *
+ * If the reservoir is not yet full, the example is stored in the next free slot. Otherwise, it may (or, if ALWAYS_ADD_EXAMPLES
+ * is 1, will) replace a randomly-selected existing example. The caller is responsible for updating the reservoir's add call count
+ * and size.
+ *
+ * \param example           The example to store.
+ * \param reservoirIdx      The index of the reservoir in which to store the example.
+ * \param oldAddCallsCount  The number of add calls that were made for the reservoir before this one.
+ * \param reservoirs        The example reservoirs: an image in which each row allows the storage of up to reservoirCapacity examples.
+ * \param reservoirCapacity The capacity (maximum size) of each reservoir.
+ * \param randomGenerator   A random number generator.
+ * \return                  true, if the example was stored in a free slot (i.e. the reservoir's size should be incremented), or false otherwise.
+ */
+template <typename ExampleType, typename RNGType>
+_CPU_AND_GPU_CODE_TEMPLATE_
+inline bool store_example_in_reservoir(const ExampleType& example, int reservoirIdx, uint32_t oldAddCallsCount, ExampleType *reservoirs,
+                                       uint32_t reservoirCapacity, RNGType& randomGenerator)
+{
+  // The raster index (in the reservoirs image) of the first example in the reservoir.
+  const int reservoirStartIdx = reservoirIdx * reservoirCapacity;
+
+  // If the old total number of add calls is less than the reservoir's capacity, then we can immediately add the example.
+  // Otherwise, we need to decide whether or not to replace an existing example with this one.
+  if(oldAddCallsCount < reservoirCapacity)
+  {
+    reservoirs[reservoirStartIdx + oldAddCallsCount] = example;
+    return true;
+  }
+  else
+  {
+#if ALWAYS_ADD_EXAMPLES
+    // Generate a random offset that will always result in an example being evicted from the reservoir.
+    const uint32_t randomOffset = randomGenerator.generate_int_from_uniform(0, reservoirCapacity - 1);
+#else
+    // Generate a random offset that may or may not result in an example being evicted from the reservoir.
+    const uint32_t randomOffset = randomGenerator.generate_int_from_uniform(0, oldAddCallsCount - 1);
+#endif
+
+    // If the random offset corresponds to an example in the reservoir, replace that with the new example.
+    if(randomOffset < reservoirCapacity)
+    {
+      reservoirs[reservoirStartIdx + randomOffset] = example;
+    }
+
+    return false;
+  }
+}
+
 /**
  * \brief Attempts to add an example to some reservoirs.
  *
@@ -45,9 +95,6 @@ inline void add_example_to_reservoirs(const ExampleType& example, const int *res
     // The reservoir index (this corresponds to a row in the reservoirs image).
     const int reservoirIdx = reservoirIndices[i];
 
-    // The raster index (in the reservoirs image) of the first example in the reservoir.
-    const int reservoirStartIdx = reservoirIdx * reservoirCapacity;
-
     // Get the total number of add calls that have ever been made for the current reservoir, and increment it for next time.
     uint32_t oldAddCallsCount = 0;
 
@@ -60,13 +107,9 @@ inline void add_example_to_reservoirs(const ExampleType& example, const int *res
     oldAddCallsCount = reservoirAddCalls[reservoirIdx]++;
 #endif
 
-    // If the old total number of add calls is less than the reservoir's capacity, then we can immediately add the example.
-    // Otherwise, we need to decide whether or not to replace an existing example with this one.
-    if(oldAddCallsCount < reservoirCapacity)
+    // Store the example in the reservoir (or not, as the case may be).
+    if(store_example_in_reservoir(example, reservoirIdx, oldAddCallsCount, reservoirs, reservoirCapacity, randomGenerator))
     {
-      // Store the example in the reservoir.
-      reservoirs[reservoirStartIdx + oldAddCallsCount] = example;
-
       // Increment the reservoir's size. Note that it is not strictly necessary to
       // maintain the reservoir sizes separately, since we can obtain the same
       // information from reservoirAddCalls by clamping the values to the reservoir
@@ -81,22 +124,6 @@ inline void add_example_to_reservoirs(const ExampleType& example, const int *res
       ++reservoirSizes[reservoirIdx];
 #endif
     }
-    else
-    {
-#if ALWAYS_ADD_EXAMPLES
-      // Generate a random offset that will always result in an example being evicted from the reservoir.
-      const uint32_t randomOffset = randomGenerator.generate_int_from_uniform(0, reservoirCapacity - 1);
-#else
-      // Generate a random offset that may or may not result in an example being evicted from the reservoir.
-      const uint32_t randomOffset = randomGenerator.generate_int_from_uniform(0, oldAddCallsCount - 1);
-#endif
-
-      // If the random offset corresponds to an example in the reservoir, replace that with the new example.
-      if(randomOffset < reservoirCapacity)
-      {
-        reservoirs[reservoirStartIdx + randomOffset] = example;
-      }
-    }
   }
 }
 
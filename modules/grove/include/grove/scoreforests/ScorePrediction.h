@@ -0,0 +1,32 @@
+/**
+ * grove: ScorePrediction.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_GROVE_SCOREPREDICTION
+#define H_GROVE_SCOREPREDICTION
+
+#include "../util/Array.h"
+#include "Keypoint3DColourCluster.h"
+
+namespace grove {
+
+//#################### TYPEDEFS ####################
+
+/**
+ * \brief An instance of this type represents the prediction made by a SCoRe forest for a single pixel, namely a set of modal
+ *        clusters of 3D points in world space (the clusters are those stored in the forest leaf that the pixel reached).
+ */
+typedef Array<Keypoint3DColourCluster,50> ScorePrediction;
+
+typedef ORUtils::MemoryBlock<ScorePrediction> ScorePredictionsMemoryBlock;
+typedef boost::shared_ptr<ScorePredictionsMemoryBlock> ScorePredictionsMemoryBlock_Ptr;
+typedef boost::shared_ptr<const ScorePredictionsMemoryBlock> ScorePredictionsMemoryBlock_CPtr;
+
+typedef ORUtils::Image<ScorePrediction> ScorePredictionsImage;
+typedef boost::shared_ptr<ScorePredictionsImage> ScorePredictionsImage_Ptr;
+typedef boost::shared_ptr<const ScorePredictionsImage> ScorePredictionsImage_CPtr;
+
+}
+
+#endif
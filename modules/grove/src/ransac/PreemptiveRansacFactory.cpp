@@ -0,0 +1,21 @@
+/**
+ * grove: PreemptiveRansacFactory.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include "ransac/PreemptiveRansacFactory.h"
+using namespace ITMLib;
+
+#include "ransac/cpu/PreemptiveRansac_CPU.h"
+
+namespace grove {
+
+//#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+
+PreemptiveRansac_Ptr PreemptiveRansacFactory::make_preemptive_ransac(const tvgutil::SettingsContainer_CPtr& settings, ITMLibSettings::DeviceType deviceType)
+{
+  // Note: The device type is currently ignored, since only the CPU implementation exists.
+  return PreemptiveRansac_Ptr(new PreemptiveRansac_CPU(settings));
+}
+
+}
@@ -0,0 +1,124 @@
+/**
+ * grove: PreemptiveRansac_CPU.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include "ransac/cpu/PreemptiveRansac_CPU.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <itmx/base/MemoryBlockFactory.h>
+using namespace itmx;
+
+#include "ransac/shared/PreemptiveRansac_Shared.h"
+
+namespace grove {
+
+//#################### CONSTRUCTORS ####################
+
+PreemptiveRansac_CPU::PreemptiveRansac_CPU(const tvgutil::SettingsContainer_CPtr& settings)
+: PreemptiveRansac(settings)
+{
+  // We need one generator per pose candidate, and one per inlier in a batch.
+  m_randomGenerators = MemoryBlockFactory::instance().make_block<CPURNG>(std::max(m_maxPoseCandidates, m_batchSizeRansac));
+  init_random();
+}
+
+//#################### PROTECTED MEMBER FUNCTIONS ####################
+
+void PreemptiveRansac_CPU::compute_energies_and_sort(uint32_t firstInlierIdx)
+{
+  const Keypoint3DColour *keypoints = m_keypointsImage->GetData(MEMORYDEVICE_CPU);
+  const ScorePrediction *predictions = m_predictionsImage->GetData(MEMORYDEVICE_CPU);
+  const int *inlierRasterIndices = m_inlierRasterIndices->GetData(MEMORYDEVICE_CPU);
+  PoseCandidate *poseCandidates = m_poseCandidates->GetData(MEMORYDEVICE_CPU);
+  const int nbInliers = static_cast<int>(m_nbInliers);
+  const int nbPoseCandidates = static_cast<int>(m_nbPoseCandidates);
+
+  // Score each candidate on the new inliers, and fold the result into its average energy. Since every candidate
+  // is processed by a single thread, visiting the inliers in order, the energies do not depend on the thread count.
+#ifdef WITH_OPENMP
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for(int candidateIdx = 0; candidateIdx < nbPoseCandidates; ++candidateIdx)
+  {
+    PoseCandidate& candidate = poseCandidates[candidateIdx];
+
+    float energySum = 0.0f;
+    for(int i = static_cast<int>(firstInlierIdx); i < nbInliers; ++i)
+    {
+      const int rasterIdx = inlierRasterIndices[i];
+      energySum += compute_energy_for_keypoint(candidate.cameraPose, keypoints[rasterIdx], predictions[rasterIdx]);
+    }
+
+    candidate.energy = nbInliers > 0 ? (candidate.energy * firstInlierIdx + energySum) / nbInliers : 0.0f;
+  }
+
+  // Sort the candidates into non-decreasing order of energy (a stable sort is used to keep the order deterministic in the event of ties).
+  std::stable_sort(poseCandidates, poseCandidates + nbPoseCandidates);
+}
+
+void PreemptiveRansac_CPU::generate_pose_candidates()
+{
+  const Keypoint3DColour *keypoints = m_keypointsImage->GetData(MEMORYDEVICE_CPU);
+  const ScorePrediction *predictions = m_predictionsImage->GetData(MEMORYDEVICE_CPU);
+  const Vector2i imgSize = m_keypointsImage->noDims;
+  PoseCandidate *poseCandidates = m_poseCandidates->GetData(MEMORYDEVICE_CPU);
+  CPURNG *randomGenerators = m_randomGenerators->GetData(MEMORYDEVICE_CPU);
+  const int maxPoseCandidates = static_cast<int>(m_maxPoseCandidates);
+
+  // Try to generate each candidate in its own slot.
+  std::vector<char> valid(maxPoseCandidates);
+
+#ifdef WITH_OPENMP
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for(int candidateIdx = 0; candidateIdx < maxPoseCandidates; ++candidateIdx)
+  {
+    valid[candidateIdx] = generate_pose_candidate(
+      keypoints, predictions, imgSize, randomGenerators[candidateIdx], poseCandidates[candidateIdx],
+      m_maxCandidateGenerationIterations, m_useAllModesPerLeafInPoseHypothesisGeneration,
+      m_checkMinDistanceBetweenSampledModes, m_minSquaredDistanceBetweenSampledModes,
+      m_checkRigidTransformationConstraint, m_maxTranslationErrorForCorrectPose
+    );
+  }
+
+  // Compact the successfully-generated candidates into the start of the array, preserving their order.
+  m_nbPoseCandidates = 0;
+  for(int candidateIdx = 0; candidateIdx < maxPoseCandidates; ++candidateIdx)
+  {
+    if(valid[candidateIdx]) poseCandidates[m_nbPoseCandidates++] = poseCandidates[candidateIdx];
+  }
+}
+
+void PreemptiveRansac_CPU::init_random()
+{
+  CPURNG *randomGenerators = m_randomGenerators->GetData(MEMORYDEVICE_CPU);
+  const int generatorCount = static_cast<int>(m_randomGenerators->dataSize);
+
+  for(int i = 0; i < generatorCount; ++i)
+  {
+    randomGenerators[i].reset(m_rngSeed + i);
+  }
+}
+
+void PreemptiveRansac_CPU::sample_inliers()
+{
+  const Keypoint3DColour *keypoints = m_keypointsImage->GetData(MEMORYDEVICE_CPU);
+  const ScorePrediction *predictions = m_predictionsImage->GetData(MEMORYDEVICE_CPU);
+  const Vector2i imgSize = m_keypointsImage->noDims;
+  int *inlierRasterIndices = m_inlierRasterIndices->GetData(MEMORYDEVICE_CPU);
+  int *inliersMask = m_inliersMaskImage->GetData(MEMORYDEVICE_CPU);
+  CPURNG *randomGenerators = m_randomGenerators->GetData(MEMORYDEVICE_CPU);
+
+  // Note: Sampling a batch of inliers is cheap compared to scoring the candidates on them, so we do it serially.
+  //       This avoids any races on the inliers mask, and means that the inliers are always sampled in the same order.
+  for(uint32_t sampleIdx = 0; sampleIdx < m_batchSizeRansac; ++sampleIdx)
+  {
+    const int rasterIdx = sample_inlier(keypoints, predictions, imgSize, randomGenerators[sampleIdx], inliersMask);
+    if(rasterIdx >= 0) inlierRasterIndices[m_nbInliers++] = rasterIdx;
+  }
+}
+
+}
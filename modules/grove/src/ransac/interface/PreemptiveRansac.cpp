@@ -0,0 +1,218 @@
+/**
+ * grove: PreemptiveRansac.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include "ransac/interface/PreemptiveRansac.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <itmx/base/MemoryBlockFactory.h>
+#include <itmx/geometry/GeometryUtil.h>
+using namespace itmx;
+
+#include "ransac/shared/PreemptiveRansac_Shared.h"
+
+namespace grove {
+
+//#################### CONSTRUCTORS ####################
+
+PreemptiveRansac::PreemptiveRansac(const tvgutil::SettingsContainer_CPtr& settings)
+: m_nbGeneratedPoseCandidates(0), m_nbInliers(0), m_nbPoseCandidates(0)
+{
+  const std::string settingsNamespace = "PreemptiveRansac.";
+
+  m_batchSizeRansac = settings->get_first_value<uint32_t>(settingsNamespace + "batchSizeRansac", 500);
+  m_checkMinDistanceBetweenSampledModes = settings->get_first_value<bool>(settingsNamespace + "checkMinDistanceBetweenSampledModes", true);
+  m_checkRigidTransformationConstraint = settings->get_first_value<bool>(settingsNamespace + "checkRigidTransformationConstraint", true);
+  m_deterministic = settings->get_first_value<bool>(settingsNamespace + "deterministic", false);
+  m_maxCandidateGenerationIterations = settings->get_first_value<uint32_t>(settingsNamespace + "maxCandidateGenerationIterations", 6000);
+  m_maxPoseCandidates = settings->get_first_value<uint32_t>(settingsNamespace + "maxPoseCandidates", 1024);
+  m_maxPoseCandidatesAfterCull = settings->get_first_value<uint32_t>(settingsNamespace + "maxPoseCandidatesAfterCull", 64);
+  m_maxTranslationErrorForCorrectPose = settings->get_first_value<float>(settingsNamespace + "maxTranslationErrorForCorrectPose", 0.05f);
+  m_poseUpdate = settings->get_first_value<bool>(settingsNamespace + "poseUpdate", true);
+  m_rngSeed = settings->get_first_value<uint32_t>(settingsNamespace + "randomSeed", 42);
+  m_useAllModesPerLeafInPoseHypothesisGeneration = settings->get_first_value<bool>(settingsNamespace + "useAllModesPerLeafInPoseHypothesisGeneration", true);
+
+  const float minDistanceBetweenSampledModes = settings->get_first_value<float>(settingsNamespace + "minDistanceBetweenSampledModes", 0.3f);
+  m_minSquaredDistanceBetweenSampledModes = minDistanceBetweenSampledModes * minDistanceBetweenSampledModes;
+
+  const float poseUpdateInlierThreshold = settings->get_first_value<float>(settingsNamespace + "poseUpdateInlierThreshold", 0.1f);
+  m_poseUpdateInlierThresholdSquared = poseUpdateInlierThreshold * poseUpdateInlierThreshold;
+
+  // Work out how many inliers we might need to sample in a single call to estimate_pose: one batch for the initial
+  // scoring step, and one for each halving step needed to get from the culled set of candidates down to one candidate.
+  uint32_t maxIterations = 1;
+  for(uint32_t nbCandidates = std::min(m_maxPoseCandidates, m_maxPoseCandidatesAfterCull); nbCandidates > 1; nbCandidates /= 2)
+  {
+    ++maxIterations;
+  }
+
+  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
+  m_inlierRasterIndices = mbf.make_block<int>(m_batchSizeRansac * maxIterations);
+  m_inliersMaskImage = mbf.make_image<int>();
+  m_poseCandidates = mbf.make_block<PoseCandidate>(m_maxPoseCandidates);
+}
+
+//#################### DESTRUCTOR ####################
+
+PreemptiveRansac::~PreemptiveRansac() {}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+boost::optional<PoseCandidate> PreemptiveRansac::estimate_pose(const Keypoint3DColourImage_CPtr& keypointsImage, const ScorePredictionsImage_CPtr& predictionsImage)
+{
+  if(keypointsImage->noDims != predictionsImage->noDims)
+  {
+    throw std::invalid_argument("Error: The keypoints and predictions images passed to preemptive RANSAC must have the same size");
+  }
+
+  m_keypointsImage = keypointsImage;
+  m_predictionsImage = predictionsImage;
+
+  // If we're in deterministic mode, reseed the random number generators so that the result depends only on the inputs.
+  if(m_deterministic) init_random();
+
+  // Step 1: Generate the pose candidates, and estimate their poses from the sampled correspondences.
+  generate_pose_candidates();
+  compute_candidate_poses_kabsch();
+  m_nbGeneratedPoseCandidates = m_nbPoseCandidates;
+
+  // Step 2: Reset the inliers.
+  m_nbInliers = 0;
+  m_inliersMaskImage->ChangeDims(keypointsImage->noDims);
+  m_inliersMaskImage->Clear();
+
+  // Step 3: If there are too many candidates, score them using an initial batch of inliers and keep only the best ones.
+  uint32_t nbEvaluatedInliers = 0;
+  if(m_nbPoseCandidates > m_maxPoseCandidatesAfterCull)
+  {
+    sample_inliers();
+    compute_energies_and_sort(0);
+    nbEvaluatedInliers = m_nbInliers;
+    m_nbPoseCandidates = m_maxPoseCandidatesAfterCull;
+  }
+
+  // Step 4: Repeatedly sample more inliers, rescore the candidates and discard the worse half of them, until only one remains.
+  //         Unless the poses have been refined since the last scoring step, only the newly-sampled inliers need to be scored.
+  while(m_nbPoseCandidates > 1)
+  {
+    sample_inliers();
+    compute_energies_and_sort(nbEvaluatedInliers);
+    nbEvaluatedInliers = m_nbInliers;
+    m_nbPoseCandidates /= 2;
+
+    if(m_poseUpdate)
+    {
+      update_candidate_poses();
+      nbEvaluatedInliers = 0;
+    }
+  }
+
+  // Release the inputs, since we no longer need them.
+  m_keypointsImage.reset();
+  m_predictionsImage.reset();
+
+  if(m_nbPoseCandidates == 0) return boost::none;
+  return m_poseCandidates->GetData(MEMORYDEVICE_CPU)[0];
+}
+
+void PreemptiveRansac::get_best_poses(std::vector<PoseCandidate>& poseCandidates, uint32_t maxPoseCount) const
+{
+  // Each culling step sorts the surviving candidates by energy and then discards the back half of them without moving them,
+  // so at the end of estimate_pose the candidates are already stored in the order we want (the winner first, then the ones
+  // eliminated in the final step, and so on). All we need to do is copy out as many of them as we need.
+  const PoseCandidate *candidates = m_poseCandidates->GetData(MEMORYDEVICE_CPU);
+  poseCandidates.assign(candidates, candidates + std::min(maxPoseCount, m_nbGeneratedPoseCandidates));
+}
+
+int PreemptiveRansac::get_min_nb_required_points() const
+{
+  // We need at least enough points to estimate a pose using the Kabsch algorithm, and to sample a batch of inliers.
+  return std::max<int>(PoseCandidate::KABSCH_POINTS, m_batchSizeRansac);
+}
+
+//#################### PRIVATE MEMBER FUNCTIONS ####################
+
+void PreemptiveRansac::compute_candidate_poses_kabsch()
+{
+  PoseCandidate *poseCandidates = m_poseCandidates->GetData(MEMORYDEVICE_CPU);
+  const int nbPoseCandidates = static_cast<int>(m_nbPoseCandidates);
+
+#ifdef WITH_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int candidateIdx = 0; candidateIdx < nbPoseCandidates; ++candidateIdx)
+  {
+    PoseCandidate& candidate = poseCandidates[candidateIdx];
+
+    Eigen::Matrix3f P, Q;
+    for(int i = 0; i < PoseCandidate::KABSCH_POINTS; ++i)
+    {
+      P.col(i) = Eigen::Map<const Eigen::Vector3f>(candidate.pointsCamera[i].v);
+      Q.col(i) = Eigen::Map<const Eigen::Vector3f>(candidate.pointsWorld[i].v);
+    }
+
+    // Note: Both Eigen and InfiniTAM store matrices in column-major order, so we can map the pose directly.
+    Eigen::Map<Eigen::Matrix4f>(candidate.cameraPose.m) = GeometryUtil::estimate_rigid_transform(P, Q);
+  }
+}
+
+void PreemptiveRansac::update_candidate_poses()
+{
+  const Keypoint3DColour *keypoints = m_keypointsImage->GetData(MEMORYDEVICE_CPU);
+  const ScorePrediction *predictions = m_predictionsImage->GetData(MEMORYDEVICE_CPU);
+  const int *inlierRasterIndices = m_inlierRasterIndices->GetData(MEMORYDEVICE_CPU);
+  PoseCandidate *poseCandidates = m_poseCandidates->GetData(MEMORYDEVICE_CPU);
+  const int nbInliers = static_cast<int>(m_nbInliers);
+  const int nbPoseCandidates = static_cast<int>(m_nbPoseCandidates);
+
+#ifdef WITH_OPENMP
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for(int candidateIdx = 0; candidateIdx < nbPoseCandidates; ++candidateIdx)
+  {
+    PoseCandidate& candidate = poseCandidates[candidateIdx];
+
+    // Pair each inlier with its closest mode under the candidate's current pose (if any mode is close enough).
+    std::vector<int> inlierIndices;
+    std::vector<const Keypoint3DColourCluster*> modes;
+    for(int i = 0; i < nbInliers; ++i)
+    {
+      const int rasterIdx = inlierRasterIndices[i];
+      const ScorePrediction& prediction = predictions[rasterIdx];
+
+      Vector3f transformedKeypoint;
+      const int modeIdx = find_closest_mode(candidate.cameraPose, keypoints[rasterIdx], prediction, m_poseUpdateInlierThresholdSquared, transformedKeypoint);
+      if(modeIdx >= 0)
+      {
+        inlierIndices.push_back(rasterIdx);
+        modes.push_back(&prediction.elts[modeIdx]);
+      }
+    }
+
+    // If there are too few correspondences to estimate a pose, leave the candidate unchanged.
+    const int nbCorrespondences = static_cast<int>(inlierIndices.size());
+    if(nbCorrespondences < PoseCandidate::KABSCH_POINTS) continue;
+
+    // Otherwise, re-estimate the pose from all of the correspondences.
+    Eigen::Matrix3Xf P(3, nbCorrespondences), Q(3, nbCorrespondences);
+    for(int i = 0; i < nbCorrespondences; ++i)
+    {
+      P.col(i) = Eigen::Map<const Eigen::Vector3f>(keypoints[inlierIndices[i]].position.v);
+      Q.col(i) = Eigen::Map<const Eigen::Vector3f>(modes[i]->position.v);
+    }
+
+    Eigen::Matrix3f R;
+    Eigen::Vector3f t;
+    GeometryUtil::estimate_rigid_transform(P, Q, R, t);
+
+    Eigen::Matrix4f M = Eigen::Matrix4f::Identity();
+    M.block<3,3>(0, 0) = R;
+    M.block<3,1>(0, 3) = t;
+    Eigen::Map<Eigen::Matrix4f>(candidate.cameraPose.m) = M;
+  }
+}
+
+}
@@ -0,0 +1,22 @@
+/**
+ * grove: ScoreRelocaliserFactory.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include "relocalisation/ScoreRelocaliserFactory.h"
+using namespace ITMLib;
+
+#include "relocalisation/cpu/ScoreRelocaliser_CPU.h"
+
+namespace grove {
+
+//#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+
+ScoreRelocaliser_Ptr ScoreRelocaliserFactory::make_score_relocaliser(const tvgutil::SettingsContainer_CPtr& settings, const std::string& forestFilename,
+                                                                     ITMLibSettings::DeviceType deviceType)
+{
+  // Note: The device type is currently ignored, since only the CPU implementation exists.
+  return ScoreRelocaliser_Ptr(new ScoreRelocaliser_CPU(settings, forestFilename));
+}
+
+}
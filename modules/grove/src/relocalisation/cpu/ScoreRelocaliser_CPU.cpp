@@ -0,0 +1,71 @@
+/**
+ * grove: ScoreRelocaliser_CPU.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include "relocalisation/cpu/ScoreRelocaliser_CPU.h"
+using namespace ITMLib;
+
+#include <itmx/base/MemoryBlockFactory.h>
+using namespace itmx;
+
+#include "clustering/cpu/ExampleClusterer_CPU.tpp"
+#include "clustering/interface/ExampleClusterer.tpp"
+#include "features/FeatureCalculatorFactory.h"
+#include "forests/cpu/DecisionForest_CPU.tpp"
+#include "forests/interface/DecisionForest.tpp"
+#include "ransac/cpu/PreemptiveRansac_CPU.h"
+#include "relocalisation/shared/ScoreRelocaliser_Shared.h"
+#include "reservoirs/cpu/ExampleReservoirs_CPU.tpp"
+#include "reservoirs/interface/ExampleReservoirs.tpp"
+
+namespace grove {
+
+//#################### CONSTRUCTORS ####################
+
+ScoreRelocaliser_CPU::ScoreRelocaliser_CPU(const tvgutil::SettingsContainer_CPtr& settings, const std::string& forestFilename)
+: ScoreRelocaliser(settings)
+{
+  // Note: We construct the CPU components directly rather than via their factories, since the relocaliser
+  //       must operate entirely on the CPU, regardless of the device on which the rest of the pipeline runs.
+  m_featureCalculator = FeatureCalculatorFactory::make_da_rgbd_patch_feature_calculator(ITMLibSettings::DEVICE_CPU);
+  m_scoreForest.reset(new DecisionForest_CPU<DescriptorType,TREE_COUNT>(forestFilename));
+
+  const uint32_t leafCount = m_scoreForest->get_nb_leaves();
+  m_exampleReservoirs.reset(new ExampleReservoirs_CPU<ExampleType>(leafCount, m_reservoirCapacity, m_rngSeed));
+  m_exampleClusterer.reset(new ExampleClusterer_CPU<ExampleType,ClusterType,ScorePrediction::Capacity>(
+    m_clustererSigma, m_clustererTau, m_maxClusterCount, m_minClusterSize
+  ));
+  m_preemptiveRansac.reset(new PreemptiveRansac_CPU(settings));
+
+  m_predictionsBlock = MemoryBlockFactory::instance().make_block<ScorePrediction>(leafCount);
+
+  reset();
+}
+
+//#################### PROTECTED MEMBER FUNCTIONS ####################
+
+void ScoreRelocaliser_CPU::get_predictions_for_leaves(const ScoreForest::LeafIndicesImage_CPtr& leafIndices, const ScorePredictionsMemoryBlock_CPtr& leafPredictions,
+                                                      ScorePredictionsImage_Ptr& outputPredictions) const
+{
+  const Vector2i imgSize = leafIndices->noDims;
+  outputPredictions->ChangeDims(imgSize);
+
+  const ScoreForest::LeafIndices *leafIndicesPtr = leafIndices->GetData(MEMORYDEVICE_CPU);
+  const ScorePrediction *leafPredictionsPtr = leafPredictions->GetData(MEMORYDEVICE_CPU);
+  ScorePrediction *outputPredictionsPtr = outputPredictions->GetData(MEMORYDEVICE_CPU);
+  const int maxModeCount = static_cast<int>(m_maxClusterCount);
+
+#ifdef WITH_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int y = 0; y < imgSize.y; ++y)
+  {
+    for(int x = 0; x < imgSize.x; ++x)
+    {
+      merge_predictions_for_keypoint<TREE_COUNT>(leafPredictionsPtr, leafIndicesPtr, outputPredictionsPtr, imgSize, maxModeCount, x, y);
+    }
+  }
+}
+
+}
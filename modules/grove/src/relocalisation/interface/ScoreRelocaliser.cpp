@@ -0,0 +1,154 @@
+/**
+ * grove: ScoreRelocaliser.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include "relocalisation/interface/ScoreRelocaliser.h"
+
+#include <algorithm>
+
+#include <itmx/base/MemoryBlockFactory.h>
+using namespace itmx;
+
+#include "clustering/interface/ExampleClusterer.tpp"
+#include "reservoirs/interface/ExampleReservoirs.tpp"
+
+#ifdef WITH_CUDA
+#include "reservoirs/cuda/ExampleReservoirs_CUDA.h"
+#endif
+
+namespace grove {
+
+//#################### CONSTRUCTORS ####################
+
+ScoreRelocaliser::ScoreRelocaliser(const tvgutil::SettingsContainer_CPtr& settings)
+: m_reservoirUpdateStartIdx(0)
+{
+  const std::string settingsNamespace = "ScoreRelocaliser.";
+
+  m_clustererSigma = settings->get_first_value<float>(settingsNamespace + "clustererSigma", 0.1f);
+  m_clustererTau = settings->get_first_value<float>(settingsNamespace + "clustererTau", 0.05f);
+  m_incrementalClustering = settings->get_first_value<bool>(settingsNamespace + "incrementalClustering", true);
+  m_maxClusterCount = settings->get_first_value<uint32_t>(settingsNamespace + "maxClusterCount", ScorePrediction::Capacity);
+  m_maxRelocalisationsToOutput = settings->get_first_value<uint32_t>(settingsNamespace + "maxRelocalisationsToOutput", 4);
+  m_maxReservoirsToUpdate = settings->get_first_value<uint32_t>(settingsNamespace + "maxReservoirsToUpdate", 256);
+  m_minClusterSize = settings->get_first_value<uint32_t>(settingsNamespace + "minClusterSize", 20);
+  m_reservoirCapacity = settings->get_first_value<uint32_t>(settingsNamespace + "reservoirCapacity", 1024);
+  m_rngSeed = settings->get_first_value<uint32_t>(settingsNamespace + "rngSeed", 42);
+
+  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
+  m_descriptorsImage = mbf.make_image<DescriptorType>();
+  m_keypointsImage = mbf.make_image<ExampleType>();
+  m_leafIndicesImage = mbf.make_image<ScoreForest::LeafIndices>();
+  m_predictionsImage = mbf.make_image<ScorePrediction>();
+}
+
+//#################### DESTRUCTOR ####################
+
+ScoreRelocaliser::~ScoreRelocaliser() {}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+boost::optional<ScoreRelocaliser::Result>
+ScoreRelocaliser::relocalise(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage, const Vector4f& depthIntrinsics) const
+{
+  std::vector<Result> results = relocalise_ranked(colourImage, depthImage, depthIntrinsics);
+  if(results.empty()) return boost::none;
+  return results[0];
+}
+
+std::vector<ScoreRelocaliser::Result>
+ScoreRelocaliser::relocalise_ranked(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage, const Vector4f& depthIntrinsics) const
+{
+  std::vector<Result> results;
+
+  // Copy the current inputs across to the CPU for use by the relocaliser.
+  colourImage->UpdateHostFromDevice();
+  depthImage->UpdateHostFromDevice();
+
+  // Compute the keypoints (in camera space) and descriptors for the frame, and find the leaves they reach in the forest.
+  m_featureCalculator->compute_keypoints_and_features(colourImage, depthImage, depthIntrinsics, m_keypointsImage.get(), m_descriptorsImage.get());
+  m_scoreForest->find_leaves(m_descriptorsImage, m_leafIndicesImage);
+
+  // Merge the modes predicted by the leaves reached by each pixel.
+  get_predictions_for_leaves(m_leafIndicesImage, m_predictionsBlock, m_predictionsImage);
+
+  // Estimate the camera pose using preemptive RANSAC, and convert the best candidates into relocalisation results.
+  // Note that the candidate poses are camera -> world transformations, whereas the relocalised poses are world -> camera.
+  if(m_preemptiveRansac->estimate_pose(m_keypointsImage, m_predictionsImage))
+  {
+    std::vector<PoseCandidate> poseCandidates;
+    m_preemptiveRansac->get_best_poses(poseCandidates, std::max<uint32_t>(m_maxRelocalisationsToOutput, 1));
+
+    for(size_t i = 0, size = poseCandidates.size(); i < size; ++i)
+    {
+      Result result;
+      result.pose.SetInvM(poseCandidates[i].cameraPose);
+      result.quality = RELOCALISATION_GOOD;
+      results.push_back(result);
+    }
+  }
+
+  return results;
+}
+
+void ScoreRelocaliser::reset()
+{
+  m_exampleReservoirs->reset();
+  m_predictionsBlock->Clear();
+
+  // Resetting the reservoirs also resets their add call counts, so the versions recorded by the clusterer are no longer meaningful.
+  m_exampleClusterer->forget_example_set_versions();
+  m_reservoirUpdateStartIdx = 0;
+}
+
+void ScoreRelocaliser::train(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage,
+                             const Vector4f& depthIntrinsics, const ORUtils::SE3Pose& cameraPose)
+{
+  // Copy the current inputs across to the CPU for use by the relocaliser.
+  colourImage->UpdateHostFromDevice();
+  depthImage->UpdateHostFromDevice();
+
+  // Compute the keypoints (in world space) and descriptors for the frame, and add the keypoints to the reservoirs
+  // associated with the leaves their descriptors reach in the forest.
+  m_featureCalculator->compute_keypoints_and_features(colourImage, depthImage, cameraPose.GetInvM(), depthIntrinsics, m_keypointsImage.get(), m_descriptorsImage.get());
+  m_scoreForest->find_leaves(m_descriptorsImage, m_leafIndicesImage);
+  m_exampleReservoirs->add_examples(m_keypointsImage, m_leafIndicesImage);
+
+  // Update some of the leaves' modes, so that the relocaliser adapts to the scene as it is being trained.
+  update_clusters();
+}
+
+void ScoreRelocaliser::update()
+{
+  update_clusters();
+}
+
+//#################### PRIVATE MEMBER FUNCTIONS ####################
+
+void ScoreRelocaliser::update_clusters()
+{
+  const uint32_t reservoirCount = m_exampleReservoirs->get_reservoir_count();
+  const uint32_t updateCount = std::min(m_maxReservoirsToUpdate, reservoirCount - m_reservoirUpdateStartIdx);
+
+  if(m_incrementalClustering)
+  {
+    // The add call counts of the reservoirs change whenever the reservoirs do, so we use them as the reservoirs' versions.
+    m_exampleClusterer->cluster_changed_examples(
+      m_exampleReservoirs->get_reservoirs(), m_exampleReservoirs->get_reservoir_sizes(), m_exampleReservoirs->get_reservoir_add_calls(),
+      m_reservoirUpdateStartIdx, updateCount, m_predictionsBlock
+    );
+  }
+  else
+  {
+    m_exampleClusterer->cluster_examples(
+      m_exampleReservoirs->get_reservoirs(), m_exampleReservoirs->get_reservoir_sizes(),
+      m_reservoirUpdateStartIdx, updateCount, m_predictionsBlock
+    );
+  }
+
+  m_reservoirUpdateStartIdx += updateCount;
+  if(m_reservoirUpdateStartIdx >= reservoirCount) m_reservoirUpdateStartIdx = 0;
+}
+
+}
@@ -72,6 +72,19 @@ struct GeometryUtil
    */
   static void estimate_rigid_transform(const Eigen::Matrix3f& P, const Eigen::Matrix3f& Q, Eigen::Matrix3f& R, Eigen::Vector3f& t);
 
+  /**
+   * \brief Estimates the rigid body transformation from an arbitrary number (>= 3) of 3D points in a set P to corresponding 3D points in a set Q
+   *        using the Kabsch algorithm.
+   *
+   * This is useful when refining a transformation using all of the correspondences that support it, rather than just three of them.
+   *
+   * \param P The first set of 3D points (each point is a column in the matrix).
+   * \param Q The second set of 3D points (each point is a column in the matrix).
+   * \param R A location into which to write the estimated rotation matrix.
+   * \param t A location into which to write the estimated translation vector.
+   */
+  static void estimate_rigid_transform(const Eigen::Matrix3Xf& P, const Eigen::Matrix3Xf& Q, Eigen::Matrix3f& R, Eigen::Vector3f& t);
+
   /**
    * \brief Finds a pose hypothesis with the greatest number of inliers from a set of such hypotheses.
    *
@@ -67,6 +67,9 @@ public:
   /** Override */
   virtual boost::optional<Result> relocalise(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage, const Vector4f& depthIntrinsics) const;
 
+  /** Override */
+  virtual std::vector<Result> relocalise_ranked(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage, const Vector4f& depthIntrinsics) const;
+
   /** Override */
   virtual void reset();
 
@@ -21,6 +21,10 @@ namespace itmx {
 /**
  * \brief An instance of this class can be used to refine the results of another relocaliser using ICP.
  *
+ * If the inner relocaliser produces several candidate poses, they are refined in rank order. A call to relocalise stops at
+ * the first candidate that ICP verifies as good (falling back to the best-ranked candidate that ICP could refine at all),
+ * whilst a call to relocalise_ranked refines all of the candidates.
+ *
  * \tparam VoxelType  The type of voxel used to reconstruct the scene that will be used during the raycasting step.
  * \tparam IndexType  The type of indexing used to access the reconstructed scene.
  */
@@ -131,6 +135,10 @@ public:
   virtual boost::optional<Result> relocalise(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage,
                                              const Vector4f& depthIntrinsics, boost::optional<ORUtils::SE3Pose>& initialPose) const;
 
+  /** Override */
+  virtual std::vector<Result> relocalise_ranked(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage,
+                                                const Vector4f& depthIntrinsics) const;
+
   /** Override */
   virtual void reset();
 
@@ -143,6 +151,27 @@ public:
 
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
+  /**
+   * \brief Copies the specified colour and depth images into the view, ready for one or more poses to be refined.
+   *
+   * \param colourImage The colour image.
+   * \param depthImage  The depth image.
+   */
+  void copy_images_to_view(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage) const;
+
+  /**
+   * \brief Refines a pose produced by the inner relocaliser using ICP.
+   *
+   * \note  The colour and depth images must already have been copied into the view.
+   * \note  The refined pose is left in the tracking state, even if ICP fails.
+   *
+   * \param initialPose     The pose to refine.
+   * \param colourImageSize The size of the colour image.
+   * \param depthImageSize  The size of the depth image.
+   * \return                The result of the refinement, if ICP succeeded, or boost::none otherwise.
+   */
+  boost::optional<Result> refine_pose(const ORUtils::SE3Pose& initialPose, const Vector2i& colourImageSize, const Vector2i& depthImageSize) const;
+
   /**
    * \brief Saves the relocalised and refined poses in text files so that they can be used later (e.g. for evaluation).
    *
@@ -103,8 +103,8 @@ ICPRefiningRelocaliser<VoxelType,IndexType>::relocalise(const ITMUChar4Image *co
   initialPose.reset();
 
   // Run the inner relocaliser. If it fails, save dummy poses and early out.
-  boost::optional<Result> relocalisationResult = m_innerRelocaliser->relocalise(colourImage, depthImage, depthIntrinsics);
-  if(!relocalisationResult)
+  std::vector<Result> candidates = m_innerRelocaliser->relocalise_ranked(colourImage, depthImage, depthIntrinsics);
+  if(candidates.empty())
   {
     Matrix4f invalidPose;
     invalidPose.setValues(std::numeric_limits<float>::quiet_NaN());
@@ -113,56 +113,72 @@ ICPRefiningRelocaliser<VoxelType,IndexType>::relocalise(const ITMUChar4Image *co
     return boost::none;
   }
 
-  // Since the inner relocaliser succeeded, copy its result into the initial pose.
-  initialPose = relocalisationResult->pose;
-
   // Copy the depth and RGB images into the view.
-  m_view->depth->SetFrom(depthImage, m_settings->deviceType == ITMLibSettings::DEVICE_CUDA ? ITMFloatImage::CUDA_TO_CUDA : ITMFloatImage::CPU_TO_CPU);
-  m_view->rgb->SetFrom(colourImage, m_settings->deviceType == ITMLibSettings::DEVICE_CUDA ? ITMUChar4Image::CUDA_TO_CUDA : ITMUChar4Image::CPU_TO_CPU);
+  copy_images_to_view(colourImage, depthImage);
 
-  // Create a fresh render state ready for raycasting.
-  // FIXME: It would be nicer to simply create the render state once and then reuse it, but unfortunately this leads
-  //        to the program randomly crashing after a while. The crash may be occurring because we don't use this render
-  //        state to integrate frames into the scene, but we haven't been able to pin this down yet. As a result, we
-  //        currently create a fresh render state each time as a workaround. A mildly less costly alternative might
-  //        be to pass in a render state that is being used elsewhere and reuse it here, but that feels messier.
-  m_voxelRenderState.reset(ITMRenderStateFactory<IndexType>::CreateRenderState(
-    m_trackingController->GetTrackedImageSize(colourImage->noDims, depthImage->noDims),
-    m_scene->sceneParams,
-    m_settings->GetMemoryType()
-  ));
+  // Refine the candidates in rank order, stopping as soon as ICP verifies one of them as good. If none of them is verified
+  // as good, fall back to the best-ranked candidate that ICP was able to refine at all (if any).
+  boost::optional<Result> refinementResult;
+  size_t chosenCandidateIdx = 0;
+  Matrix4f chosenRefinedPose;
+  for(size_t i = 0, size = candidates.size(); i < size; ++i)
+  {
+    boost::optional<Result> result = refine_pose(candidates[i].pose, colourImage->noDims, depthImage->noDims);
+
+    // Note: The refined pose of the best-ranked candidate is recorded even if ICP failed, so that it can be saved.
+    if(i == 0) chosenRefinedPose = m_trackingState->pose_d->GetInvM();
+
+    if(result && (!refinementResult || result->quality == RELOCALISATION_GOOD))
+    {
+      refinementResult = result;
+      chosenCandidateIdx = i;
+      chosenRefinedPose = m_trackingState->pose_d->GetInvM();
+      if(result->quality == RELOCALISATION_GOOD) break;
+    }
+  }
 
-  // Set up the tracking state using the initial pose.
-  m_trackingState->pose_d->SetFrom(initialPose.get_ptr());
+  // Copy the pose that the inner relocaliser produced for the chosen candidate into the initial pose, and save the poses.
+  initialPose = candidates[chosenCandidateIdx].pose;
+  save_poses(initialPose->GetInvM(), chosenRefinedPose);
 
-  // Update the list of visible blocks.
-  const bool resetVisibleList = true;
-  m_denseVoxelMapper->UpdateVisibleList(m_view.get(), m_trackingState.get(), m_scene.get(), m_voxelRenderState.get(), resetVisibleList);
+  // If we are in evaluation mode (we are saving the poses), force the quality to POOR to prevent fusion whilst evaluating the testing sequence.
+  if(refinementResult && m_savePoses) refinementResult->quality = RELOCALISATION_POOR;
 
-  // Raycast from the initial pose to prepare for tracking.
-  m_trackingController->Prepare(m_trackingState.get(), m_scene.get(), m_view.get(), m_visualisationEngine.get(), m_voxelRenderState.get());
+  stop_timer(m_timerRelocalisation);
 
-  // Run the tracker to refine the initial pose.
-  m_trackingController->Track(m_trackingState.get(), m_view.get());
+  return refinementResult;
+}
 
-  // Save the poses.
-  save_poses(initialPose->GetInvM(), m_trackingState->pose_d->GetInvM());
+template <typename VoxelType, typename IndexType>
+std::vector<Relocaliser::Result>
+ICPRefiningRelocaliser<VoxelType,IndexType>::relocalise_ranked(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage,
+                                                               const Vector4f& depthIntrinsics) const
+{
+  start_timer(m_timerRelocalisation);
 
-  // Set up the result.
-  boost::optional<Result> refinementResult;
-  if(m_trackingState->trackerResult != ITMTrackingState::TRACKING_FAILED)
+  // Run the inner relocaliser, and refine each of the candidates it produces in rank order.
+  std::vector<Result> candidates = m_innerRelocaliser->relocalise_ranked(colourImage, depthImage, depthIntrinsics);
+  if(!candidates.empty()) copy_images_to_view(colourImage, depthImage);
+
+  std::vector<Result> goodResults, poorResults;
+  for(size_t i = 0, size = candidates.size(); i < size; ++i)
   {
-    refinementResult.reset(Result());
-    refinementResult->pose.SetFrom(m_trackingState->pose_d);
-    refinementResult->quality = m_trackingState->trackerResult == ITMTrackingState::TRACKING_GOOD ? RELOCALISATION_GOOD : RELOCALISATION_POOR;
+    boost::optional<Result> result = refine_pose(candidates[i].pose, colourImage->noDims, depthImage->noDims);
+    if(!result) continue;
 
     // If we are in evaluation mode (we are saving the poses), force the quality to POOR to prevent fusion whilst evaluating the testing sequence.
-    if(m_savePoses) refinementResult->quality = RELOCALISATION_POOR;
+    if(m_savePoses) result->quality = RELOCALISATION_POOR;
+
+    if(result->quality == RELOCALISATION_GOOD) goodResults.push_back(*result);
+    else poorResults.push_back(*result);
   }
 
+  // Rank the results that ICP verified as good before the poor ones, preserving the order of the inner relocaliser within each group.
+  goodResults.insert(goodResults.end(), poorResults.begin(), poorResults.end());
+
   stop_timer(m_timerRelocalisation);
 
-  return refinementResult;
+  return goodResults;
 }
 
 template <typename VoxelType, typename IndexType>
@@ -190,6 +206,54 @@ void ICPRefiningRelocaliser<VoxelType,IndexType>::update()
 
 //#################### PRIVATE MEMBER FUNCTIONS ####################
 
+template <typename VoxelType, typename IndexType>
+void ICPRefiningRelocaliser<VoxelType,IndexType>::copy_images_to_view(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage) const
+{
+  m_view->depth->SetFrom(depthImage, m_settings->deviceType == ITMLibSettings::DEVICE_CUDA ? ITMFloatImage::CUDA_TO_CUDA : ITMFloatImage::CPU_TO_CPU);
+  m_view->rgb->SetFrom(colourImage, m_settings->deviceType == ITMLibSettings::DEVICE_CUDA ? ITMUChar4Image::CUDA_TO_CUDA : ITMUChar4Image::CPU_TO_CPU);
+}
+
+template <typename VoxelType, typename IndexType>
+boost::optional<Relocaliser::Result>
+ICPRefiningRelocaliser<VoxelType,IndexType>::refine_pose(const ORUtils::SE3Pose& initialPose, const Vector2i& colourImageSize, const Vector2i& depthImageSize) const
+{
+  // Create a fresh render state ready for raycasting.
+  // FIXME: It would be nicer to simply create the render state once and then reuse it, but unfortunately this leads
+  //        to the program randomly crashing after a while. The crash may be occurring because we don't use this render
+  //        state to integrate frames into the scene, but we haven't been able to pin this down yet. As a result, we
+  //        currently create a fresh render state each time as a workaround. A mildly less costly alternative might
+  //        be to pass in a render state that is being used elsewhere and reuse it here, but that feels messier.
+  m_voxelRenderState.reset(ITMRenderStateFactory<IndexType>::CreateRenderState(
+    m_trackingController->GetTrackedImageSize(colourImageSize, depthImageSize),
+    m_scene->sceneParams,
+    m_settings->GetMemoryType()
+  ));
+
+  // Set up the tracking state using the initial pose.
+  m_trackingState->pose_d->SetFrom(&initialPose);
+
+  // Update the list of visible blocks.
+  const bool resetVisibleList = true;
+  m_denseVoxelMapper->UpdateVisibleList(m_view.get(), m_trackingState.get(), m_scene.get(), m_voxelRenderState.get(), resetVisibleList);
+
+  // Raycast from the initial pose to prepare for tracking.
+  m_trackingController->Prepare(m_trackingState.get(), m_scene.get(), m_view.get(), m_visualisationEngine.get(), m_voxelRenderState.get());
+
+  // Run the tracker to refine the initial pose.
+  m_trackingController->Track(m_trackingState.get(), m_view.get());
+
+  // Set up the result.
+  boost::optional<Result> refinementResult;
+  if(m_trackingState->trackerResult != ITMTrackingState::TRACKING_FAILED)
+  {
+    refinementResult.reset(Result());
+    refinementResult->pose.SetFrom(m_trackingState->pose_d);
+    refinementResult->quality = m_trackingState->trackerResult == ITMTrackingState::TRACKING_GOOD ? RELOCALISATION_GOOD : RELOCALISATION_POOR;
+  }
+
+  return refinementResult;
+}
+
 template <typename VoxelType, typename IndexType>
 void ICPRefiningRelocaliser<VoxelType,IndexType>::save_poses(const Matrix4f& relocalisedPose, const Matrix4f& refinedPose) const
 {
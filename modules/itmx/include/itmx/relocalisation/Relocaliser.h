@@ -6,6 +6,8 @@
 #ifndef H_ITMX_RELOCALISER
 #define H_ITMX_RELOCALISER
 
+#include <vector>
+
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -95,6 +97,21 @@ public:
    */
   virtual void finish_training();
 
+  /**
+   * \brief Attempts to determine the location from which an RGB-D image pair was acquired, returning
+   *        all of the candidate poses found by the relocaliser, best first.
+   *
+   * By default, this just returns the result of relocalise (if any). Relocalisers that can produce several
+   * plausible poses (e.g. ones based on RANSAC) can override it so that callers can try the alternatives
+   * (e.g. by refining each of them in turn) when the best pose turns out to be wrong.
+   *
+   * \param colourImage     The colour image.
+   * \param depthImage      The depth image.
+   * \param depthIntrinsics The intrinsic parameters of the depth sensor.
+   * \return                The results of the relocalisation, in order of decreasing quality (empty if relocalisation failed).
+   */
+  virtual std::vector<Result> relocalise_ranked(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage, const Vector4f& depthIntrinsics) const;
+
   /**
    * \brief Updates the contents of the relocaliser when spare processing time is available.
    *
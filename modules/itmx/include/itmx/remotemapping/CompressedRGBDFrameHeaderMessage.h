@@ -8,32 +8,53 @@
 
 #include <boost/cstdint.hpp>
 
+#include "DepthCompressionType.h"
 #include "MappingMessage.h"
+#include "MappingProtocolVersion.h"
 
 namespace itmx {
 
 /**
  * \brief An instance of this class represents a message containing the sizes (in bytes) of the compressed depth and RGB images for a single frame of compressed RGB-D data.
+ *
+ * When the windowed protocol is in use, the message also contains the frame's sequence number (the number of frames the client sent before it).
+ * From the next version of the protocol onwards, it additionally contains the type of compression used for the frame's depth image.
  */
 class CompressedRGBDFrameHeaderMessage : public MappingMessage
 {
   //#################### PRIVATE VARIABLES ####################
 private:
+  /** The byte segment within the message data that corresponds to the type of compression used for the depth image (empty for earlier protocol versions). */
+  Segment m_depthCompressionTypeSegment;
+
   /** The byte segment within the message data that corresponds to the size in bytes of the compressed depth image. */
   Segment m_depthImageSizeSegment;
 
   /** The byte segment within the message data that corresponds to the size in bytes of the compressed RGB image. */
   Segment m_rgbImageSizeSegment;
 
+  /** The byte segment within the message data that corresponds to the sequence number of the frame (empty for the stop-and-wait protocol). */
+  Segment m_sequenceNumberSegment;
+
   //#################### CONSTRUCTORS ####################
 public:
   /**
    * \brief Constructs a compressed RGB-D frame header message.
+   *
+   * \param protocolVersion The version of the protocol with which the message will be sent (this determines the message's layout).
    */
-  CompressedRGBDFrameHeaderMessage();
+  explicit CompressedRGBDFrameHeaderMessage(MappingProtocolVersion protocolVersion = MAPPING_PROTOCOL_STOP_AND_WAIT);
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
+  /**
+   * \brief Extracts the type of compression used for the depth image from the message.
+   *
+   * \return                   The type of compression used for the depth image.
+   * \throws std::runtime_error If the message does not contain a depth compression type.
+   */
+  DepthCompressionType extract_depth_compression_type() const;
+
   /**
    * \brief Extracts the size (in bytes) of the compressed depth image from the message.
    *
@@ -48,6 +69,36 @@ public:
    */
   uint32_t extract_rgb_image_size() const;
 
+  /**
+   * \brief Extracts the sequence number of the frame from the message.
+   *
+   * \return                   The sequence number of the frame.
+   * \throws std::runtime_error If the message does not contain a sequence number.
+   */
+  uint32_t extract_sequence_number() const;
+
+  /**
+   * \brief Gets whether or not the message contains a depth compression type.
+   *
+   * \return  true, if the message contains a depth compression type, or false otherwise.
+   */
+  bool has_depth_compression_type() const;
+
+  /**
+   * \brief Gets whether or not the message contains a sequence number.
+   *
+   * \return  true, if the message contains a sequence number, or false otherwise.
+   */
+  bool has_sequence_number() const;
+
+  /**
+   * \brief Sets the type of compression used for the depth image.
+   *
+   * \param depthCompressionType The type of compression used for the depth image.
+   * \throws std::runtime_error   If the message does not contain a depth compression type.
+   */
+  void set_depth_compression_type(DepthCompressionType depthCompressionType);
+
   /**
    * \brief Sets the size in bytes of the compressed depth image.
    *
@@ -61,6 +112,14 @@ public:
    * \param rgbImageSize The size in bytes of the compressed RGB image.
    */
   void set_rgb_image_size(uint32_t rgbImageSize);
+
+  /**
+   * \brief Sets the sequence number of the frame.
+   *
+   * \param sequenceNumber      The sequence number of the frame.
+   * \throws std::runtime_error If the message does not contain a sequence number.
+   */
+  void set_sequence_number(uint32_t sequenceNumber);
 };
 
 }
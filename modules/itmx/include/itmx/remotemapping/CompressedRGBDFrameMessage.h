@@ -6,6 +6,8 @@
 #ifndef H_ITMX_COMPRESSEDRGBDFRAMEMESSAGE
 #define H_ITMX_COMPRESSEDRGBDFRAMEMESSAGE
 
+#include <boost/cstdint.hpp>
+
 #include "BaseRGBDFrameMessage.h"
 #include "CompressedRGBDFrameHeaderMessage.h"
 
@@ -13,9 +15,21 @@ namespace itmx {
 
 /**
  * \brief An instance of this class represents a message containing a single frame of compressed RGB-D data (frame index + pose + RGB-D).
+ *
+ * The frame index and pose are stored in the main message buffer, but the compressed depth and RGB images are stored in buffers of
+ * their own, so that they can be compressed into (or received into) directly, without being copied. These buffers are reused from
+ * one frame to the next, so once they have grown large enough to hold a typical frame, they are not reallocated.
  */
 class CompressedRGBDFrameMessage : public BaseRGBDFrameMessage
 {
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The buffer containing the compressed depth image data (this takes the place of a depth image segment in the main buffer). */
+  std::vector<uint8_t> m_depthImageData;
+
+  /** The buffer containing the compressed RGB image data (this takes the place of an RGB image segment in the main buffer). */
+  std::vector<uint8_t> m_rgbImageData;
+
   //#################### CONSTRUCTORS ####################
 public:
   /**
@@ -27,6 +41,12 @@ public:
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
+  /** Override */
+  virtual void append_const_buffers(std::vector<boost::asio::const_buffer>& buffers) const;
+
+  /** Override */
+  virtual void append_mutable_buffers(std::vector<boost::asio::mutable_buffer>& buffers);
+
   /**
    * \brief Extracts the compressed depth image data from the message and writes it into the specified destination vector.
    *
@@ -42,7 +62,39 @@ public:
   void extract_rgb_image_data(std::vector<uint8_t>& rgbImageData) const;
 
   /**
-   * \brief Sets the segment sizes for the depth and RGB images according to the compressed message header. Resizes the raw data storage accordingly.
+   * \brief Gets the buffer containing the compressed depth image data.
+   *
+   * The buffer can be written to directly (e.g. by a compressor), after which the compressed depth image will have the buffer's new size.
+   *
+   * \return  The buffer containing the compressed depth image data.
+   */
+  std::vector<uint8_t>& get_depth_image_data();
+
+  /**
+   * \brief Gets the buffer containing the compressed depth image data.
+   *
+   * \return  The buffer containing the compressed depth image data.
+   */
+  const std::vector<uint8_t>& get_depth_image_data() const;
+
+  /**
+   * \brief Gets the buffer containing the compressed RGB image data.
+   *
+   * The buffer can be written to directly (e.g. by a compressor), after which the compressed RGB image will have the buffer's new size.
+   *
+   * \return  The buffer containing the compressed RGB image data.
+   */
+  std::vector<uint8_t>& get_rgb_image_data();
+
+  /**
+   * \brief Gets the buffer containing the compressed RGB image data.
+   *
+   * \return  The buffer containing the compressed RGB image data.
+   */
+  const std::vector<uint8_t>& get_rgb_image_data() const;
+
+  /**
+   * \brief Sets the segment sizes for the depth and RGB images according to the compressed message header. Resizes the image buffers accordingly.
    *
    * \param headerMsg The header message corresponding to this message, which specifies the size of the compressed depth and RGB segments.
    */
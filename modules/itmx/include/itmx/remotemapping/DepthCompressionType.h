@@ -18,6 +18,9 @@ enum DepthCompressionType
 
   /** The depth images will be compressed using lossless PNG compression (requires OpenCV). */
   DEPTH_COMPRESSION_PNG,
+
+  /** The depth images will be compressed using lossless RVL compression (much faster than PNG, and does not require OpenCV). */
+  DEPTH_COMPRESSION_RVL,
 };
 
 }
@@ -6,9 +6,13 @@
 #ifndef H_ITMX_MAPPINGCLIENT
 #define H_ITMX_MAPPINGCLIENT
 
+#include <boost/thread.hpp>
+
 #include <tvgutil/boost/WrappedAsio.h>
 #include <tvgutil/containers/PooledQueue.h>
+#include <tvgutil/misc/ThreadPool.h>
 
+#include "MappingProtocolVersion.h"
 #include "RGBDCalibrationMessage.h"
 #include "RGBDFrameCompressor.h"
 #include "RGBDFrameMessage.h"
@@ -17,6 +21,15 @@ namespace itmx {
 
 /**
  * \brief An instance of this class represents a client that can be used to communicate with a remote mapping server.
+ *
+ * If the server supports it, the client uses a windowed protocol, in which it can have several frames in flight at once
+ * and the server acknowledges them cumulatively. Otherwise, it falls back to waiting for each frame to be acknowledged
+ * before sending the next one.
+ *
+ * Frames are compressed and sent in a pipeline. A dispatcher thread takes frames from the frame message queue and assigns
+ * them to a fixed number of compression slots (in round-robin order). The depth and RGB images of each frame are compressed
+ * concurrently by a pool of compression threads, and a sender thread then sends the compressed frames to the server in the
+ * order in which they were dispatched. The number of slots bounds the number of frames that can be in the pipeline at once.
  */
 class MappingClient
 {
@@ -24,27 +37,142 @@ class MappingClient
 public:
   typedef tvgutil::PooledQueue<RGBDFrameMessage_Ptr> RGBDFrameMessageQueue;
 
+  //#################### NESTED TYPES ####################
+private:
+  /**
+   * \brief An instance of this struct holds a frame that is being compressed, or that has been compressed and is waiting to be sent.
+   *
+   * \note  Once a frame has been dispatched to a slot, the slot's messages are only accessed by the compression tasks for the frame
+   *        until the frame has been compressed, and then only by the sender thread until the slot is released. The remaining
+   *        variables are protected by the client's mutex.
+   */
+  struct CompressionSlot
+  {
+    //~~~~~~~~~~~~~~~~~~~~ PUBLIC VARIABLES ~~~~~~~~~~~~~~~~~~~~
+
+    /** Whether or not the compression of the frame failed. */
+    bool m_compressionFailed;
+
+    /** The compressor used to compress the frame (each slot needs its own, since a compressor can only compress one frame at once). */
+    RGBDFrameCompressor_Ptr m_frameCompressor;
+
+    /** The header message for the compressed frame. */
+    CompressedRGBDFrameHeaderMessage m_frameHeaderMsg;
+
+    /** The compressed frame message. */
+    CompressedRGBDFrameMessage m_frameMsg;
+
+    /** Whether or not a frame has been dispatched to the slot (and not yet sent). */
+    bool m_inUse;
+
+    /** The number of the frame's images that have yet to be compressed. */
+    int m_pendingImageCount;
+
+    /** The uncompressed frame message. */
+    RGBDFrameMessage_Ptr m_uncompressedFrameMsg;
+
+    //~~~~~~~~~~~~~~~~~~~~ CONSTRUCTORS ~~~~~~~~~~~~~~~~~~~~
+
+    CompressionSlot(const RGBDFrameCompressor_Ptr& frameCompressor, MappingProtocolVersion protocolVersion, const Vector2i& rgbImageSize, const Vector2i& depthImageSize)
+    : m_compressionFailed(false),
+      m_frameCompressor(frameCompressor),
+      m_frameHeaderMsg(protocolVersion),
+      m_frameMsg(m_frameHeaderMsg),
+      m_inUse(false),
+      m_pendingImageCount(0),
+      m_uncompressedFrameMsg(RGBDFrameMessage::make(rgbImageSize, depthImageSize))
+    {}
+  };
+
+  typedef boost::shared_ptr<CompressionSlot> CompressionSlot_Ptr;
+
+  /** The type of a member function of RGBDFrameCompressor that compresses one of the images of a frame. */
+  typedef void (RGBDFrameCompressor::*ImageCompressor)(const RGBDFrameMessage&, CompressedRGBDFrameMessage&);
+
   //#################### PRIVATE VARIABLES ####################
 private:
-  /** A frame compressor, used to compress frame messages to reduce the network bandwidth they consume. */
-  RGBDFrameCompressor_Ptr m_frameCompressor;
+  /** The slots holding the frames that are being compressed, or that are waiting to be sent. */
+  std::vector<CompressionSlot_Ptr> m_compressionSlots;
+
+  /** The number of threads used to compress the frames. */
+  size_t m_compressionThreadCount;
+
+  /** The pool of threads used to compress the frames. */
+  boost::shared_ptr<tvgutil::ThreadPool> m_compressionThreadPool;
+
+  /** A condition variable used to wait for a compression slot to be released by the sender thread. */
+  boost::condition_variable m_compressionSlotReleased;
+
+  /** A condition variable used to wait for a frame to finish being compressed. */
+  boost::condition_variable m_frameCompressed;
+
+  /** The thread that dispatches frame messages from the queue to the compression slots. */
+  boost::thread m_frameDispatcher;
 
   /** A queue containing the RGB-D frame messages to be sent to the server. */
   RGBDFrameMessageQueue m_frameMessageQueue;
 
-  /** The TCP stream used as a wrapper around the connection to the server. */
-  boost::asio::ip::tcp::iostream m_stream;
+  /** The number of frames that have been dropped (either because the frame message queue was full, or because they could not be compressed). */
+  size_t m_framesDropped;
+
+  /** The number of frames that have been sent to the server. */
+  size_t m_framesSent;
+
+  /** The I/O service associated with the connection to the server. */
+  boost::asio::io_service m_ioService;
+
+  /** The thread that sends the compressed frames to the server. */
+  boost::thread m_messageSender;
+
+  /** The synchronisation mutex (this protects the frame counts, the state of the compression slots and the termination flag). */
+  mutable boost::mutex m_mutex;
+
+  /** The version of the protocol being used to communicate with the server (this is negotiated when the calibration message is sent). */
+  MappingProtocolVersion m_protocolVersion;
+
+  /** Whether or not the frame dispatcher and message sender threads should terminate. */
+  bool m_shouldTerminate;
+
+  /** The socket used to communicate with the server. */
+  boost::asio::ip::tcp::socket m_sock;
+
+  /** The maximum number of frames that can be sent to the server without having been acknowledged (requested by us, and then agreed with the server). */
+  uint16_t m_windowSize;
 
   //#################### CONSTRUCTORS ####################
 public:
   /**
    * \brief Constructs a mapping client.
    *
-   * \param host              The mapping host to which to connect.
-   * \param port              The port on the mapping host to which to connect.
-   * \param poolEmptyStrategy A strategy specifying what should happen when a push is attempted while the frame message queue's pool is empty.
+   * \param host                    The mapping host to which to connect.
+   * \param port                    The port on the mapping host to which to connect.
+   * \param poolEmptyStrategy       A strategy specifying what should happen when a push is attempted while the frame message queue's pool is empty.
+   * \param windowSize              The maximum number of frames that we would like to be able to send to the server without having received
+   *                                acknowledgements for them. This is only a request: the server may reduce it, and servers that only support
+   *                                the stop-and-wait protocol will effectively force it to 1.
+   * \param compressionThreadCount  The number of threads to use to compress frames. The depth and RGB images of each frame are compressed
+   *                                as separate tasks, and up to one more frame than this can be being compressed or waiting to be sent at once.
+   * \throws std::runtime_error      If the client cannot connect to the server.
    */
-  explicit MappingClient(const std::string& host = "localhost", const std::string& port = "7851", tvgutil::pooled_queue::PoolEmptyStrategy poolEmptyStrategy = tvgutil::pooled_queue::PES_DISCARD);
+  explicit MappingClient(const std::string& host = "localhost", const std::string& port = "7851",
+                         tvgutil::pooled_queue::PoolEmptyStrategy poolEmptyStrategy = tvgutil::pooled_queue::PES_DISCARD,
+                         size_t windowSize = 4, size_t compressionThreadCount = 2);
+
+  //#################### DESTRUCTOR ####################
+public:
+  /**
+   * \brief Destroys the mapping client.
+   *
+   * \note  This stops the frame dispatcher and message sender threads, and waits for any frames that are being compressed to finish
+   *        being compressed. Any frames that have not yet been sent to the server are discarded.
+   */
+  ~MappingClient();
+
+  //#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+  // Deliberately private and unimplemented.
+  MappingClient(const MappingClient&);
+  MappingClient& operator=(const MappingClient&);
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
@@ -54,18 +182,95 @@ public:
   RGBDFrameMessageQueue::PushHandler_Ptr begin_push_frame_message();
 
   /**
-   * \brief Sends a calibration message to the server.
+   * \brief Gets the number of frames that are currently being compressed, or that have been compressed and are waiting to be sent.
+   *
+   * \return The number of frames that are currently being compressed, or that have been compressed and are waiting to be sent.
+   */
+  size_t get_compressing_frame_count() const;
+
+  /**
+   * \brief Gets the number of frames that have been dropped so far.
+   *
+   * \note  Frames are dropped if the frame message queue is full when they are pushed (when using the discard strategy),
+   *        or if they cannot be compressed.
+   *
+   * \return The number of frames that have been dropped so far.
+   */
+  size_t get_dropped_frame_count() const;
+
+  /**
+   * \brief Gets the number of frames in the frame message queue (i.e. that are waiting to be dispatched for compression).
+   *
+   * \return The number of frames in the frame message queue.
+   */
+  size_t get_queued_frame_count() const;
+
+  /**
+   * \brief Gets the number of frames that have been sent to the server so far.
+   *
+   * \return The number of frames that have been sent to the server so far.
+   */
+  size_t get_sent_frame_count() const;
+
+  /**
+   * \brief Sends a calibration message to the server, and negotiates the protocol version to use for the frame messages that follow it.
+   *
+   * \note  If the message requests RVL depth compression, but the server is too old to support it, the client will fall back
+   *        to PNG depth compression (or no depth compression, when building without OpenCV).
    *
    * \param msg The message to send.
+   * \throws std::runtime_error If the message could not be sent and acknowledged.
    */
   void send_calibration_message(const RGBDCalibrationMessage& msg);
 
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
   /**
-   * \brief Sends frame messages from the message queue across to the server.
+   * \brief Compresses one of the images of the frame in the specified compression slot (this is run on a compression thread).
+   *
+   * If this is the last of the frame's images to be compressed, the frame's compression is also finished, and the sender
+   * thread is notified that the frame is ready to be sent.
+   *
+   * \param slot             The compression slot.
+   * \param imageCompressor  The member function of the slot's frame compressor to use to compress the image.
+   */
+  void compress_image(const CompressionSlot_Ptr& slot, ImageCompressor imageCompressor);
+
+  /**
+   * \brief Reads a message from the server (this blocks until the message has been read or the connection fails).
+   *
+   * \param msg The message into which to read.
+   * \return    true, if the message was successfully read, or false otherwise.
+   */
+  bool read_message(MappingMessage& msg);
+
+  /**
+   * \brief Dispatches frame messages from the message queue to the compression slots, and starts compressing them.
+   */
+  void run_frame_dispatcher();
+
+  /**
+   * \brief Sends the compressed frames in the compression slots across to the server (in the order in which they were dispatched).
    */
   void run_message_sender();
+
+  /**
+   * \brief Writes a compressed frame (its header message, followed by its frame message) to the server using a single gather write
+   *        (this blocks until the frame has been written or the connection fails).
+   *
+   * \param headerMsg The header message for the frame.
+   * \param frameMsg  The frame message for the frame.
+   * \return          true, if the frame was successfully written, or false otherwise.
+   */
+  bool write_frame(const CompressedRGBDFrameHeaderMessage& headerMsg, const CompressedRGBDFrameMessage& frameMsg);
+
+  /**
+   * \brief Writes a message to the server (this blocks until the message has been written or the connection fails).
+   *
+   * \param msg The message to write.
+   * \return    true, if the message was successfully written, or false otherwise.
+   */
+  bool write_message(const MappingMessage& msg);
 };
 
 //#################### TYPEDEFS ####################
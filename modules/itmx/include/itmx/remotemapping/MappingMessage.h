@@ -9,10 +9,16 @@
 #include <cstddef>
 #include <vector>
 
+#include <tvgutil/boost/WrappedAsio.h>
+
 namespace itmx {
 
 /**
  * \brief An instance of a class deriving from this one represents a message that can be sent across a network for remote mapping.
+ *
+ * By default, all of a message's data is stored contiguously in a single buffer. However, derived classes can store some of their
+ * data in additional buffers (e.g. to avoid copying large payloads into the main buffer). Messages should therefore be sent and
+ * received via the buffer sequences produced by append_const_buffers and append_mutable_buffers, which cover all of their data.
  */
 class MappingMessage
 {
@@ -35,6 +41,20 @@ public:
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
+  /**
+   * \brief Appends buffers covering all of the message's data to the specified buffer sequence (e.g. so that it can be sent).
+   *
+   * \param buffers The buffer sequence to which to append the buffers.
+   */
+  virtual void append_const_buffers(std::vector<boost::asio::const_buffer>& buffers) const;
+
+  /**
+   * \brief Appends buffers covering all of the message's data to the specified buffer sequence (e.g. so that it can be received).
+   *
+   * \param buffers The buffer sequence to which to append the buffers.
+   */
+  virtual void append_mutable_buffers(std::vector<boost::asio::mutable_buffer>& buffers);
+
   /**
    * \brief Gets a raw pointer to the message data.
    *
@@ -50,9 +70,11 @@ public:
   const char *get_data_ptr() const;
 
   /**
-   * \brief Gets the size of the message.
+   * \brief Gets the size of the message data.
+   *
+   * \note  This excludes any data that a derived class stores in additional buffers.
    *
-   * \return  The size of the message.
+   * \return  The size of the message data.
    */
   size_t get_size() const;
 };
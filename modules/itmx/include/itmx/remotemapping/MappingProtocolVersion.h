@@ -0,0 +1,35 @@
+/**
+ * itmx: MappingProtocolVersion.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_ITMX_MAPPINGPROTOCOLVERSION
+#define H_ITMX_MAPPINGPROTOCOLVERSION
+
+namespace itmx {
+
+/**
+ * \brief The values of this enumeration specify the versions of the protocol that can be used to communicate between a mapping client and server.
+ *
+ * A mapping server advertises the latest version it supports in the acknowledgement it sends in response to a client's calibration message
+ * (servers that predate versioning leave this as zero). A client that also supports a later version then negotiates its use with the server;
+ * otherwise, both sides fall back to the original stop-and-wait protocol.
+ */
+enum MappingProtocolVersion
+{
+  /** The client waits for an individual acknowledgement of each frame before sending the next one. */
+  MAPPING_PROTOCOL_STOP_AND_WAIT,
+
+  /** The client may have several (sequence-numbered) frames in flight at once, and the server sends cumulative acknowledgements. */
+  MAPPING_PROTOCOL_WINDOWED,
+
+  /** As for the windowed protocol, but each frame header also specifies the type of compression used for the frame's depth image. */
+  MAPPING_PROTOCOL_WINDOWED_WITH_DEPTH_COMPRESSION_TYPE,
+
+  /** The latest version of the protocol. */
+  MAPPING_PROTOCOL_LATEST = MAPPING_PROTOCOL_WINDOWED_WITH_DEPTH_COMPRESSION_TYPE,
+};
+
+}
+
+#endif
@@ -8,9 +8,11 @@
 
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 #include <boost/atomic.hpp>
+#include <boost/bind.hpp>
 #include <boost/optional.hpp>
 #include <boost/thread.hpp>
 
@@ -19,12 +21,22 @@
 #include <tvgutil/boost/WrappedAsio.h>
 #include <tvgutil/containers/PooledQueue.h>
 
+#include "AckMessage.h"
+#include "CompressedRGBDFrameHeaderMessage.h"
+#include "CompressedRGBDFrameMessage.h"
+#include "MappingProtocolVersion.h"
+#include "ProtocolNegotiationMessage.h"
+#include "RGBDCalibrationMessage.h"
+#include "RGBDFrameCompressor.h"
 #include "RGBDFrameMessage.h"
 
 namespace itmx {
 
 /**
  * \brief An instance of this class represents a server that can be used to communicate with remote mapping clients.
+ *
+ * The server is event-driven: rather than dedicating a thread to each client, it handles communication with all of
+ * its clients using asynchronous operations on an I/O service that is run on a small, fixed number of threads.
  */
 class MappingServer
 {
@@ -49,58 +61,129 @@ public:
 private:
   /**
    * \brief An instance of this struct contains all of the information associated with an individual client.
+   *
+   * \note  Communication with each client is handled by a chain of asynchronous operations that together form a simple state
+   *        machine (read calibration -> write ack -> { read header -> read frame -> write ack }*). The completion handlers
+   *        for a client's operations (and for its deadline timer) are run via its strand, so they never run concurrently
+   *        with each other, even though the I/O service is run on several threads.
+   *
+   * \note  If the client negotiates the windowed protocol (by sending a protocol negotiation message in place of its first
+   *        frame header), the server no longer waits for each acknowledgement to be written before reading the next frame.
+   *        Instead, acknowledgements are written alongside the reads, and each one acknowledges all of the frames that have
+   *        been received up to the point at which it is written.
    */
   struct Client
   {
     //~~~~~~~~~~~~~~~~~~~~ PUBLIC VARIABLES ~~~~~~~~~~~~~~~~~~~~
 
+    /** Whether or not an acknowledgement is currently being written to the client (this is only used by the windowed protocol). */
+    bool m_ackInProgress;
+
+    /** The acknowledgement message that is sent to the client after each message it sends (or after several, for the windowed protocol). */
+    AckMessage m_ackMsg;
+
     /** The calibration parameters of the camera associated with the client. */
     ITMLib::ITMRGBDCalib m_calib;
 
+    /** The calibration message received from the client. */
+    RGBDCalibrationMessage m_calibMsg;
+
+    /**
+     * If the server can't handle the type of depth compression specified in the client's calibration message, the reason why. This only
+     * matters if the agreed protocol version doesn't let the client switch to a different type of depth compression in each frame header.
+     */
+    std::string m_depthCompressionError;
+
     /** The size of depth image produced by the camera associated with the client. */
     Vector2i m_depthImageSize;
 
+    /** A dummy frame message used to consume frame messages that cannot be pushed onto the queue. */
+    RGBDFrameMessage_Ptr m_dummyFrameMsg;
+
+    /** Whether or not communication with the client has finished (this is only accessed via the client's strand). */
+    bool m_finished;
+
+    /** The compressor used to uncompress the frames received from the client. */
+    RGBDFrameCompressor_Ptr m_frameCompressor;
+
+    /** The header of the frame message that is currently being received from the client. */
+    CompressedRGBDFrameHeaderMessage m_frameHeaderMsg;
+
+    /** The frame message that is currently being received from the client. */
+    CompressedRGBDFrameMessage m_frameMsg;
+
+    /** The number of frames whose receipt has been (or is being) acknowledged to the client (this is only used by the windowed protocol). */
+    uint32_t m_framesAcked;
+
+    /** The number of frames that have been received from the client. */
+    uint32_t m_framesReceived;
+
     /** A queue containing the RGB-D frame messages received from the client. */
     RGBDFrameMessageQueue_Ptr m_frameMessageQueue;
 
+    /** The ID of the client. */
+    int m_id;
+
     /** A flag indicating whether or not the images associated with the first message in the queue have already been read. */
     bool m_imagesDirty;
 
+    /** The message that is read from the client immediately after its calibration message (either a protocol negotiation message or a frame header). */
+    ProtocolNegotiationMessage m_negotiationMsg;
+
     /** A flag indicating whether or not the pose associated with the first message in the queue has already been read. */
     bool m_poseDirty;
 
+    /** The version of the protocol being used to communicate with the client. */
+    MappingProtocolVersion m_protocolVersion;
+
+    /** Whether or not the client is ready to yield frame messages (i.e. whether or not its calibration message has been received). */
+    bool m_ready;
+
     /** The size of RGB image produced by the camera associated with the client. */
     Vector2i m_rgbImageSize;
 
-    /** The thread that manages communication with the client. */
-    boost::shared_ptr<boost::thread> m_thread;
+    /** The socket via which to communicate with the client. */
+    boost::shared_ptr<boost::asio::ip::tcp::socket> m_sock;
+
+    /** The strand via which all of the completion handlers for the client are run. */
+    boost::shared_ptr<boost::asio::io_service::strand> m_strand;
+
+    /** A timer used to close the connection if an operation on it does not complete in time. */
+    boost::shared_ptr<boost::asio::deadline_timer> m_timer;
 
     //~~~~~~~~~~~~~~~~~~~~ CONSTRUCTORS ~~~~~~~~~~~~~~~~~~~~
 
-    explicit Client(const boost::shared_ptr<boost::thread>& thread)
-    : m_frameMessageQueue(new RGBDFrameMessageQueue(tvgutil::pooled_queue::PES_DISCARD)),
+    Client(int id, const boost::shared_ptr<boost::asio::ip::tcp::socket>& sock, boost::asio::io_service& ioService)
+    : m_ackInProgress(false),
+      m_finished(false),
+      m_frameMsg(m_frameHeaderMsg),
+      m_framesAcked(0),
+      m_framesReceived(0),
+      m_frameMessageQueue(new RGBDFrameMessageQueue(tvgutil::pooled_queue::PES_DISCARD)),
+      m_id(id),
       m_imagesDirty(false),
       m_poseDirty(false),
-      m_thread(thread)
+      m_protocolVersion(MAPPING_PROTOCOL_STOP_AND_WAIT),
+      m_ready(false),
+      m_sock(sock),
+      m_strand(new boost::asio::io_service::strand(ioService)),
+      m_timer(new boost::asio::deadline_timer(ioService))
     {}
   };
 
   typedef boost::shared_ptr<Client> Client_Ptr;
 
+  /** The type of a member function that handles the completion of an asynchronous operation for a client. */
+  typedef void (MappingServer::*ClientHandler)(const Client_Ptr&, const boost::system::error_code&);
+
   //#################### PRIVATE VARIABLES ####################
 private:
   /** The server's TCP acceptor. */
   boost::shared_ptr<boost::asio::ip::tcp::acceptor> m_acceptor;
 
-  /** A thread that keeps the map of clients clean by removing any clients that have terminated. */
-  boost::shared_ptr<boost::thread> m_cleanerThread;
-
-  /** A condition variable used to wait until a client thread is ready to start reading frame messages. */
+  /** A condition variable used to wait until a client is ready to start yielding frame messages (or has finished). */
   mutable boost::condition_variable m_clientReady;
 
-  /** A condition variable used to wait for finished client threads that need to be cleaned up. */
-  boost::condition_variable m_clientsHaveFinished;
-
   /** The currently active clients. */
   std::map<int,Client_Ptr> m_clients;
 
@@ -110,6 +193,15 @@ private:
   /** The server's I/O service. */
   boost::asio::io_service m_ioService;
 
+  /** The number of threads on which to run the I/O service. */
+  size_t m_ioThreadCount;
+
+  /** The threads on which the I/O service is run. */
+  boost::thread_group m_ioThreads;
+
+  /** The maximum number of frames that a client using the windowed protocol may have in flight at once. */
+  uint16_t m_maxWindowSize;
+
   /** The mode in which the server should run. */
   Mode m_mode;
 
@@ -122,14 +214,11 @@ private:
   /** The port on which the server should listen for connections. */
   int m_port;
 
-  /** The server thread. */
-  boost::shared_ptr<boost::thread> m_serverThread;
-
   /** Whether or not the mapping server should terminate. */
   boost::atomic<bool> m_shouldTerminate;
 
-  /** The set of clients that have finished but have not yet been removed from the clients map. */
-  std::set<int> m_uncleanClients;
+  /** The maximum time (in milliseconds) that a message from/to a client may take to arrive/be sent, once it has been started. */
+  int m_timeoutMs;
 
   /** A worker variable used to keep the I/O service running until we want it to stop. */
   boost::shared_ptr<boost::asio::io_service::work> m_worker;
@@ -139,10 +228,15 @@ public:
   /**
    * \brief Constructs a mapping server.
    *
-   * \param mode  The mode in which the server shuold run.
-   * \param port  The port on which the server should listen for connections.
+   * \param mode          The mode in which the server shuold run.
+   * \param port          The port on which the server should listen for connections.
+   * \param ioThreadCount The number of threads on which to handle communication with the clients (these are shared between all clients).
+   * \param timeoutMs     The maximum time (in milliseconds) that a message from/to a client may take to arrive/be sent, once it has been
+   *                      started. A client that exceeds this is disconnected. (Clients may wait for as long as they like between frames.)
+   * \param maxWindowSize The maximum number of frames that a client using the windowed protocol may have in flight at once (clients may
+   *                      request smaller windows than this, but not larger ones).
    */
-  explicit MappingServer(Mode mode = MSM_MULTI_CLIENT, int port = 7851);
+  explicit MappingServer(Mode mode = MSM_MULTI_CLIENT, int port = 7851, size_t ioThreadCount = 2, int timeoutMs = 10000, size_t maxWindowSize = 16);
 
   //#################### DESTRUCTOR ####################
 public:
@@ -226,6 +320,8 @@ public:
 
   /**
    * \brief Starts the mapping server.
+   *
+   * \throws boost::system::system_error If the server cannot listen for connections on its port.
    */
   void start();
 
@@ -236,13 +332,6 @@ public:
 
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
-  /**
-   * \brief Accepts a client.
-   *
-   * This will block until either a client connects or the mapping server terminates.
-   */
-  void accept_client();
-
   /**
    * \brief The handler called when a client connects (technically, when an asynchronous accept finishes).
    *
@@ -251,6 +340,39 @@ private:
    */
   void accept_client_handler(const boost::shared_ptr<boost::asio::ip::tcp::socket>& sock, const boost::system::error_code& err);
 
+  /**
+   * \brief Starts an asynchronous accept, so that the next client to try to connect will be accepted.
+   */
+  void begin_accept_client();
+
+  /**
+   * \brief Starts communicating with the specified client by starting an asynchronous read of its calibration message.
+   *
+   * \param client  The client.
+   */
+  void begin_client(const Client_Ptr& client);
+
+  /**
+   * \brief Starts an asynchronous read of the next frame header message from the specified client.
+   *
+   * \param client  The client.
+   */
+  void begin_read_frame_header(const Client_Ptr& client);
+
+  /**
+   * \brief Starts an asynchronous write of a cumulative acknowledgement to the specified client, if one is needed and none is already in progress.
+   *
+   * \param client  The client.
+   */
+  void begin_write_cumulative_ack(const Client_Ptr& client);
+
+  /**
+   * \brief Stops communicating with the specified client and marks it as finished.
+   *
+   * \param client  The client.
+   */
+  void finish_client(const Client_Ptr& client);
+
   /**
    * \brief Attempts to get the active client with the specified ID.
    *
@@ -262,74 +384,131 @@ private:
   Client_Ptr get_client(int clientID) const;
 
   /**
-   * \brief Handles messages from a client.
+   * \brief The handler called when an asynchronous read of a calibration message from a client finishes.
    *
-   * \param clientID  The ID of the client.
-   * \param socket    The TCP socket associated with the client.
+   * \param client  The client.
+   * \param err     The error code associated with the read.
    */
-  void handle_client(int clientID, const boost::shared_ptr<boost::asio::ip::tcp::socket>& sock);
+  void read_calibration_message_handler(const Client_Ptr& client, const boost::system::error_code& err);
 
   /**
-   * \brief Attempts to read a message of type T from the specified socket.
+   * \brief The handler called when an asynchronous read of a frame header message from a client finishes.
    *
-   * This will block until either the read succeeds, an error occurs or the server terminates.
+   * \param client  The client.
+   * \param err     The error code associated with the read.
+   */
+  void read_frame_header_handler(const Client_Ptr& client, const boost::system::error_code& err);
+
+  /**
+   * \brief The handler called when an asynchronous read of the first message after a client's calibration message finishes.
    *
-   * \param sock  The socket from which to attempt to read the message.
-   * \param msg   The T into which to write the message, if reading succeeded.
-   * \return      true, if reading succeeded, or false otherwise.
+   * This is either a protocol negotiation message (from a client that supports the windowed protocol), or the
+   * first frame header (from a client that predates versioning).
+   *
+   * \param client  The client.
+   * \param err     The error code associated with the read.
+   */
+  void read_first_message_handler(const Client_Ptr& client, const boost::system::error_code& err);
+
+  /**
+   * \brief The handler called when an asynchronous read of a frame message from a client finishes.
+   *
+   * \param client  The client.
+   * \param err     The error code associated with the read.
+   */
+  void read_frame_message_handler(const Client_Ptr& client, const boost::system::error_code& err);
+
+  /**
+   * \brief Starts an asynchronous read of a message of type T from the specified client.
+   *
+   * \param client      The client.
+   * \param msg         The T into which to read the message (must remain valid until the read finishes).
+   * \param handler     The member function to call when the read finishes.
+   * \param useTimeout  Whether or not the client should be disconnected if the read does not finish in time.
    */
   template <typename T>
-  bool read_message(const boost::shared_ptr<boost::asio::ip::tcp::socket>& sock, T& msg)
+  void read_message(const Client_Ptr& client, T& msg, ClientHandler handler, bool useTimeout)
   {
-    boost::optional<boost::system::error_code> err;
-    boost::asio::async_read(*sock, boost::asio::buffer(msg.get_data_ptr(), msg.get_size()), boost::bind(&MappingServer::read_message_handler, this, _1, boost::ref(err)));
-    while(!err && !m_shouldTerminate) boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
-    return m_shouldTerminate ? false : !*err;
+    if(useTimeout) start_timeout(client);
+    else stop_timeout(client);
+
+    // Note: Messages may store their data in several buffers, which we read into directly (i.e. we scatter the read across them).
+    std::vector<boost::asio::mutable_buffer> buffers;
+    msg.append_mutable_buffers(buffers);
+
+    boost::asio::async_read(*client->m_sock, buffers, client->m_strand->wrap(boost::bind(handler, this, client, _1)));
   }
 
   /**
-   * \brief The handler called when an asynchronous read of a message finishes.
+   * \brief Runs the I/O service (this is called on each of the I/O threads).
+   */
+  void run_io_service();
+
+  /**
+   * \brief Starts (or restarts) the specified client's deadline timer.
    *
-   * \param err The error code associated with the read.
-   * \param ret A location into which to write the error code so that read_message can access it.
+   * \param client  The client.
    */
-  void read_message_handler(const boost::system::error_code& err, boost::optional<boost::system::error_code>& ret);
+  void start_timeout(const Client_Ptr& client);
 
   /**
-   * \brief Keeps the map of clients clean by removing any clients that have terminated.
+   * \brief Stops the specified client's deadline timer, so that its next operation can take as long as it likes.
+   *
+   * \param client  The client.
    */
-  void run_cleaner();
+  void stop_timeout(const Client_Ptr& client);
 
   /**
-   * \brief Runs the mapping server.
+   * \brief The handler called when a client's deadline timer expires (or is cancelled).
+   *
+   * \param client  The client.
+   * \param err     The error code associated with the timer.
    */
-  void run_server();
+  void timeout_handler(const Client_Ptr& client, const boost::system::error_code& err);
 
   /**
-   * \brief Attempts to write a message of type T on the specified socket.
+   * \brief The handler called when an asynchronous write of an acknowledgement message to a client finishes.
    *
-   * This will block until either the write succeeds, an error occurs or the server terminates.
+   * \param client  The client.
+   * \param err     The error code associated with the write.
+   */
+  void write_ack_handler(const Client_Ptr& client, const boost::system::error_code& err);
+
+  /**
+   * \brief The handler called when an asynchronous write of the acknowledgement of a client's calibration message finishes.
    *
-   * \param sock  The socket to which to attempt to write the message.
-   * \param msg   The T to write.
-   * \return      true, if writing succeeded, or false otherwise.
+   * \param client  The client.
+   * \param err     The error code associated with the write.
    */
-  template <typename T>
-  bool write_message(const boost::shared_ptr<boost::asio::ip::tcp::socket>& sock, const T& msg)
-  {
-    boost::optional<boost::system::error_code> err;
-    boost::asio::async_write(*sock, boost::asio::buffer(msg.get_data_ptr(), msg.get_size()), boost::bind(&MappingServer::write_message_handler, this, _1, boost::ref(err)));
-    while(!err && !m_shouldTerminate) boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
-    return m_shouldTerminate ? false : !*err;
-  }
+  void write_calibration_ack_handler(const Client_Ptr& client, const boost::system::error_code& err);
+
+  /**
+   * \brief The handler called when an asynchronous write of a cumulative acknowledgement to a client finishes.
+   *
+   * \param client  The client.
+   * \param err     The error code associated with the write.
+   */
+  void write_cumulative_ack_handler(const Client_Ptr& client, const boost::system::error_code& err);
 
   /**
-   * \brief The handler called when an asynchronous write of a message finishes.
+   * \brief Starts an asynchronous write of a message of type T to the specified client.
    *
-   * \param err The error code associated with the write.
-   * \param ret A location into which to write the error code so that write_message can access it.
+   * \param client      The client.
+   * \param msg         The T to write (must remain valid until the write finishes).
+   * \param handler     The member function to call when the write finishes.
+   * \param useTimeout  Whether or not the client should be disconnected if the write does not finish in time. If not,
+   *                    the client's deadline timer is left alone (since it may be timing a concurrent read).
    */
-  void write_message_handler(const boost::system::error_code& err, boost::optional<boost::system::error_code>& ret);
+  template <typename T>
+  void write_message(const Client_Ptr& client, const T& msg, ClientHandler handler, bool useTimeout)
+  {
+    if(useTimeout) start_timeout(client);
+
+    std::vector<boost::asio::const_buffer> buffers;
+    msg.append_const_buffers(buffers);
+
+    boost::asio::async_write(*client->m_sock, buffers, client->m_strand->wrap(boost::bind(handler, this, client, _1)));
+  }
 };
 
 //#################### TYPEDEFS ####################
@@ -0,0 +1,88 @@
+/**
+ * itmx: ProtocolNegotiationMessage.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_ITMX_PROTOCOLNEGOTIATIONMESSAGE
+#define H_ITMX_PROTOCOLNEGOTIATIONMESSAGE
+
+#include <boost/cstdint.hpp>
+
+#include "MappingMessage.h"
+#include "MappingProtocolVersion.h"
+
+namespace itmx {
+
+/**
+ * \brief An instance of this class represents a message that a mapping client sends to a server to request the use of a later protocol version.
+ *
+ * The message is sent (only if the server has advertised support for a later protocol version) in place of the client's first frame header.
+ * It has the same size as a stop-and-wait frame header, and starts with a marker value that can never occur as a compressed depth image size,
+ * so that the server can tell it apart from the first frame header of a client that predates versioning.
+ */
+class ProtocolNegotiationMessage : public MappingMessage
+{
+  //#################### CONSTANTS ####################
+private:
+  /** The marker value with which every protocol negotiation message starts. */
+  static const uint32_t MARKER = 0xFFFFFFFF;
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The byte segment within the message data that corresponds to the marker. */
+  Segment m_markerSegment;
+
+  /** The byte segment within the message data that corresponds to the requested protocol version. */
+  Segment m_protocolVersionSegment;
+
+  /** The byte segment within the message data that corresponds to the requested window size (the maximum number of unacknowledged frames). */
+  Segment m_windowSizeSegment;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a protocol negotiation message.
+   */
+  ProtocolNegotiationMessage();
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Extracts the requested protocol version from the message.
+   *
+   * \return  The requested protocol version.
+   */
+  MappingProtocolVersion extract_protocol_version() const;
+
+  /**
+   * \brief Extracts the requested window size from the message.
+   *
+   * \return  The requested window size.
+   */
+  uint16_t extract_window_size() const;
+
+  /**
+   * \brief Gets whether or not the message starts with the protocol negotiation marker.
+   *
+   * \return  true, if the message starts with the protocol negotiation marker, or false otherwise.
+   */
+  bool has_valid_marker() const;
+
+  /**
+   * \brief Sets the requested protocol version.
+   *
+   * \param protocolVersion The requested protocol version.
+   */
+  void set_protocol_version(MappingProtocolVersion protocolVersion);
+
+  /**
+   * \brief Sets the requested window size.
+   *
+   * \param windowSize  The requested window size.
+   */
+  void set_window_size(uint16_t windowSize);
+};
+
+}
+
+#endif
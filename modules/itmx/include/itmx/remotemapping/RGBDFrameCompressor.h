@@ -16,6 +16,15 @@ namespace itmx {
 
 /**
  * \brief An instance of this class can be used to compress or decompress RGB-D frame messages.
+ *
+ * Images are compressed directly from the segments of the uncompressed message into the buffers of the compressed message,
+ * and uncompressed directly back into the segments of the uncompressed message, without any intermediate copies (other than
+ * those needed to convert between InfiniTAM's pixel formats and those that OpenCV expects).
+ *
+ * A frame can either be compressed in one go (using compress_rgbd_frame), or piece by piece (using compress_depth_image and
+ * compress_rgb_image, followed by finish_frame_compression). Since the depth and RGB images are compressed using separate
+ * internal buffers, the latter approach makes it possible to compress the two images of a frame on different threads.
+ * A single compressor must not be used to compress more than one frame at once, however.
  */
 class RGBDFrameCompressor
 {
@@ -47,44 +56,94 @@ public:
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
+  /**
+   * \brief Compresses the depth image in an RGB-D frame message.
+   *
+   * \note  This may be called concurrently with compress_rgb_image (on the same frame).
+   *
+   * \param uncompressedFrame      The message whose depth image is to be compressed.
+   * \param compressedFrame        The compressed frame message into whose depth buffer to write the compressed depth image.
+   * \throws std::invalid_argument If the sizes of the images in the uncompressed message differ from those the compressor was constructed to handle.
+   */
+  void compress_depth_image(const RGBDFrameMessage& uncompressedFrame, CompressedRGBDFrameMessage& compressedFrame);
+
+  /**
+   * \brief Compresses the RGB image in an RGB-D frame message.
+   *
+   * \note  This may be called concurrently with compress_depth_image (on the same frame).
+   *
+   * \param uncompressedFrame      The message whose RGB image is to be compressed.
+   * \param compressedFrame        The compressed frame message into whose RGB buffer to write the compressed RGB image.
+   * \throws std::invalid_argument If the sizes of the images in the uncompressed message differ from those the compressor was constructed to handle.
+   */
+  void compress_rgb_image(const RGBDFrameMessage& uncompressedFrame, CompressedRGBDFrameMessage& compressedFrame);
+
   /**
    * \brief Compresses an RGB-D frame message.
    *
    * \param uncompressedFrame  The message to compress.
-   * \param compressedHeader   Will contain the header data for the compressed RGB-D frame.
+   * \param compressedHeader   Will contain the header data for the compressed RGB-D frame (including the depth compression type, if the header has room for it).
    * \param compressedFrame    Will contain the compressed RGB-D frame data.
+   *
+   * \throws std::invalid_argument If the sizes of the images in the uncompressed message differ from those the compressor was constructed to handle.
    */
   void compress_rgbd_frame(const RGBDFrameMessage& uncompressedFrame, CompressedRGBDFrameHeaderMessage& compressedHeader, CompressedRGBDFrameMessage& compressedFrame);
 
+  /**
+   * \brief Finishes the compression of an RGB-D frame message whose images have already been compressed.
+   *
+   * This copies the frame's metadata into the compressed frame message, and prepares the corresponding header.
+   *
+   * \param uncompressedFrame  The message being compressed.
+   * \param compressedHeader   Will contain the header data for the compressed RGB-D frame.
+   * \param compressedFrame    The compressed frame message, whose images must already have been compressed.
+   */
+  void finish_frame_compression(const RGBDFrameMessage& uncompressedFrame, CompressedRGBDFrameHeaderMessage& compressedHeader, CompressedRGBDFrameMessage& compressedFrame) const;
+
+  /**
+   * \brief Sets the type of compression to apply to (or expect from) the depth images.
+   *
+   * \param depthCompressionType    The type of compression to apply to the depth images.
+   * \throws std::invalid_argument  If the specified compression type cannot be used (e.g. when building without OpenCV).
+   */
+  void set_depth_compression_type(DepthCompressionType depthCompressionType);
+
   /**
    * \brief Uncompresses an RGB-D frame message.
    *
    * \param compressedFrame    The compressed frame message.
    * \param uncompressedFrame  Will contain the uncompressed message.
+   *
+   * \throws std::invalid_argument If the sizes of the images in the uncompressed message differ from those the compressor was constructed to handle.
+   * \throws std::runtime_error    If the compressed images cannot be uncompressed into the uncompressed message (e.g. because they have the wrong size).
    */
   void uncompress_rgbd_frame(const CompressedRGBDFrameMessage& compressedFrame, RGBDFrameMessage& uncompressedFrame);
 
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
   /**
-   * \brief Compresses the uncompressed depth image on which we are currently working.
-   */
-  void compress_depth_image();
-
-  /**
-   * \brief Compresses the uncompressed RGB image on which we are currently working.
+   * \brief Checks that the sizes of the images in the specified uncompressed message match those the compressor was constructed to handle.
+   *
+   * \param uncompressedFrame      The uncompressed message.
+   * \throws std::invalid_argument If the image sizes do not match.
    */
-  void compress_rgb_image();
+  void check_image_sizes(const RGBDFrameMessage& uncompressedFrame) const;
 
   /**
-   * \brief Uncompresses the compressed depth image on which we are currently working.
+   * \brief Uncompresses a compressed depth image directly into the specified uncompressed message.
+   *
+   * \param compressedDepthData  The compressed depth image.
+   * \param uncompressedFrame    The uncompressed message.
    */
-  void uncompress_depth_image();
+  void uncompress_depth_image(const std::vector<uint8_t>& compressedDepthData, RGBDFrameMessage& uncompressedFrame);
 
   /**
-   * \brief Uncompresses the compressed RGB image on which we are currently working.
+   * \brief Uncompresses a compressed RGB image directly into the specified uncompressed message.
+   *
+   * \param compressedRgbData  The compressed RGB image.
+   * \param uncompressedFrame  The uncompressed message.
    */
-  void uncompress_rgb_image();
+  void uncompress_rgb_image(const std::vector<uint8_t>& compressedRgbData, RGBDFrameMessage& uncompressedFrame);
 };
 
 //#################### TYPEDEFS ####################
@@ -60,6 +60,48 @@ public:
    */
   void extract_rgb_image(ITMUChar4Image *rgbImage) const;
 
+  /**
+   * \brief Gets a raw pointer to the depth image segment of the message (e.g. so that a depth image can be decoded directly into it).
+   *
+   * \return  A raw pointer to the depth image segment of the message.
+   */
+  short *get_depth_image_data();
+
+  /**
+   * \brief Gets a raw pointer to the depth image segment of the message (e.g. so that a depth image can be encoded directly from it).
+   *
+   * \return  A raw pointer to the depth image segment of the message.
+   */
+  const short *get_depth_image_data() const;
+
+  /**
+   * \brief Gets the size of the frame's depth image.
+   *
+   * \return  The size of the frame's depth image.
+   */
+  const Vector2i& get_depth_image_size() const;
+
+  /**
+   * \brief Gets a raw pointer to the RGB image segment of the message (e.g. so that an RGB image can be decoded directly into it).
+   *
+   * \return  A raw pointer to the RGB image segment of the message.
+   */
+  Vector4u *get_rgb_image_data();
+
+  /**
+   * \brief Gets a raw pointer to the RGB image segment of the message (e.g. so that an RGB image can be encoded directly from it).
+   *
+   * \return  A raw pointer to the RGB image segment of the message.
+   */
+  const Vector4u *get_rgb_image_data() const;
+
+  /**
+   * \brief Gets the size of the frame's RGB image.
+   *
+   * \return  The size of the frame's RGB image.
+   */
+  const Vector2i& get_rgb_image_size() const;
+
   /**
    * \brief Copies a depth image into the appropriate byte segment in the message.
    *
@@ -0,0 +1,51 @@
+/**
+ * itmx: RVLDepthCodec.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_ITMX_RVLDEPTHCODEC
+#define H_ITMX_RVLDEPTHCODEC
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace itmx {
+
+/**
+ * \brief This class contains functions that can be used to losslessly compress and uncompress depth images using RVL.
+ *
+ * RVL ("run length, variable length") is the scheme described in "Fast Lossless Depth Image Compression" (Wilson, ISS 2017).
+ * The image is treated as a sequence of alternating runs of zero (invalid) and non-zero pixels. The length of each run is
+ * encoded, along with the zigzag-encoded difference between each non-zero pixel and the previous non-zero pixel. All of
+ * these values are stored using a variable-length code made up of 4-bit nibbles (3 bits of data and a continuation bit),
+ * packed into 32-bit words. Compression and uncompression are a single pass over the image, and are much faster than PNG.
+ */
+class RVLDepthCodec
+{
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Compresses a depth image.
+   *
+   * \param depthData       The depth image data.
+   * \param pixelCount      The number of pixels in the depth image.
+   * \param compressedData  The vector into which to write the compressed depth image. It will be resized as necessary.
+   */
+  static void compress(const short *depthData, size_t pixelCount, std::vector<uint8_t>& compressedData);
+
+  /**
+   * \brief Uncompresses a depth image.
+   *
+   * \param compressedData      The compressed depth image.
+   * \param depthData           The memory into which to write the uncompressed depth image data.
+   * \param pixelCount          The number of pixels in the depth image.
+   * \throws std::runtime_error If the compressed data is malformed, or does not contain exactly the specified number of pixels.
+   */
+  static void uncompress(const std::vector<uint8_t>& compressedData, short *depthData, size_t pixelCount);
+};
+
+}
+
+#endif
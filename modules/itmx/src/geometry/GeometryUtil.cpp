@@ -47,30 +47,33 @@ Eigen::Matrix4f GeometryUtil::estimate_rigid_transform(const Eigen::Matrix3f& P,
 }
 
 void GeometryUtil::estimate_rigid_transform(const Eigen::Matrix3f& P, const Eigen::Matrix3f& Q, Eigen::Matrix3f& R, Eigen::Vector3f& t)
+{
+  // Note: The explicit conversions are needed to avoid calling this overload recursively.
+  estimate_rigid_transform(Eigen::Matrix3Xf(P), Eigen::Matrix3Xf(Q), R, t);
+}
+
+void GeometryUtil::estimate_rigid_transform(const Eigen::Matrix3Xf& P, const Eigen::Matrix3Xf& Q, Eigen::Matrix3f& R, Eigen::Vector3f& t)
 {
   /*
-   * Step 1: Compute the centroids of the two sets of points.
+   * Step 1: Compute the centroids of the two sets of points by averaging over the columns.
    *
-   * centroid = (x1 x2 x3) * (1/3) = ((x1 + x2 + x3) / 3) = (cx)
-   *            (y1 y2 y3)   (1/3)   ((y1 + y2 + y3) / 3)   (cy)
-   *            (z1 z2 z3)   (1/3)   ((z1 + z2 + z3) / 3)   (cz)
+   * centroid = ((x1 + ... + xn) / n) = (cx)
+   *            ((y1 + ... + yn) / n)   (cy)
+   *            ((z1 + ... + zn) / n)   (cz)
    */
-  const Eigen::Vector3f ones = Eigen::Vector3f::Ones();
-  const Eigen::Vector3f thirds = ones / 3;
-  const Eigen::Vector3f centroidP = P * thirds;
-  const Eigen::Vector3f centroidQ = Q * thirds;
+  const Eigen::Vector3f centroidP = P.rowwise().mean();
+  const Eigen::Vector3f centroidQ = Q.rowwise().mean();
 
   /*
    * Step 2: Translate the points in each set so that their centroid coincides with the origin of the coordinate system.
    *         To do this, we subtract the centroid from each point.
    *
-   * centred = (x1 x2 x3) - (cx) * (1 1 1) = (x1 x2 x3) - (cx cx cx) = (x1-cx x2-cx x3-cx)
-   *           (y1 y2 y3)   (cy)             (y1 y2 y3)   (cy cy cy)   (y1-cy y2-cy y3-cy)
-   *           (z1 z2 z3)   (cz)             (z1 z2 z3)   (cz cz cz)   (z1-cz z2-cz z3-cz)
+   * centred = (x1 ... xn) - (cx ... cx) = (x1-cx ... xn-cx)
+   *           (y1 ... yn)   (cy ... cy)   (y1-cy ... yn-cy)
+   *           (z1 ... zn)   (cz ... cz)   (z1-cz ... zn-cz)
    */
-  const Eigen::RowVector3f onesT = ones.transpose();
-  const Eigen::Matrix3f centredP = P - centroidP * onesT;
-  const Eigen::Matrix3f centredQ = Q - centroidQ * onesT;
+  const Eigen::Matrix3Xf centredP = P.colwise() - centroidP;
+  const Eigen::Matrix3Xf centredQ = Q.colwise() - centroidQ;
 
   // Step 3: Compute the cross-covariance between the two matrices of centred points.
   const Eigen::Matrix3f A = centredP * centredQ.transpose();
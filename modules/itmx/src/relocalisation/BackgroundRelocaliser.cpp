@@ -57,6 +57,34 @@ BackgroundRelocaliser::relocalise(const ITMUChar4Image *colourImage, const ITMFl
   return result;
 }
 
+std::vector<Relocaliser::Result>
+BackgroundRelocaliser::relocalise_ranked(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage, const Vector4f& depthIntrinsics) const
+{
+  // Prevent training and updating of the decorated relocaliser during a relocalisation.
+  m_relocaliserRunning = true;
+
+  // Copy the colour and depth images we want to use for relocalisation across to the CPU.
+  colourImage->UpdateHostFromDevice();
+  depthImage->UpdateHostFromDevice();
+
+  // Set the current GPU to the one on which calls to the decorated relocaliser should be performed.
+  to_relocalisation_gpu();
+
+  // Make internal copies of the colour and depth images that are accessible on the new GPU.
+  copy_images(colourImage, depthImage);
+
+  // Attempt to relocalise using the internal copies, keeping all of the candidate poses found by the decorated relocaliser.
+  std::vector<Relocaliser::Result> results = m_relocaliser->relocalise_ranked(m_colourImage.get(), m_depthImage.get(), depthIntrinsics);
+
+  // Reset the current GPU to the one on which calls were previously being performed.
+  to_old_gpu();
+
+  // Allow training and updating of the decorated relocaliser again.
+  m_relocaliserRunning = false;
+
+  return results;
+}
+
 void BackgroundRelocaliser::reset()
 {
   // Set the current GPU to the one on which calls to the decorated relocaliser should be performed.
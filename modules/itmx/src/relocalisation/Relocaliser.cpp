@@ -18,6 +18,14 @@ void Relocaliser::finish_training()
   // No-op by default
 }
 
+std::vector<Relocaliser::Result> Relocaliser::relocalise_ranked(const ITMUChar4Image *colourImage, const ITMFloatImage *depthImage, const Vector4f& depthIntrinsics) const
+{
+  std::vector<Result> results;
+  boost::optional<Result> result = relocalise(colourImage, depthImage, depthIntrinsics);
+  if(result) results.push_back(*result);
+  return results;
+}
+
 void Relocaliser::update()
 {
   // No-op by default
@@ -6,20 +6,35 @@
 #include "remotemapping/CompressedRGBDFrameHeaderMessage.h"
 
 #include <cstring>
+#include <stdexcept>
 
 namespace itmx {
 
 //#################### CONSTRUCTORS ####################
 
-CompressedRGBDFrameHeaderMessage::CompressedRGBDFrameHeaderMessage()
+CompressedRGBDFrameHeaderMessage::CompressedRGBDFrameHeaderMessage(MappingProtocolVersion protocolVersion)
 {
   m_depthImageSizeSegment = std::make_pair(0, sizeof(uint32_t));
   m_rgbImageSizeSegment = std::make_pair(m_depthImageSizeSegment.second, sizeof(uint32_t));
-  m_data.resize(m_rgbImageSizeSegment.first + m_rgbImageSizeSegment.second);
+
+  // Note: The sequence number is appended to the end of the message so that the stop-and-wait layout is unchanged.
+  const size_t sequenceNumberSize = protocolVersion >= MAPPING_PROTOCOL_WINDOWED ? sizeof(uint32_t) : 0;
+  m_sequenceNumberSegment = std::make_pair(m_rgbImageSizeSegment.first + m_rgbImageSizeSegment.second, sequenceNumberSize);
+
+  const size_t depthCompressionTypeSize = protocolVersion >= MAPPING_PROTOCOL_WINDOWED_WITH_DEPTH_COMPRESSION_TYPE ? sizeof(uint32_t) : 0;
+  m_depthCompressionTypeSegment = std::make_pair(m_sequenceNumberSegment.first + m_sequenceNumberSegment.second, depthCompressionTypeSize);
+
+  m_data.resize(m_depthCompressionTypeSegment.first + m_depthCompressionTypeSegment.second);
 }
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
+DepthCompressionType CompressedRGBDFrameHeaderMessage::extract_depth_compression_type() const
+{
+  if(!has_depth_compression_type()) throw std::runtime_error("Error: The frame header message does not contain a depth compression type");
+  return static_cast<DepthCompressionType>(*reinterpret_cast<const uint32_t*>(&m_data[m_depthCompressionTypeSegment.first]));
+}
+
 uint32_t CompressedRGBDFrameHeaderMessage::extract_depth_image_size() const
 {
   return *reinterpret_cast<const uint32_t*>(&m_data[m_depthImageSizeSegment.first]);
@@ -30,6 +45,29 @@ uint32_t CompressedRGBDFrameHeaderMessage::extract_rgb_image_size() const
   return *reinterpret_cast<const uint32_t*>(&m_data[m_rgbImageSizeSegment.first]);
 }
 
+uint32_t CompressedRGBDFrameHeaderMessage::extract_sequence_number() const
+{
+  if(!has_sequence_number()) throw std::runtime_error("Error: The frame header message does not contain a sequence number");
+  return *reinterpret_cast<const uint32_t*>(&m_data[m_sequenceNumberSegment.first]);
+}
+
+bool CompressedRGBDFrameHeaderMessage::has_depth_compression_type() const
+{
+  return m_depthCompressionTypeSegment.second != 0;
+}
+
+bool CompressedRGBDFrameHeaderMessage::has_sequence_number() const
+{
+  return m_sequenceNumberSegment.second != 0;
+}
+
+void CompressedRGBDFrameHeaderMessage::set_depth_compression_type(DepthCompressionType depthCompressionType)
+{
+  if(!has_depth_compression_type()) throw std::runtime_error("Error: The frame header message does not contain a depth compression type");
+  const uint32_t value = static_cast<uint32_t>(depthCompressionType);
+  memcpy(&m_data[m_depthCompressionTypeSegment.first], reinterpret_cast<const char*>(&value), m_depthCompressionTypeSegment.second);
+}
+
 void CompressedRGBDFrameHeaderMessage::set_depth_image_size(uint32_t depthImageSize)
 {
   memcpy(&m_data[m_depthImageSizeSegment.first], reinterpret_cast<const char*>(&depthImageSize), m_depthImageSizeSegment.second);
@@ -40,4 +78,10 @@ void CompressedRGBDFrameHeaderMessage::set_rgb_image_size(uint32_t rgbImageSize)
   memcpy(&m_data[m_rgbImageSizeSegment.first], reinterpret_cast<const char*>(&rgbImageSize), m_rgbImageSizeSegment.second);
 }
 
+void CompressedRGBDFrameHeaderMessage::set_sequence_number(uint32_t sequenceNumber)
+{
+  if(!has_sequence_number()) throw std::runtime_error("Error: The frame header message does not contain a sequence number");
+  memcpy(&m_data[m_sequenceNumberSegment.first], reinterpret_cast<const char*>(&sequenceNumber), m_sequenceNumberSegment.second);
+}
+
 }
@@ -5,6 +5,8 @@
 
 #include "remotemapping/CompressedRGBDFrameMessage.h"
 
+#include <stdexcept>
+
 #include <ITMLib/Utils/ITMMath.h>
 
 namespace itmx {
@@ -16,50 +18,84 @@ CompressedRGBDFrameMessage::CompressedRGBDFrameMessage(const CompressedRGBDFrame
   // The frame index and pose have a fixed size and position in the message.
   m_frameIndexSegment = std::make_pair(0, sizeof(int));
   m_poseSegment = std::make_pair(m_frameIndexSegment.second, sizeof(Matrix4f) + 6 * sizeof(float));
+  m_data.resize(m_poseSegment.first + m_poseSegment.second);
 
-  // The depth and RGB segments' size and position can be obtained from the header message.
+  // The sizes of the depth and RGB images can be obtained from the header message.
   set_compressed_image_sizes(headerMsg);
 }
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
+void CompressedRGBDFrameMessage::append_const_buffers(std::vector<boost::asio::const_buffer>& buffers) const
+{
+  // Note: The order of the buffers (frame index + pose, then depth, then RGB) determines the layout of the message on the wire.
+  MappingMessage::append_const_buffers(buffers);
+  buffers.push_back(boost::asio::buffer(m_depthImageData));
+  buffers.push_back(boost::asio::buffer(m_rgbImageData));
+}
+
+void CompressedRGBDFrameMessage::append_mutable_buffers(std::vector<boost::asio::mutable_buffer>& buffers)
+{
+  MappingMessage::append_mutable_buffers(buffers);
+  buffers.push_back(boost::asio::buffer(m_depthImageData));
+  buffers.push_back(boost::asio::buffer(m_rgbImageData));
+}
+
 void CompressedRGBDFrameMessage::extract_depth_image_data(std::vector<uint8_t>& depthImageData) const
 {
-  depthImageData.resize(m_depthImageSegment.second);
-  memcpy(reinterpret_cast<char*>(depthImageData.data()), &m_data[m_depthImageSegment.first], m_depthImageSegment.second);
+  depthImageData = m_depthImageData;
 }
 
 void CompressedRGBDFrameMessage::extract_rgb_image_data(std::vector<uint8_t>& rgbImageData) const
 {
-  rgbImageData.resize(m_rgbImageSegment.second);
-  memcpy(reinterpret_cast<char*>(rgbImageData.data()), &m_data[m_rgbImageSegment.first], m_rgbImageSegment.second);
+  rgbImageData = m_rgbImageData;
+}
+
+std::vector<uint8_t>& CompressedRGBDFrameMessage::get_depth_image_data()
+{
+  return m_depthImageData;
+}
+
+const std::vector<uint8_t>& CompressedRGBDFrameMessage::get_depth_image_data() const
+{
+  return m_depthImageData;
+}
+
+std::vector<uint8_t>& CompressedRGBDFrameMessage::get_rgb_image_data()
+{
+  return m_rgbImageData;
+}
+
+const std::vector<uint8_t>& CompressedRGBDFrameMessage::get_rgb_image_data() const
+{
+  return m_rgbImageData;
 }
 
 void CompressedRGBDFrameMessage::set_compressed_image_sizes(const CompressedRGBDFrameHeaderMessage& headerMsg)
 {
-  m_depthImageSegment = std::make_pair(m_poseSegment.first + m_poseSegment.second, headerMsg.extract_depth_image_size());
-  m_rgbImageSegment = std::make_pair(m_depthImageSegment.first + m_depthImageSegment.second, headerMsg.extract_rgb_image_size());
-  m_data.resize(m_rgbImageSegment.first + m_rgbImageSegment.second);
+  // Note: Resizing a vector never reduces its capacity, so this only allocates when a frame is larger than any seen before.
+  m_depthImageData.resize(headerMsg.extract_depth_image_size());
+  m_rgbImageData.resize(headerMsg.extract_rgb_image_size());
 }
 
 void CompressedRGBDFrameMessage::set_depth_image_data(const std::vector<uint8_t>& depthImageData)
 {
-  if(depthImageData.size() != m_depthImageSegment.second)
+  if(depthImageData.size() != m_depthImageData.size())
   {
     throw std::runtime_error("Error: The compressed source depth image has a different size to that of the depth segment in the message");
   }
 
-  memcpy(&m_data[m_depthImageSegment.first], reinterpret_cast<const char*>(depthImageData.data()), m_depthImageSegment.second);
+  m_depthImageData = depthImageData;
 }
 
 void CompressedRGBDFrameMessage::set_rgb_image_data(const std::vector<uint8_t>& rgbImageData)
 {
-  if(rgbImageData.size() != m_rgbImageSegment.second)
+  if(rgbImageData.size() != m_rgbImageData.size())
   {
     throw std::runtime_error("Error: The compressed source RGB image has a different size to that of the RGB segment in the message");
   }
 
-  memcpy(&m_data[m_rgbImageSegment.first], reinterpret_cast<const char*>(rgbImageData.data()), m_rgbImageSegment.second);
+  m_rgbImageData = rgbImageData;
 }
 
 }
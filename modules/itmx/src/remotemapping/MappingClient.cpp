@@ -6,88 +6,369 @@
 #include "remotemapping/MappingClient.h"
 using namespace tvgutil;
 
+#include <algorithm>
+#include <iostream>
 #include <stdexcept>
 
 #include <tvgutil/boost/WrappedAsio.h>
 using boost::asio::ip::tcp;
 
 #include "remotemapping/AckMessage.h"
+#include "remotemapping/ProtocolNegotiationMessage.h"
 
 namespace itmx {
 
 //#################### CONSTRUCTORS ####################
 
-MappingClient::MappingClient(const std::string& host, const std::string& port, pooled_queue::PoolEmptyStrategy poolEmptyStrategy)
-: m_frameMessageQueue(poolEmptyStrategy), m_stream(host, port)
+MappingClient::MappingClient(const std::string& host, const std::string& port, pooled_queue::PoolEmptyStrategy poolEmptyStrategy, size_t windowSize, size_t compressionThreadCount)
+: m_compressionThreadCount(std::max<size_t>(compressionThreadCount, 1)),
+  m_compressionThreadPool(new ThreadPool(m_compressionThreadCount)),
+  m_frameMessageQueue(poolEmptyStrategy),
+  m_framesDropped(0),
+  m_framesSent(0),
+  m_protocolVersion(MAPPING_PROTOCOL_STOP_AND_WAIT),
+  m_shouldTerminate(false),
+  m_sock(m_ioService),
+  m_windowSize(static_cast<uint16_t>(std::min<size_t>(std::max<size_t>(windowSize, 1), 0xFFFF)))
 {
-  if(!m_stream) throw std::runtime_error("Error: Could not connect to server");
+  boost::system::error_code err;
+  tcp::resolver resolver(m_ioService);
+  tcp::resolver::iterator endpoints = resolver.resolve(tcp::resolver::query(host, port), err);
+  if(!err) boost::asio::connect(m_sock, endpoints, err);
+  if(err) throw std::runtime_error("Error: Could not connect to server");
+}
+
+//#################### DESTRUCTOR ####################
+
+MappingClient::~MappingClient()
+{
+  // Tell the frame dispatcher and message sender threads to terminate, and wake them up if they are waiting for a slot to be
+  // released or for a frame to be compressed.
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_shouldTerminate = true;
+    m_compressionSlotReleased.notify_all();
+    m_frameCompressed.notify_all();
+  }
+
+  // The dispatcher may instead be waiting for a frame message to be pushed onto the queue, so interrupt it. Similarly, the
+  // sender may be waiting to read an acknowledgement from the server (or to write a frame to it), so shut down the socket.
+  m_frameDispatcher.interrupt();
+  boost::system::error_code err;
+  m_sock.shutdown(tcp::socket::shutdown_both, err);
+
+  if(m_frameDispatcher.joinable()) m_frameDispatcher.join();
+  if(m_messageSender.joinable()) m_messageSender.join();
+
+  // Wait for any compression tasks that are still running to finish, since they use the compression slots and the mutex.
+  m_compressionThreadPool.reset();
 }
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
 MappingClient::RGBDFrameMessageQueue::PushHandler_Ptr MappingClient::begin_push_frame_message()
 {
-  return m_frameMessageQueue.begin_push();
+  RGBDFrameMessageQueue::PushHandler_Ptr pushHandler = m_frameMessageQueue.begin_push();
+
+  // If the queue is full and the frame is going to be discarded, record the fact that it has been dropped.
+  if(!pushHandler->get())
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    ++m_framesDropped;
+  }
+
+  return pushHandler;
+}
+
+size_t MappingClient::get_compressing_frame_count() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+
+  size_t count = 0;
+  for(size_t i = 0, size = m_compressionSlots.size(); i < size; ++i)
+  {
+    if(m_compressionSlots[i]->m_inUse) ++count;
+  }
+
+  return count;
+}
+
+size_t MappingClient::get_dropped_frame_count() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_framesDropped;
+}
+
+size_t MappingClient::get_queued_frame_count() const
+{
+  return m_frameMessageQueue.size();
+}
+
+size_t MappingClient::get_sent_frame_count() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_framesSent;
 }
 
 void MappingClient::send_calibration_message(const RGBDCalibrationMessage& msg)
 {
   bool connectionOk = true;
 
+  // Servers that predate the depth compression type being specified in each frame header do not support RVL compression.
+  // If RVL compression has been requested, we therefore tell the server in the calibration message that we will use the
+  // best other type of compression we support, and only switch to RVL if the server agrees to a protocol version that
+  // allows us to tell it about the switch. (Servers that support that version don't reject the type we advertise until
+  // the version has been agreed, so a server without PNG support still accepts a client that will switch to RVL.)
+  const DepthCompressionType requestedDepthCompressionType = msg.extract_depth_compression_type();
+  RGBDCalibrationMessage calibMsg = msg;
+  if(requestedDepthCompressionType == DEPTH_COMPRESSION_RVL)
+  {
+#ifdef WITH_OPENCV
+    calibMsg.set_depth_compression_type(DEPTH_COMPRESSION_PNG);
+#else
+    calibMsg.set_depth_compression_type(DEPTH_COMPRESSION_NONE);
+#endif
+  }
+
   // Send the message to the server.
-  connectionOk = connectionOk && m_stream.write(msg.get_data_ptr(), msg.get_size());
+  connectionOk = connectionOk && write_message(calibMsg);
 
   // Wait for an acknowledgement (note that this is blocking, unless the connection fails).
   AckMessage ackMsg;
-  connectionOk = connectionOk && m_stream.read(ackMsg.get_data_ptr(), ackMsg.get_size());
+  connectionOk = connectionOk && read_message(ackMsg);
 
   // Throw if the message was not successfully sent and acknowledged.
   if(!connectionOk) throw std::runtime_error("Error: Failed to send calibration message");
 
+  // The acknowledgement contains the latest protocol version supported by the server (servers that predate versioning
+  // send 0, i.e. stop-and-wait). If the server supports the windowed protocol, request the latest version we both support,
+  // with our preferred window size, and then wait for the server to tell us the window size it has agreed to.
+  const int32_t serverProtocolVersion = ackMsg.extract_status_code();
+  if(serverProtocolVersion >= MAPPING_PROTOCOL_WINDOWED)
+  {
+    ProtocolNegotiationMessage negotiationMsg;
+    negotiationMsg.set_protocol_version(static_cast<MappingProtocolVersion>(std::min<int32_t>(serverProtocolVersion, MAPPING_PROTOCOL_LATEST)));
+    negotiationMsg.set_window_size(m_windowSize);
+
+    connectionOk = connectionOk && write_message(negotiationMsg) && read_message(ackMsg);
+    if(!connectionOk) throw std::runtime_error("Error: Failed to negotiate the protocol version with the server");
+
+    m_protocolVersion = negotiationMsg.extract_protocol_version();
+    m_windowSize = static_cast<uint16_t>(std::min<int32_t>(std::max<int32_t>(ackMsg.extract_status_code(), 1), m_windowSize));
+  }
+  else
+  {
+    m_windowSize = 1;
+  }
+
   // Initialise the frame message queue.
   const int capacity = 1;
   m_frameMessageQueue.initialise(capacity, boost::bind(&RGBDFrameMessage::make, msg.extract_rgb_image_size(), msg.extract_depth_image_size()));
 
-  // Set up the RGB-D frame compressor.
-  m_frameCompressor.reset(new RGBDFrameCompressor(
-    msg.extract_rgb_image_size(), msg.extract_depth_image_size(),
-    msg.extract_rgb_compression_type(), msg.extract_depth_compression_type()
-  ));
+  // Set up the compression slots, each of which has its own RGB-D frame compressor. If the agreed protocol version allows
+  // each frame header to specify the type of compression used for the depth image, we can use the type that was originally
+  // requested; if not, we use the type we told the server about in the calibration message.
+  const DepthCompressionType depthCompressionType = m_protocolVersion >= MAPPING_PROTOCOL_WINDOWED_WITH_DEPTH_COMPRESSION_TYPE
+    ? requestedDepthCompressionType
+    : calibMsg.extract_depth_compression_type();
 
-  // Start the message sender thread.
-  boost::thread messageSender(&MappingClient::run_message_sender, this);
+  const size_t slotCount = m_compressionThreadCount + 1;
+  for(size_t i = 0; i < slotCount; ++i)
+  {
+    RGBDFrameCompressor_Ptr frameCompressor(new RGBDFrameCompressor(
+      msg.extract_rgb_image_size(), msg.extract_depth_image_size(),
+      msg.extract_rgb_compression_type(), depthCompressionType
+    ));
+
+    m_compressionSlots.push_back(CompressionSlot_Ptr(new CompressionSlot(
+      frameCompressor, m_protocolVersion, msg.extract_rgb_image_size(), msg.extract_depth_image_size()
+    )));
+  }
+
+  // Start the frame dispatcher and message sender threads.
+  m_frameDispatcher = boost::thread(&MappingClient::run_frame_dispatcher, this);
+  m_messageSender = boost::thread(&MappingClient::run_message_sender, this);
 }
 
 //#################### PRIVATE MEMBER FUNCTIONS ####################
 
+void MappingClient::compress_image(const CompressionSlot_Ptr& slot, ImageCompressor imageCompressor)
+{
+  bool succeeded = true;
+  try
+  {
+    ((*slot->m_frameCompressor).*imageCompressor)(*slot->m_uncompressedFrameMsg, slot->m_frameMsg);
+  }
+  catch(std::exception& e)
+  {
+    // Note: An exception must not be allowed to escape from a compression thread.
+    std::cerr << "Warning: Could not compress a frame: " << e.what() << std::endl;
+    succeeded = false;
+  }
+
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  if(!succeeded) slot->m_compressionFailed = true;
+
+  // If this was the last of the frame's images to be compressed, finish compressing the frame and let the sender thread know that it's ready.
+  if(--slot->m_pendingImageCount == 0)
+  {
+    if(!slot->m_compressionFailed)
+    {
+      slot->m_frameCompressor->finish_frame_compression(*slot->m_uncompressedFrameMsg, slot->m_frameHeaderMsg, slot->m_frameMsg);
+    }
+
+    m_frameCompressed.notify_all();
+  }
+}
+
+bool MappingClient::read_message(MappingMessage& msg)
+{
+  std::vector<boost::asio::mutable_buffer> buffers;
+  msg.append_mutable_buffers(buffers);
+
+  boost::system::error_code err;
+  boost::asio::read(m_sock, buffers, err);
+  return !err;
+}
+
+void MappingClient::run_frame_dispatcher()
+{
+  // Note: Frames are dispatched to the slots in round-robin order, and the sender thread sends (and then releases) them in the
+  //       same order. This ensures that the frames are sent in the order in which they were pushed onto the queue, and that a
+  //       slot only becomes available to the dispatcher once all of the frames that were dispatched before it have been sent.
+  for(size_t i = 0, slotCount = m_compressionSlots.size();; i = (i + 1) % slotCount)
+  {
+    const CompressionSlot_Ptr& slot = m_compressionSlots[i];
+
+    // Wait for the slot to be released by the sender thread (or for the client to be destroyed).
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      while(slot->m_inUse && !m_shouldTerminate) m_compressionSlotReleased.wait(lock);
+      if(m_shouldTerminate) return;
+    }
+
+    // Move the first frame message in the queue (blocking until one is available) into the slot, by swapping it with the slot's
+    // spare frame message. The spare message is then returned to the queue's pool in place of the one we took. This avoids the
+    // need to copy the frame, and allows the queue to accept new frames while this one is being compressed. Note that if the
+    // client is destroyed while we are waiting for a frame message, the wait will be interrupted, ending this thread.
+    std::swap(slot->m_uncompressedFrameMsg, m_frameMessageQueue.peek());
+    m_frameMessageQueue.pop();
+
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      if(m_shouldTerminate) return;
+      slot->m_compressionFailed = false;
+      slot->m_inUse = true;
+      slot->m_pendingImageCount = 2;
+    }
+
+    // Compress the depth and RGB images of the frame concurrently.
+    m_compressionThreadPool->post_task(boost::bind(&MappingClient::compress_image, this, slot, &RGBDFrameCompressor::compress_depth_image));
+    m_compressionThreadPool->post_task(boost::bind(&MappingClient::compress_image, this, slot, &RGBDFrameCompressor::compress_rgb_image));
+  }
+}
+
 void MappingClient::run_message_sender()
 {
   AckMessage ackMsg;
-  CompressedRGBDFrameHeaderMessage headerMsg;
-  CompressedRGBDFrameMessage frameMsg(headerMsg);
+
+  const bool windowed = m_protocolVersion >= MAPPING_PROTOCOL_WINDOWED;
+
+  // The numbers of frames that we have sent to the server, and that it has acknowledged receiving. Note that these
+  // are unsigned, so that the number of frames in flight (their difference) is still correct if they wrap around.
+  uint32_t framesSent = 0, framesAcked = 0;
 
   bool connectionOk = true;
 
-  while(connectionOk)
+  for(size_t i = 0, slotCount = m_compressionSlots.size(); connectionOk; i = (i + 1) % slotCount)
   {
-    // Read the first frame message from the queue (this will block until a message is available).
-    RGBDFrameMessage_Ptr msg = m_frameMessageQueue.peek();
-
-    // Compress the frame. The compressed frame is split into two messages - a header message,
-    // which tells the server how large a frame to expect, and a separate message containing
-    // the actual frame data.
-    m_frameCompressor->compress_rgbd_frame(*msg, headerMsg, frameMsg);
-
-    // First send the header message, then send the frame message, then wait for an acknowledgement
-    // from the server. We chain all of these with && so as to early out in case of failure.
-    connectionOk = connectionOk
-      && m_stream.write(headerMsg.get_data_ptr(), headerMsg.get_size())
-      && m_stream.write(frameMsg.get_data_ptr(), frameMsg.get_size())
-      && m_stream.read(ackMsg.get_data_ptr(), ackMsg.get_size());
-
-    // Remove the frame message that we have just sent from the queue.
-    m_frameMessageQueue.pop();
+    const CompressionSlot_Ptr& slot = m_compressionSlots[i];
+
+    // Wait for the frame in the next slot to be compressed (or for the client to be destroyed). The compressed frame is split
+    // into two messages - a header message, which tells the server how large a frame to expect, and a separate message
+    // containing the actual frame data.
+    bool compressionFailed;
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      while((!slot->m_inUse || slot->m_pendingImageCount > 0) && !m_shouldTerminate) m_frameCompressed.wait(lock);
+      if(m_shouldTerminate) return;
+      compressionFailed = slot->m_compressionFailed;
+    }
+
+    CompressedRGBDFrameHeaderMessage& headerMsg = slot->m_frameHeaderMsg;
+    const CompressedRGBDFrameMessage& frameMsg = slot->m_frameMsg;
+
+    if(compressionFailed)
+    {
+      // If the frame could not be compressed, skip it (it will be counted as having been dropped).
+    }
+    else if(windowed)
+    {
+      headerMsg.set_sequence_number(framesSent);
+
+      // If the window is full, wait for the server to acknowledge some of the frames in flight before sending this one.
+      // Each acknowledgement contains the total number of frames the server has received so far.
+      while(connectionOk && framesSent - framesAcked >= m_windowSize)
+      {
+        connectionOk = read_message(ackMsg);
+        if(connectionOk) framesAcked = static_cast<uint32_t>(ackMsg.extract_status_code());
+      }
+
+      // Send the header message, then the frame message.
+      connectionOk = connectionOk && write_frame(headerMsg, frameMsg);
+      if(connectionOk) ++framesSent;
+
+      // Process any acknowledgements that have already arrived, without waiting for any more.
+      boost::system::error_code err;
+      while(connectionOk && m_sock.available(err) >= ackMsg.get_size())
+      {
+        connectionOk = read_message(ackMsg);
+        if(connectionOk) framesAcked = static_cast<uint32_t>(ackMsg.extract_status_code());
+      }
+
+      if(err) connectionOk = false;
+    }
+    else
+    {
+      // First send the header message, then send the frame message, then wait for an acknowledgement
+      // from the server. We chain all of these with && so as to early out in case of failure.
+      connectionOk = connectionOk
+        && write_frame(headerMsg, frameMsg)
+        && read_message(ackMsg);
+    }
+
+    // Release the slot so that the dispatcher can reuse it, and update the frame counts.
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      slot->m_inUse = false;
+      if(compressionFailed) ++m_framesDropped;
+      else if(connectionOk) ++m_framesSent;
+      m_compressionSlotReleased.notify_one();
+    }
   }
 }
 
+bool MappingClient::write_frame(const CompressedRGBDFrameHeaderMessage& headerMsg, const CompressedRGBDFrameMessage& frameMsg)
+{
+  // Gather the buffers of both messages into a single buffer sequence, so that they can be sent using a single write
+  // without first being concatenated.
+  std::vector<boost::asio::const_buffer> buffers;
+  headerMsg.append_const_buffers(buffers);
+  frameMsg.append_const_buffers(buffers);
+
+  boost::system::error_code err;
+  boost::asio::write(m_sock, buffers, err);
+  return !err;
+}
+
+bool MappingClient::write_message(const MappingMessage& msg)
+{
+  std::vector<boost::asio::const_buffer> buffers;
+  msg.append_const_buffers(buffers);
+
+  boost::system::error_code err;
+  boost::asio::write(m_sock, buffers, err);
+  return !err;
+}
+
 }
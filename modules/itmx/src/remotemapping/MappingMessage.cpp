@@ -13,6 +13,16 @@ MappingMessage::~MappingMessage() {}
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
+void MappingMessage::append_const_buffers(std::vector<boost::asio::const_buffer>& buffers) const
+{
+  buffers.push_back(boost::asio::buffer(m_data));
+}
+
+void MappingMessage::append_mutable_buffers(std::vector<boost::asio::mutable_buffer>& buffers)
+{
+  buffers.push_back(boost::asio::buffer(m_data));
+}
+
 char *MappingMessage::get_data_ptr()
 {
   return &m_data[0];
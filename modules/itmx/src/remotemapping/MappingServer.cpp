@@ -8,26 +8,29 @@ using boost::asio::ip::tcp;
 using namespace ITMLib;
 using namespace tvgutil;
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 #ifdef WITH_OPENCV
 #include "ocv/OpenCVUtil.h"
 #endif
 
-#include "remotemapping/AckMessage.h"
-#include "remotemapping/CompressedRGBDFrameHeaderMessage.h"
-#include "remotemapping/CompressedRGBDFrameMessage.h"
-#include "remotemapping/RGBDCalibrationMessage.h"
-#include "remotemapping/RGBDFrameCompressor.h"
-
 #define DEBUGGING 0
 
 namespace itmx {
 
 //#################### CONSTRUCTORS ####################
 
-MappingServer::MappingServer(Mode mode, int port)
-: m_mode(mode), m_nextClientID(0), m_port(port), m_shouldTerminate(false), m_worker(new boost::asio::io_service::work(m_ioService))
+MappingServer::MappingServer(Mode mode, int port, size_t ioThreadCount, int timeoutMs, size_t maxWindowSize)
+: m_ioThreadCount(std::max<size_t>(ioThreadCount, 1)),
+  m_maxWindowSize(static_cast<uint16_t>(std::min<size_t>(std::max<size_t>(maxWindowSize, 1), 0xFFFF))),
+  m_mode(mode),
+  m_nextClientID(0),
+  m_port(port),
+  m_shouldTerminate(false),
+  m_timeoutMs(timeoutMs),
+  m_worker(new boost::asio::io_service::work(m_ioService))
 {}
 
 //#################### DESTRUCTOR ####################
@@ -43,17 +46,12 @@ std::vector<int> MappingServer::get_active_clients() const
 {
   boost::lock_guard<boost::mutex> lock(m_mutex);
 
-  // Note: If necessary, we can optimise this by caching the list of active clients and updating it when new clients
-  //       are accepted or existing clients terminate. However, since the number of clients is generally fairly low,
-  //       the benefits of doing so are quite limited in practice.
+  // Note: Clients are removed from the clients map as soon as they finish, so every client in the map is active.
   std::vector<int> activeClients;
   activeClients.reserve(m_clients.size());
   for(std::map<int,Client_Ptr>::const_iterator it = m_clients.begin(), iend = m_clients.end(); it != iend; ++it)
   {
-    if(m_finishedClients.find(it->first) == m_finishedClients.end())
-    {
-      activeClients.push_back(it->first);
-    }
+    activeClients.push_back(it->first);
   }
 
   return activeClients;
@@ -160,22 +158,46 @@ bool MappingServer::has_more_images(int clientID) const
 
 void MappingServer::start()
 {
-  m_serverThread.reset(new boost::thread(boost::bind(&MappingServer::run_server, this)));
+  // Set up the TCP acceptor and start listening for connections.
+  tcp::endpoint endpoint(tcp::v4(), m_port);
+  m_acceptor.reset(new tcp::acceptor(m_ioService, endpoint));
+
+  std::cout << "Listening for connections...\n";
+  begin_accept_client();
+
+  // Start the threads on which all communication with the clients will be handled.
+  for(size_t i = 0; i < m_ioThreadCount; ++i)
+  {
+    m_ioThreads.create_thread(boost::bind(&MappingServer::run_io_service, this));
+  }
 }
 
 void MappingServer::terminate()
 {
-  m_shouldTerminate = true;
+  // If the server has already been terminated, early out.
+  if(m_shouldTerminate.exchange(true)) return;
 
-  if(m_serverThread) m_serverThread->join();
+  // Stop the I/O service and wait for any handlers that are currently running to finish.
+  m_worker.reset();
+  m_ioService.stop();
+  m_ioThreads.join_all();
 
-  if(m_cleanerThread)
+  // Mark any clients that are still active as finished, so that any threads waiting for them wake up, and destroy
+  // their sockets and timers (these must be destroyed before the I/O service, or there will be a crash on exit).
   {
-    // Make sure that the cleaner thread can terminate when there are no clients remaining to wake it up.
-    m_uncleanClients.insert(-1);
-    m_clientsHaveFinished.notify_one();
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    for(std::map<int,Client_Ptr>::const_iterator it = m_clients.begin(), iend = m_clients.end(); it != iend; ++it)
+    {
+      const Client_Ptr& client = it->second;
+      client->m_finished = true;
+      client->m_frameCompressor.reset();
+      client->m_timer.reset();
+      client->m_sock.reset();
+      m_finishedClients.insert(it->first);
+    }
 
-    m_cleanerThread->join();
+    m_clients.clear();
+    m_clientReady.notify_all();
   }
 
   // Note: It's essential that we destroy the acceptor before the I/O service, or there will be a crash.
@@ -184,46 +206,109 @@ void MappingServer::terminate()
 
 //#################### PRIVATE MEMBER FUNCTIONS ####################
 
-void MappingServer::accept_client()
+void MappingServer::accept_client_handler(const boost::shared_ptr<boost::asio::ip::tcp::socket>& sock, const boost::system::error_code& err)
 {
-  // FIXME: It would be better to have accept_client_handler call accept_client after accepted a connection.
-  //        This would allow us to get rid of the sleep loop.
-  boost::shared_ptr<tcp::socket> sock(new tcp::socket(m_ioService));
-  m_acceptor->async_accept(*sock, boost::bind(&MappingServer::accept_client_handler, this, sock, _1));
-  while(!m_shouldTerminate && m_ioService.poll() == 0)
+  // If the server is terminating, early out (without accepting any more clients).
+  if(m_shouldTerminate || err == boost::asio::error::operation_aborted) return;
+
+  if(!err)
   {
-    boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+
+    if(m_mode == MSM_SINGLE_CLIENT && m_nextClientID != 0)
+    {
+      // If the server is running in single client mode and a second client tries to connect, reject it.
+      std::cout << "Warning: Rejecting client connection (server is in single client mode)" << std::endl;
+      sock->close();
+    }
+    else
+    {
+      // Otherwise, add an entry to the clients map for the new client, and start communicating with it.
+      std::cout << "Accepted client connection" << std::endl;
+      Client_Ptr client(new Client(m_nextClientID, sock, m_ioService));
+      m_clients.insert(std::make_pair(m_nextClientID, client));
+      ++m_nextClientID;
+
+      client->m_strand->post(boost::bind(&MappingServer::begin_client, this, client));
+    }
   }
+
+  // Whether or not the accept succeeded, start waiting for the next client to connect.
+  begin_accept_client();
 }
 
-void MappingServer::accept_client_handler(const boost::shared_ptr<boost::asio::ip::tcp::socket>& sock, const boost::system::error_code& err)
+void MappingServer::begin_accept_client()
 {
-  // If an error occurred, early out.
-  if(err) return;
+  boost::shared_ptr<tcp::socket> sock(new tcp::socket(m_ioService));
+  m_acceptor->async_accept(*sock, boost::bind(&MappingServer::accept_client_handler, this, sock, _1));
+}
 
-  // If the server is running in single client mode and a second client tries to connect, early out.
-  if(m_mode == MSM_SINGLE_CLIENT && m_nextClientID != 0)
-  {
-    std::cout << "Warning: Rejecting client connection (server is in single client mode)" << std::endl;
-    sock->close();
-    return;
-  }
+void MappingServer::begin_client(const Client_Ptr& client)
+{
+  std::cout << "Starting client: " << client->m_id << '\n';
 
-  // If a client successfully connects, start a thread for it and add an entry to the clients map.
-  std::cout << "Accepted client connection" << std::endl;
+  // Read a calibration message from the client to get its camera's image sizes and calibration parameters.
+  read_message(client, client->m_calibMsg, &MappingServer::read_calibration_message_handler, true);
+}
+
+void MappingServer::begin_read_frame_header(const Client_Ptr& client)
+{
+#if DEBUGGING
+  std::cout << "Message queue size (" << client->m_id << "): " << client->m_frameMessageQueue->size() << std::endl;
+#endif
+
+  // Note: The client is allowed to take as long as it likes to start sending its next frame, so we don't use a timeout here.
+  read_message(client, client->m_frameHeaderMsg, &MappingServer::read_frame_header_handler, false);
+}
+
+void MappingServer::begin_write_cumulative_ack(const Client_Ptr& client)
+{
+  // If an acknowledgement is already being written, early out. (Its handler will call this function again once it
+  // has been written, so any frames that have been received in the meantime will be acknowledged at that point.)
+  if(client->m_ackInProgress) return;
+
+  // If all of the frames that have been received have already been acknowledged, early out.
+  if(client->m_framesAcked == client->m_framesReceived) return;
+
+  // Otherwise, acknowledge all of the frames that have been received so far in a single message.
+  client->m_ackInProgress = true;
+  client->m_framesAcked = client->m_framesReceived;
+  client->m_ackMsg.set_status_code(static_cast<int32_t>(client->m_framesAcked));
+
+  // Note: We don't time the write, since the reads of the frames are being timed concurrently.
+  write_message(client, client->m_ackMsg, &MappingServer::write_cumulative_ack_handler, false);
+}
+
+void MappingServer::finish_client(const Client_Ptr& client)
+{
+  // If we've already finished communicating with the client, early out.
+  if(client->m_finished) return;
+  client->m_finished = true;
+
+  // Stop any outstanding operations for the client.
+  boost::system::error_code err;
+  client->m_timer->cancel(err);
+  client->m_sock->close(err);
+
+  // Destroy the frame compressor prior to stopping the client (this cleanly deallocates CUDA memory and avoids a crash on exit).
+  client->m_frameCompressor.reset();
+
+  // Remove the client from the clients map and add it to the finished clients set. Note that the client itself will be
+  // destroyed once all of the remaining references to it (e.g. any that are held by outstanding handlers) are gone.
   boost::lock_guard<boost::mutex> lock(m_mutex);
-  boost::shared_ptr<boost::thread> clientThread(new boost::thread(boost::bind(&MappingServer::handle_client, this, m_nextClientID, sock)));
-  m_clients.insert(std::make_pair(m_nextClientID, Client_Ptr(new Client(clientThread))));
-  ++m_nextClientID;
+  std::cout << "Stopping client: " << client->m_id << '\n';
+  m_clients.erase(client->m_id);
+  m_finishedClients.insert(client->m_id);
+  m_clientReady.notify_all();
 }
 
 MappingServer::Client_Ptr MappingServer::get_client(int clientID) const
 {
   boost::unique_lock<boost::mutex> lock(m_mutex);
 
-  // Wait until the client is either active and ready to accept frame messages, or has terminated.
+  // Wait until the client is either active and ready to yield frame messages, or has terminated.
   std::map<int,Client_Ptr>::const_iterator it;
-  while((it = m_clients.find(clientID)) == m_clients.end() && m_finishedClients.find(clientID) == m_finishedClients.end())
+  while(((it = m_clients.find(clientID)) == m_clients.end() || !it->second->m_ready) && m_finishedClients.find(clientID) == m_finishedClients.end())
   {
     m_clientReady.wait(lock);
   }
@@ -231,173 +316,297 @@ MappingServer::Client_Ptr MappingServer::get_client(int clientID) const
   return it != m_clients.end() ? it->second : Client_Ptr();
 }
 
-void MappingServer::handle_client(int clientID, const boost::shared_ptr<tcp::socket>& sock)
+void MappingServer::read_calibration_message_handler(const Client_Ptr& client, const boost::system::error_code& err)
 {
-  // Look up the client being handled by this thread.
-  Client_Ptr client;
+  // If the calibration message could not be read, stop communicating with the client.
+  if(err)
   {
+    finish_client(client);
+    return;
+  }
+
 #if DEBUGGING
-    std::cout << "Waiting for thread creation to finish for client: " << clientID << std::endl;
+  std::cout << "Received calibration message from client: " << client->m_id << std::endl;
 #endif
+
+  const RGBDCalibrationMessage& calibMsg = client->m_calibMsg;
+
+  // Save the image sizes and calibration parameters.
+  client->m_rgbImageSize = calibMsg.extract_rgb_image_size();
+  client->m_depthImageSize = calibMsg.extract_depth_image_size();
+  client->m_calib = calibMsg.extract_calib();
+
+  // Initialise the frame message queue.
+  const size_t capacity = 5;
+  client->m_frameMessageQueue->initialise(capacity, boost::bind(&RGBDFrameMessage::make, client->m_rgbImageSize, client->m_depthImageSize));
+
+  // Set up the frame compressor. If we can't handle the type of depth compression the client has specified, we don't reject
+  // it yet, since a client that can specify the type of depth compression in each frame header advertises the type it would
+  // fall back to with older servers, and may end up using a different type. Instead, we set up the compressor without depth
+  // compression for now, and decide whether or not to reject the client once the protocol version has been agreed.
+  try
+  {
+    try
+    {
+      client->m_frameCompressor.reset(new RGBDFrameCompressor(
+        client->m_rgbImageSize, client->m_depthImageSize,
+        calibMsg.extract_rgb_compression_type(),
+        calibMsg.extract_depth_compression_type()
+      ));
+    }
+    catch(std::invalid_argument& e)
+    {
+      client->m_depthCompressionError = e.what();
+      client->m_frameCompressor.reset(new RGBDFrameCompressor(
+        client->m_rgbImageSize, client->m_depthImageSize,
+        calibMsg.extract_rgb_compression_type(),
+        DEPTH_COMPRESSION_NONE
+      ));
+    }
+  }
+  catch(std::exception& e)
+  {
+    // If the client has asked for a type of RGB compression we can't handle, stop communicating with it.
+    std::cerr << "Warning: Could not set up the frame compressor for client " << client->m_id << ": " << e.what() << std::endl;
+    finish_client(client);
+    return;
+  }
+
+  // Construct a dummy frame message to consume messages that cannot be pushed onto the queue.
+  client->m_dummyFrameMsg.reset(new RGBDFrameMessage(client->m_rgbImageSize, client->m_depthImageSize));
+
+  // Signal to other threads that the client is ready to start yielding frame messages.
+  {
     boost::lock_guard<boost::mutex> lock(m_mutex);
-    std::cout << "Starting client: " << clientID << '\n';
-    client = m_clients.find(clientID)->second;
+    client->m_ready = true;
+    m_clientReady.notify_all();
   }
 
-  // Read a calibration message from the client to get its camera's image sizes and calibration parameters.
-  RGBDCalibrationMessage calibMsg;
-  bool connectionOk = read_message(sock, calibMsg);
-#if DEBUGGING
-  std::cout << "Received calibration message from client: " << clientID << std::endl;
-#endif
+  // Signal to the client that the server is ready, and tell it the latest protocol version we support.
+  client->m_ackMsg.set_status_code(MAPPING_PROTOCOL_LATEST);
+  write_message(client, client->m_ackMsg, &MappingServer::write_calibration_ack_handler, true);
+}
 
-  // If the calibration message was successfully read:
-  RGBDFrameCompressor_Ptr frameCompressor;
-  RGBDFrameMessage_Ptr dummyFrameMsg;
-  if(connectionOk)
+void MappingServer::read_first_message_handler(const Client_Ptr& client, const boost::system::error_code& err)
+{
+  // If the message could not be read, stop communicating with the client.
+  if(err)
   {
-    // Save the image sizes and calibration parameters.
-    client->m_rgbImageSize = calibMsg.extract_rgb_image_size();
-    client->m_depthImageSize = calibMsg.extract_depth_image_size();
-    client->m_calib = calibMsg.extract_calib();
-
-    // Initialise the frame message queue.
-    const size_t capacity = 5;
-    client->m_frameMessageQueue->initialise(capacity, boost::bind(&RGBDFrameMessage::make, client->m_rgbImageSize, client->m_depthImageSize));
-
-    // Set up the frame compressor.
-    frameCompressor.reset(new RGBDFrameCompressor(
-      client->m_rgbImageSize, client->m_depthImageSize,
-      calibMsg.extract_rgb_compression_type(),
-      calibMsg.extract_depth_compression_type()
-    ));
-
-    // Construct a dummy frame message to consume messages that cannot be pushed onto the queue.
-    dummyFrameMsg.reset(new RGBDFrameMessage(client->m_rgbImageSize, client->m_depthImageSize));
-
-    // Signal to the client that the server is ready.
-    connectionOk = write_message(sock, AckMessage());
+    finish_client(client);
+    return;
   }
 
-  // Signal to other threads that we're ready to start reading frame messages from the client.
-  m_clientReady.notify_one();
+  const ProtocolNegotiationMessage& negotiationMsg = client->m_negotiationMsg;
 
-  // Read and record frame messages from the client until either (a) the connection drops, or (b) the server itself is terminating.
-  CompressedRGBDFrameHeaderMessage headerMsg;
-  CompressedRGBDFrameMessage frameMsg(headerMsg);
-  while(connectionOk && !m_shouldTerminate)
+  // If the client has asked to use a later version of the protocol, agree to the latest version we both support.
+  if(negotiationMsg.has_valid_marker())
   {
-#if DEBUGGING
-    std::cout << "Message queue size (" << clientID << "): " << client->m_frameMessageQueue->size() << std::endl;
-#endif
+    client->m_protocolVersion = std::min(negotiationMsg.extract_protocol_version(), MAPPING_PROTOCOL_LATEST);
+  }
 
-    RGBDFrameMessageQueue::PushHandler_Ptr pushHandler = client->m_frameMessageQueue->begin_push();
-    boost::optional<RGBDFrameMessage_Ptr&> elt = pushHandler->get();
-    RGBDFrameMessage& msg = elt ? **elt : *dummyFrameMsg;
+  // If we can't handle the type of depth compression specified in the client's calibration message, and the agreed protocol
+  // version doesn't let the client specify a different type in each frame header, stop communicating with the client.
+  if(!client->m_depthCompressionError.empty() && client->m_protocolVersion < MAPPING_PROTOCOL_WINDOWED_WITH_DEPTH_COMPRESSION_TYPE)
+  {
+    std::cerr << "Warning: Could not set up the frame compressor for client " << client->m_id << ": " << client->m_depthCompressionError << std::endl;
+    finish_client(client);
+    return;
+  }
 
-    // First, try to read a frame header message.
-    if((connectionOk = read_message(sock, headerMsg)))
-    {
-      // If that succeeds, set up the frame message accordingly.
-      frameMsg.set_compressed_image_sizes(headerMsg);
+  if(negotiationMsg.has_valid_marker())
+  {
+    client->m_frameHeaderMsg = CompressedRGBDFrameHeaderMessage(client->m_protocolVersion);
 
-      // Now, read the frame message itself.
-      if((connectionOk = read_message(sock, frameMsg)))
-      {
-        // If that succeeds, uncompress the images and send an acknowledgement to the client.
-        frameCompressor->uncompress_rgbd_frame(frameMsg, msg);
-        connectionOk = write_message(sock, AckMessage());
+    // Tell the client the window size we're prepared to agree to (the stop-and-wait protocol effectively uses a window of 1).
+    const uint16_t windowSize = client->m_protocolVersion >= MAPPING_PROTOCOL_WINDOWED
+      ? std::min(std::max<uint16_t>(negotiationMsg.extract_window_size(), 1), m_maxWindowSize)
+      : 1;
 
 #if DEBUGGING
-        std::cout << "Got message: " << msg.extract_frame_index() << std::endl;
-
-      #ifdef WITH_OPENCV
-        static ITMUChar4Image_Ptr rgbImage(new ITMUChar4Image(client->m_rgbImageSize, true, false));
-        msg.extract_rgb_image(rgbImage.get());
-        cv::Mat3b cvRGB = OpenCVUtil::make_rgb_image(rgbImage->GetData(MEMORYDEVICE_CPU), rgbImage->noDims.x, rgbImage->noDims.y);
-        cv::imshow("RGB", cvRGB);
-        cv::waitKey(1);
-      #endif
+    std::cout << "Client " << client->m_id << " is using protocol version " << client->m_protocolVersion << " with a window size of " << windowSize << std::endl;
 #endif
-      }
-    }
-  }
-
-  // Destroy the frame compressor prior to stopping the client (this cleanly deallocates CUDA memory and avoids a crash on exit).
-  frameCompressor.reset();
 
-  // Once we've finished reading messages, add the client to the finished clients set so that it can be cleaned up.
+    client->m_ackMsg.set_status_code(windowSize);
+    write_message(client, client->m_ackMsg, &MappingServer::write_ack_handler, true);
+  }
+  else
   {
-    boost::lock_guard<boost::mutex> lock(m_mutex);
-    std::cout << "Stopping client: " << clientID << '\n';
-    m_finishedClients.insert(clientID);
-    m_uncleanClients.insert(clientID);
-    m_clientsHaveFinished.notify_one();
+    // Otherwise, the client predates versioning, and the message is actually the header of its first frame. Since
+    // the stop-and-wait frame header has the same size as a protocol negotiation message, we can simply copy it
+    // across and continue as if we had read it directly.
+    client->m_ackMsg.set_status_code(0);
+    memcpy(client->m_frameHeaderMsg.get_data_ptr(), negotiationMsg.get_data_ptr(), negotiationMsg.get_size());
+    read_frame_header_handler(client, err);
   }
 }
 
-void MappingServer::read_message_handler(const boost::system::error_code& err, boost::optional<boost::system::error_code>& ret)
+void MappingServer::read_frame_header_handler(const Client_Ptr& client, const boost::system::error_code& err)
 {
-  // Store any error message so that it can be examined by read_message.
-  ret = err;
+  // If the frame header message could not be read, stop communicating with the client.
+  if(err)
+  {
+    finish_client(client);
+    return;
+  }
+
+  // If the client is using the windowed protocol, check that the frame is the one we're expecting.
+  // (This should always be the case, since TCP delivers messages in order, unless the client is misbehaving.)
+  const CompressedRGBDFrameHeaderMessage& headerMsg = client->m_frameHeaderMsg;
+  if(headerMsg.has_sequence_number() && headerMsg.extract_sequence_number() != client->m_framesReceived)
+  {
+    std::cerr << "Warning: Received frame " << headerMsg.extract_sequence_number() << " from client " << client->m_id
+              << " when expecting frame " << client->m_framesReceived << std::endl;
+    finish_client(client);
+    return;
+  }
+
+  // Set up the frame message according to the header, and then read the frame message itself.
+  client->m_frameMsg.set_compressed_image_sizes(client->m_frameHeaderMsg);
+  read_message(client, client->m_frameMsg, &MappingServer::read_frame_message_handler, true);
 }
 
-void MappingServer::run_cleaner()
+void MappingServer::read_frame_message_handler(const Client_Ptr& client, const boost::system::error_code& err)
 {
-  boost::unique_lock<boost::mutex> lock(m_mutex);
+  // If the frame message could not be read, stop communicating with the client.
+  if(err)
+  {
+    finish_client(client);
+    return;
+  }
 
-  bool canTerminate = m_shouldTerminate && m_clients.empty();
-  while(!canTerminate)
+  // Uncompress the frame into the next element of the frame message queue, or into the dummy frame message if the queue is full.
+  // Note that since the queue discards frames when it is full, beginning a push never blocks the I/O thread.
   {
-    // Wait for clients to finish.
-    while(m_uncleanClients.empty()) m_clientsHaveFinished.wait(lock);
+    RGBDFrameMessageQueue::PushHandler_Ptr pushHandler = client->m_frameMessageQueue->begin_push();
+    boost::optional<RGBDFrameMessage_Ptr&> elt = pushHandler->get();
+    RGBDFrameMessage& msg = elt ? **elt : *client->m_dummyFrameMsg;
 
-    // Clean up any clients that have finished.
-    for(std::set<int>::const_iterator it = m_uncleanClients.begin(), iend = m_uncleanClients.end(); it != iend; ++it)
+    try
     {
-      if(m_clients.find(*it) != m_clients.end())
+      // If the frame header specifies how the depth image was compressed, make sure the compressor uses the same type of compression.
+      // (Clients that support this send the type of compression they will fall back to with older servers in their calibration message.)
+      const CompressedRGBDFrameHeaderMessage& headerMsg = client->m_frameHeaderMsg;
+      if(headerMsg.has_depth_compression_type())
       {
-        std::cout << "Cleaning up client: " << *it << std::endl;
-        m_clients.erase(*it);
+        client->m_frameCompressor->set_depth_compression_type(headerMsg.extract_depth_compression_type());
       }
+
+      client->m_frameCompressor->uncompress_rgbd_frame(client->m_frameMsg, msg);
+    }
+    catch(std::exception& e)
+    {
+      // If the frame is malformed, stop communicating with the client (an exception must not be allowed to escape from an I/O thread).
+      std::cerr << "Warning: Could not uncompress a frame from client " << client->m_id << ": " << e.what() << std::endl;
+      finish_client(client);
+      return;
     }
 
-    m_uncleanClients.clear();
+#if DEBUGGING
+    std::cout << "Got message: " << msg.extract_frame_index() << std::endl;
+
+  #ifdef WITH_OPENCV
+    static ITMUChar4Image_Ptr rgbImage(new ITMUChar4Image(client->m_rgbImageSize, true, false));
+    msg.extract_rgb_image(rgbImage.get());
+    cv::Mat3b cvRGB = OpenCVUtil::make_rgb_image(rgbImage->GetData(MEMORYDEVICE_CPU), rgbImage->noDims.x, rgbImage->noDims.y);
+    cv::imshow("RGB", cvRGB);
+    cv::waitKey(1);
+  #endif
+#endif
+  }
 
-    // Update the flag.
-    canTerminate = m_shouldTerminate && m_clients.empty();
+  ++client->m_framesReceived;
+
+  if(client->m_protocolVersion >= MAPPING_PROTOCOL_WINDOWED)
+  {
+    // If the client is using the windowed protocol, acknowledge the frame (along with any others that have not
+    // yet been acknowledged), and immediately start waiting for the next frame without waiting for the write.
+    begin_write_cumulative_ack(client);
+    begin_read_frame_header(client);
   }
+  else
+  {
+    // Otherwise, send an acknowledgement to the client, and wait for it to be written before reading the next frame.
+    write_message(client, client->m_ackMsg, &MappingServer::write_ack_handler, true);
+  }
+}
+
+void MappingServer::run_io_service()
+{
+  m_ioService.run();
 
 #if DEBUGGING
-  std::cout << "Cleaner thread terminating" << std::endl;
+  std::cout << "I/O thread terminating" << std::endl;
 #endif
 }
 
-void MappingServer::run_server()
+void MappingServer::start_timeout(const Client_Ptr& client)
 {
-  // Spawn a thread to keep the map of clients clean by removing any clients that have terminated.
-  m_cleanerThread.reset(new boost::thread(&MappingServer::run_cleaner, this));
+  // Note: Setting the expiry time cancels any outstanding wait on the timer.
+  client->m_timer->expires_from_now(boost::posix_time::milliseconds(m_timeoutMs));
+  client->m_timer->async_wait(client->m_strand->wrap(boost::bind(&MappingServer::timeout_handler, this, client, _1)));
+}
 
-  // Set up the TCP acceptor and listen for connections.
-  tcp::endpoint endpoint(tcp::v4(), m_port);
-  m_acceptor.reset(new tcp::acceptor(m_ioService, endpoint));
+void MappingServer::stop_timeout(const Client_Ptr& client)
+{
+  client->m_timer->expires_at(boost::posix_time::pos_infin);
+}
 
-  std::cout << "Listening for connections...\n";
+void MappingServer::timeout_handler(const Client_Ptr& client, const boost::system::error_code& err)
+{
+  // If the wait was cancelled (because the timer was restarted or stopped), or we've already finished communicating with the client, early out.
+  if(err == boost::asio::error::operation_aborted || client->m_finished) return;
 
-  while(!m_shouldTerminate)
+  // Otherwise, check whether the deadline has really passed. (The timer may have expired just before being restarted or stopped,
+  // in which case this handler will have been queued without being cancelled, and the deadline will now be in the future.)
+  if(client->m_timer->expires_at() <= boost::asio::deadline_timer::traits_type::now())
   {
-    accept_client();
+    std::cerr << "Warning: Timed out whilst communicating with client " << client->m_id << std::endl;
+
+    // Closing the socket causes the outstanding operation to finish with an error, which will then finish the client.
+    boost::system::error_code ignored;
+    client->m_sock->close(ignored);
   }
+}
 
-#if DEBUGGING
-  std::cout << "Server thread terminating" << std::endl;
-#endif
+void MappingServer::write_ack_handler(const Client_Ptr& client, const boost::system::error_code& err)
+{
+  // If the acknowledgement could not be sent, stop communicating with the client.
+  if(err)
+  {
+    finish_client(client);
+    return;
+  }
+
+  // Once the acknowledgement has been sent, start waiting for the next frame from the client.
+  begin_read_frame_header(client);
+}
+
+void MappingServer::write_calibration_ack_handler(const Client_Ptr& client, const boost::system::error_code& err)
+{
+  // If the acknowledgement could not be sent, stop communicating with the client.
+  if(err)
+  {
+    finish_client(client);
+    return;
+  }
+
+  // Read the next message from the client, which will tell us which version of the protocol it wants to use.
+  // Note: The client is allowed to take as long as it likes to start sending its first frame, so we don't use a timeout here.
+  read_message(client, client->m_negotiationMsg, &MappingServer::read_first_message_handler, false);
 }
 
-void MappingServer::write_message_handler(const boost::system::error_code& err, boost::optional<boost::system::error_code>& ret)
+void MappingServer::write_cumulative_ack_handler(const Client_Ptr& client, const boost::system::error_code& err)
 {
-  // Store any error message so that it can be examined by write_message.
-  ret = err;
+  // If the acknowledgement could not be sent, stop communicating with the client.
+  if(err)
+  {
+    finish_client(client);
+    return;
+  }
+
+  // Acknowledge any frames that have been received whilst the acknowledgement was being written.
+  client->m_ackInProgress = false;
+  begin_write_cumulative_ack(client);
 }
 
 }
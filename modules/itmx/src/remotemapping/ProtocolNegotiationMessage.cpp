@@ -0,0 +1,53 @@
+/**
+ * itmx: ProtocolNegotiationMessage.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include "remotemapping/ProtocolNegotiationMessage.h"
+
+#include <cstring>
+
+namespace itmx {
+
+//#################### CONSTRUCTORS ####################
+
+ProtocolNegotiationMessage::ProtocolNegotiationMessage()
+{
+  m_markerSegment = std::make_pair(0, sizeof(uint32_t));
+  m_protocolVersionSegment = std::make_pair(m_markerSegment.first + m_markerSegment.second, sizeof(uint16_t));
+  m_windowSizeSegment = std::make_pair(m_protocolVersionSegment.first + m_protocolVersionSegment.second, sizeof(uint16_t));
+  m_data.resize(m_windowSizeSegment.first + m_windowSizeSegment.second);
+
+  const uint32_t marker = MARKER;
+  memcpy(&m_data[m_markerSegment.first], reinterpret_cast<const char*>(&marker), m_markerSegment.second);
+}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+MappingProtocolVersion ProtocolNegotiationMessage::extract_protocol_version() const
+{
+  return static_cast<MappingProtocolVersion>(*reinterpret_cast<const uint16_t*>(&m_data[m_protocolVersionSegment.first]));
+}
+
+uint16_t ProtocolNegotiationMessage::extract_window_size() const
+{
+  return *reinterpret_cast<const uint16_t*>(&m_data[m_windowSizeSegment.first]);
+}
+
+bool ProtocolNegotiationMessage::has_valid_marker() const
+{
+  return *reinterpret_cast<const uint32_t*>(&m_data[m_markerSegment.first]) == MARKER;
+}
+
+void ProtocolNegotiationMessage::set_protocol_version(MappingProtocolVersion protocolVersion)
+{
+  const uint16_t version = static_cast<uint16_t>(protocolVersion);
+  memcpy(&m_data[m_protocolVersionSegment.first], reinterpret_cast<const char*>(&version), m_protocolVersionSegment.second);
+}
+
+void ProtocolNegotiationMessage::set_window_size(uint16_t windowSize)
+{
+  memcpy(&m_data[m_windowSizeSegment.first], reinterpret_cast<const char*>(&windowSize), m_windowSizeSegment.second);
+}
+
+}
@@ -4,7 +4,9 @@
  */
 
 #include "remotemapping/RGBDFrameCompressor.h"
+#include "remotemapping/RVLDepthCodec.h"
 
+#include <cstring>
 #include <stdexcept>
 
 #ifdef WITH_OPENCV
@@ -13,39 +15,29 @@
 #include <opencv2/imgproc.hpp>
 #endif
 
-#include "base/MemoryBlockFactory.h"
-
 namespace itmx {
 
 //#################### NESTED TYPES ####################
 
 struct RGBDFrameCompressor::Impl
 {
-  /** A vector containing the results of depth compression. */
-  std::vector<uint8_t> compressedDepthBytes;
-
-  /** A vector containing the results of RGB compression. */
-  std::vector<uint8_t> compressedRgbBytes;
-
   /** The type of compression algorithm to use for the depth images. */
   DepthCompressionType depthCompressionType;
 
+  /** The size of the depth images to be compressed. */
+  Vector2i depthImageSize;
+
   /** The type of compression algorithm to use for the RGB images. */
   RGBCompressionType rgbCompressionType;
 
-  /** An image storing the temporary uncompressed depth data. */
-  ITMShortImage_Ptr uncompressedDepthImage;
+  /** The size of the RGB images to be compressed. */
+  Vector2i rgbImageSize;
 
 #ifdef WITH_OPENCV
-  /** An OpenCV image storing the temporary uncompressed depth data. */
+  /** An OpenCV image storing a depth image that is being compressed, converted to the format needed for PNG compression. */
   cv::Mat uncompressedDepthMat;
-#endif
-
-  /** An image storing the temporary uncompressed RGB data. */
-  ITMUChar4Image_Ptr uncompressedRgbImage;
 
-#ifdef WITH_OPENCV
-  /** An OpenCV image storing the temporary uncompressed RGB data. */
+  /** An OpenCV image storing an RGB image that is being compressed or uncompressed, in the format used by OpenCV's codecs. */
   cv::Mat uncompressedRgbMat;
 #endif
 };
@@ -55,24 +47,11 @@ struct RGBDFrameCompressor::Impl
 RGBDFrameCompressor::RGBDFrameCompressor(const Vector2i& rgbImageSize, const Vector2i& depthImageSize, RGBCompressionType rgbCompressionType, DepthCompressionType depthCompressionType)
 : m_impl(new Impl)
 {
-  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
-
-  m_impl->depthCompressionType = depthCompressionType;
+  m_impl->depthImageSize = depthImageSize;
   m_impl->rgbCompressionType = rgbCompressionType;
-  m_impl->uncompressedDepthImage = mbf.make_image<short>(depthImageSize);
-  m_impl->uncompressedRgbImage = mbf.make_image<Vector4u>(rgbImageSize);
+  m_impl->rgbImageSize = rgbImageSize;
 
-  // If we're using the PNG compression from OpenCV to compress depth images, allocate a temporary OpenCV image accordingly.
-  // The format of this image needs to be CV_16U to properly encode a depth image as PNG. We will use convertTo to fill
-  // this image from an ITMShortImage.
-  if(depthCompressionType == DEPTH_COMPRESSION_PNG)
-  {
-#ifdef WITH_OPENCV
-    m_impl->uncompressedDepthMat.create(depthImageSize.y, depthImageSize.x, CV_16UC1);
-#else
-    throw std::invalid_argument("Error: Cannot compress depth images to PNG format. Reconfigure in CMake with the WITH_OPENCV option set to on.");
-#endif
-  }
+  set_depth_compression_type(depthCompressionType);
 
   // If we're using either the JPG or PNG compression from OpenCV to compress RGB images, allocate a temporary OpenCV image accordingly.
   // The image we allocate will have 3 channels, and we will use cvtColor to fill it.
@@ -88,166 +67,215 @@ RGBDFrameCompressor::RGBDFrameCompressor(const Vector2i& rgbImageSize, const Vec
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
-void RGBDFrameCompressor::compress_rgbd_frame(const RGBDFrameMessage& uncompressedFrame, CompressedRGBDFrameHeaderMessage& compressedHeader, CompressedRGBDFrameMessage& compressedFrame)
-{
-  // First, copy the metadata.
-  compressedFrame.set_frame_index(uncompressedFrame.extract_frame_index());
-  compressedFrame.set_pose(uncompressedFrame.extract_pose());
-
-  // Then, extract the images from the uncompressed message.
-  uncompressedFrame.extract_depth_image(m_impl->uncompressedDepthImage.get());
-  uncompressedFrame.extract_rgb_image(m_impl->uncompressedRgbImage.get());
-
-  // Perform the compression.
-  compress_depth_image();
-  compress_rgb_image();
-
-  // Now, prepare the compressed header.
-  compressedHeader.set_depth_image_size(static_cast<uint32_t>(m_impl->compressedDepthBytes.size()));
-  compressedHeader.set_rgb_image_size(static_cast<uint32_t>(m_impl->compressedRgbBytes.size()));
-
-  // Finally, prepare the compressed frame.
-  compressedFrame.set_compressed_image_sizes(compressedHeader);
-  compressedFrame.set_depth_image_data(m_impl->compressedDepthBytes);
-  compressedFrame.set_rgb_image_data(m_impl->compressedRgbBytes);
-}
-
-void RGBDFrameCompressor::uncompress_rgbd_frame(const CompressedRGBDFrameMessage& compressedFrame, RGBDFrameMessage& uncompressedFrame)
+void RGBDFrameCompressor::compress_depth_image(const RGBDFrameMessage& uncompressedFrame, CompressedRGBDFrameMessage& compressedFrame)
 {
-  // First, copy the metadata.
-  uncompressedFrame.set_frame_index(compressedFrame.extract_frame_index());
-  uncompressedFrame.set_pose(compressedFrame.extract_pose());
-
-  // Then, extract the compressed byte vectors.
-  compressedFrame.extract_depth_image_data(m_impl->compressedDepthBytes);
-  compressedFrame.extract_rgb_image_data(m_impl->compressedRgbBytes);
-
-  // Perform the uncompression.
-  uncompress_depth_image();
-  uncompress_rgb_image();
-
-  // Finally, store the images into the uncompressed message.
-  uncompressedFrame.set_depth_image(m_impl->uncompressedDepthImage);
-  uncompressedFrame.set_rgb_image(m_impl->uncompressedRgbImage);
-}
+  check_image_sizes(uncompressedFrame);
 
-//#################### PRIVATE MEMBER FUNCTIONS ####################
+  std::vector<uint8_t>& compressedDepthData = compressedFrame.get_depth_image_data();
 
-void RGBDFrameCompressor::compress_depth_image()
-{
   if(m_impl->depthCompressionType == DEPTH_COMPRESSION_PNG)
   {
 #ifdef WITH_OPENCV
-    // If we're using PNG compresson, first wrap the InfiniTAM depth image as an OpenCV image.
+    // If we're using PNG compresson, first wrap the depth segment of the message as an OpenCV image (this does not copy the data).
     cv::Mat depthWrapper(
-      m_impl->uncompressedDepthImage->noDims.y,
-      m_impl->uncompressedDepthImage->noDims.x,
+      m_impl->depthImageSize.y,
+      m_impl->depthImageSize.x,
       CV_16SC1,
-      m_impl->uncompressedDepthImage->GetData(MEMORYDEVICE_CPU)
+      const_cast<short*>(uncompressedFrame.get_depth_image_data())
     );
 
     // Then, convert the format to CV_16U (this is necessary to properly encode the image in PNG format).
     depthWrapper.convertTo(m_impl->uncompressedDepthMat, CV_16U);
 
-    // Finally, compress the image, storing the compressed representation in an internal buffer.
-    cv::imencode(".png", m_impl->uncompressedDepthMat, m_impl->compressedDepthBytes);
+    // Finally, compress the image directly into the output buffer.
+    cv::imencode(".png", m_impl->uncompressedDepthMat, compressedDepthData);
 #endif
   }
+  else if(m_impl->depthCompressionType == DEPTH_COMPRESSION_RVL)
+  {
+    // If we're using RVL compression, compress the depth segment of the message directly into the output buffer.
+    RVLDepthCodec::compress(uncompressedFrame.get_depth_image_data(), m_impl->depthImageSize.x * m_impl->depthImageSize.y, compressedDepthData);
+  }
   else
   {
-    // If we're not using PNG compression, simply copy the raw bytes of the image into the internal buffer.
-    m_impl->compressedDepthBytes.resize(m_impl->uncompressedDepthImage->dataSize * sizeof(short));
-    memcpy(m_impl->compressedDepthBytes.data(), m_impl->uncompressedDepthImage->GetData(MEMORYDEVICE_CPU), m_impl->compressedDepthBytes.size());
+    // If we're not using PNG compression, simply copy the raw bytes of the image into the output buffer.
+    const uint8_t *depthBytes = reinterpret_cast<const uint8_t*>(uncompressedFrame.get_depth_image_data());
+    compressedDepthData.assign(depthBytes, depthBytes + m_impl->depthImageSize.x * m_impl->depthImageSize.y * sizeof(short));
   }
 }
 
-void RGBDFrameCompressor::compress_rgb_image()
+void RGBDFrameCompressor::compress_rgb_image(const RGBDFrameMessage& uncompressedFrame, CompressedRGBDFrameMessage& compressedFrame)
 {
+  check_image_sizes(uncompressedFrame);
+
+  std::vector<uint8_t>& compressedRgbData = compressedFrame.get_rgb_image_data();
+
   if(m_impl->rgbCompressionType == RGB_COMPRESSION_NONE)
   {
-    // If we're not using compression, simply copy the raw bytes of the image into an internal buffer.
-    m_impl->compressedRgbBytes.resize(m_impl->uncompressedRgbImage->dataSize * sizeof(Vector4u));
-    memcpy(m_impl->compressedRgbBytes.data(), m_impl->uncompressedRgbImage->GetData(MEMORYDEVICE_CPU), m_impl->compressedRgbBytes.size());
+    // If we're not using compression, simply copy the raw bytes of the image into the output buffer.
+    const uint8_t *rgbBytes = reinterpret_cast<const uint8_t*>(uncompressedFrame.get_rgb_image_data());
+    compressedRgbData.assign(rgbBytes, rgbBytes + m_impl->rgbImageSize.x * m_impl->rgbImageSize.y * sizeof(Vector4u));
   }
   else
   {
 #ifdef WITH_OPENCV
-    // Otherwise, first wrap the InfiniTAM RGB image as an OpenCV image.
+    // Otherwise, first wrap the RGB segment of the message as an OpenCV image (this does not copy the data).
     cv::Mat rgbWrapper(
-      m_impl->uncompressedRgbImage->noDims.y,
-      m_impl->uncompressedRgbImage->noDims.x,
+      m_impl->rgbImageSize.y,
+      m_impl->rgbImageSize.x,
       CV_8UC4,
-      m_impl->uncompressedRgbImage->GetData(MEMORYDEVICE_CPU)
+      const_cast<Vector4u*>(uncompressedFrame.get_rgb_image_data())
     );
 
     // Then, make a copy of this image in which we reorder the colours and drop the alpha channel.
     cv::cvtColor(rgbWrapper, m_impl->uncompressedRgbMat, CV_RGBA2BGR);
 
-    // Finally, compress the image using the appropriate format, storing the compressed representation in the internal buffer.
+    // Finally, compress the image using the appropriate format, directly into the output buffer.
     const std::string outputFormat = m_impl->rgbCompressionType == RGB_COMPRESSION_JPG ? ".jpg" : ".png";
-    cv::imencode(outputFormat, m_impl->uncompressedRgbMat, m_impl->compressedRgbBytes);
+    cv::imencode(outputFormat, m_impl->uncompressedRgbMat, compressedRgbData);
 #endif
   }
 }
 
-void RGBDFrameCompressor::uncompress_depth_image()
+void RGBDFrameCompressor::compress_rgbd_frame(const RGBDFrameMessage& uncompressedFrame, CompressedRGBDFrameHeaderMessage& compressedHeader, CompressedRGBDFrameMessage& compressedFrame)
 {
-  if(m_impl->depthCompressionType == DEPTH_COMPRESSION_PNG)
+  // Compress the images directly into the buffers of the compressed frame, and then copy the metadata and prepare the header.
+  compress_depth_image(uncompressedFrame, compressedFrame);
+  compress_rgb_image(uncompressedFrame, compressedFrame);
+  finish_frame_compression(uncompressedFrame, compressedHeader, compressedFrame);
+}
+
+void RGBDFrameCompressor::finish_frame_compression(const RGBDFrameMessage& uncompressedFrame, CompressedRGBDFrameHeaderMessage& compressedHeader,
+                                                   CompressedRGBDFrameMessage& compressedFrame) const
+{
+  // Copy the metadata.
+  compressedFrame.set_frame_index(uncompressedFrame.extract_frame_index());
+  compressedFrame.set_pose(uncompressedFrame.extract_pose());
+
+  // Prepare the compressed header.
+  compressedHeader.set_depth_image_size(static_cast<uint32_t>(compressedFrame.get_depth_image_data().size()));
+  compressedHeader.set_rgb_image_size(static_cast<uint32_t>(compressedFrame.get_rgb_image_data().size()));
+  if(compressedHeader.has_depth_compression_type()) compressedHeader.set_depth_compression_type(m_impl->depthCompressionType);
+}
+
+void RGBDFrameCompressor::set_depth_compression_type(DepthCompressionType depthCompressionType)
+{
+  switch(depthCompressionType)
   {
+    case DEPTH_COMPRESSION_NONE:
+    case DEPTH_COMPRESSION_RVL:
+      break;
+    case DEPTH_COMPRESSION_PNG:
+    {
+      // If we're using the PNG compression from OpenCV to compress depth images, allocate a temporary OpenCV image accordingly.
+      // The format of this image needs to be CV_16U to properly encode a depth image as PNG. We will use convertTo to fill
+      // this image from the depth segment of an RGB-D frame message.
 #ifdef WITH_OPENCV
-    // If we're using PNG compression, first decode the image into a preallocated internal buffer.
-    m_impl->uncompressedDepthMat = cv::imdecode(m_impl->compressedDepthBytes, cv::IMREAD_ANYDEPTH, &m_impl->uncompressedDepthMat);
+      m_impl->uncompressedDepthMat.create(m_impl->depthImageSize.y, m_impl->depthImageSize.x, CV_16UC1);
+#else
+      throw std::invalid_argument("Error: Cannot compress depth images to PNG format. Reconfigure in CMake with the WITH_OPENCV option set to on.");
+#endif
+      break;
+    }
+    default:
+      throw std::invalid_argument("Error: Unknown depth compression type");
+  }
 
-    // Then, copy the image back into an InfiniTAM image. Note that as part of this process,
-    // we convert the format back from CV_16U (as returned to cv::imdecode) to CV_16S (the
-    // format InfiniTAM is expecting).
-    cv::Mat depthWrapper(
-      m_impl->uncompressedDepthImage->noDims.y,
-      m_impl->uncompressedDepthImage->noDims.x, CV_16SC1,
-      m_impl->uncompressedDepthImage->GetData(MEMORYDEVICE_CPU)
-    );
+  m_impl->depthCompressionType = depthCompressionType;
+}
+
+void RGBDFrameCompressor::uncompress_rgbd_frame(const CompressedRGBDFrameMessage& compressedFrame, RGBDFrameMessage& uncompressedFrame)
+{
+  check_image_sizes(uncompressedFrame);
+
+  // First, copy the metadata.
+  uncompressedFrame.set_frame_index(compressedFrame.extract_frame_index());
+  uncompressedFrame.set_pose(compressedFrame.extract_pose());
 
-    m_impl->uncompressedDepthMat.convertTo(depthWrapper, CV_16S);
+  // Then, uncompress the images directly into the uncompressed frame.
+  uncompress_depth_image(compressedFrame.get_depth_image_data(), uncompressedFrame);
+  uncompress_rgb_image(compressedFrame.get_rgb_image_data(), uncompressedFrame);
+}
+
+//#################### PRIVATE MEMBER FUNCTIONS ####################
+
+void RGBDFrameCompressor::check_image_sizes(const RGBDFrameMessage& uncompressedFrame) const
+{
+  if(uncompressedFrame.get_depth_image_size() != m_impl->depthImageSize || uncompressedFrame.get_rgb_image_size() != m_impl->rgbImageSize)
+  {
+    throw std::invalid_argument("Error: The image sizes of the RGB-D frame message do not match those of the compressor");
+  }
+}
+
+void RGBDFrameCompressor::uncompress_depth_image(const std::vector<uint8_t>& compressedDepthData, RGBDFrameMessage& uncompressedFrame)
+{
+  if(m_impl->depthCompressionType == DEPTH_COMPRESSION_PNG)
+  {
+#ifdef WITH_OPENCV
+    // If we're using PNG compression, wrap the depth segment of the message as a CV_16U OpenCV image, and decode the
+    // image directly into it. Reinterpreting the CV_16U values that cv::imdecode produces as the CV_16S values that
+    // InfiniTAM is expecting is safe, since the compressor never produces values that are out of range for CV_16S
+    // (any negative depths are clamped to zero by the conversion to CV_16U prior to compression).
+    short *depthData = uncompressedFrame.get_depth_image_data();
+    cv::Mat depthWrapper(m_impl->depthImageSize.y, m_impl->depthImageSize.x, CV_16UC1, depthData);
+    cv::imdecode(compressedDepthData, cv::IMREAD_ANYDEPTH, &depthWrapper);
+
+    // If the decoded image did not have the expected size and format, cv::imdecode will have reallocated the
+    // wrapper rather than decoding into the message, so we check for this.
+    if(depthWrapper.data != reinterpret_cast<uchar*>(depthData))
+    {
+      throw std::runtime_error("Depth image size in the compressed message does not match the uncompressed depth image size.");
+    }
 #endif
   }
+  else if(m_impl->depthCompressionType == DEPTH_COMPRESSION_RVL)
+  {
+    // If we're using RVL compression, uncompress the image directly into the depth segment of the message
+    // (the codec checks that the compressed data contains exactly the expected number of pixels).
+    RVLDepthCodec::uncompress(compressedDepthData, uncompressedFrame.get_depth_image_data(), m_impl->depthImageSize.x * m_impl->depthImageSize.y);
+  }
   else
   {
     // Otherwise, first check that the size of the uncompressed image matches that of the compressed data.
-    if(m_impl->uncompressedDepthImage->dataSize * sizeof(short) != m_impl->compressedDepthBytes.size())
+    if(m_impl->depthImageSize.x * m_impl->depthImageSize.y * sizeof(short) != compressedDepthData.size())
     {
       throw std::runtime_error("Depth image size in the compressed message does not match the uncompressed depth image size.");
     }
 
     // If it does, simply copy the bytes across.
-    memcpy(m_impl->uncompressedDepthImage->GetData(MEMORYDEVICE_CPU), m_impl->compressedDepthBytes.data(), m_impl->compressedDepthBytes.size());
+    memcpy(uncompressedFrame.get_depth_image_data(), compressedDepthData.data(), compressedDepthData.size());
   }
 }
 
-void RGBDFrameCompressor::uncompress_rgb_image()
+void RGBDFrameCompressor::uncompress_rgb_image(const std::vector<uint8_t>& compressedRgbData, RGBDFrameMessage& uncompressedFrame)
 {
   if(m_impl->rgbCompressionType == RGB_COMPRESSION_NONE)
   {
     // If we're not using compression, check that the size of the uncompressed image matches that of the compressed data.
-    if(m_impl->uncompressedRgbImage->dataSize * sizeof(Vector4u) != m_impl->compressedRgbBytes.size())
+    if(m_impl->rgbImageSize.x * m_impl->rgbImageSize.y * sizeof(Vector4u) != compressedRgbData.size())
     {
       throw std::runtime_error("RGB image size in the compressed message does not match the uncompressed RGB image size.");
     }
 
     // If it does, simply copy the bytes across.
-    memcpy(m_impl->uncompressedRgbImage->GetData(MEMORYDEVICE_CPU), m_impl->compressedRgbBytes.data(), m_impl->compressedRgbBytes.size());
+    memcpy(uncompressedFrame.get_rgb_image_data(), compressedRgbData.data(), compressedRgbData.size());
   }
   else
   {
 #ifdef WITH_OPENCV
     // Otherwise, first decode the image into a preallocated internal buffer.
-    m_impl->uncompressedRgbMat = cv::imdecode(m_impl->compressedRgbBytes, cv::IMREAD_COLOR, &m_impl->uncompressedRgbMat);
+    cv::imdecode(compressedRgbData, cv::IMREAD_COLOR, &m_impl->uncompressedRgbMat);
+    if(m_impl->uncompressedRgbMat.rows != m_impl->rgbImageSize.y || m_impl->uncompressedRgbMat.cols != m_impl->rgbImageSize.x)
+    {
+      throw std::runtime_error("RGB image size in the compressed message does not match the uncompressed RGB image size.");
+    }
 
-    // Then, copy the image back into an InfiniTAM image. Note that as part of this process,
-    // we reorder the bytes and re-add the alpha channel.
+    // Then, convert the image directly into the RGB segment of the message. Note that as part of this
+    // process, we reorder the bytes and re-add the alpha channel.
     cv::Mat rgbWrapper(
-      m_impl->uncompressedRgbImage->noDims.y,
-      m_impl->uncompressedRgbImage->noDims.x, CV_8UC4,
-      m_impl->uncompressedRgbImage->GetData(MEMORYDEVICE_CPU)
+      m_impl->rgbImageSize.y,
+      m_impl->rgbImageSize.x, CV_8UC4,
+      uncompressedFrame.get_rgb_image_data()
     );
 
     cv::cvtColor(m_impl->uncompressedRgbMat, rgbWrapper, CV_BGR2RGBA);
@@ -52,6 +52,36 @@ void RGBDFrameMessage::extract_rgb_image(ITMUChar4Image *rgbImage) const
   memcpy(reinterpret_cast<char*>(rgbImage->GetData(MEMORYDEVICE_CPU)), &m_data[m_rgbImageSegment.first], m_rgbImageSegment.second);
 }
 
+short *RGBDFrameMessage::get_depth_image_data()
+{
+  return reinterpret_cast<short*>(&m_data[m_depthImageSegment.first]);
+}
+
+const short *RGBDFrameMessage::get_depth_image_data() const
+{
+  return reinterpret_cast<const short*>(&m_data[m_depthImageSegment.first]);
+}
+
+const Vector2i& RGBDFrameMessage::get_depth_image_size() const
+{
+  return m_depthImageSize;
+}
+
+Vector4u *RGBDFrameMessage::get_rgb_image_data()
+{
+  return reinterpret_cast<Vector4u*>(&m_data[m_rgbImageSegment.first]);
+}
+
+const Vector4u *RGBDFrameMessage::get_rgb_image_data() const
+{
+  return reinterpret_cast<const Vector4u*>(&m_data[m_rgbImageSegment.first]);
+}
+
+const Vector2i& RGBDFrameMessage::get_rgb_image_size() const
+{
+  return m_rgbImageSize;
+}
+
 void RGBDFrameMessage::set_depth_image(const ITMShortImage_CPtr& depthImage)
 {
   memcpy(&m_data[m_depthImageSegment.first], reinterpret_cast<const char*>(depthImage->GetData(MEMORYDEVICE_CPU)), m_depthImageSegment.second);
@@ -0,0 +1,189 @@
+/**
+ * itmx: RVLDepthCodec.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include "remotemapping/RVLDepthCodec.h"
+
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+namespace itmx {
+
+//#################### HELPER CLASSES ####################
+
+/**
+ * \brief An instance of this class can be used to write a sequence of variable-length-encoded values to a byte vector.
+ */
+class RVLWriter
+{
+private:
+  std::vector<uint8_t>& m_data;
+  int m_nibblesWritten;
+  uint32_t m_word;
+
+public:
+  explicit RVLWriter(std::vector<uint8_t>& data)
+  : m_data(data), m_nibblesWritten(0), m_word(0)
+  {}
+
+public:
+  void flush()
+  {
+    // Write out any partial word, with its nibbles shifted into the positions they would occupy in a full word.
+    if(m_nibblesWritten != 0)
+    {
+      m_word <<= 4 * (8 - m_nibblesWritten);
+      write_word();
+    }
+  }
+
+  void write(uint32_t value)
+  {
+    // Write the value as a sequence of nibbles, each of which contains 3 bits of the value (least significant first)
+    // and a continuation bit that indicates whether or not any more nibbles follow.
+    do
+    {
+      uint32_t nibble = value & 0x7;
+      value >>= 3;
+      if(value) nibble |= 0x8;
+
+      m_word = (m_word << 4) | nibble;
+      if(++m_nibblesWritten == 8) write_word();
+    }
+    while(value);
+  }
+
+private:
+  void write_word()
+  {
+    const size_t offset = m_data.size();
+    m_data.resize(offset + sizeof(uint32_t));
+    memcpy(&m_data[offset], &m_word, sizeof(uint32_t));
+    m_nibblesWritten = 0;
+    m_word = 0;
+  }
+};
+
+/**
+ * \brief An instance of this class can be used to read a sequence of variable-length-encoded values from a byte vector.
+ */
+class RVLReader
+{
+private:
+  const std::vector<uint8_t>& m_data;
+  int m_nibblesRemaining;
+  size_t m_offset;
+  uint32_t m_word;
+
+public:
+  explicit RVLReader(const std::vector<uint8_t>& data)
+  : m_data(data), m_nibblesRemaining(0), m_offset(0), m_word(0)
+  {}
+
+public:
+  bool is_exhausted() const
+  {
+    return m_offset == m_data.size();
+  }
+
+  uint32_t read()
+  {
+    uint32_t value = 0;
+    for(int shift = 0;; shift += 3)
+    {
+      // A valid value never needs more than 11 nibbles (33 bits).
+      if(shift > 30) throw std::runtime_error("Error: Malformed RVL data (value too long)");
+
+      if(m_nibblesRemaining == 0) read_word();
+
+      const uint32_t nibble = m_word >> 28;
+      m_word <<= 4;
+      --m_nibblesRemaining;
+
+      value |= (nibble & 0x7) << shift;
+      if(!(nibble & 0x8)) return value;
+    }
+  }
+
+private:
+  void read_word()
+  {
+    if(m_offset + sizeof(uint32_t) > m_data.size()) throw std::runtime_error("Error: Malformed RVL data (unexpected end of data)");
+    memcpy(&m_word, &m_data[m_offset], sizeof(uint32_t));
+    m_offset += sizeof(uint32_t);
+    m_nibblesRemaining = 8;
+  }
+};
+
+//#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+
+void RVLDepthCodec::compress(const short *depthData, size_t pixelCount, std::vector<uint8_t>& compressedData)
+{
+  // Note: Clearing the vector keeps its capacity, so this only allocates when an image compresses less well than any seen before.
+  compressedData.clear();
+  RVLWriter writer(compressedData);
+
+  const short *p = depthData, *end = depthData + pixelCount;
+  int previous = 0;
+  while(p != end)
+  {
+    // Encode the length of the run of zero pixels (which may be empty).
+    const short *runStart = p;
+    while(p != end && *p == 0) ++p;
+    writer.write(static_cast<uint32_t>(p - runStart));
+
+    // Encode the length of the subsequent run of non-zero pixels (which may also be empty, at the end of the image).
+    runStart = p;
+    while(p != end && *p != 0) ++p;
+    writer.write(static_cast<uint32_t>(p - runStart));
+
+    // Encode the differences between successive non-zero pixels, mapping them to unsigned values such that
+    // small differences of either sign have small codes (i.e. 0, -1, 1, -2, 2, ... -> 0, 1, 2, 3, 4, ...).
+    for(const short *q = runStart; q != p; ++q)
+    {
+      const int delta = *q - previous;
+      writer.write((static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+      previous = *q;
+    }
+  }
+
+  writer.flush();
+}
+
+void RVLDepthCodec::uncompress(const std::vector<uint8_t>& compressedData, short *depthData, size_t pixelCount)
+{
+  RVLReader reader(compressedData);
+
+  short *p = depthData, *end = depthData + pixelCount;
+  int previous = 0;
+  while(p != end)
+  {
+    // Decode the run of zero pixels.
+    const uint32_t zeros = reader.read();
+    if(zeros > static_cast<size_t>(end - p)) throw std::runtime_error("Error: Malformed RVL data (too many pixels)");
+    memset(p, 0, zeros * sizeof(short));
+    p += zeros;
+
+    // Decode the subsequent run of non-zero pixels.
+    const uint32_t nonZeros = reader.read();
+    if(nonZeros > static_cast<size_t>(end - p)) throw std::runtime_error("Error: Malformed RVL data (too many pixels)");
+    for(short *q = p + nonZeros; p != q; ++p)
+    {
+      const uint32_t positive = reader.read();
+      if(positive > 0x1FFFF) throw std::runtime_error("Error: Malformed RVL data (delta out of range)");
+      const int delta = static_cast<int>(positive >> 1) ^ -static_cast<int>(positive & 1);
+      previous += delta;
+
+      // Reject any value that cannot have come from a depth pixel (note that the deltas alone can legitimately
+      // span twice the range of a short, so it is only the reconstructed value itself that can be checked).
+      if(previous < SHRT_MIN || previous > SHRT_MAX) throw std::runtime_error("Error: Malformed RVL data (depth out of range)");
+      *p = static_cast<short>(previous);
+    }
+  }
+
+  if(!reader.is_exhausted()) throw std::runtime_error("Error: Malformed RVL data (unexpected trailing data)");
+}
+
+}
@@ -0,0 +1,174 @@
+/**
+ * rafl: DescriptorBatch.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2015. All rights reserved.
+ */
+
+#ifndef H_RAFL_DESCRIPTORBATCH
+#define H_RAFL_DESCRIPTORBATCH
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+namespace rafl {
+
+/**
+ * \brief An instance of this class represents a batch of feature descriptors that are stored contiguously as the rows of a float matrix.
+ *
+ * A batch can either own its storage or act as a view onto externally-owned memory (e.g. the feature memory block filled by a
+ * feature calculator), in which case no copying is involved in making the descriptors available to rafl. Owned storage is retained
+ * when a batch is resized to a smaller or equal size, so a batch can be recycled from one frame to the next without reallocating.
+ *
+ * Rows of a batch can be passed directly to functions that accept a pointer to the features of a descriptor, e.g.
+ * DecisionFunction::classify_features or RandomForest::predict.
+ */
+class DescriptorBatch
+{
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** A pointer to the start of the matrix (this points either into m_storage or to externally-owned memory). */
+  const float *m_data;
+
+  /** The number of descriptors (rows) in the batch. */
+  size_t m_descriptorCount;
+
+  /** The number of features in each descriptor (i.e. the number of columns in the matrix). */
+  size_t m_featureCount;
+
+  /** The storage for the matrix, if the batch owns it. */
+  std::vector<float> m_storage;
+
+  /** Whether or not the batch owns its storage. */
+  bool m_ownsData;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs an empty batch that owns its storage.
+   */
+  DescriptorBatch();
+
+  /**
+   * \brief Constructs a batch that owns its storage and has room for the specified number of descriptors.
+   *
+   * The features of the descriptors are initialised to zero.
+   *
+   * \param descriptorCount The number of descriptors in the batch.
+   * \param featureCount    The number of features in each descriptor.
+   */
+  DescriptorBatch(size_t descriptorCount, size_t featureCount);
+
+  /**
+   * \brief Constructs a batch that acts as a view onto externally-owned memory.
+   *
+   * The memory must remain valid (and should not be modified) for as long as the batch is used.
+   *
+   * \param data            A pointer to the externally-owned descriptors, stored contiguously in row-major order.
+   * \param descriptorCount The number of descriptors in the batch.
+   * \param featureCount    The number of features in each descriptor.
+   */
+  DescriptorBatch(const float *data, size_t descriptorCount, size_t featureCount);
+
+  //#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+public:
+  /**
+   * \brief Constructs a copy of a batch.
+   *
+   * If the source batch owns its storage, the copy will have its own copy of the storage. Otherwise, the copy will be a view onto
+   * the same externally-owned memory.
+   *
+   * \param rhs The batch to copy.
+   */
+  DescriptorBatch(const DescriptorBatch& rhs);
+
+  /**
+   * \brief Assigns another batch to this one.
+   *
+   * \param rhs The other batch.
+   * \return    This batch.
+   */
+  DescriptorBatch& operator=(const DescriptorBatch& rhs);
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets the specified descriptor in the batch.
+   *
+   * \param descriptorIndex The index of the descriptor.
+   * \return                A pointer to the features of the descriptor.
+   */
+  const float *get_descriptor(size_t descriptorIndex) const
+  {
+    return m_data + descriptorIndex * m_featureCount;
+  }
+
+  /**
+   * \brief Gets the number of descriptors in the batch.
+   *
+   * \return  The number of descriptors in the batch.
+   */
+  size_t get_descriptor_count() const
+  {
+    return m_descriptorCount;
+  }
+
+  /**
+   * \brief Gets the number of features in each descriptor in the batch.
+   *
+   * \return  The number of features in each descriptor in the batch.
+   */
+  size_t get_feature_count() const
+  {
+    return m_featureCount;
+  }
+
+  /**
+   * \brief Gets the specified descriptor in the batch, so that its features can be written.
+   *
+   * \param descriptorIndex     The index of the descriptor.
+   * \return                    A pointer to the features of the descriptor.
+   * \throws std::runtime_error If the batch does not own its storage.
+   */
+  float *get_writable_descriptor(size_t descriptorIndex);
+
+  /**
+   * \brief Gets whether or not the batch owns its storage.
+   *
+   * \return  true, if the batch owns its storage, or false if it is a view onto externally-owned memory.
+   */
+  bool owns_data() const
+  {
+    return m_ownsData;
+  }
+
+  /**
+   * \brief Resizes the batch so that it owns storage for the specified number of descriptors.
+   *
+   * Any existing storage is reused if it is large enough. Note that the existing features are not preserved
+   * (in particular, if the batch was previously a view, its new storage is not initialised from the view).
+   *
+   * \param descriptorCount The new number of descriptors in the batch.
+   * \param featureCount    The new number of features in each descriptor.
+   */
+  void resize(size_t descriptorCount, size_t featureCount);
+
+  /**
+   * \brief Makes the batch act as a view onto externally-owned memory.
+   *
+   * Any storage owned by the batch is retained for later reuse.
+   *
+   * \param data            A pointer to the externally-owned descriptors, stored contiguously in row-major order.
+   * \param descriptorCount The number of descriptors in the batch.
+   * \param featureCount    The number of features in each descriptor.
+   */
+  void wrap(const float *data, size_t descriptorCount, size_t featureCount);
+};
+
+//#################### TYPEDEFS ####################
+
+typedef boost::shared_ptr<DescriptorBatch> DescriptorBatch_Ptr;
+typedef boost::shared_ptr<const DescriptorBatch> DescriptorBatch_CPtr;
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * rafl: BatchPredictions.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2015. All rights reserved.
+ */
+
+#ifndef H_RAFL_BATCHPREDICTIONS
+#define H_RAFL_BATCHPREDICTIONS
+
+#include <cstddef>
+#include <vector>
+
+namespace rafl {
+
+//#################### FORWARD DECLARATIONS ####################
+
+template <typename Label> class CompiledRandomForest;
+
+/**
+ * \brief An instance of an instantiation of this class template holds the predictions made by a random forest for a batch of descriptors.
+ *
+ * For each descriptor, this stores both the predicted label and a dense PMF, i.e. a row of masses with one column for each label
+ * that occurs in any leaf of the forest. The columns are ordered by label (see get_labels). A single instance can (and should) be
+ * reused from one batch to the next: its storage is only reallocated if a batch needs more of it than any previous batch.
+ */
+template <typename Label>
+class BatchPredictions
+{
+  //#################### FRIENDS ####################
+
+  friend class CompiledRandomForest<Label>;
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The number of descriptors for which predictions have been made. */
+  size_t m_descriptorCount;
+
+  /** The labels corresponding to the columns of the mass matrix, in ascending order. */
+  std::vector<Label> m_labels;
+
+  /** The PMFs for the descriptors, stored as the rows of a descriptorCount x labelCount matrix. */
+  std::vector<float> m_masses;
+
+  /** The labels predicted for the descriptors. */
+  std::vector<Label> m_predictedLabels;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs an empty set of batch predictions.
+   */
+  BatchPredictions()
+  : m_descriptorCount(0)
+  {}
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets the number of descriptors for which predictions have been made.
+   *
+   * \return  The number of descriptors for which predictions have been made.
+   */
+  size_t get_descriptor_count() const
+  {
+    return m_descriptorCount;
+  }
+
+  /**
+   * \brief Gets the number of labels (i.e. the number of columns in each dense PMF).
+   *
+   * \return  The number of labels.
+   */
+  size_t get_label_count() const
+  {
+    return m_labels.size();
+  }
+
+  /**
+   * \brief Gets the labels corresponding to the columns of the dense PMFs.
+   *
+   * \return  The labels corresponding to the columns of the dense PMFs, in ascending order.
+   */
+  const std::vector<Label>& get_labels() const
+  {
+    return m_labels;
+  }
+
+  /**
+   * \brief Gets the dense PMF for the specified descriptor.
+   *
+   * \param descriptorIndex The index of the descriptor.
+   * \return                A pointer to the masses for the descriptor (one for each label in get_labels(), in the same order),
+   *                        or NULL if there are no labels (e.g. if the forest has not yet seen any examples).
+   */
+  const float *get_masses(size_t descriptorIndex) const
+  {
+    return m_labels.empty() ? NULL : &m_masses[descriptorIndex * m_labels.size()];
+  }
+
+  /**
+   * \brief Gets the label predicted for the specified descriptor.
+   *
+   * \param descriptorIndex The index of the descriptor.
+   * \return                The label predicted for the descriptor.
+   */
+  Label get_predicted_label(size_t descriptorIndex) const
+  {
+    return m_predictedLabels[descriptorIndex];
+  }
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Prepares the predictions to be filled in for a new batch of descriptors.
+   *
+   * All of the masses are set to zero. Existing storage is reused wherever possible.
+   *
+   * \param descriptorCount The number of descriptors in the new batch.
+   * \param labels          The labels corresponding to the columns of the dense PMFs.
+   */
+  void reset(size_t descriptorCount, const std::vector<Label>& labels)
+  {
+    m_descriptorCount = descriptorCount;
+    m_labels = labels;
+    m_masses.assign(descriptorCount * labels.size(), 0.0f);
+    m_predictedLabels.resize(descriptorCount);
+  }
+};
+
+}
+
+#endif
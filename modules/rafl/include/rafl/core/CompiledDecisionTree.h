@@ -0,0 +1,570 @@
+/**
+ * rafl: CompiledDecisionTree.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2015. All rights reserved.
+ */
+
+#ifndef H_RAFL_COMPILEDDECISIONTREE
+#define H_RAFL_COMPILEDDECISIONTREE
+
+#include <algorithm>
+#include <deque>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_pod.hpp>
+
+#include "DecisionTree.h"
+
+namespace rafl {
+
+/**
+ * \brief An instance of an instantiation of this class template represents an immutable, compiled snapshot of a decision tree
+ *        that is suitable for fast prediction.
+ *
+ * The nodes of the tree are stored as a structure of arrays in breadth-first order, such that the two children of each
+ * split node are adjacent in memory. The decision functions of the nodes are stored in flat form wherever possible, so
+ * that walking the tree does not normally involve either chasing pointers through the heap or making virtual calls.
+ * The leaf PMFs are stored contiguously in a pair of label and mass arrays.
+ *
+ * A compiled tree does not track any subsequent changes to the tree from which it was made, and so must be recompiled
+ * whenever the original tree is trained further.
+ *
+ * A compiled tree can also be written to a stream in a flat binary form, and subsequently used directly from memory that
+ * contains such data (e.g. a memory-mapped file), without any deserialisation. The flat form consists of a header of four
+ * 32-bit integers (the node count, the leaf count, the total number of leaf PMF entries, and a reserved zero), followed by
+ * the node and leaf arrays in the order in which they are declared below, each padded to a multiple of FLAT_ALIGNMENT bytes.
+ * Only trees whose decision functions all have flat forms can be written in this way.
+ */
+template <typename Label>
+class CompiledDecisionTree : private boost::noncopyable
+{
+  //#################### ENUMERATIONS ####################
+private:
+  /**
+   * \brief An enumeration specifying the different kinds of test that can be performed at a split node.
+   *
+   * Note that the values for the flat operations deliberately match those in DecisionFunction::FlatForm::Op.
+   */
+  enum NodeOp
+  {
+    /** Compare the first feature to the threshold. */
+    NO_FIRST = DecisionFunction::FlatForm::FO_FIRST,
+
+    /** Compare the sum of the two features to the threshold. */
+    NO_ADD = DecisionFunction::FlatForm::FO_ADD,
+
+    /** Compare the difference of the two features to the threshold. */
+    NO_SUBTRACT = DecisionFunction::FlatForm::FO_SUBTRACT,
+
+    /** Classify the descriptor using the node's original decision function (via a virtual call). */
+    NO_GENERIC
+  };
+
+  //#################### CONSTANTS ####################
+public:
+  /** The alignment (in bytes) of the arrays in the flat form of a compiled tree. */
+  static const size_t FLAT_ALIGNMENT = 8;
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /**
+   * The child indices for the nodes. For a split node, this is the index of the node's left child (its right child is the next node along).
+   * For a leaf, this is the bitwise complement of the index of the leaf in the leaf arrays (and is thus negative).
+   */
+  const int *m_childIndices;
+
+  /** The indices of the first features tested by the split nodes (or the indices of the generic decision functions for NO_GENERIC nodes). */
+  const int *m_firstFeatureIndices;
+
+  /** The indices of the second features tested by the split nodes (only meaningful for NO_ADD and NO_SUBTRACT nodes). */
+  const int *m_secondFeatureIndices;
+
+  /** The thresholds used by the split nodes. */
+  const float *m_thresholds;
+
+  /** The kinds of test performed at the split nodes (see NodeOp). */
+  const unsigned char *m_ops;
+
+  /** The offsets of the leaf PMFs in the leaf label and mass arrays. */
+  const int *m_leafOffsets;
+
+  /** The labels in the leaf PMFs (the entries for leaf i are in the range [m_leafOffsets[i], m_leafOffsets[i+1])). */
+  const Label *m_leafLabels;
+
+  /** The masses in the leaf PMFs (indexed in the same way as the labels). */
+  const float *m_leafMasses;
+
+  /** The external memory (if any) containing the tree's arrays, which must be kept alive for as long as the tree exists. */
+  boost::shared_ptr<const void> m_externalStorage;
+
+  /** The minimum number of features that a descriptor must have for the flat split nodes of the tree to be able to test it. */
+  int m_featureCount;
+
+  /** Any decision functions that could not be flattened and must be evaluated using a virtual call. */
+  std::vector<DecisionFunction_Ptr> m_genericSplitters;
+
+  /** The number of leaves in the tree. */
+  int m_leafCount;
+
+  /** The total number of entries in the leaf PMFs. */
+  int m_leafEntryCount;
+
+  /** The number of nodes in the tree. */
+  int m_nodeCount;
+
+  /** The storage for the arrays of a tree that was compiled in memory (these are empty for a tree that views external memory). */
+  std::vector<int> m_ownedChildIndices, m_ownedFirstFeatureIndices, m_ownedLeafOffsets, m_ownedSecondFeatureIndices;
+  std::vector<Label> m_ownedLeafLabels;
+  std::vector<float> m_ownedLeafMasses, m_ownedThresholds;
+  std::vector<unsigned char> m_ownedOps;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Compiles the specified decision tree.
+   *
+   * \param tree  The decision tree to compile.
+   */
+  explicit CompiledDecisionTree(const DecisionTree<Label>& tree)
+  {
+    // Walk the original tree in breadth-first order, assigning compiled indices to the nodes as we go. Since the children
+    // of a split node are always enqueued together, they always end up adjacent in the compiled arrays.
+    std::deque<int> originalIndices;
+    originalIndices.push_back(tree.m_rootIndex);
+    int nextIndex = 1;
+
+    m_ownedLeafOffsets.push_back(0);
+    while(!originalIndices.empty())
+    {
+      int originalIndex = originalIndices.front();
+      originalIndices.pop_front();
+
+      const typename DecisionTree<Label>::Node& n = *tree.m_nodes[originalIndex];
+      if(tree.is_leaf(originalIndex))
+      {
+        int leafIndex = static_cast<int>(m_ownedLeafOffsets.size()) - 1;
+        add_leaf_pmf(tree, originalIndex);
+        add_node(~leafIndex, NO_GENERIC, -1, -1, 0.0f);
+      }
+      else
+      {
+        boost::optional<DecisionFunction::FlatForm> flatForm = n.m_splitter->to_flat_form();
+        if(flatForm)
+        {
+          add_node(nextIndex, static_cast<NodeOp>(flatForm->m_op), flatForm->m_firstFeatureIndex, flatForm->m_secondFeatureIndex, flatForm->m_threshold);
+        }
+        else
+        {
+          add_node(nextIndex, NO_GENERIC, static_cast<int>(m_genericSplitters.size()), -1, 0.0f);
+          m_genericSplitters.push_back(n.m_splitter);
+        }
+
+        originalIndices.push_back(n.m_leftChildIndex);
+        originalIndices.push_back(n.m_rightChildIndex);
+        nextIndex += 2;
+      }
+    }
+
+    // Point the array pointers at the owned storage.
+    m_childIndices = &m_ownedChildIndices[0];
+    m_firstFeatureIndices = &m_ownedFirstFeatureIndices[0];
+    m_secondFeatureIndices = &m_ownedSecondFeatureIndices[0];
+    m_thresholds = &m_ownedThresholds[0];
+    m_ops = &m_ownedOps[0];
+    m_leafOffsets = &m_ownedLeafOffsets[0];
+    m_leafLabels = m_ownedLeafLabels.empty() ? NULL : &m_ownedLeafLabels[0];
+    m_leafMasses = m_ownedLeafMasses.empty() ? NULL : &m_ownedLeafMasses[0];
+
+    m_leafCount = static_cast<int>(m_ownedLeafOffsets.size()) - 1;
+    m_leafEntryCount = static_cast<int>(m_ownedLeafLabels.size());
+    m_nodeCount = static_cast<int>(m_ownedChildIndices.size());
+    m_featureCount = calculate_feature_count();
+  }
+
+  /**
+   * \brief Constructs a compiled decision tree that views a tree in flat form in external memory (e.g. a memory-mapped file).
+   *
+   * The data are validated before use, so that a corrupt or truncated file cannot cause out-of-bounds accesses to the tree's
+   * arrays during prediction. The feature indices used by the split nodes cannot be bounded by the file itself, so callers
+   * must also ensure that any descriptor they pass in has at least get_feature_count() features (CompiledRandomForest
+   * checks this for the descriptors passed to its descriptor-based functions).
+   *
+   * \param data                The start of the flat form of the tree (must be aligned to a FLAT_ALIGNMENT-byte boundary).
+   * \param size                The number of bytes available from the start of the tree's data.
+   * \param storage             The object that owns the external memory (this will be kept alive for as long as the tree exists).
+   * \throws std::runtime_error If the data do not contain a valid tree in flat form.
+   */
+  CompiledDecisionTree(const char *data, size_t size, const boost::shared_ptr<const void>& storage)
+  : m_externalStorage(storage)
+  {
+    BOOST_STATIC_ASSERT(boost::is_pod<Label>::value && sizeof(int) == 4 && sizeof(float) == 4);
+
+    const char *cur = data, *end = data + size;
+    const int *header = read_array<int>(cur, end, 4);
+    m_nodeCount = header[0];
+    m_leafCount = header[1];
+    m_leafEntryCount = header[2];
+    if(m_nodeCount <= 0 || m_leafCount <= 0 || m_leafEntryCount < 0) throw std::runtime_error("Error: Bad compiled tree header");
+
+    m_childIndices = read_array<int>(cur, end, m_nodeCount);
+    m_firstFeatureIndices = read_array<int>(cur, end, m_nodeCount);
+    m_secondFeatureIndices = read_array<int>(cur, end, m_nodeCount);
+    m_thresholds = read_array<float>(cur, end, m_nodeCount);
+    m_ops = read_array<unsigned char>(cur, end, m_nodeCount);
+    m_leafOffsets = read_array<int>(cur, end, m_leafCount + 1);
+    m_leafLabels = read_array<Label>(cur, end, m_leafEntryCount);
+    m_leafMasses = read_array<float>(cur, end, m_leafEntryCount);
+
+    validate();
+    m_featureCount = calculate_feature_count();
+  }
+
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Rounds the specified number of bytes up to a multiple of FLAT_ALIGNMENT.
+   *
+   * \param size  The number of bytes.
+   * \return      The padded number of bytes.
+   */
+  static size_t pad(size_t size)
+  {
+    return (size + FLAT_ALIGNMENT - 1) / FLAT_ALIGNMENT * FLAT_ALIGNMENT;
+  }
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Adds the probability masses of the leaf to which an example with the specified descriptor would be added to a label -> mass map.
+   *
+   * \param features            A pointer to the features of the descriptor.
+   * \param masses              The label -> mass map to which to add the masses.
+   * \throws std::runtime_error If the relevant leaf has not seen any examples.
+   */
+  void accumulate_masses(const float *features, typename tvgutil::ProbabilityMassFunction<Label>::Masses& masses) const
+  {
+    int leafIndex = find_leaf(features);
+    int begin = m_leafOffsets[leafIndex], end = m_leafOffsets[leafIndex + 1];
+    if(begin == end) throw std::runtime_error("Cannot make a probability mass function from an empty histogram");
+
+    for(int i = begin; i < end; ++i)
+    {
+      masses[m_leafLabels[i]] += m_leafMasses[i];
+    }
+  }
+
+  /**
+   * \brief Adds the probability masses of the leaf to which an example with the specified descriptor would be added to a dense row of masses.
+   *
+   * \param features    A pointer to the features of the descriptor.
+   * \param leafColumns The columns in the row that correspond to the labels of the entries in the leaf arrays (see get_leaf_entry_label).
+   * \param masses      The row of masses to which to add the masses.
+   * \return            true, if the relevant leaf has seen some examples, or false otherwise (in which case no masses are added).
+   */
+  bool accumulate_masses(const float *features, const int *leafColumns, float *masses) const
+  {
+    int leafIndex = find_leaf(features);
+    int begin = m_leafOffsets[leafIndex], end = m_leafOffsets[leafIndex + 1];
+    for(int i = begin; i < end; ++i)
+    {
+      masses[leafColumns[i]] += m_leafMasses[i];
+    }
+    return begin != end;
+  }
+
+  /**
+   * \brief Gets the minimum number of features that a descriptor must have for the tree to be able to test it.
+   *
+   * \return  The minimum number of features that a descriptor must have for the tree to be able to test it.
+   */
+  size_t get_feature_count() const
+  {
+    return static_cast<size_t>(m_featureCount);
+  }
+
+  /**
+   * \brief Gets the number of bytes that the tree will occupy when written in flat form.
+   *
+   * \return  The number of bytes that the tree will occupy when written in flat form.
+   */
+  size_t get_flat_size() const
+  {
+    return pad(4 * sizeof(int))
+         + 3 * pad(m_nodeCount * sizeof(int)) + pad(m_nodeCount * sizeof(float)) + pad(m_nodeCount)
+         + pad((m_leafCount + 1) * sizeof(int)) + pad(m_leafEntryCount * sizeof(Label)) + pad(m_leafEntryCount * sizeof(float));
+  }
+
+  /**
+   * \brief Gets the number of leaves in the compiled tree.
+   *
+   * \return  The number of leaves in the compiled tree.
+   */
+  size_t get_leaf_count() const
+  {
+    return static_cast<size_t>(m_leafCount);
+  }
+
+  /**
+   * \brief Gets the total number of entries in the PMFs of the leaves of the compiled tree.
+   *
+   * \return  The total number of entries in the PMFs of the leaves of the compiled tree.
+   */
+  size_t get_leaf_entry_count() const
+  {
+    return static_cast<size_t>(m_leafEntryCount);
+  }
+
+  /**
+   * \brief Gets the label of the specified entry in the PMFs of the leaves of the compiled tree.
+   *
+   * \param entryIndex  The index of the entry (in the range [0,get_leaf_entry_count())).
+   * \return            The label of the entry.
+   */
+  Label get_leaf_entry_label(size_t entryIndex) const
+  {
+    return m_leafLabels[entryIndex];
+  }
+
+  /**
+   * \brief Gets the number of nodes in the compiled tree.
+   *
+   * \return  The number of nodes in the compiled tree.
+   */
+  size_t get_node_count() const
+  {
+    return static_cast<size_t>(m_nodeCount);
+  }
+
+  /**
+   * \brief Looks up the probability mass function for the leaf to which an example with the specified descriptor would be added.
+   *
+   * \param features            A pointer to the features of the descriptor.
+   * \return                    The probability mass function for the leaf to which an example with that descriptor would be added.
+   * \throws std::runtime_error If the relevant leaf has not seen any examples.
+   */
+  tvgutil::ProbabilityMassFunction<Label> lookup_pmf(const float *features) const
+  {
+    typename tvgutil::ProbabilityMassFunction<Label>::Masses masses;
+    accumulate_masses(features, masses);
+    return tvgutil::ProbabilityMassFunction<Label>(masses);
+  }
+
+  /**
+   * \brief Writes the tree to a binary stream in flat form.
+   *
+   * \param os                  The stream.
+   * \throws std::runtime_error If the tree contains any decision functions that have no flat form.
+   */
+  void write(std::ostream& os) const
+  {
+    BOOST_STATIC_ASSERT(boost::is_pod<Label>::value && sizeof(int) == 4 && sizeof(float) == 4);
+
+    if(!m_genericSplitters.empty()) throw std::runtime_error("Error: Cannot write a compiled tree whose decision functions do not all have flat forms");
+
+    const int header[] = { m_nodeCount, m_leafCount, m_leafEntryCount, 0 };
+    write_array(os, header, 4);
+    write_array(os, m_childIndices, m_nodeCount);
+    write_array(os, m_firstFeatureIndices, m_nodeCount);
+    write_array(os, m_secondFeatureIndices, m_nodeCount);
+    write_array(os, m_thresholds, m_nodeCount);
+    write_array(os, m_ops, m_nodeCount);
+    write_array(os, m_leafOffsets, m_leafCount + 1);
+    write_array(os, m_leafLabels, m_leafEntryCount);
+    write_array(os, m_leafMasses, m_leafEntryCount);
+  }
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Appends the PMF of the specified leaf in the original tree to the leaf arrays.
+   *
+   * Leaves that have not yet seen any examples are given an empty range in the leaf arrays.
+   *
+   * \param tree          The original tree.
+   * \param originalIndex The index of the leaf in the original tree.
+   */
+  void add_leaf_pmf(const DecisionTree<Label>& tree, int originalIndex)
+  {
+    if(!tree.m_nodes[originalIndex]->m_reservoir.get_histogram()->empty())
+    {
+      tvgutil::ProbabilityMassFunction<Label> pmf = tree.make_pmf(originalIndex);
+      const typename tvgutil::ProbabilityMassFunction<Label>::Masses& masses = pmf.get_masses();
+      for(typename tvgutil::ProbabilityMassFunction<Label>::Masses::const_iterator it = masses.begin(), iend = masses.end(); it != iend; ++it)
+      {
+        m_ownedLeafLabels.push_back(it->first);
+        m_ownedLeafMasses.push_back(it->second);
+      }
+    }
+
+    m_ownedLeafOffsets.push_back(static_cast<int>(m_ownedLeafLabels.size()));
+  }
+
+  /**
+   * \brief Appends a node to the compiled tree.
+   *
+   * \param childIndex          The child index for the node (see m_childIndices).
+   * \param op                  The kind of test performed at the node.
+   * \param firstFeatureIndex   The index of the first feature tested by the node (or the index of its generic decision function).
+   * \param secondFeatureIndex  The index of the second feature tested by the node.
+   * \param threshold           The threshold used by the node.
+   */
+  void add_node(int childIndex, NodeOp op, int firstFeatureIndex, int secondFeatureIndex, float threshold)
+  {
+    m_ownedChildIndices.push_back(childIndex);
+    m_ownedFirstFeatureIndices.push_back(firstFeatureIndex);
+    m_ownedOps.push_back(static_cast<unsigned char>(op));
+    m_ownedSecondFeatureIndices.push_back(secondFeatureIndex);
+    m_ownedThresholds.push_back(threshold);
+  }
+
+  /**
+   * \brief Calculates the minimum number of features that a descriptor must have for the flat split nodes of the tree to be able to test it.
+   *
+   * \return  One more than the largest feature index tested by a flat split node (or 0, if there are no such nodes).
+   */
+  int calculate_feature_count() const
+  {
+    int featureCount = 0;
+    for(int i = 0; i < m_nodeCount; ++i)
+    {
+      if(m_childIndices[i] < 0) continue;
+      switch(m_ops[i])
+      {
+        case NO_ADD:
+        case NO_SUBTRACT:
+          featureCount = std::max(featureCount, m_secondFeatureIndices[i] + 1);
+          // Deliberately fall through, since these ops also test the first feature.
+        case NO_FIRST:
+          featureCount = std::max(featureCount, m_firstFeatureIndices[i] + 1);
+          break;
+        default:
+          // Generic nodes test the descriptor using their original decision functions.
+          break;
+      }
+    }
+    return featureCount;
+  }
+
+  /**
+   * \brief Finds the index of the leaf to which an example with the specified descriptor would be added.
+   *
+   * \param features  A pointer to the features of the descriptor.
+   * \return          The index of the leaf in the leaf arrays.
+   */
+  int find_leaf(const float *features) const
+  {
+    int curIndex = 0;
+    int childIndex;
+    while((childIndex = m_childIndices[curIndex]) >= 0)
+    {
+      // Note: The right child immediately follows the left child, so we can select it without branching on the outcome of the test.
+      curIndex = childIndex + (test_goes_right(curIndex, features) ? 1 : 0);
+    }
+    return ~childIndex;
+  }
+
+  /**
+   * \brief Determines whether a descriptor should be sent down the right subtree of the specified split node.
+   *
+   * \param nodeIndex The index of the split node.
+   * \param features  A pointer to the features of the descriptor.
+   * \return          true, if the descriptor should be sent right, or false otherwise.
+   */
+  bool test_goes_right(int nodeIndex, const float *features) const
+  {
+    float value;
+    switch(m_ops[nodeIndex])
+    {
+      case NO_FIRST:
+        value = features[m_firstFeatureIndices[nodeIndex]];
+        break;
+      case NO_ADD:
+        value = features[m_firstFeatureIndices[nodeIndex]] + features[m_secondFeatureIndices[nodeIndex]];
+        break;
+      case NO_SUBTRACT:
+        value = features[m_firstFeatureIndices[nodeIndex]] - features[m_secondFeatureIndices[nodeIndex]];
+        break;
+      default:
+        return m_genericSplitters[m_firstFeatureIndices[nodeIndex]]->classify_features(features) == DecisionFunction::DC_RIGHT;
+    }
+
+    // Note: This must match the "value < threshold => left" convention used by the original decision functions.
+    return !(value < m_thresholds[nodeIndex]);
+  }
+
+  /**
+   * \brief Checks that the arrays of a tree viewed from external memory describe a valid tree.
+   *
+   * In particular, this checks that every walk from the root terminates at a valid leaf, and that every leaf PMF is in range.
+   *
+   * \throws std::runtime_error If the arrays do not describe a valid tree.
+   */
+  void validate() const
+  {
+    for(int i = 0; i < m_nodeCount; ++i)
+    {
+      int childIndex = m_childIndices[i];
+      if(childIndex >= 0)
+      {
+        // Children must come after their parents (which guarantees termination), and flat trees cannot contain generic nodes.
+        bool validChildren = childIndex > i && childIndex + 1 < m_nodeCount;
+        bool validOp = m_ops[i] == NO_FIRST || m_ops[i] == NO_ADD || m_ops[i] == NO_SUBTRACT;
+        bool validFeatures = m_firstFeatureIndices[i] >= 0 && (m_ops[i] == NO_FIRST || m_secondFeatureIndices[i] >= 0);
+        if(!validChildren || !validOp || !validFeatures) throw std::runtime_error("Error: Bad split node in compiled tree");
+      }
+      else if(~childIndex >= m_leafCount) throw std::runtime_error("Error: Bad leaf index in compiled tree");
+    }
+
+    if(m_leafOffsets[0] != 0 || m_leafOffsets[m_leafCount] != m_leafEntryCount) throw std::runtime_error("Error: Bad leaf offsets in compiled tree");
+    for(int i = 0; i < m_leafCount; ++i)
+    {
+      if(m_leafOffsets[i] > m_leafOffsets[i + 1]) throw std::runtime_error("Error: Bad leaf offsets in compiled tree");
+    }
+  }
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Gets a pointer to an array of the specified type in some flat data, and advances past it.
+   *
+   * \param cur                 A pointer to the start of the array (this will be advanced past the array and its padding).
+   * \param end                 A pointer to the end of the flat data.
+   * \param count               The number of elements in the array.
+   * \return                    A pointer to the array.
+   * \throws std::runtime_error If the array extends beyond the end of the data, or is incorrectly aligned.
+   */
+  template <typename T>
+  static const T *read_array(const char *& cur, const char *end, int count)
+  {
+    size_t paddedSize = pad(count * sizeof(T));
+    if(reinterpret_cast<size_t>(cur) % FLAT_ALIGNMENT != 0) throw std::runtime_error("Error: Misaligned compiled tree data");
+    if(static_cast<size_t>(end - cur) < paddedSize) throw std::runtime_error("Error: Truncated compiled tree data");
+
+    const T *result = reinterpret_cast<const T*>(cur);
+    cur += paddedSize;
+    return result;
+  }
+
+  /**
+   * \brief Writes an array of the specified type to a binary stream, followed by enough zero bytes to pad it to a multiple of FLAT_ALIGNMENT.
+   *
+   * \param os    The stream.
+   * \param arr   The array.
+   * \param count The number of elements in the array.
+   */
+  template <typename T>
+  static void write_array(std::ostream& os, const T *arr, int count)
+  {
+    const char zeros[FLAT_ALIGNMENT] = {0};
+    size_t size = count * sizeof(T);
+    if(size > 0) os.write(reinterpret_cast<const char*>(arr), size);
+    os.write(zeros, pad(size) - size);
+  }
+};
+
+}
+
+#endif
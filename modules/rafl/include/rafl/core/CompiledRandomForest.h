@@ -0,0 +1,424 @@
+/**
+ * rafl: CompiledRandomForest.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2015. All rights reserved.
+ */
+
+#ifndef H_RAFL_COMPILEDRANDOMFOREST
+#define H_RAFL_COMPILEDRANDOMFOREST
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "BatchPredictions.h"
+#include "CompiledDecisionTree.h"
+#include "../base/DescriptorBatch.h"
+
+namespace rafl {
+
+/**
+ * \brief An instance of an instantiation of this class template represents an immutable, compiled random forest that is suitable for fast prediction.
+ *
+ * A compiled forest can either be made from the trees of an ordinary forest, or loaded from a file in a flat binary format.
+ * Loading is designed to be cheap: by default, the file is memory-mapped read-only and the trees are used in place, so the
+ * cost of loading is bounded by the cost of (lazily) reading the file rather than by the cost of deserialising it.
+ *
+ * The file format (version 1) is as follows (all values are in the native byte order of the machine that wrote the file):
+ *
+ * - An 8-byte magic string ("RAFLFLAT").
+ * - Four 32-bit unsigned integers: the format version, a byte-order mark (0x01020304), sizeof(Label) and the tree count.
+ * - For each tree, a 64-bit unsigned integer specifying the size (in bytes) of the tree's data.
+ * - The flat form of each tree in turn (see CompiledDecisionTree).
+ *
+ * Only forests whose decision functions all have flat forms can be saved in this format.
+ */
+template <typename Label>
+class CompiledRandomForest : private boost::noncopyable
+{
+  //#################### TYPEDEFS ####################
+private:
+  typedef CompiledDecisionTree<Label> CompiledDT;
+  typedef boost::shared_ptr<const CompiledDT> CompiledDT_CPtr;
+  typedef boost::shared_ptr<DecisionTree<Label> > DT_Ptr;
+
+  //#################### CONSTANTS ####################
+public:
+  /** The version of the file format that is written by save() and understood by load(). */
+  static const boost::uint32_t FORMAT_VERSION = 1;
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The minimum number of features that a descriptor must have for all of the trees in the forest to be able to test it. */
+  size_t m_featureCount;
+
+  /** The labels that occur in the leaves of the forest, in ascending order (these correspond to the columns of the dense PMFs used for batch prediction). */
+  std::vector<Label> m_labels;
+
+  /** For each tree, the columns of the dense PMFs that correspond to the labels of the entries in the tree's leaf arrays. */
+  std::vector<std::vector<int> > m_leafColumns;
+
+  /** The compiled trees that collectively make up the forest. */
+  std::vector<CompiledDT_CPtr> m_trees;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Compiles the specified decision trees into a forest.
+   *
+   * \param trees The decision trees to compile.
+   */
+  explicit CompiledRandomForest(const std::vector<DT_Ptr>& trees)
+  {
+    m_trees.reserve(trees.size());
+    for(typename std::vector<DT_Ptr>::const_iterator it = trees.begin(), iend = trees.end(); it != iend; ++it)
+    {
+      m_trees.push_back(CompiledDT_CPtr(new CompiledDT(**it)));
+    }
+
+    index_labels();
+    calculate_feature_count();
+  }
+
+private:
+  /**
+   * \brief Constructs a compiled forest from the flat form of a forest in external memory.
+   *
+   * \param data                The start of the flat form of the forest (must be aligned to a CompiledDT::FLAT_ALIGNMENT-byte boundary).
+   * \param size                The number of bytes in the flat form of the forest.
+   * \param storage             The object that owns the external memory (this will be kept alive for as long as any of the trees exists).
+   * \throws std::runtime_error If the data do not contain a valid forest in flat form.
+   */
+  CompiledRandomForest(const char *data, size_t size, const boost::shared_ptr<const void>& storage)
+  {
+    // Check the header.
+    const size_t headerSize = 8 + 4 * sizeof(boost::uint32_t);
+    if(size < headerSize || memcmp(data, "RAFLFLAT", 8) != 0) throw std::runtime_error("Error: The data are not in the flat rafl forest format");
+
+    boost::uint32_t header[4];
+    memcpy(header, data + 8, sizeof(header));
+    if(header[0] != FORMAT_VERSION) throw std::runtime_error("Error: Unsupported flat rafl forest format version");
+    if(header[1] != 0x01020304) throw std::runtime_error("Error: The flat rafl forest was written on a machine with a different byte order");
+    if(header[2] != sizeof(Label)) throw std::runtime_error("Error: The flat rafl forest was written for a different label type");
+
+    const size_t treeCount = header[3];
+    size_t offset = headerSize + treeCount * sizeof(boost::uint64_t);
+    if(size < offset) throw std::runtime_error("Error: Truncated flat rafl forest");
+
+    // Construct the trees as views onto the external memory.
+    m_trees.reserve(treeCount);
+    for(size_t i = 0; i < treeCount; ++i)
+    {
+      boost::uint64_t treeSize;
+      memcpy(&treeSize, data + headerSize + i * sizeof(boost::uint64_t), sizeof(boost::uint64_t));
+      if(treeSize > size - offset) throw std::runtime_error("Error: Truncated flat rafl forest");
+
+      m_trees.push_back(CompiledDT_CPtr(new CompiledDT(data + offset, static_cast<size_t>(treeSize), storage)));
+      offset += static_cast<size_t>(treeSize);
+    }
+
+    index_labels();
+    calculate_feature_count();
+  }
+
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Loads a compiled forest from a file in the flat binary format.
+   *
+   * \param path                The path to the file.
+   * \param useMemoryMapping    Whether to memory-map the file (the default) or read it into memory.
+   * \return                    The loaded forest.
+   * \throws std::runtime_error If the file cannot be read, or does not contain a valid forest.
+   */
+  static boost::shared_ptr<const CompiledRandomForest> load(const std::string& path, bool useMemoryMapping = true)
+  {
+    if(useMemoryMapping)
+    {
+      boost::shared_ptr<boost::interprocess::mapped_region> region;
+      try
+      {
+        boost::interprocess::file_mapping file(path.c_str(), boost::interprocess::read_only);
+        region.reset(new boost::interprocess::mapped_region(file, boost::interprocess::read_only));
+      }
+      catch(boost::interprocess::interprocess_exception&)
+      {
+        throw std::runtime_error("Error: Could not memory-map the flat rafl forest in '" + path + "'");
+      }
+
+      const char *data = static_cast<const char*>(region->get_address());
+      return boost::shared_ptr<const CompiledRandomForest>(new CompiledRandomForest(data, region->get_size(), region));
+    }
+    else
+    {
+      std::ifstream fs(path.c_str(), std::ios::binary);
+      if(!fs) throw std::runtime_error("Error: Could not open the flat rafl forest in '" + path + "'");
+
+      fs.seekg(0, std::ios::end);
+      size_t size = static_cast<size_t>(fs.tellg());
+      fs.seekg(0, std::ios::beg);
+
+      // Note: We read the file into a buffer of 64-bit integers to guarantee that the trees will be suitably aligned.
+      boost::shared_ptr<std::vector<boost::uint64_t> > buffer(new std::vector<boost::uint64_t>((size + 7) / 8 + 1));
+      char *data = reinterpret_cast<char*>(&(*buffer)[0]);
+      if(!fs.read(data, size)) throw std::runtime_error("Error: Could not read the flat rafl forest in '" + path + "'");
+
+      return boost::shared_ptr<const CompiledRandomForest>(new CompiledRandomForest(data, size, buffer));
+    }
+  }
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Calculates an overall forest PMF for the specified descriptor.
+   *
+   * \param descriptor            The descriptor.
+   * \return                      The PMF.
+   * \throws std::invalid_argument If the descriptor has fewer features than the forest tests (see get_feature_count).
+   */
+  tvgutil::ProbabilityMassFunction<Label> calculate_pmf(const Descriptor_CPtr& descriptor) const
+  {
+    check_feature_count(descriptor->size());
+    return calculate_pmf(descriptor->empty() ? NULL : &(*descriptor)[0]);
+  }
+
+  /**
+   * \brief Calculates an overall forest PMF for the specified descriptor.
+   *
+   * \param features  A pointer to the features of the descriptor (this must point to at least get_feature_count() features).
+   * \return          The PMF.
+   */
+  tvgutil::ProbabilityMassFunction<Label> calculate_pmf(const float *features) const
+  {
+    // Sum the masses from the individual tree PMFs for the descriptor, and then normalise them.
+    typename tvgutil::ProbabilityMassFunction<Label>::Masses masses;
+    for(typename std::vector<CompiledDT_CPtr>::const_iterator it = m_trees.begin(), iend = m_trees.end(); it != iend; ++it)
+    {
+      (*it)->accumulate_masses(features, masses);
+    }
+    return tvgutil::ProbabilityMassFunction<Label>(masses);
+  }
+
+  /**
+   * \brief Gets the minimum number of features that a descriptor must have for the forest to be able to make a prediction for it.
+   *
+   * \return  The minimum number of features that a descriptor must have for the forest to be able to make a prediction for it.
+   */
+  size_t get_feature_count() const
+  {
+    return m_featureCount;
+  }
+
+  /**
+   * \brief Gets the specified tree in the forest.
+   *
+   * \param treeIndex           The index of the tree to get.
+   * \return                    The specified tree.
+   * \throws std::runtime_error If the tree index is invalid.
+   */
+  CompiledDT_CPtr get_tree(size_t treeIndex) const
+  {
+    if(treeIndex < m_trees.size()) return m_trees[treeIndex];
+    else throw std::runtime_error("Bad tree index");
+  }
+
+  /**
+   * \brief Gets the number of trees in the forest.
+   *
+   * \return  The number of trees in the forest.
+   */
+  size_t get_tree_count() const
+  {
+    return m_trees.size();
+  }
+
+  /**
+   * \brief Predicts a label for the specified descriptor.
+   *
+   * \param descriptor            The descriptor.
+   * \return                      The predicted label.
+   * \throws std::invalid_argument If the descriptor has fewer features than the forest tests (see get_feature_count).
+   */
+  Label predict(const Descriptor_CPtr& descriptor) const
+  {
+    return calculate_pmf(descriptor).calculate_best_label();
+  }
+
+  /**
+   * \brief Predicts a label for the specified descriptor.
+   *
+   * \param features  A pointer to the features of the descriptor (this must point to at least get_feature_count() features).
+   * \return          The predicted label.
+   */
+  Label predict(const float *features) const
+  {
+    return calculate_pmf(features).calculate_best_label();
+  }
+
+  /**
+   * \brief Predicts labels and dense PMFs for a batch of descriptors.
+   *
+   * The descriptors are processed in chunks: each chunk is pushed through one tree at a time, so that the nodes of the tree
+   * stay in cache whilst they are being used for the whole chunk. If OpenMP is available, the chunks are processed in parallel.
+   * The results are exactly the same as those obtained by calling calculate_pmf and predict on each descriptor in turn.
+   *
+   * \param descriptors         The batch of descriptors.
+   * \param predictions           The predictions in which to store the results (any existing storage in this will be reused).
+   * \throws std::invalid_argument If the descriptors have fewer features than the forest tests (see get_feature_count).
+   * \throws std::runtime_error    If any of the descriptors ends up in a leaf that has not seen any examples.
+   */
+  void predict_batch(const DescriptorBatch& descriptors, BatchPredictions<Label>& predictions) const
+  {
+    if(descriptors.get_descriptor_count() > 0) check_feature_count(descriptors.get_feature_count());
+
+    const int descriptorCount = static_cast<int>(descriptors.get_descriptor_count());
+    const int labelCount = static_cast<int>(m_labels.size());
+    const int treeCount = static_cast<int>(m_trees.size());
+    predictions.reset(descriptorCount, m_labels);
+
+    const int chunkSize = 256;
+    const int chunkCount = (descriptorCount + chunkSize - 1) / chunkSize;
+    bool foundEmptyLeaf = false;
+
+#ifdef WITH_OPENMP
+    #pragma omp parallel for schedule(dynamic) reduction(||:foundEmptyLeaf)
+#endif
+    for(int chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
+    {
+      const int begin = chunkIndex * chunkSize;
+      const int end = std::min(begin + chunkSize, descriptorCount);
+
+      // Sum the masses from the individual tree PMFs for the descriptors in the chunk.
+      for(int treeIndex = 0; treeIndex < treeCount; ++treeIndex)
+      {
+        const CompiledDT& tree = *m_trees[treeIndex];
+        const int *leafColumns = m_leafColumns[treeIndex].empty() ? NULL : &m_leafColumns[treeIndex][0];
+        for(int i = begin; i < end; ++i)
+        {
+          if(!tree.accumulate_masses(descriptors.get_descriptor(i), leafColumns, &predictions.m_masses[i * labelCount])) foundEmptyLeaf = true;
+        }
+      }
+
+      // Normalise the summed masses and pick the best label for each descriptor (the order of the operations here deliberately
+      // matches that used by ProbabilityMassFunction, so that the results are identical to those of calculate_pmf and predict).
+      for(int i = begin; i < end; ++i)
+      {
+        float *masses = &predictions.m_masses[i * labelCount];
+
+        float sum = 0.0f;
+        for(int j = 0; j < labelCount; ++j) sum += masses[j];
+
+        int bestColumn = 0;
+        for(int j = 0; j < labelCount; ++j)
+        {
+          masses[j] /= sum;
+          if(masses[j] > masses[bestColumn]) bestColumn = j;
+        }
+
+        if(labelCount > 0) predictions.m_predictedLabels[i] = m_labels[bestColumn];
+      }
+    }
+
+    if(foundEmptyLeaf) throw std::runtime_error("Cannot make a probability mass function from an empty histogram");
+  }
+
+  /**
+   * \brief Saves the forest to a file in the flat binary format.
+   *
+   * \param path                The path to the file.
+   * \throws std::runtime_error If the file cannot be written, or the forest contains decision functions that have no flat form.
+   */
+  void save(const std::string& path) const
+  {
+    std::ofstream fs(path.c_str(), std::ios::binary);
+    if(!fs) throw std::runtime_error("Error: Could not open '" + path + "' for writing");
+
+    const boost::uint32_t header[] = { FORMAT_VERSION, 0x01020304, sizeof(Label), static_cast<boost::uint32_t>(m_trees.size()) };
+    fs.write("RAFLFLAT", 8);
+    fs.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    for(typename std::vector<CompiledDT_CPtr>::const_iterator it = m_trees.begin(), iend = m_trees.end(); it != iend; ++it)
+    {
+      boost::uint64_t treeSize = (*it)->get_flat_size();
+      fs.write(reinterpret_cast<const char*>(&treeSize), sizeof(boost::uint64_t));
+    }
+
+    for(typename std::vector<CompiledDT_CPtr>::const_iterator it = m_trees.begin(), iend = m_trees.end(); it != iend; ++it)
+    {
+      (*it)->write(fs);
+    }
+
+    if(!fs) throw std::runtime_error("Error: Could not write the flat rafl forest to '" + path + "'");
+  }
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Calculates the minimum number of features that a descriptor must have for all of the trees in the forest to be able to test it.
+   */
+  void calculate_feature_count()
+  {
+    m_featureCount = 0;
+    for(typename std::vector<CompiledDT_CPtr>::const_iterator it = m_trees.begin(), iend = m_trees.end(); it != iend; ++it)
+    {
+      m_featureCount = std::max(m_featureCount, (*it)->get_feature_count());
+    }
+  }
+
+  /**
+   * \brief Checks that descriptors with the specified number of features can be tested by all of the trees in the forest.
+   *
+   * \param featureCount          The number of features in the descriptors.
+   * \throws std::invalid_argument If the descriptors have fewer features than the forest tests.
+   */
+  void check_feature_count(size_t featureCount) const
+  {
+    if(featureCount < m_featureCount)
+    {
+      throw std::invalid_argument("Error: The descriptor has fewer features than are tested by the compiled forest");
+    }
+  }
+
+  /**
+   * \brief Determines the labels that occur in the leaves of the forest, and maps the leaf entries of each tree to the corresponding columns of the dense PMFs.
+   */
+  void index_labels()
+  {
+    std::map<Label,int> labelToColumn;
+    for(typename std::vector<CompiledDT_CPtr>::const_iterator it = m_trees.begin(), iend = m_trees.end(); it != iend; ++it)
+    {
+      for(size_t i = 0, size = (*it)->get_leaf_entry_count(); i < size; ++i)
+      {
+        labelToColumn[(*it)->get_leaf_entry_label(i)] = 0;
+      }
+    }
+
+    m_labels.clear();
+    for(typename std::map<Label,int>::iterator it = labelToColumn.begin(), iend = labelToColumn.end(); it != iend; ++it)
+    {
+      it->second = static_cast<int>(m_labels.size());
+      m_labels.push_back(it->first);
+    }
+
+    m_leafColumns.resize(m_trees.size());
+    for(size_t treeIndex = 0, treeCount = m_trees.size(); treeIndex < treeCount; ++treeIndex)
+    {
+      const CompiledDT& tree = *m_trees[treeIndex];
+      std::vector<int>& leafColumns = m_leafColumns[treeIndex];
+      leafColumns.resize(tree.get_leaf_entry_count());
+      for(size_t i = 0, size = leafColumns.size(); i < size; ++i)
+      {
+        leafColumns[i] = labelToColumn[tree.get_leaf_entry_label(i)];
+      }
+    }
+  }
+};
+
+}
+
+#endif
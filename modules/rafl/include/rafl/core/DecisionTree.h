@@ -6,16 +6,27 @@
 #ifndef H_RAFL_DECISIONTREE
 #define H_RAFL_DECISIONTREE
 
+#include <algorithm>
+#include <climits>
 #include <set>
 #include <stdexcept>
 
+#include <boost/serialization/traits.hpp>
+#include <boost/serialization/version.hpp>
+
 #include <tvgutil/containers/PriorityQueue.h>
+#include <tvgutil/numbers/ParallelRandomNumberGenerator.h>
+#include <tvgutil/numbers/RandomNumberStream.h>
 #include <tvgutil/persistence/PropertyUtil.h>
 
 #include "../decisionfunctions/DecisionFunctionGeneratorFactory.h"
 
 namespace rafl {
 
+//#################### FORWARD DECLARATIONS ####################
+
+template <typename Label> class CompiledDecisionTree;
+
 /**
  * \brief An instance of an instantiation of this class template represents a tree suitable for use within a random forest.
  */
@@ -34,6 +45,9 @@ private:
     /** The depth of the node in the tree. */
     size_t m_depth;
 
+    /** Whether or not examples have been added to the node during the current call to add_examples() (this is not serialized). */
+    bool m_isDirty;
+
     /** The index of the node's left child in the tree's node array. */
     int m_leftChildIndex;
 
@@ -51,12 +65,12 @@ private:
     /**
      * \brief Constructs a node.
      *
-     * \param depth                 The depth of the node in the tree.
-     * \param maxClassSize          The maximum number of examples of each class allowed in the node's reservoir at any one time.
-     * \param randomNumberGenerator A random number generator.
+     * \param depth           The depth of the node in the tree.
+     * \param maxClassSize    The maximum number of examples of each class allowed in the node's reservoir at any one time.
+     * \param reservoirBudget The budget (if any) that limits the total number of examples that can be stored in the tree's reservoirs.
      */
-    Node(size_t depth, size_t maxClassSize, const tvgutil::RandomNumberGenerator_Ptr& randomNumberGenerator)
-    : m_depth(depth), m_leftChildIndex(-1), m_reservoir(maxClassSize, randomNumberGenerator), m_rightChildIndex(-1)
+    Node(size_t depth, size_t maxClassSize, const ExampleReservoirBudget_Ptr& reservoirBudget)
+    : m_depth(depth), m_isDirty(false), m_leftChildIndex(-1), m_reservoir(maxClassSize, reservoirBudget), m_rightChildIndex(-1)
     {}
 
   private:
@@ -65,7 +79,9 @@ private:
      *
      * Note: This constructor is needed for serialization and should not be used otherwise.
      */
-    Node() {}
+    Node()
+    : m_isDirty(false)
+    {}
 
     //~~~~~~~~~~~~~~~~~~~~ SERIALIZATION ~~~~~~~~~~~~~~~~~~~~
   private:
@@ -91,8 +107,13 @@ private:
 public:
   /**
    * \brief An instance of this class can be used to provide the settings needed to configure a decision tree.
+   *
+   * The settings are saved in version 1 of their format. Version 0 is the original format, which lacked
+   * the maxStoredExamples, parallelSplitting, reservoirBudget and splitBinCount settings. Since Settings
+   * is nested inside a class template, its version cannot be specified by specialising
+   * boost::serialization::version, so it is specified via the serialization traits base class instead.
    */
-  class Settings
+  class Settings : public boost::serialization::traits<Settings,boost::serialization::object_class_info,boost::serialization::track_selectively,1>
   {
     //~~~~~~~~~~~~~~~~~~~~ TYPEDEFS ~~~~~~~~~~~~~~~~~~~~
   private:
@@ -112,15 +133,37 @@ public:
     /** The maximum number of examples of each class allowed in a node's reservoir at any one time. */
     size_t maxClassSize;
 
+    /**
+     * The maximum number of examples that may be stored in the reservoirs of a tree (or of all of the trees in a forest, each of
+     * which gets an equal share) at any one time, or 0 for no limit. Once this limit is reached, reservoirs can only replace the
+     * examples they contain.
+     */
+    size_t maxStoredExamples;
+
     /** The maximum height allowed for a tree. */
     size_t maxTreeHeight;
 
+    /**
+     * Whether or not to search for the splits of several nodes concurrently during training. In this mode, the search for each
+     * split is given its own random number generator (seeded from the tree's one), so that training remains reproducible.
+     */
+    bool parallelSplitting;
+
     /** A random number generator. */
     tvgutil::RandomNumberGenerator_Ptr randomNumberGenerator;
 
+    /** The budget that enforces maxStoredExamples (this is shared by all of the trees that are configured using these settings, except those in a forest). */
+    ExampleReservoirBudget_Ptr reservoirBudget;
+
     /** The minimum number of examples that must have been added to an example reservoir before its containing node can be split. */
     size_t seenExamplesThreshold;
 
+    /**
+     * The number of bins to use when searching for the best threshold for each candidate decision function, or 0 to evaluate
+     * each candidate exactly as generated (see DecisionFunctionGenerator::split_examples).
+     */
+    size_t splitBinCount;
+
     /** A threshold splittability below which nodes should not be split (must be > 0). */
     float splittabilityThreshold;
 
@@ -178,14 +221,18 @@ public:
         GET_SETTING(decisionFunctionGeneratorType);
         GET_SETTING(gainThreshold);
         GET_SETTING(maxClassSize);
+        GET_SETTING(maxStoredExamples);
         GET_SETTING(maxTreeHeight);
+        GET_SETTING(parallelSplitting);
         GET_SETTING(randomSeed);
         GET_SETTING(seenExamplesThreshold);
+        GET_SETTING(splitBinCount);
         GET_SETTING(splittabilityThreshold);
         GET_SETTING(usePMFReweighting);
       #undef GET_SETTING
 
       randomNumberGenerator.reset(new tvgutil::RandomNumberGenerator(randomSeed));
+      reservoirBudget.reset(new ExampleReservoirBudget(maxStoredExamples));
       decisionFunctionGenerator = DecisionFunctionGeneratorFactory<Label>::instance().make(decisionFunctionGeneratorType, decisionFunctionGeneratorParams);
     }
 
@@ -200,7 +247,24 @@ public:
     template <typename Archive>
     void load(Archive& ar, const unsigned int version)
     {
-      serialize_common(ar);
+      if(version == 0)
+      {
+        // Settings saved in the original format lack the newer settings, so we give those their default values.
+        ar & candidateCount;
+        ar & gainThreshold;
+        ar & maxClassSize;
+        ar & maxTreeHeight;
+        ar & randomNumberGenerator;
+        ar & seenExamplesThreshold;
+        ar & splittabilityThreshold;
+        ar & usePMFReweighting;
+
+        maxStoredExamples = 0;
+        parallelSplitting = false;
+        reservoirBudget.reset(new ExampleReservoirBudget(maxStoredExamples));
+        splitBinCount = 0;
+      }
+      else serialize_common(ar);
 
       std::string decisionFunctionGeneratorParams;
       std::string decisionFunctionGeneratorType;
@@ -242,9 +306,13 @@ public:
       ar & candidateCount;
       ar & gainThreshold;
       ar & maxClassSize;
+      ar & maxStoredExamples;
       ar & maxTreeHeight;
+      ar & parallelSplitting;
       ar & randomNumberGenerator;
+      ar & reservoirBudget;
       ar & seenExamplesThreshold;
+      ar & splitBinCount;
       ar & splittabilityThreshold;
       ar & usePMFReweighting;
     }
@@ -262,6 +330,7 @@ public:
 private:
   typedef boost::shared_ptr<const Example<Label> > Example_CPtr;
   typedef boost::shared_ptr<Node> Node_Ptr;
+  typedef typename DecisionFunctionGenerator<Label>::Split_CPtr Split_CPtr;
   typedef tvgutil::PriorityQueue<int,float,signed char,std::greater<float> > SplittabilityQueue;
 
   //#################### PRIVATE VARIABLES ####################
@@ -270,7 +339,7 @@ private:
   tvgutil::Histogram<Label> m_classFrequencies;
 
   /** The indices of nodes to which examples have been added during the current call to add_examples() and whose splittability may need recalculating. */
-  std::set<int> m_dirtyNodes;
+  std::vector<int> m_dirtyNodes;
 
   /** The inverses of the L1-normalised class frequencies observed in the training data. */
   boost::optional<std::map<Label,float> > m_inverseClassWeights;
@@ -281,6 +350,14 @@ private:
   /** The nodes in the tree. */
   std::vector<Node_Ptr> m_nodes;
 
+  /**
+   * A lock-free random number stream, seeded from the random number generator in the settings, that is used for all of the
+   * tree's serial random decisions (adding examples to reservoirs, sampling examples and searching for splits one at a time).
+   * A tree is only ever modified by one thread at a time, so this avoids locking the (possibly shared) generator in the settings
+   * for every number drawn. It is not saved, but is re-seeded from the generator in the settings when the tree is loaded.
+   */
+  tvgutil::RandomNumberStream m_randomNumberStream;
+
   /** The root node's index in the node array. */
   int m_rootIndex;
 
@@ -301,7 +378,7 @@ public:
    * \param settings  The settings needed to configure the decision tree.
    */
   explicit DecisionTree(const Settings& settings)
-  : m_isValid(false), m_settings(settings), m_treeDepth(0)
+  : m_isValid(false), m_randomNumberStream(draw_seed(*settings.randomNumberGenerator)), m_settings(settings), m_treeDepth(0)
   {
     m_rootIndex = add_node(0);
 
@@ -315,7 +392,9 @@ private:
    *
    * Note: This constructor is needed for serialization and should not be used otherwise.
    */
-  DecisionTree() {}
+  DecisionTree()
+  : m_randomNumberStream(0)
+  {}
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
@@ -343,10 +422,30 @@ public:
    */
   void add_examples(const std::vector<Example_CPtr>& examples, const std::vector<size_t>& indices)
   {
-    // Add each example indicated in the indices list to the tree.
-    for(size_t i = 0, size = indices.size(); i < size; ++i)
+    // Check that all of the indices are valid before doing anything else (we can't throw from within the parallel loop below).
+    const int indexCount = static_cast<int>(indices.size());
+    for(int i = 0; i < indexCount; ++i)
     {
-      add_example(examples.at(indices[i]));
+      if(indices[i] >= examples.size()) throw std::out_of_range("Bad example index whilst trying to add examples to a tree");
+    }
+
+    // Find the leaves to which to add the examples. Adding examples to leaves does not change the structure of the tree,
+    // so we can safely look up the leaves for all of the examples in parallel before adding any of them.
+    std::vector<int> leafIndices(indexCount);
+
+#ifdef WITH_OPENMP
+    #pragma omp parallel for
+#endif
+    for(int i = 0; i < indexCount; ++i)
+    {
+      leafIndices[i] = find_leaf(&(*examples[indices[i]]->get_descriptor())[0]);
+    }
+
+    // Add each example indicated in the indices list to its leaf. Note that we do this serially and in order,
+    // since adding examples to reservoirs consumes random numbers and we want the results to be reproducible.
+    for(int i = 0; i < indexCount; ++i)
+    {
+      add_example(examples[indices[i]], leafIndices[i]);
     }
 
     // Provided we added at least one example, the tree is now valid if it wasn't already.
@@ -400,6 +499,21 @@ public:
     return m_nodes.size();
   }
 
+  /**
+   * \brief Gets the number of examples that are currently stored in the tree's reservoirs.
+   *
+   * \return  The number of examples that are currently stored in the tree's reservoirs.
+   */
+  size_t get_stored_example_count() const
+  {
+    size_t count = 0;
+    for(size_t i = 0, size = m_nodes.size(); i < size; ++i)
+    {
+      count += m_nodes[i]->m_reservoir.current_size();
+    }
+    return count;
+  }
+
   /**
    * \brief Gets the depth of the tree.
    *
@@ -430,7 +544,18 @@ public:
    */
   tvgutil::ProbabilityMassFunction<Label> lookup_pmf(const Descriptor_CPtr& descriptor) const
   {
-    int leafIndex = find_leaf(*descriptor);
+    return lookup_pmf(&(*descriptor)[0]);
+  }
+
+  /**
+   * \brief Looks up the probability mass function for the leaf to which an example with the specified descriptor would be added.
+   *
+   * \param features  A pointer to the features of the descriptor (e.g. a row of a DescriptorBatch).
+   * \return          The probability mass function for the leaf to which an example with that descriptor would be added.
+   */
+  tvgutil::ProbabilityMassFunction<Label> lookup_pmf(const float *features) const
+  {
+    int leafIndex = find_leaf(features);
     return make_pmf(leafIndex);
   }
 
@@ -455,16 +580,30 @@ public:
     return lookup_pmf(descriptor).calculate_best_label();
   }
 
+  /**
+   * \brief Predicts a label for the specified descriptor.
+   *
+   * \param features  A pointer to the features of the descriptor (e.g. a row of a DescriptorBatch).
+   * \return          The predicted label.
+   */
+  Label predict(const float *features) const
+  {
+    return lookup_pmf(features).calculate_best_label();
+  }
+
   /**
    * \brief Trains the tree by splitting a number of suitable nodes.
    *
    * The number of nodes that are split in each training step is limited to ensure that a step is not overly costly.
+   * If the tree's settings enable parallel splitting, the splits for several nodes are searched for concurrently.
    *
    * \param splitBudget The maximum number of nodes that may be split in this training step.
    * \return            The number of nodes that have been split.
    */
   size_t train(size_t splitBudget)
   {
+    if(m_settings.parallelSplitting) return train_in_parallel(splitBudget);
+
     size_t nodesSplit = 0;
 
     // Keep splitting nodes until we either run out of nodes to split or exceed the split budget. In practice,
@@ -496,20 +635,23 @@ public:
   //#################### PRIVATE MEMBER FUNCTIONS ####################
 private:
   /**
-   * \brief Adds a new training example to the decision tree.
+   * \brief Adds a new training example to the specified leaf of the decision tree.
    *
-   * \param example The example to be added.
+   * \param example   The example to be added.
+   * \param leafIndex The index of the leaf to which the example should be added (as found by find_leaf).
    */
-  void add_example(const Example_CPtr& example)
+  void add_example(const Example_CPtr& example, int leafIndex)
   {
-    // Find the leaf to which to add the new example.
-    int leafIndex = find_leaf(*example->get_descriptor());
-
     // Add the example to the leaf's reservoir.
-    m_nodes[leafIndex]->m_reservoir.add_example(example);
+    m_nodes[leafIndex]->m_reservoir.add_example(example, m_randomNumberStream);
 
     // Mark the leaf as dirty to ensure that its splittability is properly recalculated once all of the examples have been added.
-    m_dirtyNodes.insert(leafIndex);
+    Node& leaf = *m_nodes[leafIndex];
+    if(!leaf.m_isDirty)
+    {
+      leaf.m_isDirty = true;
+      m_dirtyNodes.push_back(leafIndex);
+    }
 
     // Update the class frequency histogram.
     m_classFrequencies.add(example->get_label());
@@ -524,7 +666,7 @@ private:
    */
   int add_node(size_t depth)
   {
-    m_nodes.push_back(Node_Ptr(new Node(depth, m_settings.maxClassSize, m_settings.randomNumberGenerator)));
+    m_nodes.push_back(Node_Ptr(new Node(depth, m_settings.maxClassSize, m_settings.reservoirBudget)));
     if(depth > m_treeDepth) m_treeDepth = depth;
 
     int id = static_cast<int>(m_nodes.size()) - 1;
@@ -534,6 +676,38 @@ private:
     return id;
   }
 
+  /**
+   * \brief Applies a split to the node with the specified index.
+   *
+   * \param nodeIndex The index of the node to split.
+   * \param split     The split to apply (as found by find_split).
+   */
+  void apply_split(int nodeIndex, const typename DecisionFunctionGenerator<Label>::Split& split)
+  {
+    Node& n = *m_nodes[nodeIndex];
+
+    // Set the decision function of the node to be split.
+    n.m_splitter = split.m_decisionFunction;
+
+    // Add left and right child nodes and populate their example reservoirs based on the chosen split.
+    size_t childDepth = n.m_depth + 1;
+    n.m_leftChildIndex = add_node(childDepth);
+    n.m_rightChildIndex = add_node(childDepth);
+    std::map<Label,float> multipliers = n.m_reservoir.get_class_multipliers();
+
+    // Clear the example reservoir in the node that was split. We do this before filling the child reservoirs so that the slots
+    // it was using are returned to the reservoir budget (if any) in time for them to be reused (the split holds its own references
+    // to the examples, so they remain valid).
+    n.m_reservoir.clear();
+
+    fill_reservoir(split.m_leftExamples, multipliers, m_nodes[n.m_leftChildIndex]->m_reservoir);
+    fill_reservoir(split.m_rightExamples, multipliers, m_nodes[n.m_rightChildIndex]->m_reservoir);
+
+    // Update the splittability for the child nodes.
+    update_splittability(n.m_leftChildIndex);
+    update_splittability(n.m_rightChildIndex);
+  }
+
   /**
    * \brief Fills the specified reservoir with examples sampled from an input set of examples.
    *
@@ -563,13 +737,13 @@ private:
       std::vector<Example_CPtr> sampledExamples = sample_examples(it->second, sampleCount);
       for(size_t j = 0; j < sampleCount; ++j)
       {
-        reservoir.add_example(sampledExamples[j]);
+        reservoir.add_example(sampledExamples[j], m_randomNumberStream);
       }
 #else
       // Simply add all of the examples for the group to the target reservoir (useful for debugging purposes).
       for(size_t j = 0, size = it->second.size(); j < size; ++j)
       {
-        reservoir.add_example(it->second[j]);
+        reservoir.add_example(it->second[j], m_randomNumberStream);
       }
 #endif
     }
@@ -578,19 +752,41 @@ private:
   /**
    * \brief Finds the index of the leaf to which an example with the specified descriptor would currently be added.
    *
-   * \param descriptor  The descriptor.
-   * \return            The index of the leaf to which an example with the descriptor would currently be added.
+   * \param features  A pointer to the features of the descriptor.
+   * \return          The index of the leaf to which an example with the descriptor would currently be added.
    */
-  int find_leaf(const Descriptor& descriptor) const
+  int find_leaf(const float *features) const
   {
     int curIndex = m_rootIndex;
     while(!is_leaf(curIndex))
     {
-      curIndex = m_nodes[curIndex]->m_splitter->classify_descriptor(descriptor) == DecisionFunction::DC_LEFT ? m_nodes[curIndex]->m_leftChildIndex : m_nodes[curIndex]->m_rightChildIndex;
+      curIndex = m_nodes[curIndex]->m_splitter->classify_features(features) == DecisionFunction::DC_LEFT ? m_nodes[curIndex]->m_leftChildIndex : m_nodes[curIndex]->m_rightChildIndex;
     }
     return curIndex;
   }
 
+  /**
+   * \brief Searches for a suitable split for the node with the specified index.
+   *
+   * This does not modify the tree, and so can safely be called for several nodes concurrently,
+   * provided that each call is given a different source of random numbers.
+   *
+   * \param nodeIndex           The index of the node for which to search for a split.
+   * \param randomNumberSource  The source of the random numbers to use during the search.
+   * \return                    The split, if a suitable one was found, or NULL otherwise.
+   */
+  Split_CPtr find_split(int nodeIndex, tvgutil::RandomNumberSource& randomNumberSource) const
+  {
+    return m_settings.decisionFunctionGenerator->split_examples(
+      m_nodes[nodeIndex]->m_reservoir,
+      m_settings.candidateCount,
+      m_settings.gainThreshold,
+      m_inverseClassWeights,
+      randomNumberSource,
+      m_settings.splitBinCount
+    );
+  }
+
   /**
    * \brief Returns whether or not the specified node is a leaf.
    *
@@ -649,7 +845,7 @@ private:
     std::vector<Example_CPtr> outputExamples;
     for(size_t i = 0; i < sampleCount; ++i)
     {
-      int exampleIndex = m_settings.randomNumberGenerator->generate_int_from_uniform(0, static_cast<int>(inputExamples.size()) - 1);
+      int exampleIndex = m_randomNumberStream.generate_int_from_uniform(0, static_cast<int>(inputExamples.size()) - 1);
       outputExamples.push_back(inputExamples[exampleIndex]);
     }
     return outputExamples;
@@ -663,35 +859,76 @@ private:
    */
   bool split_node(int nodeIndex)
   {
-    Node& n = *m_nodes[nodeIndex];
-    typename DecisionFunctionGenerator<Label>::Split_CPtr split = m_settings.decisionFunctionGenerator->split_examples(
-      n.m_reservoir,
-      m_settings.candidateCount,
-      m_settings.gainThreshold,
-      m_inverseClassWeights,
-      m_settings.randomNumberGenerator
-    );
+    Split_CPtr split = find_split(nodeIndex, m_randomNumberStream);
     if(!split) return false;
 
-    // Set the decision function of the node to be split.
-    n.m_splitter = split->m_decisionFunction;
+    apply_split(nodeIndex, *split);
+    return true;
+  }
 
-    // Add left and right child nodes and populate their example reservoirs based on the chosen split.
-    size_t childDepth = n.m_depth + 1;
-    n.m_leftChildIndex = add_node(childDepth);
-    n.m_rightChildIndex = add_node(childDepth);
-    std::map<Label,float> multipliers = n.m_reservoir.get_class_multipliers();
-    fill_reservoir(split->m_leftExamples, multipliers, m_nodes[n.m_leftChildIndex]->m_reservoir);
-    fill_reservoir(split->m_rightExamples, multipliers, m_nodes[n.m_rightChildIndex]->m_reservoir);
+  /**
+   * \brief Trains the tree by splitting a number of suitable nodes, searching for the splits of several nodes concurrently.
+   *
+   * Training proceeds in rounds. In each round, we take as many of the most splittable nodes as the remaining split budget allows,
+   * search for their splits in parallel, and then apply the successful splits serially (in order of splittability). The children
+   * created in one round are eligible to be split in the next. As in train(), nodes that cannot be split at present are re-added
+   * to the splittability queue at the end of the training step.
+   *
+   * \param splitBudget The maximum number of nodes that may be split in this training step.
+   * \return            The number of nodes that have been split.
+   */
+  size_t train_in_parallel(size_t splitBudget)
+  {
+    size_t nodesSplit = 0;
+    std::vector<typename SplittabilityQueue::Element> elementsToReAdd;
 
-    // Update the splittability for the child nodes.
-    update_splittability(n.m_leftChildIndex);
-    update_splittability(n.m_rightChildIndex);
+    while(nodesSplit < splitBudget)
+    {
+      // Take as many of the most splittable nodes as the remaining split budget allows.
+      std::vector<typename SplittabilityQueue::Element> candidates;
+      while(!m_splittabilityQueue.empty() && nodesSplit + candidates.size() < splitBudget && m_splittabilityQueue.top().key() >= m_settings.splittabilityThreshold)
+      {
+        candidates.push_back(m_splittabilityQueue.top());
+        m_splittabilityQueue.pop();
+      }
 
-    // Clear the example reservoir in the node that was split.
-    n.m_reservoir.clear();
+      if(candidates.empty()) break;
 
-    return true;
+      // Give each search its own lock-free random number stream. The streams are derived from a single seed drawn from the tree's
+      // own stream, and are indexed by candidate rather than by thread, so that the results are reproducible.
+      const int candidateCount = static_cast<int>(candidates.size());
+      tvgutil::ParallelRandomNumberGenerator randomNumberStreams(draw_seed(m_randomNumberStream), candidates.size());
+
+      // Search for the splits in parallel.
+      std::vector<Split_CPtr> splits(candidateCount);
+
+#ifdef WITH_OPENMP
+      #pragma omp parallel for schedule(dynamic)
+#endif
+      for(int i = 0; i < candidateCount; ++i)
+      {
+        splits[i] = find_split(candidates[i].id(), randomNumberStreams.get_stream(i));
+      }
+
+      // Apply the successful splits.
+      for(int i = 0; i < candidateCount; ++i)
+      {
+        if(splits[i])
+        {
+          apply_split(candidates[i].id(), *splits[i]);
+          ++nodesSplit;
+        }
+        else elementsToReAdd.push_back(candidates[i]);
+      }
+    }
+
+    // Re-add any elements corresponding to nodes that could not be successfully split in this training step.
+    for(typename std::vector<typename SplittabilityQueue::Element>::iterator it = elementsToReAdd.begin(), iend = elementsToReAdd.end(); it != iend; ++it)
+    {
+      m_splittabilityQueue.insert(it->id(), it->key(), it->data());
+    }
+
+    return nodesSplit;
   }
 
   /**
@@ -699,8 +936,11 @@ private:
    */
   void update_dirty_nodes()
   {
-    for(std::set<int>::const_iterator it = m_dirtyNodes.begin(), iend = m_dirtyNodes.end(); it != iend; ++it)
+    // Note: We update the nodes in index order so that the state of the splittability queue does not depend on the order in which they became dirty.
+    std::sort(m_dirtyNodes.begin(), m_dirtyNodes.end());
+    for(std::vector<int>::const_iterator it = m_dirtyNodes.begin(), iend = m_dirtyNodes.end(); it != iend; ++it)
     {
+      m_nodes[*it]->m_isDirty = false;
       update_splittability(*it);
     }
 
@@ -715,12 +955,15 @@ private:
    */
   void update_splittability(int nodeIndex)
   {
-    // Recalculate the node's splittability.
+    // Recalculate the node's splittability. Note that a node whose reservoir is empty (which can happen if the reservoir budget
+    // is exhausted) cannot be split, however many examples it has seen. Note also that only the unweighted entropy is maintained
+    // incrementally: if PMF reweighting is enabled, the inverse class weights change whenever the class frequencies do (i.e. on
+    // every call to add_examples), so the weighted entropy is recalculated by a single allocation-free pass over the node's bins.
     const ExampleReservoir<Label>& reservoir = m_nodes[nodeIndex]->m_reservoir;
     float splittability;
-    if(m_nodes[nodeIndex]->m_depth + 1 < m_settings.maxTreeHeight && reservoir.seen_examples() >= m_settings.seenExamplesThreshold)
+    if(m_nodes[nodeIndex]->m_depth + 1 < m_settings.maxTreeHeight && reservoir.seen_examples() >= m_settings.seenExamplesThreshold && reservoir.current_size() > 0)
     {
-      splittability = ExampleUtil::calculate_entropy(*reservoir.get_histogram(), m_inverseClassWeights);
+      splittability = reservoir.calculate_entropy(m_inverseClassWeights);
     }
     else
     {
@@ -740,13 +983,26 @@ private:
 
     float count = static_cast<float>(m_classFrequencies.get_count());
 
-    const std::map<Label,size_t>& bins = m_classFrequencies.get_bins();
-    for(typename std::map<Label,size_t>::const_iterator it = bins.begin(), iend = bins.end(); it != iend; ++it)
+    const typename tvgutil::Histogram<Label>::Bins& bins = m_classFrequencies.get_bins();
+    for(typename tvgutil::Histogram<Label>::Bins::const_iterator it = bins.begin(), iend = bins.end(); it != iend; ++it)
     {
       (*m_inverseClassWeights)[it->first] = count / it->second;
     }
   }
 
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Draws a seed for a new random number stream from the specified source of random numbers.
+   *
+   * \param randomNumberSource  The source of random numbers.
+   * \return                    The seed.
+   */
+  static unsigned int draw_seed(tvgutil::RandomNumberSource& randomNumberSource)
+  {
+    return static_cast<unsigned int>(randomNumberSource.generate_int_from_uniform(0, INT_MAX));
+  }
+
   //#################### SERIALIZATION ####################
 private:
   /**
@@ -759,7 +1015,16 @@ private:
   void serialize(Archive& ar, const unsigned int version)
   {
     ar & m_classFrequencies;
-    ar & m_dirtyNodes;
+
+    // Trees saved in the original format (version 0) stored the dirty nodes in a set rather than a vector.
+    if(Archive::is_loading::value && version == 0)
+    {
+      std::set<int> dirtyNodes;
+      ar & dirtyNodes;
+      m_dirtyNodes.assign(dirtyNodes.begin(), dirtyNodes.end());
+    }
+    else ar & m_dirtyNodes;
+
     ar & m_inverseClassWeights;
     ar & m_isValid;
     ar & m_nodes;
@@ -767,11 +1032,46 @@ private:
     ar & m_settings;
     ar & m_splittabilityQueue;
     ar & m_treeDepth;
+
+    // Neither the per-node dirty flags nor the random number stream are saved, so restore the flags from the list of dirty nodes,
+    // and re-seed the stream from the random number generator in the settings.
+    if(Archive::is_loading::value)
+    {
+      m_randomNumberStream = tvgutil::RandomNumberStream(draw_seed(*m_settings.randomNumberGenerator));
+
+      for(std::vector<int>::const_iterator it = m_dirtyNodes.begin(), iend = m_dirtyNodes.end(); it != iend; ++it)
+      {
+        m_nodes[*it]->m_isDirty = true;
+      }
+    }
   }
 
   friend class boost::serialization::access;
+
+  //#################### FRIENDS ####################
+
+  friend class CompiledDecisionTree<Label>;
+};
+
+}
+
+//#################### SERIALIZATION TRAITS ####################
+
+namespace boost {
+namespace serialization {
+
+/**
+ * \brief Decision trees are saved in version 1 of their format (version 0 is the original format).
+ */
+template <typename Label>
+struct version<rafl::DecisionTree<Label> >
+{
+  typedef mpl::integral_c_tag tag;
+  typedef mpl::int_<1> type;
+  BOOST_STATIC_CONSTANT(int, value = 1);
 };
 
+}
 }
 
 #endif
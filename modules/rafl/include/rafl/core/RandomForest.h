@@ -6,7 +6,10 @@
 #ifndef H_RAFL_RANDOMFOREST
 #define H_RAFL_RANDOMFOREST
 
-#include "DecisionTree.h"
+#include <climits>
+
+#include "../base/DescriptorBatch.h"
+#include "CompiledRandomForest.h"
 
 namespace rafl {
 
@@ -25,6 +28,15 @@ private:
 
   //#################### PRIVATE VARIABLES ####################
 private:
+  /** A compiled snapshot of the forest, if available (this is discarded whenever the forest is modified). */
+  boost::shared_ptr<const CompiledRandomForest<Label> > m_compiledForest;
+
+  /**
+   * Whether or not to add examples to and train the trees in parallel. Since each tree has its own random number generator
+   * and its own share of the reservoir budget (see make_tree_settings), the resulting forest is the same either way.
+   */
+  bool m_parallelTraining;
+
   /** The settings needed to configure the decision trees. */
   typename DT::Settings m_settings;
 
@@ -36,15 +48,28 @@ public:
   /**
    * \brief Constructs a random forest.
    *
-   * \param treeCount The number of decision trees to use in the random forest.
-   * \param settings  The settings needed to configure the decision trees.
+   * \param treeCount         The number of decision trees to use in the random forest.
+   * \param settings          The settings needed to configure the decision trees.
+   * \param parallelTraining  Whether or not to add examples to and train the trees in parallel.
+   *
+   * \throws std::runtime_error If the number of examples that may be stored is limited, but to fewer than one per tree.
    */
-  RandomForest(size_t treeCount, const typename DT::Settings& settings)
-  : m_settings(settings)
+  RandomForest(size_t treeCount, const typename DT::Settings& settings, bool parallelTraining = false)
+  : m_parallelTraining(parallelTraining), m_settings(settings)
   {
+    if(m_settings.maxStoredExamples > 0 && m_settings.maxStoredExamples < treeCount)
+    {
+      throw std::runtime_error("Error: The maximum number of stored examples must be either 0 (no limit) or at least the number of trees in the forest");
+    }
+
+    // The limit on the number of stored examples applies across all of the trees in the forest, but rather than sharing
+    // a single budget (which would make the forest depend on the order in which concurrently-trained trees acquired their
+    // slots), each tree is given its own share of the limit (see make_tree_settings).
+    m_settings.reservoirBudget.reset();
+
     for(size_t i = 0; i < treeCount; ++i)
     {
-      m_trees.push_back(DT_Ptr(new DT(settings)));
+      m_trees.push_back(DT_Ptr(new DT(make_tree_settings(i, treeCount))));
     }
   }
 
@@ -53,8 +78,11 @@ private:
    * \brief Constructs a random forest.
    *
    * Note: This constructor is needed for serialization and should not be used otherwise.
+   *       Forests that are loaded from an archive always add examples and train serially.
    */
-  RandomForest() {}
+  RandomForest()
+  : m_parallelTraining(false)
+  {}
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
@@ -65,10 +93,18 @@ public:
    */
   void add_examples(const std::vector<Example_CPtr>& examples)
   {
+    // Adding examples changes the leaf PMFs, so any compiled snapshots of the trees are now out-of-date.
+    m_compiledForest.reset();
+
     // Add the new examples to the different trees.
-    for(typename std::vector<DT_Ptr>::const_iterator it = m_trees.begin(), iend = m_trees.end(); it != iend; ++it)
+    const int treeCount = static_cast<int>(m_trees.size());
+
+#ifdef WITH_OPENMP
+    #pragma omp parallel for if(m_parallelTraining)
+#endif
+    for(int i = 0; i < treeCount; ++i)
     {
-      (*it)->add_examples(examples);
+      m_trees[i]->add_examples(examples);
     }
   }
 
@@ -81,10 +117,24 @@ public:
    */
   void add_examples(const std::vector<Example_CPtr>& examples, const std::vector<size_t>& indices)
   {
+    // Check that all of the indices are valid before doing anything else (we can't throw from within the parallel loop below).
+    for(size_t i = 0, size = indices.size(); i < size; ++i)
+    {
+      if(indices[i] >= examples.size()) throw std::out_of_range("Bad example index whilst trying to add examples to the forest");
+    }
+
+    // Adding examples changes the leaf PMFs, so any compiled snapshots of the trees are now out-of-date.
+    m_compiledForest.reset();
+
     // Add the new examples to the different trees.
-    for(typename std::vector<DT_Ptr>::const_iterator it = m_trees.begin(), iend = m_trees.end(); it != iend; ++it)
+    const int treeCount = static_cast<int>(m_trees.size());
+
+#ifdef WITH_OPENMP
+    #pragma omp parallel for if(m_parallelTraining)
+#endif
+    for(int i = 0; i < treeCount; ++i)
     {
-      (*it)->add_examples(examples, indices);
+      m_trees[i]->add_examples(examples, indices);
     }
   }
 
@@ -92,19 +142,33 @@ public:
    * \brief Calculates an overall forest PMF for the specified descriptor.
    *
    * This is simply the average of the PMFs for the specified descriptor in the various decision trees.
+   * If the forest has been compiled, the compiled snapshots of the trees will be used to look up the PMFs.
    *
    * \param descriptor  The descriptor.
    * \return            The PMF.
    */
   tvgutil::ProbabilityMassFunction<Label> calculate_pmf(const Descriptor_CPtr& descriptor) const
   {
+    return calculate_pmf(&(*descriptor)[0]);
+  }
+
+  /**
+   * \brief Calculates an overall forest PMF for the specified descriptor.
+   *
+   * \param features  A pointer to the features of the descriptor (e.g. a row of a DescriptorBatch).
+   * \return          The PMF.
+   */
+  tvgutil::ProbabilityMassFunction<Label> calculate_pmf(const float *features) const
+  {
+    if(m_compiledForest) return m_compiledForest->calculate_pmf(features);
+
     // Sum the masses from the individual tree PMFs for the descriptor.
-    std::map<Label,float> masses;
+    typename tvgutil::ProbabilityMassFunction<Label>::Masses masses;
     for(typename std::vector<DT_Ptr>::const_iterator it = m_trees.begin(), iend = m_trees.end(); it != iend; ++it)
     {
-      tvgutil::ProbabilityMassFunction<Label> individualPMF = (*it)->lookup_pmf(descriptor);
-      const std::map<Label,float>& individualMasses = individualPMF.get_masses();
-      for(typename std::map<Label,float>::const_iterator jt = individualMasses.begin(), jend = individualMasses.end(); jt != jend; ++jt)
+      tvgutil::ProbabilityMassFunction<Label> individualPMF = (*it)->lookup_pmf(features);
+      const typename tvgutil::ProbabilityMassFunction<Label>::Masses& individualMasses = individualPMF.get_masses();
+      for(typename tvgutil::ProbabilityMassFunction<Label>::Masses::const_iterator jt = individualMasses.begin(), jend = individualMasses.end(); jt != jend; ++jt)
       {
         masses[jt->first] += jt->second;
       }
@@ -114,6 +178,33 @@ public:
     return tvgutil::ProbabilityMassFunction<Label>(masses);
   }
 
+  /**
+   * \brief Compiles the trees in the forest into immutable snapshots that can be used for fast prediction.
+   *
+   * Once the forest has been compiled, predict() and calculate_pmf() will use the compiled snapshots until the forest
+   * is next modified (e.g. by adding examples, training or resetting a tree), at which point the snapshots will be
+   * discarded. If the forest is already compiled, this is a no-op. Note that this function is not thread-safe, and
+   * should therefore be called before (rather than during) any parallel prediction.
+   */
+  void compile()
+  {
+    if(!m_compiledForest) m_compiledForest.reset(new CompiledRandomForest<Label>(m_trees));
+  }
+
+  /**
+   * \brief Gets an immutable compiled snapshot of the forest that can be used for fast prediction.
+   *
+   * The snapshot remains valid (and unchanged) even if the forest itself is subsequently modified.
+   * As a side effect, the forest will be compiled.
+   *
+   * \return  A compiled snapshot of the forest.
+   */
+  boost::shared_ptr<const CompiledRandomForest<Label> > get_compiled_forest()
+  {
+    compile();
+    return m_compiledForest;
+  }
+
   /**
    * \brief Gets the specified tree in the forest.
    *
@@ -136,6 +227,16 @@ public:
     return m_trees.size();
   }
   
+  /**
+   * \brief Gets whether or not the forest currently has up-to-date compiled snapshots of its trees.
+   *
+   * \return  true, if the forest is currently compiled, or false otherwise.
+   */
+  bool is_compiled() const
+  {
+    return m_compiledForest.get() != NULL;
+  }
+
   /**
    * \brief Gets whether or not the forest is valid.
    *
@@ -198,6 +299,34 @@ public:
     return calculate_pmf(descriptor).calculate_best_label();
   }
 
+  /**
+   * \brief Predicts a label for the specified descriptor.
+   *
+   * \param features  A pointer to the features of the descriptor (e.g. a row of a DescriptorBatch).
+   * \return          The predicted label.
+   */
+  Label predict(const float *features) const
+  {
+    return calculate_pmf(features).calculate_best_label();
+  }
+
+  /**
+   * \brief Predicts labels and dense PMFs for a batch of descriptors.
+   *
+   * This is much faster than calling predict on each descriptor in turn (see CompiledRandomForest::predict_batch), but gives
+   * the same results. It requires a compiled forest: if the forest has not been compiled, a temporary compiled snapshot will be
+   * made for the purpose, so callers that predict repeatedly should call compile() beforehand.
+   *
+   * \param descriptors         The batch of descriptors.
+   * \param predictions         The predictions in which to store the results (any existing storage in this will be reused).
+   * \throws std::runtime_error If any of the descriptors ends up in a leaf that has not seen any examples.
+   */
+  void predict_batch(const DescriptorBatch& descriptors, BatchPredictions<Label>& predictions) const
+  {
+    if(m_compiledForest) m_compiledForest->predict_batch(descriptors, predictions);
+    else CompiledRandomForest<Label>(m_trees).predict_batch(descriptors, predictions);
+  }
+
   /**
    * \brief Resets the specified tree.
    *
@@ -206,28 +335,85 @@ public:
    */
   void reset_tree(size_t treeIndex)
   {
-    if(treeIndex < m_trees.size()) m_trees[treeIndex].reset(new DT(m_settings));
+    m_compiledForest.reset();
+    if(treeIndex < m_trees.size()) m_trees[treeIndex].reset(new DT(make_tree_settings(treeIndex, m_trees.size())));
     else throw std::runtime_error("Bad tree index whilst trying to reset tree");
   }
 
+  /**
+   * \brief Saves the forest to a file in the flat binary format used by CompiledRandomForest.
+   *
+   * The resulting file can be loaded (and memory-mapped) for inference-only use via CompiledRandomForest::load.
+   * As a side effect, the forest will be compiled.
+   *
+   * \param path                The path to the file.
+   * \throws std::runtime_error If the file cannot be written, or the forest contains decision functions that have no flat form.
+   */
+  void save_compiled(const std::string& path)
+  {
+    compile();
+    m_compiledForest->save(path);
+  }
+
   /**
    * \brief Trains the forest by splitting a number of suitable nodes in each tree.
    *
    * The number of nodes that are split in each training step is limited to ensure that a step is not overly costly.
+   * If the forest was constructed for parallel training, the trees are trained concurrently.
    *
    * \param splitBudget The maximum number of nodes per tree that may be split in this training step.
    * \return            The total number of nodes that have been split across all the trees.
    */
   size_t train(size_t splitBudget)
   {
+    m_compiledForest.reset();
+
     size_t nodesSplit = 0;
-    for(typename std::vector<DT_Ptr>::const_iterator it = m_trees.begin(), iend = m_trees.end(); it != iend; ++it)
+    const int treeCount = static_cast<int>(m_trees.size());
+
+#ifdef WITH_OPENMP
+    #pragma omp parallel for if(m_parallelTraining) reduction(+:nodesSplit)
+#endif
+    for(int i = 0; i < treeCount; ++i)
     {
-      nodesSplit += (*it)->train(splitBudget);
+      nodesSplit += m_trees[i]->train(splitBudget);
     }
+
     return nodesSplit;
   }
 
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Makes the settings for a new tree in the forest.
+   *
+   * Each new tree is given its own random number generator, whose seed is drawn from the forest's generator, and its own
+   * reservoir budget, whose capacity is the tree's share of maxStoredExamples (the shares differ by at most one, and sum
+   * to maxStoredExamples; since the constructor rejects limits that are smaller than the number of trees, each share is
+   * at least one, and so is never mistaken for no limit). Since trees are only ever created serially, and no state is
+   * shared between them, the forest is reproducible for a given seed, whether or not it is trained in parallel.
+   *
+   * \param treeIndex The index of the new tree in the forest.
+   * \param treeCount The number of trees in the forest.
+   * \return          The settings for the new tree.
+   */
+  typename DT::Settings make_tree_settings(size_t treeIndex, size_t treeCount) const
+  {
+    typename DT::Settings treeSettings = m_settings;
+
+    unsigned int treeSeed = static_cast<unsigned int>(m_settings.randomNumberGenerator->generate_int_from_uniform(0, INT_MAX));
+    treeSettings.randomNumberGenerator.reset(new tvgutil::RandomNumberGenerator(treeSeed));
+
+    size_t treeCapacity = 0;
+    if(m_settings.maxStoredExamples > 0)
+    {
+      treeCapacity = m_settings.maxStoredExamples / treeCount + (treeIndex < m_settings.maxStoredExamples % treeCount ? 1 : 0);
+    }
+    treeSettings.reservoirBudget.reset(new ExampleReservoirBudget(treeCapacity));
+
+    return treeSettings;
+  }
+
   //#################### SERIALIZATION ####################
 private:
   /**
@@ -18,6 +18,7 @@ header to avoid inadvertent mistakes.
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 
+#include <boost/optional.hpp>
 #include <boost/serialization/export.hpp>
 #include <boost/serialization/serialization.hpp>
 
@@ -42,6 +43,46 @@ public:
     DC_RIGHT
   };
 
+  //#################### NESTED TYPES ####################
+public:
+  /**
+   * \brief An instance of this struct represents a decision function in a flat form of the kind (f1 'op' f2) < threshold,
+   *        which can be stored in a compiled tree and evaluated without a virtual call.
+   */
+  struct FlatForm
+  {
+    //~~~~~~~~~~~~~~~~~~~~ ENUMERATIONS ~~~~~~~~~~~~~~~~~~~~
+
+    /**
+     * \brief An enumeration specifying the operations that can be used in a flat decision function.
+     */
+    enum Op
+    {
+      /** Only the first feature should be compared to the threshold. */
+      FO_FIRST,
+
+      /** The two features should be added together. */
+      FO_ADD,
+
+      /** The second feature should be subtracted from the first feature. */
+      FO_SUBTRACT
+    };
+
+    //~~~~~~~~~~~~~~~~~~~~ PUBLIC VARIABLES ~~~~~~~~~~~~~~~~~~~~
+
+    /** The index of the first feature in a feature descriptor. */
+    int m_firstFeatureIndex;
+
+    /** The operation to apply to the features. */
+    Op m_op;
+
+    /** The index of the second feature in a feature descriptor (ignored for FO_FIRST). */
+    int m_secondFeatureIndex;
+
+    /** The threshold against which to compare the result of the operation. */
+    float m_threshold;
+  };
+
   //#################### DESTRUCTOR ####################
 public:
   /**
@@ -52,12 +93,14 @@ public:
   //#################### PUBLIC ABSTRACT MEMBER FUNCTIONS ####################
 public:
   /**
-   * \brief Classifies the specified descriptor using the decision function.
+   * \brief Classifies the descriptor whose features are stored contiguously at the specified location using the decision function.
    *
-   * \param descriptor  The descriptor to classify.
-   * \return            DC_LEFT, if the descriptor should be sent down the left subtree of the node, or DC_RIGHT otherwise.
+   * This allows descriptors to be classified without needing to be wrapped in a Descriptor (e.g. when they are rows in a DescriptorBatch).
+   *
+   * \param features  A pointer to the features of the descriptor to classify.
+   * \return          DC_LEFT, if the descriptor should be sent down the left subtree of the node, or DC_RIGHT otherwise.
    */
-  virtual DescriptorClassification classify_descriptor(const Descriptor& descriptor) const = 0;
+  virtual DescriptorClassification classify_features(const float *features) const = 0;
 
   /**
    * \brief Outputs the decision function to the specified stream.
@@ -66,6 +109,32 @@ public:
    */
   virtual void output(std::ostream& os) const = 0;
 
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Classifies the specified descriptor using the decision function.
+   *
+   * \param descriptor  The descriptor to classify.
+   * \return            DC_LEFT, if the descriptor should be sent down the left subtree of the node, or DC_RIGHT otherwise.
+   */
+  DescriptorClassification classify_descriptor(const Descriptor& descriptor) const
+  {
+    return classify_features(&descriptor[0]);
+  }
+
+  /**
+   * \brief Attempts to express the decision function in flat form.
+   *
+   * Decision functions that cannot be expressed in this way should not override this function. Nodes with such
+   * decision functions will still work in a compiled tree, but will be evaluated using a virtual call.
+   *
+   * \return The flat form of the decision function, if available, or boost::none otherwise.
+   */
+  virtual boost::optional<FlatForm> to_flat_form() const
+  {
+    return boost::none;
+  }
+
   //#################### SERIALIZATION #################### 
 private:
   /**
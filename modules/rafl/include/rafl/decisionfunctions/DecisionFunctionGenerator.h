@@ -6,6 +6,9 @@
 #ifndef H_RAFL_DECISIONFUNCTIONGENERATOR
 #define H_RAFL_DECISIONFUNCTIONGENERATOR
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <utility>
 
 #ifdef WITH_OPENMP
@@ -15,6 +18,8 @@
 #include "../examples/ExampleReservoir.h"
 #include "../examples/ExampleUtil.h"
 #include "DecisionFunction.h"
+#include "FeatureThresholdingDecisionFunction.h"
+#include "PairwiseOpAndThresholdDecisionFunction.h"
 
 namespace rafl {
 
@@ -52,10 +57,39 @@ public:
   typedef boost::shared_ptr<Split> Split_Ptr;
   typedef boost::shared_ptr<const Split> Split_CPtr;
 
-  //#################### PRIVATE VARIABLES ####################
+  //#################### PRIVATE NESTED TYPES ####################
 private:
-  /* The split candidates. */
-  mutable std::vector<Split> m_splitCandidates;
+  /**
+   * \brief An instance of this struct records the best split found so far by a binned split search.
+   */
+  struct BinnedSplitCandidate
+  {
+    /** The index of the candidate decision function that induced the split (or -1 if no split has been found). */
+    int m_candidateIndex;
+
+    /** The information gain resulting from the split. */
+    float m_gain;
+
+    /** The threshold to use in place of the candidate's own threshold (only used for candidates that have a flat form). */
+    float m_threshold;
+
+    BinnedSplitCandidate()
+    : m_candidateIndex(-1), m_gain(static_cast<float>(INT_MIN)), m_threshold(0.0f)
+    {}
+
+    /**
+     * \brief Determines whether this split is better than another one (breaking ties in favour of the lower candidate index).
+     *
+     * \param rhs The other split.
+     * \return    true, if this split is better than the other one, or false otherwise.
+     */
+    bool is_better_than(const BinnedSplitCandidate& rhs) const
+    {
+      if(m_candidateIndex == -1) return false;
+      if(rhs.m_candidateIndex == -1) return true;
+      return m_gain > rhs.m_gain || (m_gain == rhs.m_gain && m_candidateIndex < rhs.m_candidateIndex);
+    }
+  };
 
   //#################### DESTRUCTOR ####################
 public:
@@ -70,10 +104,10 @@ public:
    * \brief Generates a candidate decision function to split the specified set of examples.
    *
    * \param examples              The examples to split.
-   * \param randomNumberGenerator A random number generator.
+   * \param randomNumberSource    A source of random numbers.
    * \return                      The candidate decision function.
    */
-  virtual DecisionFunction_Ptr generate_candidate_decision_function(const std::vector<Example_CPtr>& examples, const tvgutil::RandomNumberGenerator_Ptr& randomNumberGenerator) const = 0;
+  virtual DecisionFunction_Ptr generate_candidate_decision_function(const std::vector<Example_CPtr>& examples, tvgutil::RandomNumberSource& randomNumberSource) const = 0;
 
   /**
    * \brief Gets the parameters of the decision function generator as a string.
@@ -94,17 +128,23 @@ public:
   /**
    * \brief Tries to pick an appropriate way in which to split the specified reservoir of examples.
    *
+   * Note that a generator holds no state that is modified by this function, so it is safe for several trees to use
+   * the same generator to split their nodes concurrently.
+   *
    * \param reservoir             The reservoir of examples to split.
    * \param candidateCount        The number of candidates to evaluate.
    * \param gainThreshold         The minimum information gain that must be obtained from a split to make it worthwhile.
    * \param inverseClassWeights   The (optional) inverses of the L1-normalised class frequencies observed in the training data.
-   * \param randomNumberGenerator A random number generator.
+   * \param randomNumberSource    A source of random numbers.
+   * \param binCount              The number of bins to use for a binned split search (see split_examples_binned), or 0 to evaluate each candidate exactly as generated.
    * \return                      The chosen split, if one was suitable, or NULL otherwise.
    */
   Split_CPtr split_examples(const ExampleReservoir<Label>& reservoir, int candidateCount, float gainThreshold, const boost::optional<std::map<Label,float> >& inverseClassWeights,
-                            const tvgutil::RandomNumberGenerator_Ptr& randomNumberGenerator) const
+                            tvgutil::RandomNumberSource& randomNumberSource, size_t binCount = 0) const
   {
-    std::vector<Example_CPtr> examples = reservoir.get_examples();
+    if(binCount > 0) return split_examples_binned(reservoir, candidateCount, gainThreshold, inverseClassWeights, randomNumberSource, binCount);
+
+    const std::vector<Example_CPtr>& examples = reservoir.get_examples();
     float initialEntropy = ExampleUtil::calculate_entropy(*reservoir.get_histogram(), inverseClassWeights);
 
 #if 0
@@ -112,10 +152,10 @@ public:
 #endif
 
     // Generate the split candidates.
-    if(static_cast<int>(m_splitCandidates.size()) != candidateCount) m_splitCandidates.resize(candidateCount);
+    std::vector<Split> splitCandidates(candidateCount);
     for(int i = 0; i < candidateCount; ++i)
     {
-      m_splitCandidates[i].m_decisionFunction = generate_candidate_decision_function(examples, randomNumberGenerator);
+      splitCandidates[i].m_decisionFunction = generate_candidate_decision_function(examples, randomNumberSource);
     }
 
     // Pick the best split candidate and return it.
@@ -138,22 +178,20 @@ public:
 #endif
 
       // Partition the examples using the split candidate's decision function.
-      m_splitCandidates[i].m_leftExamples.clear();
-      m_splitCandidates[i].m_rightExamples.clear();
       for(size_t j = 0, size = examples.size(); j < size; ++j)
       {
-        if(m_splitCandidates[i].m_decisionFunction->classify_descriptor(*examples[j]->get_descriptor()) == DecisionFunction::DC_LEFT)
+        if(splitCandidates[i].m_decisionFunction->classify_descriptor(*examples[j]->get_descriptor()) == DecisionFunction::DC_LEFT)
         {
-          m_splitCandidates[i].m_leftExamples.push_back(examples[j]);
+          splitCandidates[i].m_leftExamples.push_back(examples[j]);
         }
         else
         {
-          m_splitCandidates[i].m_rightExamples.push_back(examples[j]);
+          splitCandidates[i].m_rightExamples.push_back(examples[j]);
         }
       }
 
       // Calculate the information gain we would obtain from this split.
-      float gain = calculate_information_gain(reservoir, initialEntropy, m_splitCandidates[i].m_leftExamples, m_splitCandidates[i].m_rightExamples, inverseClassWeights);
+      float gain = calculate_information_gain(reservoir, initialEntropy, splitCandidates[i].m_leftExamples, splitCandidates[i].m_rightExamples, inverseClassWeights);
 
 #ifdef WITH_OPENMP
       #pragma omp critical
@@ -161,7 +199,7 @@ public:
       {
         if(gain > bestGain)
         {
-          if(gain > gainThreshold && !m_splitCandidates[i].m_leftExamples.empty() && !m_splitCandidates[i].m_rightExamples.empty())
+          if(gain > gainThreshold && !splitCandidates[i].m_leftExamples.empty() && !splitCandidates[i].m_rightExamples.empty())
           {
             bestGain = gain;
             bestIndex = i;
@@ -171,14 +209,239 @@ public:
     }
 
     Split_Ptr bestSplitCandidate;
-    if(bestIndex != -1) bestSplitCandidate.reset(new Split(m_splitCandidates[bestIndex]));
+    if(bestIndex != -1) bestSplitCandidate.reset(new Split(splitCandidates[bestIndex]));
 
     // Return a split candidate that had maximum gain (note that this may be NULL if no split had a high enough gain).
     return bestSplitCandidate;
   }
 
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Tries to pick an appropriate way in which to split the specified reservoir of examples, using a binned search over thresholds.
+   *
+   * Rather than evaluating each candidate decision function exactly as generated, we treat each candidate that has a flat form
+   * as a feature response, bin the responses of all the examples into a fixed number of equal-width bins per label, and then
+   * choose the best threshold for that response by scanning the bin boundaries using cumulative label counts. The cost of
+   * evaluating a candidate is thus O(exampleCount + binCount * labelCount), and involves no per-example allocations. Candidates
+   * that have no flat form are evaluated exactly as generated, but still without partitioning the examples until the end.
+   *
+   * Each thread keeps track of its own best split, and these are combined once all the candidates have been evaluated.
+   * Ties are broken in favour of the lowest candidate index, so the result does not depend on the number of threads.
+   *
+   * \param reservoir             The reservoir of examples to split.
+   * \param candidateCount        The number of candidates to evaluate.
+   * \param gainThreshold         The minimum information gain that must be obtained from a split to make it worthwhile.
+   * \param inverseClassWeights   The (optional) inverses of the L1-normalised class frequencies observed in the training data.
+   * \param randomNumberSource    A source of random numbers.
+   * \param binCount              The number of bins into which to divide the range of each feature response.
+   * \return                      The chosen split, if one was suitable, or NULL otherwise.
+   */
+  Split_CPtr split_examples_binned(const ExampleReservoir<Label>& reservoir, int candidateCount, float gainThreshold, const boost::optional<std::map<Label,float> >& inverseClassWeights,
+                                   tvgutil::RandomNumberSource& randomNumberSource, size_t binCount) const
+  {
+    const std::vector<Example_CPtr>& examples = reservoir.get_examples();
+    float initialEntropy = ExampleUtil::calculate_entropy(*reservoir.get_histogram(), inverseClassWeights);
+    const int exampleCount = static_cast<int>(examples.size());
+
+    // Assign a dense index to each label in the reservoir, and look up the multiplier that should be used to weight its examples.
+    // As in calculate_information_gain, labels without a multiplier are given a weight of 1.
+    std::map<Label,float> multipliers = reservoir.get_class_multipliers();
+    if(inverseClassWeights) multipliers = combine_multipliers(multipliers, *inverseClassWeights);
+
+    std::map<Label,int> labelIndices;
+    std::vector<float> labelWeights;
+    const typename tvgutil::Histogram<Label>::Bins& bins = reservoir.get_histogram()->get_bins();
+    for(typename tvgutil::Histogram<Label>::Bins::const_iterator it = bins.begin(), iend = bins.end(); it != iend; ++it)
+    {
+      labelIndices.insert(std::make_pair(it->first, static_cast<int>(labelWeights.size())));
+      typename std::map<Label,float>::const_iterator jt = multipliers.find(it->first);
+      labelWeights.push_back(jt != multipliers.end() ? jt->second : 1.0f);
+    }
+
+    const int labelCount = static_cast<int>(labelWeights.size());
+    std::vector<int> exampleLabelIndices(exampleCount);
+    for(int j = 0; j < exampleCount; ++j)
+    {
+      exampleLabelIndices[j] = labelIndices.find(examples[j]->get_label())->second;
+    }
+
+    // Generate the split candidates (note that this must be done serially, since the random number generator is not thread-safe).
+    std::vector<DecisionFunction_Ptr> candidates(candidateCount);
+    for(int i = 0; i < candidateCount; ++i)
+    {
+      candidates[i] = generate_candidate_decision_function(examples, randomNumberSource);
+    }
+
+    BinnedSplitCandidate bestSplit;
+
+#ifdef WITH_OPENMP
+    #pragma omp parallel
+#endif
+    {
+      // Allocate the working memory for the thread (this is reused for all the candidates the thread evaluates).
+      std::vector<int> binIndices(exampleCount);
+      std::vector<float> binMinima(binCount);
+      std::vector<int> binSizes(binCount);
+      std::vector<int> binLabelCounts(binCount * labelCount);
+      std::vector<int> leftCounts(labelCount), rightCounts(labelCount);
+      std::vector<float> responses(exampleCount);
+      BinnedSplitCandidate threadBestSplit;
+
+#ifdef WITH_OPENMP
+      #pragma omp for schedule(static)
+#endif
+      for(int i = 0; i < candidateCount; ++i)
+      {
+        boost::optional<DecisionFunction::FlatForm> flatForm = candidates[i]->to_flat_form();
+        if(!flatForm)
+        {
+          // If the candidate has no flat form, evaluate it exactly as generated.
+          std::fill(leftCounts.begin(), leftCounts.end(), 0);
+          std::fill(rightCounts.begin(), rightCounts.end(), 0);
+          int leftSize = 0;
+          for(int j = 0; j < exampleCount; ++j)
+          {
+            if(candidates[i]->classify_descriptor(*examples[j]->get_descriptor()) == DecisionFunction::DC_LEFT)
+            {
+              ++leftCounts[exampleLabelIndices[j]];
+              ++leftSize;
+            }
+            else ++rightCounts[exampleLabelIndices[j]];
+          }
+
+          if(leftSize == 0 || leftSize == exampleCount) continue;
+
+          BinnedSplitCandidate split;
+          split.m_candidateIndex = i;
+          split.m_gain = calculate_information_gain(initialEntropy, leftCounts, rightCounts, leftSize, exampleCount, labelWeights);
+          if(split.m_gain > gainThreshold && split.is_better_than(threadBestSplit)) threadBestSplit = split;
+          continue;
+        }
+
+        // Calculate the feature responses for the examples, and determine their range.
+        float minResponse = 0.0f, maxResponse = 0.0f;
+        for(int j = 0; j < exampleCount; ++j)
+        {
+          responses[j] = calculate_response(*flatForm, &(*examples[j]->get_descriptor())[0]);
+          if(j == 0 || responses[j] < minResponse) minResponse = responses[j];
+          if(j == 0 || responses[j] > maxResponse) maxResponse = responses[j];
+        }
+
+        // If all of the examples have the same response, they cannot be split using this candidate.
+        if(!(minResponse < maxResponse)) continue;
+
+        // Bin the responses. Note that the bin index is a non-decreasing function of the response, so equal responses
+        // always end up in the same bin, and every response in a bin is smaller than every response in a later bin.
+        std::fill(binMinima.begin(), binMinima.end(), maxResponse);
+        std::fill(binSizes.begin(), binSizes.end(), 0);
+        std::fill(binLabelCounts.begin(), binLabelCounts.end(), 0);
+        std::fill(leftCounts.begin(), leftCounts.end(), 0);
+        std::fill(rightCounts.begin(), rightCounts.end(), 0);
+
+        // Note: The bin offsets are calculated in double precision, since the response range can be so small (e.g. a subnormal
+        //       difference) that the scale would overflow in single precision. They are then clamped to the valid range before
+        //       being converted to bin indices, in a way that also maps any non-finite offsets to a valid bin.
+        const double scale = binCount / (static_cast<double>(maxResponse) - static_cast<double>(minResponse));
+        const double maxOffset = static_cast<double>(binCount - 1);
+        for(int j = 0; j < exampleCount; ++j)
+        {
+          const double offset = (static_cast<double>(responses[j]) - minResponse) * scale;
+          size_t binIndex = offset > 0.0 ? (offset < maxOffset ? static_cast<size_t>(offset) : binCount - 1) : 0;
+          if(responses[j] < binMinima[binIndex]) binMinima[binIndex] = responses[j];
+          ++binSizes[binIndex];
+          ++binLabelCounts[binIndex * labelCount + exampleLabelIndices[j]];
+          ++rightCounts[exampleLabelIndices[j]];
+        }
+
+        // Scan the boundaries between the bins, moving the counts for each bin from the right-hand side to the left-hand side as we go.
+        // Splitting just before a non-empty bin corresponds to a threshold equal to the smallest response in that bin, which is
+        // consistent with the "response < threshold => left" convention used by the decision functions.
+        int leftSize = 0;
+        for(size_t b = 0; b + 1 < binCount; ++b)
+        {
+          if(binSizes[b] == 0) continue;
+
+          const int *counts = &binLabelCounts[b * labelCount];
+          for(int k = 0; k < labelCount; ++k)
+          {
+            leftCounts[k] += counts[k];
+            rightCounts[k] -= counts[k];
+          }
+          leftSize += binSizes[b];
+          if(leftSize == exampleCount) break;
+
+          size_t nextBin = b + 1;
+          while(binSizes[nextBin] == 0) ++nextBin;
+
+          BinnedSplitCandidate split;
+          split.m_candidateIndex = i;
+          split.m_gain = calculate_information_gain(initialEntropy, leftCounts, rightCounts, leftSize, exampleCount, labelWeights);
+          split.m_threshold = binMinima[nextBin];
+          if(split.m_gain > gainThreshold && split.is_better_than(threadBestSplit)) threadBestSplit = split;
+        }
+      }
+
+      // Combine the best split found by this thread with those found by the other threads.
+#ifdef WITH_OPENMP
+      #pragma omp critical
+#endif
+      {
+        if(threadBestSplit.is_better_than(bestSplit)) bestSplit = threadBestSplit;
+      }
+    }
+
+    // If no split had a high enough gain, early out.
+    if(bestSplit.m_candidateIndex == -1) return Split_CPtr();
+
+    // Otherwise, make the decision function for the best split, and use it to partition the examples.
+    Split_Ptr split(new Split);
+    boost::optional<DecisionFunction::FlatForm> flatForm = candidates[bestSplit.m_candidateIndex]->to_flat_form();
+    if(flatForm)
+    {
+      flatForm->m_threshold = bestSplit.m_threshold;
+      split->m_decisionFunction = make_decision_function(*flatForm);
+    }
+    else split->m_decisionFunction = candidates[bestSplit.m_candidateIndex];
+
+    for(int j = 0; j < exampleCount; ++j)
+    {
+      if(split->m_decisionFunction->classify_descriptor(*examples[j]->get_descriptor()) == DecisionFunction::DC_LEFT)
+      {
+        split->m_leftExamples.push_back(examples[j]);
+      }
+      else
+      {
+        split->m_rightExamples.push_back(examples[j]);
+      }
+    }
+
+    return split;
+  }
+
   //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
 private:
+  /**
+   * \brief Calculates the information gain that results from splitting a set of examples, given the per-label counts of the two halves of the split.
+   *
+   * This calculates exactly the same quantity as the reservoir-based version of the function, but without needing to make any histograms or PMFs.
+   *
+   * \param initialEntropy  The entropy of the example set before the split.
+   * \param leftCounts      The number of examples with each label that end up in the left half of the split.
+   * \param rightCounts     The number of examples with each label that end up in the right half of the split.
+   * \param leftSize        The total number of examples that end up in the left half of the split.
+   * \param exampleCount    The total number of examples.
+   * \param labelWeights    The weights by which to multiply the counts for each label.
+   * \return                The information gain resulting from the split.
+   */
+  static float calculate_information_gain(float initialEntropy, const std::vector<int>& leftCounts, const std::vector<int>& rightCounts, int leftSize, int exampleCount, const std::vector<float>& labelWeights)
+  {
+    float leftWeight = static_cast<float>(leftSize) / exampleCount;
+    float rightWeight = static_cast<float>(exampleCount - leftSize) / exampleCount;
+    return initialEntropy - (leftWeight * calculate_weighted_entropy(leftCounts, labelWeights) + rightWeight * calculate_weighted_entropy(rightCounts, labelWeights));
+  }
+
+
   /**
    * \brief Calculates the information gain that results from splitting an example reservoir in a particular way.
    *
@@ -214,6 +477,54 @@ private:
     return gain;
   }
 
+  /**
+   * \brief Calculates the response of a flat decision function to a descriptor (i.e. the value that it compares to its threshold).
+   *
+   * \param flatForm  The flat form of the decision function.
+   * \param features  A pointer to the features of the descriptor.
+   * \return          The response of the decision function to the descriptor.
+   */
+  static float calculate_response(const DecisionFunction::FlatForm& flatForm, const float *features)
+  {
+    switch(flatForm.m_op)
+    {
+      case DecisionFunction::FlatForm::FO_ADD:
+        return features[flatForm.m_firstFeatureIndex] + features[flatForm.m_secondFeatureIndex];
+      case DecisionFunction::FlatForm::FO_SUBTRACT:
+        return features[flatForm.m_firstFeatureIndex] - features[flatForm.m_secondFeatureIndex];
+      default:
+        return features[flatForm.m_firstFeatureIndex];
+    }
+  }
+
+  /**
+   * \brief Calculates the entropy of the label distribution represented by a set of weighted per-label counts.
+   *
+   * \param counts        The number of examples with each label.
+   * \param labelWeights  The weights by which to multiply the counts for each label.
+   * \return              The entropy of the label distribution.
+   */
+  static float calculate_weighted_entropy(const std::vector<int>& counts, const std::vector<float>& labelWeights)
+  {
+    float sum = 0.0f;
+    for(size_t k = 0, size = counts.size(); k < size; ++k)
+    {
+      sum += counts[k] * labelWeights[k];
+    }
+    if(sum <= 0.0f) return 0.0f;
+
+    float entropy = 0.0f;
+    for(size_t k = 0, size = counts.size(); k < size; ++k)
+    {
+      if(counts[k] > 0)
+      {
+        float mass = counts[k] * labelWeights[k] / sum;
+        entropy += mass * log2(mass);
+      }
+    }
+    return -entropy;
+  }
+
   /**
    * \brief Multiplies together two sets of multipliers that share some labels in common.
    *
@@ -242,6 +553,25 @@ private:
 
     return result;
   }
+
+  /**
+   * \brief Makes a decision function from the specified flat form.
+   *
+   * \param flatForm  The flat form of the decision function.
+   * \return          The decision function.
+   */
+  static DecisionFunction_Ptr make_decision_function(const DecisionFunction::FlatForm& flatForm)
+  {
+    switch(flatForm.m_op)
+    {
+      case DecisionFunction::FlatForm::FO_ADD:
+        return DecisionFunction_Ptr(new PairwiseOpAndThresholdDecisionFunction(flatForm.m_firstFeatureIndex, flatForm.m_secondFeatureIndex, PairwiseOpAndThresholdDecisionFunction::PO_ADD, flatForm.m_threshold));
+      case DecisionFunction::FlatForm::FO_SUBTRACT:
+        return DecisionFunction_Ptr(new PairwiseOpAndThresholdDecisionFunction(flatForm.m_firstFeatureIndex, flatForm.m_secondFeatureIndex, PairwiseOpAndThresholdDecisionFunction::PO_SUBTRACT, flatForm.m_threshold));
+      default:
+        return DecisionFunction_Ptr(new FeatureThresholdingDecisionFunction(flatForm.m_firstFeatureIndex, flatForm.m_threshold));
+    }
+  }
 };
 
 }
@@ -8,7 +8,7 @@
 
 #include <cassert>
 
-#include <tvgutil/numbers/RandomNumberGenerator.h>
+#include <tvgutil/numbers/RandomNumberSource.h>
 
 #include "FeatureBasedDecisionFunctionGenerator.h"
 #include "FeatureThresholdingDecisionFunction.h"
@@ -65,7 +65,7 @@ public:
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
   /** Override */
-  virtual DecisionFunction_Ptr generate_candidate_decision_function(const std::vector<Example_CPtr>& examples, const tvgutil::RandomNumberGenerator_Ptr& randomNumberGenerator) const
+  virtual DecisionFunction_Ptr generate_candidate_decision_function(const std::vector<Example_CPtr>& examples, tvgutil::RandomNumberSource& randomNumberSource) const
   {
     assert(!examples.empty());
 
@@ -73,11 +73,11 @@ public:
 
     // Pick a random feature in the descriptor to threshold.
     std::pair<int,int> featureIndexRange = this->get_feature_index_range(descriptorSize);
-    int featureIndex = randomNumberGenerator->generate_int_from_uniform(featureIndexRange.first, featureIndexRange.second);
+    int featureIndex = randomNumberSource.generate_int_from_uniform(featureIndexRange.first, featureIndexRange.second);
 
     // Select an appropriate threshold by picking a random example and using
     // the value of the chosen feature from that example as the threshold.
-    int exampleIndex = randomNumberGenerator->generate_int_from_uniform(0, static_cast<int>(examples.size()) - 1);
+    int exampleIndex = randomNumberSource.generate_int_from_uniform(0, static_cast<int>(examples.size()) - 1);
     float threshold = (*examples[exampleIndex]->get_descriptor())[featureIndex];
 
     return DecisionFunction_Ptr(new FeatureThresholdingDecisionFunction(featureIndex, threshold));
@@ -72,11 +72,14 @@ private:
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
   /** Override */
-  virtual DescriptorClassification classify_descriptor(const Descriptor& descriptor) const;
+  virtual DescriptorClassification classify_features(const float *features) const;
 
   /** Override */
   virtual void output(std::ostream& os) const;
 
+  /** Override */
+  virtual boost::optional<FlatForm> to_flat_form() const;
+
   //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
 public:
   /**
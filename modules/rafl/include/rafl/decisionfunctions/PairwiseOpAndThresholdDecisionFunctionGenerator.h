@@ -8,7 +8,7 @@
 
 #include <cassert>
 
-#include <tvgutil/numbers/RandomNumberGenerator.h>
+#include <tvgutil/numbers/RandomNumberSource.h>
 
 #include "FeatureBasedDecisionFunctionGenerator.h"
 #include "PairwiseOpAndThresholdDecisionFunction.h"
@@ -65,7 +65,7 @@ public:
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
   /** Override */
-  virtual DecisionFunction_Ptr generate_candidate_decision_function(const std::vector<Example_CPtr>& examples, const tvgutil::RandomNumberGenerator_Ptr& randomNumberGenerator) const
+  virtual DecisionFunction_Ptr generate_candidate_decision_function(const std::vector<Example_CPtr>& examples, tvgutil::RandomNumberSource& randomNumberSource) const
   {
     assert(!examples.empty());
 
@@ -73,19 +73,19 @@ public:
     std::pair<int,int> featureIndexRange = this->get_feature_index_range(descriptorSize);
 
     // Pick the first random feature in the descriptor.
-    int firstFeatureIndex = randomNumberGenerator->generate_int_from_uniform(featureIndexRange.first, featureIndexRange.second);
+    int firstFeatureIndex = randomNumberSource.generate_int_from_uniform(featureIndexRange.first, featureIndexRange.second);
 
     // Pick the second random feature in the descriptor.
-    int secondFeatureIndex = randomNumberGenerator->generate_int_from_uniform(featureIndexRange.first, featureIndexRange.second);
+    int secondFeatureIndex = randomNumberSource.generate_int_from_uniform(featureIndexRange.first, featureIndexRange.second);
 
     // Pick the pairwise operation.
-    int opIndex = randomNumberGenerator->generate_int_from_uniform(0, PairwiseOpAndThresholdDecisionFunction::PO_COUNT - 1);
+    int opIndex = randomNumberSource.generate_int_from_uniform(0, PairwiseOpAndThresholdDecisionFunction::PO_COUNT - 1);
     PairwiseOpAndThresholdDecisionFunction::Op op = static_cast<PairwiseOpAndThresholdDecisionFunction::Op>(opIndex);
 
     // Select an appropriate threshold by picking a random example and using
     // the result of applying the pairwise operation to the chosen features
     // from that example as the threshold.
-    int exampleIndex = randomNumberGenerator->generate_int_from_uniform(0, static_cast<int>(examples.size()) - 1);
+    int exampleIndex = randomNumberSource.generate_int_from_uniform(0, static_cast<int>(examples.size()) - 1);
     const Descriptor& descriptor = (*examples[exampleIndex]->get_descriptor());
     float threshold = PairwiseOpAndThresholdDecisionFunction::apply_op(op, descriptor[firstFeatureIndex], descriptor[secondFeatureIndex]);
 
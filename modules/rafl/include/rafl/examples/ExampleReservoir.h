@@ -8,15 +8,21 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iosfwd>
-#include <iterator>
 #include <map>
 #include <vector>
 
+#include <boost/optional.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
+
 #include <tvgutil/numbers/RandomNumberGenerator.h>
+#include <tvgutil/numbers/RandomNumberSource.h>
 #include <tvgutil/statistics/Histogram.h>
 
 #include "Example.h"
+#include "ExampleReservoirBudget.h"
 
 namespace rafl {
 
@@ -32,13 +38,40 @@ private:
   typedef boost::shared_ptr<tvgutil::Histogram<Label> > Histogram_Ptr;
   typedef boost::shared_ptr<const tvgutil::Histogram<Label> > Histogram_CPtr;
 
+  //#################### NESTED TYPES ####################
+private:
+  /**
+   * \brief An instance of this struct records which of the reservoir's slots contain the examples for a particular class.
+   */
+  struct ClassSlots
+  {
+    /** The label of the class. */
+    Label label;
+
+    /** The indices of the slots that contain the examples for the class. */
+    std::vector<unsigned int> slotIndices;
+
+    explicit ClassSlots(const Label& label_)
+    : label(label_)
+    {}
+  };
+
   //#################### PRIVATE VARIABLES ####################
 private:
-  /** The total number of examples currently in the reservoir. */
-  size_t m_curSize;
+  /** The budget (if any) that limits the total number of examples that can be stored in this and any other reservoirs sharing it. */
+  ExampleReservoirBudget_Ptr m_budget;
 
-  /** The examples in the reservoir. */
-  std::map<Label,std::vector<Example_CPtr> > m_examples;
+  /** The slots used by the different classes that have examples in the reservoir (there are normally only a few of these). */
+  std::vector<ClassSlots> m_classSlots;
+
+  /**
+   * The sum, over the bins of the histogram, of c log2(c), where c is the count in the bin. This is maintained incrementally
+   * as examples are added, so that the (unweighted) entropy of the histogram can be calculated in constant time.
+   */
+  double m_countEntropyTerm;
+
+  /** The examples in the reservoir, stored contiguously in a flat array of slots (examples of different classes may be interleaved). */
+  std::vector<Example_CPtr> m_examples;
 
   /** The histogram of the label distribution of all of the examples that have ever been added to the reservoir. */
   Histogram_Ptr m_histogram;
@@ -46,9 +79,6 @@ private:
   /** The maximum number of examples of each class allowed in the reservoir at any one time. */
   size_t m_maxClassSize;
 
-  /** A random number generator. */
-  tvgutil::RandomNumberGenerator_Ptr m_randomNumberGenerator;
-
   /** The total number of examples that have been added to the reservoir over time. */
   size_t m_seenExamples;
 
@@ -58,13 +88,15 @@ public:
    * \brief Constructs a reservoir that can store at most the specified number of examples of each class.
    *
    * Adding more than the specified number of examples of a particular class to the reservoir may result
-   * in some of the older examples for that class being (randomly) discarded.
+   * in some of the older examples for that class being (randomly) discarded. The same happens if the
+   * reservoir has a budget and that budget has been exhausted.
    *
-   * \param maxClassSize          The maximum number of examples of each class allowed in the reservoir at any one time.
-   * \param randomNumberGenerator A random number generator.
+   * \param maxClassSize  The maximum number of examples of each class allowed in the reservoir at any one time.
+   * \param budget        An optional budget that limits the total number of examples that can be stored in the reservoir
+   *                      and any other reservoirs that share the same budget.
    */
-  ExampleReservoir(size_t maxClassSize, const tvgutil::RandomNumberGenerator_Ptr& randomNumberGenerator)
-  : m_curSize(0), m_histogram(new tvgutil::Histogram<Label>), m_maxClassSize(maxClassSize), m_randomNumberGenerator(randomNumberGenerator), m_seenExamples(0)
+  explicit ExampleReservoir(size_t maxClassSize, const ExampleReservoirBudget_Ptr& budget = ExampleReservoirBudget_Ptr())
+  : m_budget(budget), m_countEntropyTerm(0.0), m_histogram(new tvgutil::Histogram<Label>), m_maxClassSize(maxClassSize), m_seenExamples(0)
   {}
 
   /**
@@ -72,57 +104,130 @@ public:
    *
    * Note: This constructor is needed for serialization and should not be used otherwise.
    */
-  ExampleReservoir() {}
+  ExampleReservoir()
+  : m_countEntropyTerm(0.0), m_maxClassSize(0), m_seenExamples(0)
+  {}
+
+private:
+  // Deliberately private and unimplemented (copying a reservoir would double-count its examples against its budget).
+  ExampleReservoir(const ExampleReservoir&);
+  ExampleReservoir& operator=(const ExampleReservoir&);
+
+  //#################### DESTRUCTOR ####################
+public:
+  /**
+   * \brief Destroys the reservoir, returning its slots to its budget (if any).
+   */
+  ~ExampleReservoir()
+  {
+    if(m_budget) m_budget->release(m_examples.size());
+  }
 
   //#################### PUBLIC MEMBER FUNCTIONS ####################
 public:
   /**
    * \brief Adds an example to the reservoir.
    *
-   * If there is already a full complement of examples for the class corresponding to the new example's label in the reservoir,
-   * an older example of that class may be (randomly) discarded to make space for the new one. If not, the new example itself
-   * is discarded.
+   * If there is already a full complement of examples for the class corresponding to the new example's label in the reservoir
+   * (or the reservoir's budget has been exhausted), an older example of that class may be (randomly) discarded to make space
+   * for the new one. If not, the new example itself is discarded. Replacing an example takes constant time.
+   *
+   * The reservoir does not own a random number generator: instead, the caller supplies the source of random numbers to use.
+   * This allows a tree to use a single lock-free stream for all of its reservoirs, rather than a shared, mutex-locked generator.
    *
-   * \param example The example to be added.
-   * \return        true, if the example was actually added to the reservoir, or false otherwise.
+   * \param example             The example to be added.
+   * \param randomNumberSource  The source of the random numbers used to decide which example (if any) to discard.
+   * \return                    true, if the example was actually added to the reservoir, or false otherwise.
    */
-  bool add_example(const Example_CPtr& example)
+  bool add_example(const Example_CPtr& example, tvgutil::RandomNumberSource& randomNumberSource)
   {
     bool changed = false;
 
-    std::vector<Example_CPtr>& examplesForClass = m_examples[example->get_label()];
-    if(examplesForClass.size() < m_maxClassSize)
+    // Look up the number of examples of this class that have been seen so far.
+    const typename tvgutil::Histogram<Label>::Bins& bins = m_histogram->get_bins();
+    typename tvgutil::Histogram<Label>::Bins::const_iterator binIt = bins.find(example->get_label());
+    size_t binSize = binIt != bins.end() ? binIt->second : 0;
+
+    std::vector<unsigned int>& slotIndices = get_class_slots(example->get_label()).slotIndices;
+    if(slotIndices.size() < m_maxClassSize && (!m_budget || m_budget->try_acquire()))
     {
-      // If we haven't yet reached the maximum number of examples for this class, simply add the new one.
-      examplesForClass.push_back(example);
-      ++m_curSize;
+      // If we haven't yet reached the maximum number of examples for this class, and there is room in the budget, simply add the new one.
+      slotIndices.push_back(static_cast<unsigned int>(m_examples.size()));
+      m_examples.push_back(example);
       changed = true;
     }
-    else
+    else if(!slotIndices.empty())
     {
       // Otherwise, randomly decide whether or not to replace one of the existing examples for this class with the new one.
-      size_t binSize = m_histogram->get_bins().find(example->get_label())->second;
-      size_t k = m_randomNumberGenerator->generate_int_from_uniform(0, static_cast<int>(binSize) - 1);
-      if(k < examplesForClass.size())
+      size_t k = randomNumberSource.generate_int_from_uniform(0, static_cast<int>(binSize) - 1);
+      if(k < slotIndices.size())
       {
-        examplesForClass[k] = example;
+        m_examples[slotIndices[k]] = example;
         changed = true;
       }
     }
 
+    // Update the histogram, and adjust the entropy term to account for the change to the relevant bin.
     m_histogram->add(example->get_label());
+    m_countEntropyTerm += count_entropy_term(binSize + 1) - count_entropy_term(binSize);
     ++m_seenExamples;
     return changed;
   }
 
   /**
-   * \brief Clears the reservoir.
+   * \brief Calculates the entropy of the label distribution of all of the examples that have ever been added to the reservoir.
+   *
+   * This gives the same result as ExampleUtil::calculate_entropy on the reservoir's histogram (up to rounding), but is much cheaper:
+   * without multipliers, it takes constant time, and with multipliers, it takes time linear in the number of bins, with no allocations.
+   * The weighted entropy is deliberately not maintained incrementally, since the multipliers used by DecisionTree (its inverse class
+   * weights) change every time examples are added to the tree, which would invalidate any cached weighted terms anyway.
+   *
+   * \param multipliers Optional per-class ratios that can be used to scale the probabilities for the different labels.
+   * \return            The entropy of the label distribution.
+   */
+  float calculate_entropy(const boost::optional<std::map<Label,float> >& multipliers = boost::none) const
+  {
+    if(!m_histogram || m_histogram->empty()) return 0.0f;
+
+    // If the probabilities of the labels are proportional to the weighted counts a_i = c_i w_i, and S and T denote the sums
+    // of a_i and a_i log2(a_i) respectively, then the entropy is -sum_i (a_i/S) log2(a_i/S) = log2(S) - T/S.
+    double sum, term;
+    if(!multipliers)
+    {
+      sum = static_cast<double>(m_histogram->get_count());
+      term = m_countEntropyTerm;
+    }
+    else
+    {
+      sum = term = 0.0;
+
+      // Note: The bins and multipliers are both ordered by label, so we can find the multipliers for the bins in a single pass.
+      const typename tvgutil::Histogram<Label>::Bins& bins = m_histogram->get_bins();
+      typename std::map<Label,float>::const_iterator jt = multipliers->begin(), jend = multipliers->end();
+      for(typename tvgutil::Histogram<Label>::Bins::const_iterator it = bins.begin(), iend = bins.end(); it != iend; ++it)
+      {
+        while(jt != jend && jt->first < it->first) ++jt;
+        double weightedCount = static_cast<double>(it->second);
+        if(jt != jend && !(it->first < jt->first)) weightedCount *= jt->second;
+
+        sum += weightedCount;
+        term += weightedCount * log2(weightedCount);
+      }
+    }
+
+    return static_cast<float>(std::max(log2(sum) - term / sum, 0.0));
+  }
+
+  /**
+   * \brief Clears the reservoir, returning its slots to its budget (if any) and releasing the memory it uses.
    */
   void clear()
   {
-    m_examples.clear();
+    if(m_budget) m_budget->release(m_examples.size());
+    m_countEntropyTerm = 0.0;
+    std::vector<ClassSlots>().swap(m_classSlots);
+    std::vector<Example_CPtr>().swap(m_examples);
     m_histogram.reset();
-    m_randomNumberGenerator.reset();
   }
 
   /**
@@ -132,44 +237,43 @@ public:
    */
   size_t current_size() const
   {
-    return m_curSize;
+    return m_examples.size();
   }
 
   /**
    * \brief Gets the per-class ratios between the total number of examples seen for a class and the number of examples currently in the reservoir.
    *
+   * Classes that have been seen but have no examples currently in the reservoir (which can happen if its budget has been exhausted) are omitted.
+   *
    * \return  The per-class ratios between the total number of examples seen for a class and the number of examples currently in the reservoir.
    */
   std::map<Label,float> get_class_multipliers() const
   {
     std::map<Label,float> result;
 
-    const std::map<Label,size_t>& bins = m_histogram->get_bins();
-    typename std::map<Label,std::vector<Example_CPtr> >::const_iterator it = m_examples.begin(), iend = m_examples.end();
-    typename std::map<Label,size_t>::const_iterator jt = bins.begin();
-    for(; it != iend; ++it, ++jt)
+    const typename tvgutil::Histogram<Label>::Bins& bins = m_histogram->get_bins();
+    for(typename std::vector<ClassSlots>::const_iterator it = m_classSlots.begin(), iend = m_classSlots.end(); it != iend; ++it)
     {
-      assert(it->first == jt->first);
-      result.insert(std::make_pair(it->first, static_cast<float>(jt->second) / it->second.size()));
+      if(it->slotIndices.empty()) continue;
+      typename tvgutil::Histogram<Label>::Bins::const_iterator jt = bins.find(it->label);
+      assert(jt != bins.end());
+      result.insert(std::make_pair(it->label, static_cast<float>(jt->second) / it->slotIndices.size()));
     }
 
     return result;
   }
 
   /**
-   * \brief Gets the examples currently in the reservoir.
+   * \brief Gets a view of the examples currently in the reservoir.
+   *
+   * No copying is involved: the returned reference is to the reservoir's own slot array, and remains valid (and reflects any
+   * subsequent changes to the reservoir) until the reservoir is cleared or destroyed.
    *
    * \return  The examples currently in the reservoir.
    */
-  std::vector<Example_CPtr> get_examples() const
+  const std::vector<Example_CPtr>& get_examples() const
   {
-    std::vector<Example_CPtr> examples;
-    examples.reserve(m_curSize);
-    for(typename std::map<Label,std::vector<Example_CPtr> >::const_iterator it = m_examples.begin(), iend = m_examples.end(); it != iend; ++it)
-    {
-      std::copy(it->second.begin(), it->second.end(), std::back_inserter(examples));
-    }
-    return examples;
+    return m_examples;
   }
 
   /**
@@ -192,6 +296,65 @@ public:
     return m_seenExamples;
   }
 
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Gets the slots used by the class with the specified label, adding an empty entry for the class if necessary.
+   *
+   * \param label The label of the class.
+   * \return      The slots used by the class.
+   */
+  ClassSlots& get_class_slots(const Label& label)
+  {
+    for(typename std::vector<ClassSlots>::iterator it = m_classSlots.begin(), iend = m_classSlots.end(); it != iend; ++it)
+    {
+      if(it->label == label) return *it;
+    }
+
+    m_classSlots.push_back(ClassSlots(label));
+    return m_classSlots.back();
+  }
+
+  /**
+   * \brief Rebuilds the record of which slots are used by which classes from the examples in the slots.
+   */
+  void rebuild_class_slots()
+  {
+    m_classSlots.clear();
+    for(size_t i = 0, size = m_examples.size(); i < size; ++i)
+    {
+      get_class_slots(m_examples[i]->get_label()).slotIndices.push_back(static_cast<unsigned int>(i));
+    }
+  }
+
+  /**
+   * \brief Recalculates the entropy term from scratch using the histogram.
+   */
+  void recalculate_count_entropy_term()
+  {
+    m_countEntropyTerm = 0.0;
+    if(!m_histogram) return;
+
+    const typename tvgutil::Histogram<Label>::Bins& bins = m_histogram->get_bins();
+    for(typename tvgutil::Histogram<Label>::Bins::const_iterator it = bins.begin(), iend = bins.end(); it != iend; ++it)
+    {
+      m_countEntropyTerm += count_entropy_term(it->second);
+    }
+  }
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Calculates the contribution c log2(c) that a histogram bin with the specified count makes to the entropy term.
+   *
+   * \param count The count in the bin.
+   * \return      The contribution of the bin to the entropy term.
+   */
+  static double count_entropy_term(size_t count)
+  {
+    return count > 0 ? count * log2(static_cast<double>(count)) : 0.0;
+  }
+
   //#################### STREAM OPERATORS ####################
 
   /**
@@ -214,25 +377,96 @@ public:
   //#################### SERIALIZATION #################### 
 private:
   /**
-   * \brief Serializes the example reservoir to/from an archive.
+   * \brief Loads the example reservoir from an archive.
+   *
+   * Reservoirs saved in the original format (version 0), which stored their examples in a map from labels to per-class
+   * example vectors and had no budget, are converted to the current format as they are loaded. Their examples are placed
+   * in the slots class by class, and they are not subject to any budget. They also stored a random number generator, which
+   * is now supplied by the caller of add_example, and so is skipped.
+   *
+   * \param ar      The archive.
+   * \param version The file format version number.
+   */
+  template <typename Archive>
+  void load(Archive& ar, const unsigned int version)
+  {
+    if(version == 0)
+    {
+      size_t curSize;
+      std::map<Label,std::vector<Example_CPtr> > examplesByClass;
+      ar & curSize;
+      ar & examplesByClass;
+
+      m_budget.reset();
+      m_examples.clear();
+      m_examples.reserve(curSize);
+      for(typename std::map<Label,std::vector<Example_CPtr> >::const_iterator it = examplesByClass.begin(), iend = examplesByClass.end(); it != iend; ++it)
+      {
+        m_examples.insert(m_examples.end(), it->second.begin(), it->second.end());
+      }
+    }
+    else
+    {
+      ar & m_budget;
+      ar & m_examples;
+    }
+
+    ar & m_histogram;
+    ar & m_maxClassSize;
+
+    if(version == 0)
+    {
+      tvgutil::RandomNumberGenerator_Ptr randomNumberGenerator;
+      ar & randomNumberGenerator;
+    }
+
+    ar & m_seenExamples;
+
+    // Neither the class slots nor the entropy term are saved, since they can be recalculated from the examples and the histogram.
+    rebuild_class_slots();
+    recalculate_count_entropy_term();
+  }
+
+  /**
+   * \brief Saves the example reservoir to an archive.
    *
    * \param ar      The archive.
    * \param version The file format version number.
    */
   template <typename Archive>
-  void serialize(Archive& ar, const unsigned int version)
+  void save(Archive& ar, const unsigned int version) const
   {
-    ar & m_curSize;
+    ar & m_budget;
     ar & m_examples;
     ar & m_histogram;
     ar & m_maxClassSize;
-    ar & m_randomNumberGenerator;
     ar & m_seenExamples;
   }
 
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+
   friend class boost::serialization::access;
 };
 
 }
 
+//#################### SERIALIZATION TRAITS ####################
+
+namespace boost {
+namespace serialization {
+
+/**
+ * \brief Example reservoirs are saved in version 1 of their format (version 0 is the original, map-based format).
+ */
+template <typename Label>
+struct version<rafl::ExampleReservoir<Label> >
+{
+  typedef mpl::integral_c_tag tag;
+  typedef mpl::int_<1> type;
+  BOOST_STATIC_CONSTANT(int, value = 1);
+};
+
+}
+}
+
 #endif
@@ -0,0 +1,139 @@
+/**
+ * rafl: ExampleReservoirBudget.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2015. All rights reserved.
+ */
+
+#ifndef H_RAFL_EXAMPLERESERVOIRBUDGET
+#define H_RAFL_EXAMPLERESERVOIRBUDGET
+
+#include <boost/serialization/serialization.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace rafl {
+
+/**
+ * \brief An instance of this class limits the total number of examples that can be stored in a set of example reservoirs
+ *        (e.g. all of the reservoirs in a decision tree), so as to put a hard bound on the memory they use.
+ *
+ * Reservoirs acquire a slot from their budget before storing a new example, and release their slots when they are cleared.
+ * Once a budget is exhausted, reservoirs can only replace the examples they already store. Acquiring and releasing slots is
+ * thread-safe with respect to OpenMP threads, but note that if several trees that share a budget are trained concurrently,
+ * the order in which they acquire slots (and hence the trees themselves) will not be reproducible. For this reason, random
+ * forests give each of their trees a separate budget.
+ */
+class ExampleReservoirBudget
+{
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The maximum number of examples that may be stored at any one time (0 means that there is no limit). */
+  size_t m_capacity;
+
+  /** The number of examples that are currently stored. */
+  size_t m_used;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a budget.
+   *
+   * \param capacity  The maximum number of examples that may be stored at any one time (0 means that there is no limit).
+   */
+  explicit ExampleReservoirBudget(size_t capacity)
+  : m_capacity(capacity), m_used(0)
+  {}
+
+private:
+  /**
+   * \brief Constructs a budget.
+   *
+   * Note: This constructor is needed for serialization and should not be used otherwise.
+   */
+  ExampleReservoirBudget()
+  : m_capacity(0), m_used(0)
+  {}
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets the maximum number of examples that may be stored at any one time.
+   *
+   * \return  The maximum number of examples that may be stored at any one time (0 means that there is no limit).
+   */
+  size_t get_capacity() const
+  {
+    return m_capacity;
+  }
+
+  /**
+   * \brief Gets the number of examples that are currently stored (this is only tracked if the budget is limited).
+   *
+   * \return  The number of examples that are currently stored.
+   */
+  size_t get_used() const
+  {
+    return m_used;
+  }
+
+  /**
+   * \brief Releases the specified number of slots back to the budget.
+   *
+   * \param count The number of slots to release.
+   */
+  void release(size_t count)
+  {
+    if(m_capacity == 0) return;
+
+#ifdef WITH_OPENMP
+    #pragma omp critical(rafl_ExampleReservoirBudget)
+#endif
+    m_used -= count;
+  }
+
+  /**
+   * \brief Attempts to acquire a slot in which to store a new example.
+   *
+   * \return  true, if a slot was successfully acquired, or false if the budget has been exhausted.
+   */
+  bool try_acquire()
+  {
+    if(m_capacity == 0) return true;
+
+    bool acquired = false;
+
+#ifdef WITH_OPENMP
+    #pragma omp critical(rafl_ExampleReservoirBudget)
+#endif
+    if(m_used < m_capacity)
+    {
+      ++m_used;
+      acquired = true;
+    }
+
+    return acquired;
+  }
+
+  //#################### SERIALIZATION ####################
+private:
+  /**
+   * \brief Serializes the budget to/from an archive.
+   *
+   * \param ar      The archive.
+   * \param version The file format version number.
+   */
+  template <typename Archive>
+  void serialize(Archive& ar, const unsigned int version)
+  {
+    ar & m_capacity;
+    ar & m_used;
+  }
+
+  friend class boost::serialization::access;
+};
+
+//#################### TYPEDEFS ####################
+
+typedef boost::shared_ptr<ExampleReservoirBudget> ExampleReservoirBudget_Ptr;
+
+}
+
+#endif
@@ -6,9 +6,18 @@
 #ifndef H_RAFL_EXAMPLEUTIL
 #define H_RAFL_EXAMPLEUTIL
 
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_pod.hpp>
 
-#include <tvgutil/persistence/LineUtil.h>
 #include <tvgutil/statistics/ProbabilityMassFunction.h>
 
 #include "Example.h"
@@ -20,6 +29,11 @@ namespace rafl {
  */
 class ExampleUtil
 {
+  //#################### CONSTANTS ####################
+private:
+  /** The version of the binary example format that is written by save_binary_examples. */
+  static const boost::uint32_t BINARY_VERSION = 1;
+
   //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
 public:
   /**
@@ -50,41 +64,45 @@ public:
     return histogram.empty() ? 0.0f : tvgutil::ProbabilityMassFunction<Label>(histogram, multipliers).calculate_entropy();
   }
 
+  /**
+   * \brief Determines whether or not the specified file contains examples in the binary format written by save_binary_examples.
+   *
+   * \param filename  The name of the file.
+   * \return          true, if the file starts with the signature of the binary example format, or false otherwise.
+   */
+  static bool is_binary_example_file(const std::string& filename)
+  {
+    std::ifstream fs(filename.c_str(), std::ios::binary);
+    char magic[8];
+    return fs.read(magic, sizeof(magic)) && memcmp(magic, binary_magic(), sizeof(magic)) == 0;
+  }
+
   /**
    * \brief Loads a set of examples from the specified file.
    *
-   * \param filename  The name of the file from which to load the examples.
-   * \return          The loaded examples.
+   * The file can either be in the binary format written by save_binary_examples, or be a text file with one example per line,
+   * in which the descriptor features are followed by the label, and the fields are separated by commas and/or whitespace.
+   * Blank lines in text files are ignored. Text files are parsed in parallel if OpenMP is available.
+   *
+   * \param filename            The name of the file from which to load the examples.
+   * \return                    The loaded examples.
+   * \throws std::runtime_error If the file cannot be read, or does not contain valid examples. For text files, the error
+   *                            message specifies the line and column at which the first problem was found.
    */
   template <typename Label>
   static std::vector<boost::shared_ptr<const Example<Label> > > load_examples(const std::string& filename)
   {
-    // FIXME: Make this robust to bad data.
-
-    typedef boost::shared_ptr<const Example<Label> > Example_CPtr;
-    std::vector<Example_CPtr> result;
-
-    std::ifstream fs(filename.c_str());
+    std::ifstream fs(filename.c_str(), std::ios::binary);
     if(!fs) throw std::runtime_error("Error: '" + filename + "' could not be opened");
 
-    const std::string delimiters(", ");
-    std::vector<std::vector<std::string> > wordLines = tvgutil::LineUtil::extract_word_lines(fs, delimiters);
+    // Read the entire file into memory.
+    fs.seekg(0, std::ios::end);
+    std::string contents(static_cast<size_t>(fs.tellg()), '\0');
+    fs.seekg(0, std::ios::beg);
+    if(!contents.empty() && !fs.read(&contents[0], contents.size())) throw std::runtime_error("Error: '" + filename + "' could not be read");
 
-    for(size_t i = 0, lineCount = wordLines.size(); i < lineCount; ++i)
-    {
-      const std::vector<std::string>& words = wordLines[i];
-
-      Descriptor_Ptr descriptor(new Descriptor);
-      for(size_t j = 0; j < words.size() - 1; ++j)
-      {
-        descriptor->push_back(boost::lexical_cast<float>(words[j]));
-      }
-
-      Label label = boost::lexical_cast<Label>(words.back());
-      result.push_back(Example_CPtr(new Example<Label>(descriptor, label)));
-    }
-
-    return result;
+    if(contents.size() >= 8 && memcmp(contents.data(), binary_magic(), 8) == 0) return read_binary_examples<Label>(contents, filename);
+    else return parse_text_examples<Label>(contents, filename);
   }
 
   /**
@@ -120,6 +138,302 @@ public:
   {
     return tvgutil::ProbabilityMassFunction<Label>(make_histogram(examples), multipliers);
   }
+
+  /**
+   * \brief Saves a set of examples to the specified file in a compact binary format.
+   *
+   * The format consists of a header (an 8-byte signature, followed by four 32-bit unsigned integers specifying the format version,
+   * a byte-order mark, sizeof(Label) and a reserved zero, followed by two 64-bit unsigned integers specifying the numbers of examples
+   * and features), followed by the descriptors as a row-major float matrix, followed by the labels. Values are stored in the native
+   * byte order of the machine that wrote the file.
+   *
+   * \param examples            The examples to save.
+   * \param filename            The name of the file to which to save the examples.
+   * \throws std::runtime_error If the examples do not all have the same number of features, or the file cannot be written.
+   */
+  template <typename Label>
+  static void save_binary_examples(const std::vector<boost::shared_ptr<const Example<Label> > >& examples, const std::string& filename)
+  {
+    BOOST_STATIC_ASSERT(boost::is_pod<Label>::value);
+
+    const size_t exampleCount = examples.size();
+    const size_t featureCount = exampleCount > 0 ? examples[0]->get_descriptor()->size() : 0;
+    for(size_t i = 0; i < exampleCount; ++i)
+    {
+      if(examples[i]->get_descriptor()->size() != featureCount) throw std::runtime_error("Error: Cannot save examples with differing numbers of features");
+    }
+
+    std::ofstream fs(filename.c_str(), std::ios::binary);
+    if(!fs) throw std::runtime_error("Error: '" + filename + "' could not be opened for writing");
+
+    const boost::uint32_t header[] = { BINARY_VERSION, 0x01020304, sizeof(Label), 0 };
+    const boost::uint64_t sizes[] = { exampleCount, featureCount };
+    fs.write(binary_magic(), 8);
+    fs.write(reinterpret_cast<const char*>(header), sizeof(header));
+    fs.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+
+    for(size_t i = 0; i < exampleCount && featureCount > 0; ++i)
+    {
+      fs.write(reinterpret_cast<const char*>(&(*examples[i]->get_descriptor())[0]), featureCount * sizeof(float));
+    }
+
+    for(size_t i = 0; i < exampleCount; ++i)
+    {
+      const Label label = examples[i]->get_label();
+      fs.write(reinterpret_cast<const char*>(&label), sizeof(Label));
+    }
+
+    if(!fs) throw std::runtime_error("Error: The examples could not be written to '" + filename + "'");
+  }
+
+  /**
+   * \brief Saves a set of examples to the specified file in the text format understood by load_examples.
+   *
+   * Each example is written on a separate line, as its comma-separated features followed by its label.
+   * The features are written with enough precision to be read back exactly.
+   *
+   * \param examples            The examples to save.
+   * \param filename            The name of the file to which to save the examples.
+   * \throws std::runtime_error If the file cannot be written.
+   */
+  template <typename Label>
+  static void save_text_examples(const std::vector<boost::shared_ptr<const Example<Label> > >& examples, const std::string& filename)
+  {
+    std::ofstream fs(filename.c_str());
+    if(!fs) throw std::runtime_error("Error: '" + filename + "' could not be opened for writing");
+
+    fs << std::setprecision(9);
+    for(size_t i = 0, size = examples.size(); i < size; ++i)
+    {
+      const Descriptor& descriptor = *examples[i]->get_descriptor();
+      for(size_t j = 0, featureCount = descriptor.size(); j < featureCount; ++j)
+      {
+        fs << descriptor[j] << ',';
+      }
+      fs << examples[i]->get_label() << '\n';
+    }
+
+    if(!fs) throw std::runtime_error("Error: The examples could not be written to '" + filename + "'");
+  }
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Gets the signature at the start of a file in the binary example format.
+   *
+   * \return  The signature (the first 8 characters of the returned string).
+   */
+  static const char *binary_magic()
+  {
+    return "RAFLEXMP";
+  }
+
+  /**
+   * \brief Determines whether or not the specified character separates the fields of an example in a text file.
+   *
+   * \param c The character.
+   * \return  true, if the character is a field separator, or false otherwise.
+   */
+  static bool is_separator(char c)
+  {
+    return c == ',' || c == ' ' || c == '\t' || c == '\r';
+  }
+
+  /**
+   * \brief Parses a set of examples from the contents of a text file.
+   *
+   * The lines are split into chunks that are parsed in parallel. Any errors are collected during parsing,
+   * and the one that occurs earliest in the file is reported once parsing is complete.
+   *
+   * \param contents            The contents of the file (a null-terminated string).
+   * \param filename            The name of the file (used in error messages).
+   * \return                    The examples.
+   * \throws std::runtime_error If the contents do not represent a valid set of examples.
+   */
+  template <typename Label>
+  static std::vector<boost::shared_ptr<const Example<Label> > > parse_text_examples(const std::string& contents, const std::string& filename)
+  {
+    typedef boost::shared_ptr<const Example<Label> > Example_CPtr;
+
+    // Find the start of each line.
+    const char *text = contents.c_str();
+    const char *textEnd = text + contents.size();
+    std::vector<const char*> lineStarts;
+    for(const char *p = text; p < textEnd; ++p)
+    {
+      lineStarts.push_back(p);
+      p = static_cast<const char*>(memchr(p, '\n', textEnd - p));
+      if(!p) break;
+    }
+
+    // Parse the lines in parallel. Blank lines are left as null examples.
+    const int lineCount = static_cast<int>(lineStarts.size());
+    std::vector<Example_CPtr> lineExamples(lineCount);
+    int errorLine = INT_MAX;
+    std::string errorMessage;
+
+#ifdef WITH_OPENMP
+    #pragma omp parallel
+#endif
+    {
+      std::vector<std::pair<const char*,const char*> > fields;
+
+#ifdef WITH_OPENMP
+      #pragma omp for schedule(dynamic, 1024)
+#endif
+      for(int i = 0; i < lineCount; ++i)
+      {
+        const char *lineStart = lineStarts[i];
+        const char *lineEnd = static_cast<const char*>(memchr(lineStart, '\n', textEnd - lineStart));
+        if(!lineEnd) lineEnd = textEnd;
+
+        // Split the line into fields.
+        fields.clear();
+        for(const char *p = lineStart; p < lineEnd;)
+        {
+          if(is_separator(*p)) { ++p; continue; }
+          const char *fieldStart = p;
+          while(p < lineEnd && !is_separator(*p)) ++p;
+          fields.push_back(std::make_pair(fieldStart, p));
+        }
+        if(fields.empty()) continue;
+
+        // Parse the features and the label.
+        std::string error;
+        const char *errorField = NULL;
+        Descriptor_Ptr descriptor(new Descriptor(fields.size() - 1));
+        for(size_t j = 0, featureCount = fields.size() - 1; j < featureCount && !errorField; ++j)
+        {
+          char *parseEnd;
+          (*descriptor)[j] = strtof(fields[j].first, &parseEnd);
+          if(parseEnd != fields[j].second)
+          {
+            errorField = fields[j].first;
+            error = "'" + std::string(fields[j].first, fields[j].second) + "' is not a valid feature";
+          }
+        }
+
+        Label label = Label();
+        if(!errorField)
+        {
+          if(fields.size() == 1)
+          {
+            errorField = fields[0].first;
+            error = "the example has no features";
+          }
+          else
+          {
+            try
+            {
+              label = boost::lexical_cast<Label>(fields.back().first, fields.back().second - fields.back().first);
+            }
+            catch(boost::bad_lexical_cast&)
+            {
+              errorField = fields.back().first;
+              error = "'" + std::string(fields.back().first, fields.back().second) + "' is not a valid label";
+            }
+          }
+        }
+
+        if(errorField)
+        {
+#ifdef WITH_OPENMP
+          #pragma omp critical
+#endif
+          if(i < errorLine)
+          {
+            errorLine = i;
+            errorMessage = make_text_error(filename, i, errorField - lineStart, error);
+          }
+        }
+        else lineExamples[i].reset(new Example<Label>(descriptor, label));
+      }
+    }
+
+    if(errorLine != INT_MAX) throw std::runtime_error(errorMessage);
+
+    // Collect the examples from the non-blank lines, checking that they all have the same number of features.
+    std::vector<Example_CPtr> examples;
+    examples.reserve(lineCount);
+    for(int i = 0; i < lineCount; ++i)
+    {
+      if(!lineExamples[i]) continue;
+      if(!examples.empty() && lineExamples[i]->get_descriptor()->size() != examples[0]->get_descriptor()->size())
+      {
+        std::ostringstream oss;
+        oss << "expected " << examples[0]->get_descriptor()->size() << " features, but found " << lineExamples[i]->get_descriptor()->size();
+        throw std::runtime_error(make_text_error(filename, i, 0, oss.str()));
+      }
+      examples.push_back(lineExamples[i]);
+    }
+
+    return examples;
+  }
+
+  /**
+   * \brief Makes an error message for a problem found whilst parsing a text file of examples.
+   *
+   * \param filename    The name of the file.
+   * \param lineIndex   The (0-based) index of the line on which the problem was found.
+   * \param columnIndex The (0-based) index of the column at which the problem was found.
+   * \param error       A description of the problem.
+   * \return            The error message.
+   */
+  static std::string make_text_error(const std::string& filename, int lineIndex, ptrdiff_t columnIndex, const std::string& error)
+  {
+    std::ostringstream oss;
+    oss << "Error: Bad example in '" << filename << "' at line " << lineIndex + 1 << ", column " << columnIndex + 1 << ": " << error;
+    return oss.str();
+  }
+
+  /**
+   * \brief Reads a set of examples from the contents of a file in the binary format written by save_binary_examples.
+   *
+   * \param contents            The contents of the file.
+   * \param filename            The name of the file (used in error messages).
+   * \return                    The examples.
+   * \throws std::runtime_error If the contents do not represent a valid set of examples.
+   */
+  template <typename Label>
+  static std::vector<boost::shared_ptr<const Example<Label> > > read_binary_examples(const std::string& contents, const std::string& filename)
+  {
+    BOOST_STATIC_ASSERT(boost::is_pod<Label>::value);
+    typedef boost::shared_ptr<const Example<Label> > Example_CPtr;
+
+    const size_t headerSize = 8 + 4 * sizeof(boost::uint32_t) + 2 * sizeof(boost::uint64_t);
+    if(contents.size() < headerSize) throw std::runtime_error("Error: The example file '" + filename + "' is truncated");
+
+    boost::uint32_t header[4];
+    boost::uint64_t sizes[2];
+    memcpy(header, contents.data() + 8, sizeof(header));
+    memcpy(sizes, contents.data() + 8 + sizeof(header), sizeof(sizes));
+    if(header[0] != BINARY_VERSION) throw std::runtime_error("Error: The example file '" + filename + "' has an unsupported format version");
+    if(header[1] != 0x01020304) throw std::runtime_error("Error: The example file '" + filename + "' was written on a machine with a different byte order");
+    if(header[2] != sizeof(Label)) throw std::runtime_error("Error: The example file '" + filename + "' was written for a different label type");
+
+    const boost::uint64_t exampleCount = sizes[0], featureCount = sizes[1];
+    if((featureCount != 0 && exampleCount > (contents.size() - headerSize) / (featureCount * sizeof(float))) ||
+       contents.size() - headerSize != exampleCount * (featureCount * sizeof(float) + sizeof(Label)))
+    {
+      throw std::runtime_error("Error: The size of the example file '" + filename + "' does not match its header");
+    }
+
+    const char *features = contents.data() + headerSize;
+    const char *labels = features + exampleCount * featureCount * sizeof(float);
+    std::vector<Example_CPtr> examples(static_cast<size_t>(exampleCount));
+    for(size_t i = 0, size = examples.size(); i < size; ++i)
+    {
+      Descriptor_Ptr descriptor(new Descriptor(static_cast<size_t>(featureCount)));
+      if(featureCount > 0) memcpy(&(*descriptor)[0], features + i * featureCount * sizeof(float), featureCount * sizeof(float));
+
+      Label label;
+      memcpy(&label, labels + i * sizeof(Label), sizeof(Label));
+
+      examples[i].reset(new Example<Label>(descriptor, label));
+    }
+
+    return examples;
+  }
 };
 
 }
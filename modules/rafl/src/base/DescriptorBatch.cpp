@@ -0,0 +1,80 @@
+/**
+ * rafl: DescriptorBatch.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2015. All rights reserved.
+ */
+
+#include "base/DescriptorBatch.h"
+
+#include <stdexcept>
+
+namespace rafl {
+
+//#################### CONSTRUCTORS ####################
+
+DescriptorBatch::DescriptorBatch()
+: m_data(NULL), m_descriptorCount(0), m_featureCount(0), m_ownsData(true)
+{}
+
+DescriptorBatch::DescriptorBatch(size_t descriptorCount, size_t featureCount)
+: m_data(NULL), m_descriptorCount(0), m_featureCount(0), m_ownsData(true)
+{
+  resize(descriptorCount, featureCount);
+}
+
+DescriptorBatch::DescriptorBatch(const float *data, size_t descriptorCount, size_t featureCount)
+: m_data(data), m_descriptorCount(descriptorCount), m_featureCount(featureCount), m_ownsData(false)
+{}
+
+//#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+
+DescriptorBatch::DescriptorBatch(const DescriptorBatch& rhs)
+: m_data(rhs.m_data), m_descriptorCount(rhs.m_descriptorCount), m_featureCount(rhs.m_featureCount), m_storage(rhs.m_storage), m_ownsData(rhs.m_ownsData)
+{
+  if(m_ownsData) m_data = m_storage.empty() ? NULL : &m_storage[0];
+}
+
+DescriptorBatch& DescriptorBatch::operator=(const DescriptorBatch& rhs)
+{
+  if(this != &rhs)
+  {
+    m_descriptorCount = rhs.m_descriptorCount;
+    m_featureCount = rhs.m_featureCount;
+    m_ownsData = rhs.m_ownsData;
+
+    if(m_ownsData)
+    {
+      m_storage.assign(rhs.m_storage.begin(), rhs.m_storage.end());
+      m_data = m_storage.empty() ? NULL : &m_storage[0];
+    }
+    else m_data = rhs.m_data;
+  }
+  return *this;
+}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+float *DescriptorBatch::get_writable_descriptor(size_t descriptorIndex)
+{
+  if(!m_ownsData) throw std::runtime_error("Cannot write to a descriptor batch that is a view onto externally-owned memory");
+  return &m_storage[descriptorIndex * m_featureCount];
+}
+
+void DescriptorBatch::resize(size_t descriptorCount, size_t featureCount)
+{
+  // Note: std::vector never releases capacity when it shrinks, so recycling a batch does not cause any reallocation.
+  m_storage.resize(descriptorCount * featureCount);
+  m_data = m_storage.empty() ? NULL : &m_storage[0];
+  m_descriptorCount = descriptorCount;
+  m_featureCount = featureCount;
+  m_ownsData = true;
+}
+
+void DescriptorBatch::wrap(const float *data, size_t descriptorCount, size_t featureCount)
+{
+  m_data = data;
+  m_descriptorCount = descriptorCount;
+  m_featureCount = featureCount;
+  m_ownsData = false;
+}
+
+}
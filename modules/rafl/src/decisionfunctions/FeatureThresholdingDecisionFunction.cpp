@@ -17,9 +17,9 @@ FeatureThresholdingDecisionFunction::FeatureThresholdingDecisionFunction(size_t
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
-DecisionFunction::DescriptorClassification FeatureThresholdingDecisionFunction::classify_descriptor(const Descriptor& descriptor) const
+DecisionFunction::DescriptorClassification FeatureThresholdingDecisionFunction::classify_features(const float *features) const
 {
-  return descriptor[m_featureIndex] < m_threshold ? DC_LEFT : DC_RIGHT;
+  return features[m_featureIndex] < m_threshold ? DC_LEFT : DC_RIGHT;
 }
 
 void FeatureThresholdingDecisionFunction::output(std::ostream& os) const
@@ -27,6 +27,16 @@ void FeatureThresholdingDecisionFunction::output(std::ostream& os) const
   os << "Feature " << m_featureIndex << " < " << m_threshold;
 }
 
+boost::optional<DecisionFunction::FlatForm> FeatureThresholdingDecisionFunction::to_flat_form() const
+{
+  FlatForm result;
+  result.m_firstFeatureIndex = static_cast<int>(m_featureIndex);
+  result.m_op = FlatForm::FO_FIRST;
+  result.m_secondFeatureIndex = static_cast<int>(m_featureIndex);
+  result.m_threshold = m_threshold;
+  return result;
+}
+
 }
 
 BOOST_CLASS_EXPORT(rafl::FeatureThresholdingDecisionFunction)
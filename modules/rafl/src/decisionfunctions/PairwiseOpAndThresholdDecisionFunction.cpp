@@ -23,9 +23,9 @@ PairwiseOpAndThresholdDecisionFunction::PairwiseOpAndThresholdDecisionFunction()
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
-DecisionFunction::DescriptorClassification PairwiseOpAndThresholdDecisionFunction::classify_descriptor(const Descriptor& descriptor) const
+DecisionFunction::DescriptorClassification PairwiseOpAndThresholdDecisionFunction::classify_features(const float *features) const
 {
-  float result = apply_op(m_op, descriptor[m_firstFeatureIndex], descriptor[m_secondFeatureIndex]);
+  float result = apply_op(m_op, features[m_firstFeatureIndex], features[m_secondFeatureIndex]);
   return result < m_threshold ? DC_LEFT : DC_RIGHT;
 }
 
@@ -37,6 +37,29 @@ void PairwiseOpAndThresholdDecisionFunction::output(std::ostream& os) const
      << " < " << m_threshold;
 }
 
+boost::optional<DecisionFunction::FlatForm> PairwiseOpAndThresholdDecisionFunction::to_flat_form() const
+{
+  FlatForm result;
+  result.m_firstFeatureIndex = static_cast<int>(m_firstFeatureIndex);
+  result.m_secondFeatureIndex = static_cast<int>(m_secondFeatureIndex);
+  result.m_threshold = m_threshold;
+
+  switch(m_op)
+  {
+    case PO_ADD:
+      result.m_op = FlatForm::FO_ADD;
+      break;
+    case PO_SUBTRACT:
+      result.m_op = FlatForm::FO_SUBTRACT;
+      break;
+    default:
+      // This should never happen.
+      throw std::runtime_error("Unknown pairwise operation");
+  }
+
+  return result;
+}
+
 //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
 
 float PairwiseOpAndThresholdDecisionFunction::apply_op(Op op, float a, float b)
@@ -56,6 +56,9 @@ private:
   /** A memory block in which to store the locations of the voxels sampled for prediction purposes. */
   Selector::Selection_Ptr m_predictionVoxelLocationsMB;
 
+  /** The predictions made by the random forest for the voxels sampled for prediction purposes (reused from one frame to the next). */
+  rafl::BatchPredictions<SpaintVoxel::Label> m_predictions;
+
   /** The ID of the scene on which the component should operate. */
   std::string m_sceneID;
 
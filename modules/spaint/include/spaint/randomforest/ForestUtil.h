@@ -8,6 +8,7 @@
 
 #include <ORUtils/MemoryBlock.h>
 
+#include <rafl/base/DescriptorBatch.h>
 #include <rafl/examples/Example.h>
 
 namespace spaint {
@@ -20,14 +21,16 @@ struct ForestUtil
   //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
 
   /**
-   * \brief Makes rafl feature descriptors from feature descriptors that are stored implicitly and contiguously in an InfiniTAM memory block.
+   * \brief Makes a rafl descriptor batch that acts as a view onto feature descriptors that are stored implicitly and contiguously in an InfiniTAM memory block.
+   *
+   * No copying of the features is involved, so the memory block must remain alive and unmodified for as long as the batch is in use.
    *
    * \param featuresMB      The InfiniTAM memory block containing the feature descriptors.
    * \param descriptorCount The number of feature descriptors that are stored in the memory block.
    * \param featureCount    The number of features in a feature descriptor.
-   * \return                The rafl feature descriptors.
+   * \return                The rafl descriptor batch.
    */
-  static std::vector<rafl::Descriptor_CPtr> make_descriptors(const ORUtils::MemoryBlock<float>& featuresMB, size_t descriptorCount, size_t featureCount);
+  static rafl::DescriptorBatch make_descriptor_batch(const ORUtils::MemoryBlock<float>& featuresMB, size_t descriptorCount, size_t featureCount);
 
   /**
    * \brief Makes rafl examples from feature descriptors that are stored implicitly and contiguously in an InfiniTAM memory block.
@@ -21,7 +21,11 @@ class ColourAppearanceModel
 {
   //#################### TYPEDEFS ####################
 private:
-  typedef boost::shared_ptr<tvgutil::ProbabilityMassFunction<int> > PMF_Ptr;
+  // Since the (linearised) bin indices are small non-negative integers, we store the histograms and PMFs densely.
+  typedef tvgutil::DenseLabelStorage<256*256> BinStorage;
+  typedef tvgutil::Histogram<int,BinStorage> Histogram;
+  typedef tvgutil::ProbabilityMassFunction<int,BinStorage> PMF;
+  typedef boost::shared_ptr<PMF> PMF_Ptr;
 
   //#################### PRIVATE VARIABLES ####################
 private:
@@ -32,10 +36,10 @@ private:
   int m_binsCr;
 
   // A (linearised) 2D histogram representing P(Colour | object).
-  tvgutil::Histogram<int> m_histColourGivenObject;
+  Histogram m_histColourGivenObject;
 
   // A (linearised) 2D histogram representing P(Colour | !object).
-  tvgutil::Histogram<int> m_histColourGivenNotObject;
+  Histogram m_histColourGivenNotObject;
 
   // A (linearised) 2D probability mass function representing P(Colour | object).
   PMF_Ptr m_pmfColourGivenObject;
@@ -50,6 +54,7 @@ public:
    *
    * \param binsCb  The number of Cb bins in the histogram.
    * \param binsCr  The number of Cr bins in the histogram.
+   * \throws std::runtime_error If either bin count is not in the range [1,256].
    */
   ColourAppearanceModel(int binsCb, int binsCr);
 
@@ -80,6 +85,17 @@ private:
    * \return          The 2D histogram bin index for the colour.
    */
   int compute_bin(const Vector3u& rgbColour) const;
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Looks up the mass of the specified bin in a PMF.
+   *
+   * \param pmf The PMF.
+   * \param bin The bin.
+   * \return    The mass of the bin in the PMF (0 if it does not appear in the PMF).
+   */
+  static float lookup_mass(const PMF& pmf, int bin);
 };
 
 //#################### TYPEDEFS ####################
@@ -31,8 +31,8 @@ class TouchDetector
 private:
   typedef boost::shared_ptr<af::array> AFArray_Ptr;
   typedef int Label;
-  typedef rafl::RandomForest<Label> RF;
-  typedef boost::shared_ptr<RF> RF_Ptr;
+  typedef rafl::CompiledRandomForest<Label> CompiledRF;
+  typedef boost::shared_ptr<const CompiledRF> CompiledRF_CPtr;
 
   //#################### PRIVATE DEBUGGING VARIABLES ####################
 private:
@@ -60,7 +60,7 @@ private:
   AFArray_Ptr m_diffRawRaycast;
 
   /** The random forest used to score the candidate connected components. */
-  RF_Ptr m_forest;
+  CompiledRF_CPtr m_forest;
 
   /** The height of the images on which the touch detector is running. */
   int m_imageHeight;
@@ -19,6 +19,8 @@ class TouchSettings
   //#################### TYPEDEFS ####################
 private:
   typedef int Label;
+  typedef rafl::CompiledRandomForest<Label> CompiledRF;
+  typedef boost::shared_ptr<const CompiledRF> CompiledRF_CPtr;
   typedef rafl::RandomForest<Label> RF;
   typedef boost::shared_ptr<RF> RF_Ptr;
 
@@ -71,13 +73,17 @@ public:
   const std::string& get_save_candidate_components_path() const;
 
   /**
-   * \brief Loads a random forest from the file specified by the forest path.
+   * \brief Loads a compiled random forest for the file specified by the forest path.
+   *
+   * If a file in the flat binary format used by CompiledRandomForest (with the extension .rff) exists alongside
+   * the specified file, it will be memory-mapped in preference to deserialising the (much slower to load) text
+   * archive. Otherwise, the forest will be loaded from the text archive and compiled.
    *
    * The loading is done in TouchSettings rather than TouchDetector to work around a weird compiler bug.
    *
    * \return  The random forest that has been loaded.
    */
-  RF_Ptr load_forest() const;
+  CompiledRF_CPtr load_forest() const;
 
   /**
    * \brief Gets whether or not to save images of the candidate connected components.
@@ -18,6 +18,11 @@ using namespace InputSource;
 using namespace ITMLib;
 using namespace ORUtils;
 
+#ifdef WITH_GROVE
+#include <grove/relocalisation/ScoreRelocaliserFactory.h>
+using namespace grove;
+#endif
+
 #ifdef WITH_OPENCV
 #include <itmx/ocv/OpenCVUtil.h>
 #endif
@@ -312,11 +317,10 @@ void SLAMComponent::set_mapping_client(const MappingClient_Ptr& mappingClient)
     calibMsg.set_calib(m_imageSourceEngine->getCalib());
 
     // TODO: Allow these to be configured from the command line.
+    calibMsg.set_depth_compression_type(DEPTH_COMPRESSION_RVL);
 #ifdef WITH_OPENCV
-    calibMsg.set_depth_compression_type(DEPTH_COMPRESSION_PNG);
     calibMsg.set_rgb_compression_type(RGB_COMPRESSION_JPG);
 #else
-    calibMsg.set_depth_compression_type(DEPTH_COMPRESSION_NONE);
     calibMsg.set_rgb_compression_type(RGB_COMPRESSION_NONE);
 #endif
 
@@ -427,6 +431,21 @@ void SLAMComponent::setup_relocaliser()
       m_relocaliseEveryFrame ? FernRelocaliser::ALWAYS_TRY_ADD : FernRelocaliser::DELAY_AFTER_RELOCALISATION
     ));
   }
+  else if(m_relocaliserType == "forest")
+  {
+#ifdef WITH_GROVE
+    // Note: There is no default forest (forests are trained offline for a particular camera), so the path must be specified.
+    m_relocaliserForestPath = settings->get_first_value<std::string>(settingsNamespace + "relocalisationForestPath", "");
+    if(m_relocaliserForestPath.empty())
+    {
+      throw std::runtime_error("Error: Cannot construct a forest relocaliser without a forest. Specify its path using the SLAMComponent.relocalisationForestPath setting.");
+    }
+
+    innerRelocaliser = ScoreRelocaliserFactory::make_score_relocaliser(settings, m_relocaliserForestPath, settings->deviceType);
+#else
+    throw std::runtime_error("Error: Cannot construct a forest relocaliser, since grove is not currently available. Reconfigure in CMake with the BUILD_GROVE option set to on.");
+#endif
+  }
   else throw std::invalid_argument("Invalid relocaliser type: " + m_relocaliserType);
 
   // Now decorate this relocaliser with one that uses an ICP tracker to refine the results.
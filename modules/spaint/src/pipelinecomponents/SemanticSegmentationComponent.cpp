@@ -84,7 +84,8 @@ void SemanticSegmentationComponent::reset_forest()
 {
   const size_t treeCount = 5;
   DecisionTree<SpaintVoxel::Label>::Settings dtSettings(m_context->get_resources_dir() + "/RaflSettings.xml");
-  m_forest.reset(new RandomForest<SpaintVoxel::Label>(treeCount, dtSettings));
+  const bool parallelTraining = true;
+  m_forest.reset(new RandomForest<SpaintVoxel::Label>(treeCount, dtSettings, parallelTraining));
 }
 
 void SemanticSegmentationComponent::reset_voxel_samplers(int raycastResultSize)
@@ -136,17 +137,18 @@ void SemanticSegmentationComponent::run_prediction(const VoxelRenderState_CPtr&
 
   // Calculate feature descriptors for the sampled voxels.
   m_featureCalculator->calculate_features(*m_predictionVoxelLocationsMB, m_context->get_slam_state(m_sceneID)->get_voxel_scene().get(), *m_predictionFeaturesMB);
-  std::vector<Descriptor_CPtr> descriptors = ForestUtil::make_descriptors(*m_predictionFeaturesMB, m_maxPredictionVoxelCount, m_featureCalculator->get_feature_count());
+  DescriptorBatch descriptors = ForestUtil::make_descriptor_batch(*m_predictionFeaturesMB, m_maxPredictionVoxelCount, m_featureCalculator->get_feature_count());
+
+  // Make sure that the forest has been compiled for fast prediction (this is a no-op unless it has been trained since the last compilation).
+  m_forest->compile();
 
   // Predict labels for the voxels based on the feature descriptors.
-  SpaintVoxel::PackedLabel *labels = m_predictionLabelsMB->GetData(MEMORYDEVICE_CPU);
+  m_forest->predict_batch(descriptors, m_predictions);
 
-#ifdef WITH_OPENMP
-  #pragma omp parallel for
-#endif
-  for(int i = 0; i < static_cast<int>(m_maxPredictionVoxelCount); ++i)
+  SpaintVoxel::PackedLabel *labels = m_predictionLabelsMB->GetData(MEMORYDEVICE_CPU);
+  for(size_t i = 0; i < m_maxPredictionVoxelCount; ++i)
   {
-    labels[i] = SpaintVoxel::PackedLabel(m_forest->predict(descriptors[i]), SpaintVoxel::LG_FOREST);
+    labels[i] = SpaintVoxel::PackedLabel(m_predictions.get_predicted_label(i), SpaintVoxel::LG_FOREST);
   }
 
   m_predictionLabelsMB->UpdateDeviceFromHost();
@@ -5,19 +5,24 @@
 
 #include "segmentation/ColourAppearanceModel.h"
 
+#include <stdexcept>
+
 #include <itmx/util/ColourConversion_Shared.h>
 using namespace itmx;
 
-#include <tvgutil/containers/MapUtil.h>
-using namespace tvgutil;
-
 namespace spaint {
 
 //#################### CONSTRUCTORS ####################
 
 ColourAppearanceModel::ColourAppearanceModel(int binsCb, int binsCr)
 : m_binsCb(binsCb), m_binsCr(binsCr)
-{}
+{
+  // Note: The chroma channels only have 256 distinct values, so there is no point in having more bins than that.
+  if(binsCb < 1 || binsCb > 256 || binsCr < 1 || binsCr > 256)
+  {
+    throw std::runtime_error("Error: The numbers of Cb and Cr bins for a colour appearance model must be in the range [1,256]");
+  }
+}
 
 //#################### PUBLIC MEMBER FUNCTIONS ####################
 
@@ -38,8 +43,8 @@ float ColourAppearanceModel::compute_posterior_probability(const Vector3u& rgbCo
                        P(colour | object) + P(colour | !object)
   */
   int bin = compute_bin(rgbColour);
-  float colourGivenObject = MapUtil::lookup(m_pmfColourGivenObject->get_masses(), bin, 0.0f);
-  float colourGivenNotObject = MapUtil::lookup(m_pmfColourGivenNotObject->get_masses(), bin, 0.0f);
+  float colourGivenObject = lookup_mass(*m_pmfColourGivenObject, bin);
+  float colourGivenNotObject = lookup_mass(*m_pmfColourGivenNotObject, bin);
   float denom = colourGivenObject + colourGivenNotObject;
   return denom > 0.0f ? colourGivenObject / denom : 0.5f;
 }
@@ -56,8 +61,8 @@ void ColourAppearanceModel::train(const ITMUChar4Image_CPtr& image, const ITMUCh
   }
 
   // Update the likelihood PMFs from the histograms.
-  if(m_histColourGivenObject.get_count() > 0) m_pmfColourGivenObject.reset(new ProbabilityMassFunction<int>(m_histColourGivenObject));
-  if(m_histColourGivenNotObject.get_count() > 0) m_pmfColourGivenNotObject.reset(new ProbabilityMassFunction<int>(m_histColourGivenNotObject));
+  if(m_histColourGivenObject.get_count() > 0) m_pmfColourGivenObject.reset(new PMF(m_histColourGivenObject));
+  if(m_histColourGivenNotObject.get_count() > 0) m_pmfColourGivenNotObject.reset(new PMF(m_histColourGivenNotObject));
 }
 
 //#################### PRIVATE MEMBER FUNCTIONS ####################
@@ -72,4 +77,12 @@ int ColourAppearanceModel::compute_bin(const Vector3u& rgbColour) const
   return y * m_binsCb + x;
 }
 
+//#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+
+float ColourAppearanceModel::lookup_mass(const PMF& pmf, int bin)
+{
+  PMF::Masses::const_iterator it = pmf.get_masses().find(bin);
+  return it != pmf.get_masses().end() ? it->second : 0.0f;
+}
+
 }
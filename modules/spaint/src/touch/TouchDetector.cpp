@@ -71,7 +71,10 @@ TouchDetector::TouchDetector(const Vector2i& imgSize, const Settings_CPtr& itmSe
 
 #if defined(DEBUG_TOUCH_OUTPUT_FOREST_STATISTICS)
   // Output the statistics of the forest for debugging purposes.
-  m_forest->output_statistics(std::cout);
+  for(size_t i = 0, treeCount = m_forest->get_tree_count(); i < treeCount; ++i)
+  {
+    std::cout << "Tree " << i << ": " << m_forest->get_tree(i)->get_node_count() << " nodes, " << m_forest->get_tree(i)->get_leaf_count() << " leaves\n";
+  }
 #endif
 }
 
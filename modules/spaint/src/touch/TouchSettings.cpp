@@ -33,9 +33,9 @@ TouchSettings::TouchSettings(const boost::filesystem::path& touchSettingsFile)
     GET_SETTING(saveCandidateComponentsPath);
   #undef GET_SETTING
 
-  // Determine the full path to the file containing the random forest, and check that it exists.
+  // Determine the full path to the file containing the random forest, and check that either it or its flat version exists.
   fullForestPath = touchSettingsFile.branch_path() / forestPath;
-  if(!boost::filesystem::exists(fullForestPath))
+  if(!boost::filesystem::exists(fullForestPath) && !boost::filesystem::exists(boost::filesystem::path(fullForestPath).replace_extension(".rff")))
   {
     throw std::runtime_error("Touch detection random forest not found: " + fullForestPath.string());
   }
@@ -63,15 +63,22 @@ const std::string& TouchSettings::get_save_candidate_components_path() const
   return saveCandidateComponentsPath;
 }
 
-TouchSettings::RF_Ptr TouchSettings::load_forest() const
+TouchSettings::CompiledRF_CPtr TouchSettings::load_forest() const
 {
-  // Register the relevant decision function generators with the factory.
+  // If a flat version of the forest is available, load it directly.
+  boost::filesystem::path flatForestPath = fullForestPath;
+  flatForestPath.replace_extension(".rff");
+  if(boost::filesystem::exists(flatForestPath))
+  {
+    return CompiledRF::load(flatForestPath.string());
+  }
+
+  // Otherwise, register the relevant decision function generators with the factory.
   rafl::DecisionFunctionGeneratorFactory<Label>::instance().register_rafl_makers();
 
-  // Load the forest.
+  // Load the forest from the text archive, and compile it.
   RF_Ptr forest = SerializationUtil::load_text(fullForestPath.string(), forest);
-
-  return forest;
+  return forest->get_compiled_forest();
 }
 
 bool TouchSettings::should_save_candidate_components() const
@@ -0,0 +1,445 @@
+/**
+ * tvgutil: DenseLabelMap.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2015. All rights reserved.
+ */
+
+#ifndef H_TVGUTIL_DENSELABELMAP
+#define H_TVGUTIL_DENSELABELMAP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/level.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/tracking.hpp>
+#include <boost/type_traits/remove_const.hpp>
+
+namespace tvgutil {
+
+/**
+ * \brief An instance of an instantiation of this class template represents a map from small, non-negative integer labels
+ *        to values that is stored as a directly-indexed array rather than as a tree.
+ *
+ * The interface mirrors the subset of std::map that is needed by histograms and PMFs, so that either can be used as
+ * their underlying storage. In particular, iteration visits the entries in ascending label order, exactly as for a map.
+ * Unlike std::map, however, inserting a new label can invalidate existing iterators. The array only grows as far as the
+ * largest label inserted so far, so a large capacity does not in itself cost any memory.
+ *
+ * Labels must lie in the range [0,Capacity).
+ */
+template <typename Label, typename Value, size_t Capacity>
+class DenseLabelMap
+{
+  //#################### TYPEDEFS ####################
+public:
+  typedef Label key_type;
+  typedef Value mapped_type;
+  typedef size_t size_type;
+  typedef std::pair<Label,Value> value_type;
+
+  //#################### NESTED TYPES ####################
+private:
+  /**
+   * \brief An instance of an instantiation of this class template can be used to iterate over the entries in a dense label map.
+   */
+  template <typename Entry>
+  class Iterator
+  {
+    //~~~~~~~~~~~~~~~~~~~~ TYPEDEFS ~~~~~~~~~~~~~~~~~~~~
+  public:
+    typedef std::ptrdiff_t difference_type;
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef Entry *pointer;
+    typedef Entry& reference;
+    typedef typename boost::remove_const<Entry>::type value_type;
+
+    //~~~~~~~~~~~~~~~~~~~~ PRIVATE VARIABLES ~~~~~~~~~~~~~~~~~~~~
+  private:
+    /** The entry array of the map. */
+    Entry *m_entries;
+
+    /** The index of the slot to which the iterator currently points. */
+    size_t m_index;
+
+    /** The presence flags of the map. */
+    const unsigned char *m_present;
+
+    /** The number of slots in the map. */
+    size_t m_slotCount;
+
+    //~~~~~~~~~~~~~~~~~~~~ CONSTRUCTORS ~~~~~~~~~~~~~~~~~~~~
+  public:
+    /**
+     * \brief Constructs a singular iterator.
+     */
+    Iterator()
+    : m_entries(NULL), m_index(0), m_present(NULL), m_slotCount(0)
+    {}
+
+    /**
+     * \brief Constructs an iterator that points to the first occupied slot at or after the specified index.
+     *
+     * \param entries   The entry array of the map.
+     * \param present   The presence flags of the map.
+     * \param slotCount The number of slots in the map.
+     * \param index     The index of the slot from which to start looking.
+     */
+    Iterator(Entry *entries, const unsigned char *present, size_t slotCount, size_t index)
+    : m_entries(entries), m_index(index), m_present(present), m_slotCount(slotCount)
+    {
+      while(m_index < m_slotCount && !m_present[m_index]) ++m_index;
+    }
+
+    /**
+     * \brief Converts an iterator into a const iterator.
+     *
+     * \param rhs The iterator to convert.
+     */
+    template <typename OtherEntry>
+    Iterator(const Iterator<OtherEntry>& rhs)
+    : m_entries(rhs.m_entries), m_index(rhs.m_index), m_present(rhs.m_present), m_slotCount(rhs.m_slotCount)
+    {}
+
+    //~~~~~~~~~~~~~~~~~~~~ PUBLIC OPERATORS ~~~~~~~~~~~~~~~~~~~~
+  public:
+    reference operator*() const
+    {
+      return m_entries[m_index];
+    }
+
+    pointer operator->() const
+    {
+      return &m_entries[m_index];
+    }
+
+    Iterator& operator++()
+    {
+      do ++m_index; while(m_index < m_slotCount && !m_present[m_index]);
+      return *this;
+    }
+
+    Iterator operator++(int)
+    {
+      Iterator copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    Iterator& operator--()
+    {
+      do --m_index; while(!m_present[m_index]);
+      return *this;
+    }
+
+    Iterator operator--(int)
+    {
+      Iterator copy = *this;
+      --*this;
+      return copy;
+    }
+
+    template <typename OtherEntry>
+    bool operator==(const Iterator<OtherEntry>& rhs) const
+    {
+      return m_index == rhs.m_index;
+    }
+
+    template <typename OtherEntry>
+    bool operator!=(const Iterator<OtherEntry>& rhs) const
+    {
+      return m_index != rhs.m_index;
+    }
+
+    //~~~~~~~~~~~~~~~~~~~~ FRIENDS ~~~~~~~~~~~~~~~~~~~~
+    template <typename> friend class Iterator;
+  };
+
+public:
+  typedef Iterator<value_type> iterator;
+  typedef Iterator<const value_type> const_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The entries of the map, indexed by label (the first element of each slot is always equal to the slot's index). */
+  std::vector<value_type> m_entries;
+
+  /** Flags indicating which slots are currently occupied. */
+  std::vector<unsigned char> m_present;
+
+  /** The number of occupied slots. */
+  size_t m_size;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs an empty dense label map.
+   */
+  DenseLabelMap()
+  : m_size(0)
+  {}
+
+  //#################### PUBLIC OPERATORS ####################
+public:
+  /**
+   * \brief Gets the value associated with the specified label, inserting a default-constructed value if necessary.
+   *
+   * \param label               The label.
+   * \return                    The value associated with the label.
+   * \throws std::out_of_range  If the label is outside the capacity of the map.
+   */
+  Value& operator[](const Label& label)
+  {
+    size_t index = ensure_slot(label);
+    if(!m_present[index])
+    {
+      m_present[index] = 1;
+      ++m_size;
+    }
+    return m_entries[index].second;
+  }
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  iterator begin()
+  {
+    return make_iterator(0);
+  }
+
+  const_iterator begin() const
+  {
+    return make_iterator(0);
+  }
+
+  /**
+   * \brief Removes all of the entries from the map.
+   */
+  void clear()
+  {
+    m_entries.clear();
+    m_present.clear();
+    m_size = 0;
+  }
+
+  /**
+   * \brief Gets the number of entries in the map with the specified label (either 0 or 1).
+   *
+   * \param label The label.
+   * \return      1, if the map contains an entry for the label, or 0 otherwise.
+   */
+  size_t count(const Label& label) const
+  {
+    size_t index = static_cast<size_t>(label);
+    return index < m_present.size() && m_present[index] ? 1 : 0;
+  }
+
+  bool empty() const
+  {
+    return m_size == 0;
+  }
+
+  iterator end()
+  {
+    return make_iterator(m_entries.size());
+  }
+
+  const_iterator end() const
+  {
+    return make_iterator(m_entries.size());
+  }
+
+  /**
+   * \brief Finds the entry in the map with the specified label (if any).
+   *
+   * \param label The label.
+   * \return      An iterator pointing to the entry for the label, if it exists, or end() otherwise.
+   */
+  iterator find(const Label& label)
+  {
+    return make_iterator(count(label) ? static_cast<size_t>(label) : m_entries.size());
+  }
+
+  const_iterator find(const Label& label) const
+  {
+    return make_iterator(count(label) ? static_cast<size_t>(label) : m_entries.size());
+  }
+
+  /**
+   * \brief Inserts an entry into the map, unless there is already an entry with the same label.
+   *
+   * \param entry               The entry to insert.
+   * \return                    A pair containing an iterator pointing to the entry for the label, and a flag indicating whether the insertion took place.
+   * \throws std::out_of_range  If the label is outside the capacity of the map.
+   */
+  std::pair<iterator,bool> insert(const value_type& entry)
+  {
+    size_t index = ensure_slot(entry.first);
+    bool inserted = !m_present[index];
+    if(inserted)
+    {
+      m_entries[index].second = entry.second;
+      m_present[index] = 1;
+      ++m_size;
+    }
+    return std::make_pair(make_iterator(index), inserted);
+  }
+
+  reverse_iterator rbegin()
+  {
+    return reverse_iterator(end());
+  }
+
+  const_reverse_iterator rbegin() const
+  {
+    return const_reverse_iterator(end());
+  }
+
+  reverse_iterator rend()
+  {
+    return reverse_iterator(begin());
+  }
+
+  const_reverse_iterator rend() const
+  {
+    return const_reverse_iterator(begin());
+  }
+
+  size_t size() const
+  {
+    return m_size;
+  }
+
+  //#################### PRIVATE MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Makes sure that the map has a slot for the specified label.
+   *
+   * \param label               The label.
+   * \return                    The index of the slot for the label.
+   * \throws std::out_of_range  If the label is outside the capacity of the map.
+   */
+  size_t ensure_slot(const Label& label)
+  {
+    size_t index = static_cast<size_t>(label);
+    if(index >= Capacity) throw std::out_of_range("Cannot store a label that is outside the capacity of a dense label map");
+
+    size_t oldSlotCount = m_entries.size();
+    if(index >= oldSlotCount)
+    {
+      m_entries.resize(index + 1);
+      m_present.resize(index + 1, 0);
+      for(size_t i = oldSlotCount; i <= index; ++i)
+      {
+        m_entries[i].first = static_cast<Label>(i);
+      }
+    }
+
+    return index;
+  }
+
+  iterator make_iterator(size_t index)
+  {
+    return iterator(m_entries.empty() ? NULL : &m_entries[0], m_present.empty() ? NULL : &m_present[0], m_entries.size(), index);
+  }
+
+  const_iterator make_iterator(size_t index) const
+  {
+    return const_iterator(m_entries.empty() ? NULL : &m_entries[0], m_present.empty() ? NULL : &m_present[0], m_entries.size(), index);
+  }
+
+  //#################### SERIALIZATION ####################
+private:
+  /**
+   * \brief Loads the map from an archive.
+   *
+   * Note that the map is serialized in exactly the same format as the equivalent std::map, so that the two are interchangeable on disk
+   * (see also the serialization traits at the bottom of this file).
+   *
+   * \param ar      The archive.
+   * \param version The file format version number.
+   */
+  template <typename Archive>
+  void load(Archive& ar, const unsigned int version)
+  {
+    std::map<Label,Value> entries;
+    ar & entries;
+
+    clear();
+    for(typename std::map<Label,Value>::const_iterator it = entries.begin(), iend = entries.end(); it != iend; ++it)
+    {
+      insert(*it);
+    }
+  }
+
+  /**
+   * \brief Saves the map to an archive.
+   *
+   * \param ar      The archive.
+   * \param version The file format version number.
+   */
+  template <typename Archive>
+  void save(Archive& ar, const unsigned int version) const
+  {
+    std::map<Label,Value> entries(begin(), end());
+    ar & entries;
+  }
+
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+  friend class boost::serialization::access;
+};
+
+//#################### COMPARISON OPERATORS ####################
+
+template <typename Label, typename Value, size_t Capacity>
+bool operator==(const DenseLabelMap<Label,Value,Capacity>& lhs, const DenseLabelMap<Label,Value,Capacity>& rhs)
+{
+  return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+template <typename Label, typename Value, size_t Capacity>
+bool operator!=(const DenseLabelMap<Label,Value,Capacity>& lhs, const DenseLabelMap<Label,Value,Capacity>& rhs)
+{
+  return !(lhs == rhs);
+}
+
+}
+
+//#################### SERIALIZATION TRAITS ####################
+
+namespace boost {
+namespace serialization {
+
+/**
+ * \brief Dense label maps are serialized without any class information, as is the case for std::map.
+ */
+template <typename Label, typename Value, size_t Capacity>
+struct implementation_level<tvgutil::DenseLabelMap<Label,Value,Capacity> >
+{
+  typedef mpl::integral_c_tag tag;
+  typedef mpl::int_<object_serializable> type;
+  BOOST_STATIC_CONSTANT(int, value = object_serializable);
+};
+
+/**
+ * \brief Dense label maps are never tracked, as is the case for std::map.
+ */
+template <typename Label, typename Value, size_t Capacity>
+struct tracking_level<tvgutil::DenseLabelMap<Label,Value,Capacity> >
+{
+  typedef mpl::integral_c_tag tag;
+  typedef mpl::int_<track_never> type;
+  BOOST_STATIC_CONSTANT(int, value = track_never);
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * tvgutil: ParallelRandomNumberGenerator.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_TVGUTIL_PARALLELRANDOMNUMBERGENERATOR
+#define H_TVGUTIL_PARALLELRANDOMNUMBERGENERATOR
+
+#include <vector>
+
+#include "RandomNumberStream.h"
+
+namespace tvgutil {
+
+/**
+ * \brief An instance of this class provides a fixed number of independent, reproducibly-seeded random number streams.
+ *
+ * Unlike RandomNumberGenerator, which serialises all of its callers on a mutex, this class hands out a separate
+ * lock-free stream to each caller. Stream i is obtained by jumping the engine seeded with the specified seed ahead
+ * by i * 2^128 steps, so the streams never overlap, and the numbers drawn from each stream depend only on the seed
+ * and the stream index. To keep results reproducible, parallel code should index the streams by work item (or by
+ * statically-scheduled thread index), rather than by whichever thread happens to pick up a piece of work.
+ *
+ * Note: The streams themselves are not thread-safe; each must only be used by one thread at a time.
+ */
+class ParallelRandomNumberGenerator
+{
+  //#################### NESTED TYPES ####################
+private:
+  /**
+   * \brief A stream, padded so that no two streams in the vector share a cache line.
+   *
+   * The vector's storage is not guaranteed to be cache-line aligned, so the padding is at least a whole cache line long:
+   * this keeps the bytes of adjacent streams more than a cache line apart, however the storage is aligned. The padding
+   * also rounds the size of each element up to a multiple of the cache line size, so that if the storage does happen to
+   * be aligned, each stream starts on a cache line boundary.
+   */
+  struct PaddedStream
+  {
+    enum { CACHE_LINE_SIZE = 64 };
+    enum { PADDING_SIZE = CACHE_LINE_SIZE + (CACHE_LINE_SIZE - sizeof(RandomNumberStream) % CACHE_LINE_SIZE) % CACHE_LINE_SIZE };
+
+    RandomNumberStream m_stream;
+    char m_padding[PADDING_SIZE];
+
+    explicit PaddedStream(const Xoshiro256StarStar& gen)
+    : m_stream(gen), m_padding()
+    {}
+  };
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The seed from which the streams were derived. */
+  unsigned int m_seed;
+
+  /** The streams. */
+  std::vector<PaddedStream> m_streams;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a parallel random number generator with the specified number of streams.
+   *
+   * \param seed        The seed from which to derive the streams.
+   * \param streamCount The number of streams to create.
+   */
+  ParallelRandomNumberGenerator(unsigned int seed, size_t streamCount);
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets the seed from which the streams were derived.
+   *
+   * \return  The seed from which the streams were derived.
+   */
+  unsigned int get_seed() const;
+
+  /**
+   * \brief Gets the specified stream.
+   *
+   * \param streamIdx           The index of the stream.
+   * \return                    The stream.
+   * \throws std::runtime_error If the stream index is out of range.
+   */
+  RandomNumberStream& get_stream(size_t streamIdx);
+
+  /**
+   * \brief Gets the number of streams.
+   *
+   * \return  The number of streams.
+   */
+  size_t get_stream_count() const;
+
+  /**
+   * \brief Re-derives all of the streams from the specified seed.
+   *
+   * \param seed  The seed from which to re-derive the streams.
+   */
+  void reseed(unsigned int seed);
+};
+
+//#################### TYPEDEFS ####################
+
+typedef boost::shared_ptr<ParallelRandomNumberGenerator> ParallelRandomNumberGenerator_Ptr;
+typedef boost::shared_ptr<const ParallelRandomNumberGenerator> ParallelRandomNumberGenerator_CPtr;
+
+}
+
+#endif
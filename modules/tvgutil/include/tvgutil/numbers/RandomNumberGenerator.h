@@ -6,18 +6,26 @@
 #ifndef H_TVGUTIL_RANDOMNUMBERGENERATOR
 #define H_TVGUTIL_RANDOMNUMBERGENERATOR
 
+#include <cstddef>
+
 #include <boost/random.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
+#include "RandomNumberSource.h"
+
 #include <boost/serialization/split_member.hpp>
 
 namespace tvgutil {
 
 /**
  * \brief An instance of this class represents a thread-safe random number generator.
+ *
+ * Every call takes a lock, so callers that need many numbers should prefer the batched generation functions, which
+ * take the lock only once per batch, and code that draws numbers from several threads at once should prefer the
+ * lock-free streams provided by ParallelRandomNumberGenerator.
  */
-class RandomNumberGenerator
+class RandomNumberGenerator : public RandomNumberSource
 {
   //#################### PRIVATE VARIABLES ####################
 private:
@@ -73,7 +81,20 @@ public:
    * \param upper The upper bound of the range.
    * \return      The generated integer.
    */
-  int generate_int_from_uniform(int lower, int upper);
+  virtual int generate_int_from_uniform(int lower, int upper);
+
+  /**
+   * \brief Fills a buffer with random integers from a uniform distribution over the specified (closed) range.
+   *
+   * The buffer receives exactly the same values as count successive calls to generate_int_from_uniform would produce,
+   * but the generator is only locked once.
+   *
+   * \param lower The lower bound of the range.
+   * \param upper The upper bound of the range.
+   * \param out   The buffer into which to write the generated integers.
+   * \param count The number of integers to generate.
+   */
+  virtual void generate_ints_from_uniform(int lower, int upper, int *out, size_t count);
 
   /**
    * \brief Generates a random real number from a uniform distribution over the specified (closed) range.
@@ -90,6 +111,25 @@ public:
     return dist(*m_gen);
   }
 
+  /**
+   * \brief Fills a buffer with random real numbers from a uniform distribution over the specified (closed) range.
+   *
+   * The buffer receives exactly the same values as count successive calls to generate_real_from_uniform would produce,
+   * but the generator is only locked once.
+   *
+   * \param lower The lower bound of the range.
+   * \param upper The upper bound of the range.
+   * \param out   The buffer into which to write the generated real numbers.
+   * \param count The number of real numbers to generate.
+   */
+  template <typename T>
+  void generate_reals_from_uniform(T lower, T upper, T *out, size_t count)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    boost::random::uniform_real_distribution<T> dist(lower, upper);
+    for(size_t i = 0; i < count; ++i) out[i] = dist(*m_gen);
+  }
+
   //#################### SERIALIZATION #################### 
 public:
   /**
@@ -0,0 +1,59 @@
+/**
+ * tvgutil: RandomNumberSource.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_TVGUTIL_RANDOMNUMBERSOURCE
+#define H_TVGUTIL_RANDOMNUMBERSOURCE
+
+#include <cstddef>
+
+#include <boost/shared_ptr.hpp>
+
+namespace tvgutil {
+
+/**
+ * \brief An instance of a class deriving from this one can be used to generate random integers.
+ *
+ * This is the interface shared by the thread-safe RandomNumberGenerator and the lock-free RandomNumberStream. It allows
+ * code that only needs random integers (e.g. the random forest training code) to be written once, and then to be given
+ * either a shared generator or a stream that is private to the calling thread, as appropriate.
+ */
+class RandomNumberSource
+{
+  //#################### DESTRUCTOR ####################
+public:
+  /**
+   * \brief Destroys the random number source.
+   */
+  virtual ~RandomNumberSource() {}
+
+  //#################### PUBLIC ABSTRACT MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Generates a random integer from a uniform distribution over the specified (closed) range.
+   *
+   * \param lower The lower bound of the range.
+   * \param upper The upper bound of the range.
+   * \return      The generated integer.
+   */
+  virtual int generate_int_from_uniform(int lower, int upper) = 0;
+
+  /**
+   * \brief Fills a buffer with random integers from a uniform distribution over the specified (closed) range.
+   *
+   * \param lower The lower bound of the range.
+   * \param upper The upper bound of the range.
+   * \param out   The buffer into which to write the generated integers.
+   * \param count The number of integers to generate.
+   */
+  virtual void generate_ints_from_uniform(int lower, int upper, int *out, size_t count) = 0;
+};
+
+//#################### TYPEDEFS ####################
+
+typedef boost::shared_ptr<RandomNumberSource> RandomNumberSource_Ptr;
+
+}
+
+#endif
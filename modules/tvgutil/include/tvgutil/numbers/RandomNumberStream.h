@@ -0,0 +1,138 @@
+/**
+ * tvgutil: RandomNumberStream.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_TVGUTIL_RANDOMNUMBERSTREAM
+#define H_TVGUTIL_RANDOMNUMBERSTREAM
+
+#include <cstddef>
+
+#include <boost/random.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "RandomNumberSource.h"
+#include "Xoshiro256StarStar.h"
+
+namespace tvgutil {
+
+/**
+ * \brief An instance of this class represents a lock-free stream of random numbers.
+ *
+ * A stream provides the same generation functions as RandomNumberGenerator (and can be used wherever a RandomNumberSource
+ * is needed), but is not synchronised, and so must only be used by one thread at a time. Streams are intended to be obtained from a ParallelRandomNumberGenerator, which gives each
+ * of them a separate, non-overlapping subsequence of a single seeded engine, so that code that draws numbers in parallel
+ * can avoid contending for a shared generator whilst remaining reproducible.
+ */
+class RandomNumberStream : public RandomNumberSource
+{
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The generation engine. */
+  Xoshiro256StarStar m_gen;
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a random number stream whose generation engine is seeded with the specified value.
+   *
+   * \param seed  The seed with which to initialise the generation engine.
+   */
+  explicit RandomNumberStream(unsigned int seed)
+  : m_gen(seed)
+  {}
+
+  /**
+   * \brief Constructs a random number stream that uses the specified generation engine.
+   *
+   * \param gen The generation engine.
+   */
+  explicit RandomNumberStream(const Xoshiro256StarStar& gen)
+  : m_gen(gen)
+  {}
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Generates a random number from a 1D Gaussian distribution with the specified parameters.
+   *
+   * \param mean  The mean of the Gaussian distribution.
+   * \param sigma The standard deviation of the Gaussian distribution.
+   * \return      The generated number.
+   */
+  template <typename T = float>
+  T generate_from_gaussian(T mean, T sigma)
+  {
+    boost::random::normal_distribution<T> dist(mean, sigma);
+    return dist(m_gen);
+  }
+
+  /**
+   * \brief Generates a random integer from a uniform distribution over the specified (closed) range.
+   *
+   * \param lower The lower bound of the range.
+   * \param upper The upper bound of the range.
+   * \return      The generated integer.
+   */
+  virtual int generate_int_from_uniform(int lower, int upper)
+  {
+    boost::random::uniform_int_distribution<> dist(lower, upper);
+    return dist(m_gen);
+  }
+
+  /**
+   * \brief Fills a buffer with random integers from a uniform distribution over the specified (closed) range.
+   *
+   * The buffer receives exactly the same values as count successive calls to generate_int_from_uniform would produce.
+   *
+   * \param lower The lower bound of the range.
+   * \param upper The upper bound of the range.
+   * \param out   The buffer into which to write the generated integers.
+   * \param count The number of integers to generate.
+   */
+  virtual void generate_ints_from_uniform(int lower, int upper, int *out, size_t count)
+  {
+    boost::random::uniform_int_distribution<> dist(lower, upper);
+    for(size_t i = 0; i < count; ++i) out[i] = dist(m_gen);
+  }
+
+  /**
+   * \brief Generates a random real number from a uniform distribution over the specified (closed) range.
+   *
+   * \param lower The lower bound of the range.
+   * \param upper The upper bound of the range.
+   * \return      The generated real number.
+   */
+  template <typename T = float>
+  T generate_real_from_uniform(T lower, T upper)
+  {
+    boost::random::uniform_real_distribution<T> dist(lower, upper);
+    return dist(m_gen);
+  }
+
+  /**
+   * \brief Fills a buffer with random real numbers from a uniform distribution over the specified (closed) range.
+   *
+   * The buffer receives exactly the same values as count successive calls to generate_real_from_uniform would produce.
+   *
+   * \param lower The lower bound of the range.
+   * \param upper The upper bound of the range.
+   * \param out   The buffer into which to write the generated real numbers.
+   * \param count The number of real numbers to generate.
+   */
+  template <typename T>
+  void generate_reals_from_uniform(T lower, T upper, T *out, size_t count)
+  {
+    boost::random::uniform_real_distribution<T> dist(lower, upper);
+    for(size_t i = 0; i < count; ++i) out[i] = dist(m_gen);
+  }
+};
+
+//#################### TYPEDEFS ####################
+
+typedef boost::shared_ptr<RandomNumberStream> RandomNumberStream_Ptr;
+typedef boost::shared_ptr<const RandomNumberStream> RandomNumberStream_CPtr;
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * tvgutil: Xoshiro256StarStar.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#ifndef H_TVGUTIL_XOSHIRO256STARSTAR
+#define H_TVGUTIL_XOSHIRO256STARSTAR
+
+#include <boost/cstdint.hpp>
+
+namespace tvgutil {
+
+/**
+ * \brief An instance of this class represents a xoshiro256** random number generation engine (Blackman and Vigna, 2018).
+ *
+ * The engine has a 256-bit state, is much cheaper to step than the Mersenne Twister, and supports a jump function that
+ * advances it by 2^128 steps. The latter makes it possible to split a single seeded engine into many non-overlapping
+ * streams, e.g. one per thread. The engine satisfies the requirements of a uniform random number generator, so it can
+ * be used with the Boost.Random distributions.
+ *
+ * Note: Instances of this class are not thread-safe.
+ */
+class Xoshiro256StarStar
+{
+  //#################### TYPEDEFS ####################
+public:
+  typedef boost::uint64_t result_type;
+
+  //#################### PRIVATE VARIABLES ####################
+private:
+  /** The state of the engine. */
+  boost::uint64_t m_state[4];
+
+  //#################### CONSTRUCTORS ####################
+public:
+  /**
+   * \brief Constructs a xoshiro256** engine whose state is initialised from the specified seed.
+   *
+   * The state is initialised using a splitmix64 generator, as recommended by the authors of xoshiro256**.
+   *
+   * \param seed  The seed with which to initialise the engine.
+   */
+  explicit Xoshiro256StarStar(boost::uint64_t seed = 0)
+  {
+    this->seed(seed);
+  }
+
+  //#################### PUBLIC STATIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Gets the smallest value the engine can generate.
+   *
+   * \return  The smallest value the engine can generate.
+   */
+  static result_type min() { return 0; }
+
+  /**
+   * \brief Gets the largest value the engine can generate.
+   *
+   * \return  The largest value the engine can generate.
+   */
+  static result_type max() { return ~result_type(0); }
+
+  //#################### PUBLIC OPERATORS ####################
+public:
+  /**
+   * \brief Generates the next value in the engine's sequence.
+   *
+   * \return  The generated value.
+   */
+  result_type operator()()
+  {
+    const boost::uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+    const boost::uint64_t t = m_state[1] << 17;
+
+    m_state[2] ^= m_state[0];
+    m_state[3] ^= m_state[1];
+    m_state[1] ^= m_state[2];
+    m_state[0] ^= m_state[3];
+    m_state[2] ^= t;
+    m_state[3] = rotl(m_state[3], 45);
+
+    return result;
+  }
+
+  //#################### PUBLIC MEMBER FUNCTIONS ####################
+public:
+  /**
+   * \brief Advances the engine by 2^128 steps.
+   *
+   * Repeatedly copying and jumping an engine yields up to 2^128 non-overlapping subsequences, each of length 2^128.
+   */
+  void jump()
+  {
+    static const boost::uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+
+    boost::uint64_t s[4] = { 0, 0, 0, 0 };
+    for(int i = 0; i < 4; ++i)
+    {
+      for(int b = 0; b < 64; ++b)
+      {
+        if(JUMP[i] & (1ULL << b))
+        {
+          for(int j = 0; j < 4; ++j) s[j] ^= m_state[j];
+        }
+        (*this)();
+      }
+    }
+
+    for(int j = 0; j < 4; ++j) m_state[j] = s[j];
+  }
+
+  /**
+   * \brief Re-initialises the state of the engine from the specified seed.
+   *
+   * \param seed  The seed with which to re-initialise the engine.
+   */
+  void seed(boost::uint64_t seed)
+  {
+    // Note: splitmix64 never produces four consecutive zeros, so the state is guaranteed not to be all zero.
+    for(int i = 0; i < 4; ++i)
+    {
+      boost::uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      m_state[i] = z ^ (z >> 31);
+    }
+  }
+
+  //#################### PRIVATE STATIC MEMBER FUNCTIONS ####################
+private:
+  /**
+   * \brief Rotates a 64-bit value left by the specified number of bits.
+   *
+   * \param x The value to rotate.
+   * \param k The number of bits by which to rotate it (must be in the range [1,63]).
+   * \return  The rotated value.
+   */
+  static boost::uint64_t rotl(boost::uint64_t x, int k)
+  {
+    return (x << k) | (x >> (64 - k));
+  }
+};
+
+}
+
+#endif
@@ -6,25 +6,32 @@
 #ifndef H_TVGUTIL_HISTOGRAM
 #define H_TVGUTIL_HISTOGRAM
 
-#include <map>
 #include <stdexcept>
 
 #include <boost/serialization/serialization.hpp>
 
+#include "LabelStorage.h"
 #include "../containers/LimitedContainer.h"
 
 namespace tvgutil {
 
 /**
  * \brief An instance of an instantiation of this class template represents a histogram over the specified label type.
+ *
+ * The bins are stored in a way that is determined by the specified storage policy (see LabelStorage.h). By default,
+ * this is a std::map, but histograms over small integer label sets can store their bins densely instead.
  */
-template <typename Label>
+template <typename Label, typename Storage = typename DefaultLabelStorage<Label>::type>
 class Histogram
 {
+  //#################### TYPEDEFS ####################
+public:
+  typedef typename Storage::template Map<Label,size_t>::type Bins;
+
   //#################### PRIVATE VARIABLES ####################
 private:
   /** The bins that record the number of instances of each label that have been seen. */
-  std::map<Label,size_t> m_bins;
+  Bins m_bins;
 
   /** The total number of instances that are in the histogram. */
   size_t m_count;
@@ -66,7 +73,7 @@ public:
    *
    * \return The bins that record the number of instances of each label that have been seen.
    */
-  const std::map<Label,size_t>& get_bins() const
+  const Bins& get_bins() const
   {
     return m_bins;
   }
@@ -108,8 +115,8 @@ private:
  * \param rhs The histogram to output.
  * \return    The stream.
  */
-template <typename Label>
-std::ostream& operator<<(std::ostream& os, const Histogram<Label>& rhs)
+template <typename Label, typename Storage>
+std::ostream& operator<<(std::ostream& os, const Histogram<Label,Storage>& rhs)
 {
   const size_t ELEMENT_DISPLAY_LIMIT = 10;
   os << make_limited_container(rhs.get_bins(), ELEMENT_DISPLAY_LIMIT);
@@ -0,0 +1,66 @@
+/**
+ * tvgutil: LabelStorage.h
+ * Copyright (c) Torr Vision Group, University of Oxford, 2015. All rights reserved.
+ */
+
+#ifndef H_TVGUTIL_LABELSTORAGE
+#define H_TVGUTIL_LABELSTORAGE
+
+#include <map>
+
+#include "../containers/DenseLabelMap.h"
+
+namespace tvgutil {
+
+/**
+ * \brief This struct can be used to make histograms and PMFs store their per-label values in a std::map.
+ *
+ * This is appropriate for arbitrary label types, and for integer labels drawn from a large or sparse range.
+ */
+struct SparseLabelStorage
+{
+  template <typename Label, typename Value>
+  struct Map
+  {
+    typedef std::map<Label,Value> type;
+  };
+};
+
+/**
+ * \brief An instantiation of this struct template can be used to make histograms and PMFs store their per-label values
+ *        in a directly-indexed array, avoiding the allocations and log-time lookups of a std::map.
+ *
+ * This is only appropriate for integer labels in the range [0,Capacity).
+ */
+template <size_t Capacity>
+struct DenseLabelStorage
+{
+  template <typename Label, typename Value>
+  struct Map
+  {
+    typedef DenseLabelMap<Label,Value,Capacity> type;
+  };
+};
+
+/**
+ * \brief An instantiation of this struct template specifies the storage that histograms and PMFs over a particular
+ *        label type use by default.
+ */
+template <typename Label>
+struct DefaultLabelStorage
+{
+  typedef SparseLabelStorage type;
+};
+
+/**
+ * \brief Unsigned char labels (e.g. the voxel labels in spaint) can always be stored densely.
+ */
+template <>
+struct DefaultLabelStorage<unsigned char>
+{
+  typedef DenseLabelStorage<256> type;
+};
+
+}
+
+#endif
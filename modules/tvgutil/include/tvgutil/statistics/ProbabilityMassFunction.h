@@ -24,15 +24,21 @@ const float SMALL_EPSILON = 1e-9f;
 /**
  * \brief An instance of an instantiation of this class template represents a probability mass function (PMF).
  *
+ * As for histograms, the masses are stored in a way that is determined by the specified storage policy.
+ *
  * Datatype Invariant: The masses in the PMF must sum to 1.
  */
-template <typename Label>
+template <typename Label, typename Storage = typename DefaultLabelStorage<Label>::type>
 class ProbabilityMassFunction
 {
+  //#################### TYPEDEFS ####################
+public:
+  typedef typename Storage::template Map<Label,float>::type Masses;
+
   //#################### PRIVATE VARIABLES ####################
 private:
   /** The masses for the various labels. */
-  std::map<Label,float> m_masses;
+  Masses m_masses;
 
   //#################### CONSTRUCTORS ####################
 public:
@@ -46,7 +52,7 @@ public:
    *
    * \param masses  The label -> masses map to normalise.
    */
-  explicit ProbabilityMassFunction(const std::map<Label,float>& masses)
+  explicit ProbabilityMassFunction(const Masses& masses)
   : m_masses(masses)
   {
     assert(!masses.empty());
@@ -60,13 +66,13 @@ public:
    * \param histogram   The histogram from which to construct a PMF.
    * \param multipliers Optional per-class ratios that can be used to scale the probabilities for the different labels.
    */
-  explicit ProbabilityMassFunction(const Histogram<Label>& histogram, const boost::optional<std::map<Label,float> >& multipliers = boost::none)
+  explicit ProbabilityMassFunction(const Histogram<Label,Storage>& histogram, const boost::optional<std::map<Label,float> >& multipliers = boost::none)
   {
     // Determine the masses for the labels in the histogram by dividing the number of instances in each bin by the histogram count.
-    const std::map<Label,size_t>& bins = histogram.get_bins();
+    const typename Histogram<Label,Storage>::Bins& bins = histogram.get_bins();
     size_t count = histogram.get_count();
     if(count == 0) throw std::runtime_error("Cannot make a probability mass function from an empty histogram");
-    for(typename std::map<Label,size_t>::const_iterator it = bins.begin(), iend = bins.end(); it != iend; ++it)
+    for(typename Histogram<Label,Storage>::Bins::const_iterator it = bins.begin(), iend = bins.end(); it != iend; ++it)
     {
       float mass = static_cast<float>(it->second) / count;
 
@@ -112,7 +118,7 @@ public:
   float calculate_entropy() const
   {
     float entropy = 0.0f;
-    for(typename std::map<Label,float>::const_iterator it = m_masses.begin(), iend = m_masses.end(); it != iend; ++it)
+    for(typename Masses::const_iterator it = m_masses.begin(), iend = m_masses.end(); it != iend; ++it)
     {
       float mass = it->second;
       if(mass > 0)
@@ -129,7 +135,7 @@ public:
    *
    * \return The masses for the various labels.
    */
-  const std::map<Label,float>& get_masses() const
+  const Masses& get_masses() const
   {
     return m_masses;
   }
@@ -144,7 +150,7 @@ private:
   float calculate_sum()
   {
     float sum = 0.0f;
-    for(typename std::map<Label,float>::const_iterator it = m_masses.begin(), iend = m_masses.end(); it != iend; ++it)
+    for(typename Masses::const_iterator it = m_masses.begin(), iend = m_masses.end(); it != iend; ++it)
     {
       assert(it->second >= 0.0f);
       sum += it->second;
@@ -175,7 +181,7 @@ private:
     if(fabs(sum) < SMALL_EPSILON) throw std::runtime_error("Cannot normalise the probability mass function: denominator too small");
 
     // Normalise the PMF by dividing each mass by the sum.
-    for(typename std::map<Label,float>::iterator it = m_masses.begin(), iend = m_masses.end(); it != iend; ++it)
+    for(typename Masses::iterator it = m_masses.begin(), iend = m_masses.end(); it != iend; ++it)
     {
       it->second /= sum;
     }
@@ -191,8 +197,8 @@ private:
  * \param rhs The PMF to output.
  * \return    The stream.
  */
-template <typename Label>
-std::ostream& operator<<(std::ostream& os, const ProbabilityMassFunction<Label>& rhs)
+template <typename Label, typename Storage>
+std::ostream& operator<<(std::ostream& os, const ProbabilityMassFunction<Label,Storage>& rhs)
 {
   const size_t ELEMENT_DISPLAY_LIMIT = 3;
   os << make_limited_container(rhs.get_masses(), ELEMENT_DISPLAY_LIMIT);
@@ -0,0 +1,53 @@
+/**
+ * tvgutil: ParallelRandomNumberGenerator.cpp
+ * Copyright (c) Torr Vision Group, University of Oxford, 2017. All rights reserved.
+ */
+
+#include "numbers/ParallelRandomNumberGenerator.h"
+
+#include <stdexcept>
+
+namespace tvgutil {
+
+//#################### CONSTRUCTORS ####################
+
+ParallelRandomNumberGenerator::ParallelRandomNumberGenerator(unsigned int seed, size_t streamCount)
+{
+  if(streamCount == 0) throw std::runtime_error("Error: A parallel random number generator must have at least one stream");
+  m_streams.reserve(streamCount);
+  for(size_t i = 0; i < streamCount; ++i) m_streams.push_back(PaddedStream(Xoshiro256StarStar()));
+  reseed(seed);
+}
+
+//#################### PUBLIC MEMBER FUNCTIONS ####################
+
+unsigned int ParallelRandomNumberGenerator::get_seed() const
+{
+  return m_seed;
+}
+
+RandomNumberStream& ParallelRandomNumberGenerator::get_stream(size_t streamIdx)
+{
+  if(streamIdx >= m_streams.size()) throw std::runtime_error("Error: Random number stream index out of range");
+  return m_streams[streamIdx].m_stream;
+}
+
+size_t ParallelRandomNumberGenerator::get_stream_count() const
+{
+  return m_streams.size();
+}
+
+void ParallelRandomNumberGenerator::reseed(unsigned int seed)
+{
+  m_seed = seed;
+
+  // Derive each stream from its predecessor by jumping ahead, so that the streams never overlap.
+  Xoshiro256StarStar gen(seed);
+  for(size_t i = 0, size = m_streams.size(); i < size; ++i)
+  {
+    m_streams[i].m_stream = RandomNumberStream(gen);
+    gen.jump();
+  }
+}
+
+}
@@ -27,4 +27,13 @@ int RandomNumberGenerator::generate_int_from_uniform(int lower, int upper)
   return dist(*m_gen) + lower;
 }
 
+void RandomNumberGenerator::generate_ints_from_uniform(int lower, int upper, int *out, size_t count)
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+
+  // Note: As in generate_int_from_uniform, we generate numbers >= 0 and then offset them.
+  boost::random::uniform_int_distribution<> dist(0, upper - lower);
+  for(size_t i = 0; i < count; ++i) out[i] = dist(*m_gen) + lower;
+}
+
 }
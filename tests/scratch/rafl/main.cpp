@@ -87,9 +87,12 @@ int main(int argc, char *argv[])
       settings->decisionFunctionGenerator = decisionFunctionGenerator;
       settings->gainThreshold = 0.0f;
       settings->maxClassSize = 10000;
+      settings->maxStoredExamples = 0;
       settings->maxTreeHeight = 15;
+      settings->parallelSplitting = false;
       settings->randomNumberGenerator = randomNumberGenerator;
       settings->seenExamplesThreshold = 30;
+      settings->splitBinCount = 0;
       settings->splittabilityThreshold = 0.5f;
     }
 
@@ -0,0 +1,343 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+namespace bf = boost::filesystem;
+
+#include <grove/features/base/Descriptor.h>
+#include <grove/features/base/QuantisedDescriptor.h>
+#include <grove/forests/cpu/DecisionForest_CPU.tpp>
+#include <grove/forests/interface/DecisionForest.tpp>
+#include <grove/forests/shared/DecisionForest_Shared.h>
+using namespace grove;
+
+#include <itmx/base/MemoryBlockFactory.h>
+using namespace itmx;
+
+#include <tvgutil/numbers/RandomNumberGenerator.h>
+using namespace tvgutil;
+
+//#################### TYPES ####################
+
+typedef Descriptor<16> TestDescriptor;
+typedef QuantisedDescriptor<16> QuantisedTestDescriptor;
+typedef DecisionForest_CPU<QuantisedTestDescriptor,3> QuantisedTestForest;
+
+/**
+ * \brief A CPU decision forest that exposes its node image, so that the tiled leaf search can be compared with compute_leaf_indices.
+ */
+struct TestForest : DecisionForest_CPU<TestDescriptor,3>
+{
+  explicit TestForest(const std::string& filename)
+  : DecisionForest_CPU<TestDescriptor,3>(filename)
+  {}
+
+  const NodeEntry *get_nodes() const
+  {
+    return m_nodeImage->GetData(MEMORYDEVICE_CPU);
+  }
+
+  size_t get_node_count() const
+  {
+    return m_nodeImage->dataSize;
+  }
+};
+
+/**
+ * \brief A node in a randomly-generated tree, in the order in which it appears in the text format of a forest.
+ */
+struct TestNode
+{
+  int leftChildIdx;
+  int leafIdx;
+  uint32_t featureIdx;
+  float featureThreshold;
+};
+
+//#################### HELPER FUNCTIONS ####################
+
+/**
+ * \brief Makes a unique path in the temporary directory.
+ *
+ * \return The path.
+ */
+bf::path make_temp_path()
+{
+  return bf::temp_directory_path() / bf::unique_path("grove-forest-%%%%-%%%%");
+}
+
+/**
+ * \brief Reads the entire contents of a file into a string.
+ *
+ * \param path The path to the file.
+ * \return     The contents of the file.
+ */
+std::string read_file(const bf::path& path)
+{
+  std::ifstream fs(path.string().c_str(), std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+}
+
+/**
+ * \brief Adds a random subtree to a tree whose nodes are stored in the format used by DecisionForest.
+ *
+ * \param nodeIdx   The index of the (already-allocated) root node of the subtree.
+ * \param depth     The depth of the root node of the subtree.
+ * \param nodes     The nodes of the tree.
+ * \param nbLeaves  The number of leaves in the tree so far.
+ * \param rng       A random number generator.
+ */
+void add_random_subtree(int nodeIdx, int depth, std::vector<TestNode>& nodes, int& nbLeaves, RandomNumberGenerator& rng)
+{
+  const bool isLeaf = depth == 8 || (depth > 1 && rng.generate_int_from_uniform(0, 3) == 0);
+  if(isLeaf)
+  {
+    // Give the leaf a wildly out-of-range feature index: it must never be used to look anything up. Also give it a
+    // non-negative left child index, since only the leaf index should ever be used to determine whether a node is a leaf.
+    TestNode leaf = { 0, nbLeaves++, 1000000, 0.0f };
+    nodes[nodeIdx] = leaf;
+  }
+  else
+  {
+    const int leftChildIdx = static_cast<int>(nodes.size());
+    nodes.resize(nodes.size() + 2);
+
+    TestNode branch = {
+      leftChildIdx, -1,
+      static_cast<uint32_t>(rng.generate_int_from_uniform(0, TestDescriptor::FEATURE_COUNT - 1)),
+      rng.generate_real_from_uniform(-1.0f, 1.0f)
+    };
+    nodes[nodeIdx] = branch;
+
+    add_random_subtree(leftChildIdx, depth + 1, nodes, nbLeaves, rng);
+    add_random_subtree(leftChildIdx + 1, depth + 1, nodes, nbLeaves, rng);
+  }
+}
+
+/**
+ * \brief Writes a random forest with the right number of trees for a TestForest to a file in the text format.
+ *
+ * \param filename  The name of the file.
+ * \param rng       A random number generator.
+ */
+void write_random_forest(const std::string& filename, RandomNumberGenerator& rng)
+{
+  std::vector<std::vector<TestNode> > trees(TestForest::TREE_COUNT);
+  std::vector<int> nbLeaves(TestForest::TREE_COUNT, 0);
+  for(int i = 0; i < TestForest::TREE_COUNT; ++i)
+  {
+    trees[i].resize(1);
+    add_random_subtree(0, 0, trees[i], nbLeaves[i], rng);
+  }
+
+  std::ofstream fs(filename.c_str());
+  fs << TestForest::TREE_COUNT << '\n';
+  for(int i = 0; i < TestForest::TREE_COUNT; ++i)
+  {
+    fs << trees[i].size() << ' ' << nbLeaves[i] << '\n';
+  }
+
+  for(int i = 0; i < TestForest::TREE_COUNT; ++i)
+  {
+    for(size_t j = 0, size = trees[i].size(); j < size; ++j)
+    {
+      const TestNode& node = trees[i][j];
+      fs << node.leftChildIdx << ' ' << node.leafIdx << ' ' << node.featureIdx << ' ' << node.featureThreshold << '\n';
+    }
+  }
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_DecisionForest)
+
+BOOST_AUTO_TEST_CASE(find_leaves_test)
+{
+  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
+  mbf.set_device_type(ITMLib::ITMLibSettings::DEVICE_CPU);
+
+  RandomNumberGenerator rng(12345);
+
+  const bf::path forestPath = make_temp_path();
+  write_random_forest(forestPath.string(), rng);
+  TestForest forest(forestPath.string());
+  bf::remove(forestPath);
+
+  // Make an image of random descriptors whose size is not a multiple of the tile size used by find_leaves.
+  const Vector2i imgSize(37, 5);
+  TestForest::DescriptorImage_Ptr descriptors = mbf.make_image<TestDescriptor>(imgSize);
+  TestDescriptor *descriptorsPtr = descriptors->GetData(MEMORYDEVICE_CPU);
+  for(int i = 0, size = imgSize.x * imgSize.y; i < size; ++i)
+  {
+    for(int j = 0; j < TestDescriptor::FEATURE_COUNT; ++j)
+    {
+      descriptorsPtr[i].data[j] = rng.generate_real_from_uniform(-1.0f, 1.0f);
+    }
+  }
+
+  // Find the leaves using the tiled implementation.
+  TestForest::LeafIndicesImage_Ptr leafIndices = mbf.make_image<TestForest::LeafIndices>();
+  forest.find_leaves(descriptors, leafIndices);
+  BOOST_REQUIRE(leafIndices->noDims == imgSize);
+
+  // Find the leaves one descriptor at a time using the shared implementation, and check that the results are identical.
+  TestForest::LeafIndicesImage_Ptr expectedLeafIndices = mbf.make_image<TestForest::LeafIndices>(imgSize);
+  const TestForest::LeafIndices *leafIndicesPtr = leafIndices->GetData(MEMORYDEVICE_CPU);
+  TestForest::LeafIndices *expectedLeafIndicesPtr = expectedLeafIndices->GetData(MEMORYDEVICE_CPU);
+  for(int y = 0; y < imgSize.y; ++y)
+  {
+    for(int x = 0; x < imgSize.x; ++x)
+    {
+      compute_leaf_indices(x, y, descriptorsPtr, imgSize, forest.get_nodes(), expectedLeafIndicesPtr);
+
+      const int rasterIdx = y * imgSize.x + x;
+      for(int treeIdx = 0; treeIdx < TestForest::TREE_COUNT; ++treeIdx)
+      {
+        BOOST_CHECK_EQUAL(leafIndicesPtr[rasterIdx][treeIdx], expectedLeafIndicesPtr[rasterIdx][treeIdx]);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(corrupt_binary_test)
+{
+  MemoryBlockFactory::instance().set_device_type(ITMLib::ITMLibSettings::DEVICE_CPU);
+
+  RandomNumberGenerator rng(12345);
+
+  const bf::path textPath = make_temp_path(), binaryPath = make_temp_path(), corruptPath = make_temp_path();
+  write_random_forest(textPath.string(), rng);
+  TestForest(textPath.string()).save_structure_to_binary_file(binaryPath.string());
+  const std::string binary = read_file(binaryPath);
+
+  // The offset of the number of nodes in the first tree (after the magic number and the five header fields).
+  const size_t nbNodesOffset = 8 + 5 * sizeof(uint32_t);
+
+  // A forest whose first tree claims to have a huge number of nodes should be rejected without trying to allocate them.
+  {
+    std::string corrupt = binary;
+    const uint32_t hugeNbNodes = 0x7FFFFFFF;
+    corrupt.replace(nbNodesOffset, sizeof(uint32_t), reinterpret_cast<const char*>(&hugeNbNodes), sizeof(uint32_t));
+    std::ofstream(corruptPath.string().c_str(), std::ios::binary) << corrupt;
+    BOOST_CHECK_THROW(TestForest forest(corruptPath.string()), std::runtime_error);
+  }
+
+  // So should a forest whose first tree claims to have more leaves than nodes.
+  {
+    std::string corrupt = binary;
+    const uint32_t treeSize[] = { 1, 2 };
+    corrupt.replace(nbNodesOffset, sizeof(treeSize), reinterpret_cast<const char*>(treeSize), sizeof(treeSize));
+    std::ofstream(corruptPath.string().c_str(), std::ios::binary) << corrupt;
+    BOOST_CHECK_THROW(TestForest forest(corruptPath.string()), std::runtime_error);
+  }
+
+  // So should a forest that has been truncated, or that has trailing data.
+  std::ofstream(corruptPath.string().c_str(), std::ios::binary) << binary.substr(0, binary.size() - 1);
+  BOOST_CHECK_THROW(TestForest forest(corruptPath.string()), std::runtime_error);
+
+  std::ofstream(corruptPath.string().c_str(), std::ios::binary) << binary << '\0';
+  BOOST_CHECK_THROW(TestForest forest(corruptPath.string()), std::runtime_error);
+
+  bf::remove(textPath);
+  bf::remove(binaryPath);
+  bf::remove(corruptPath);
+}
+
+BOOST_AUTO_TEST_CASE(quantisation_test)
+{
+  MemoryBlockFactory::instance().set_device_type(ITMLib::ITMLibSettings::DEVICE_CPU);
+
+  RandomNumberGenerator rng(12345);
+
+  const bf::path inputPath = make_temp_path(), textPath = make_temp_path(), binaryPath = make_temp_path();
+  write_random_forest(inputPath.string(), rng);
+
+  // A floating-point forest cannot be loaded for use with quantised descriptors.
+  BOOST_CHECK_THROW(QuantisedTestForest forest(inputPath.string()), std::runtime_error);
+
+  // Quantise the thresholds of a forest, and check that they cannot be quantised a second time.
+  TestForest forest(inputPath.string());
+  BOOST_CHECK(!forest.is_quantised());
+
+  const std::vector<float> quantisationSteps(TestDescriptor::FEATURE_COUNT, 0.01f);
+  forest.quantise_thresholds(quantisationSteps);
+  BOOST_CHECK(forest.is_quantised());
+  BOOST_CHECK_THROW(forest.quantise_thresholds(quantisationSteps), std::runtime_error);
+
+  // Save the quantised forest in both formats, and check that it is marked as quantised in each of them: it should then
+  // only be possible to load it back for use with quantised descriptors.
+  forest.save_structure_to_file(textPath.string());
+  forest.save_structure_to_binary_file(binaryPath.string());
+
+  BOOST_CHECK_THROW(TestForest forest(textPath.string()), std::runtime_error);
+  BOOST_CHECK_THROW(TestForest forest(binaryPath.string()), std::runtime_error);
+
+  QuantisedTestForest textForest(textPath.string()), binaryForest(binaryPath.string());
+  BOOST_CHECK(textForest.is_quantised());
+  BOOST_CHECK(binaryForest.is_quantised());
+
+  // Check that the tree count and the quantisation marker can be read from both files without loading the forest.
+  bool quantised = false;
+  BOOST_CHECK_EQUAL(TestForest::read_tree_count(textPath.string(), quantised), TestForest::TREE_COUNT);
+  BOOST_CHECK(quantised);
+
+  quantised = false;
+  BOOST_CHECK_EQUAL(TestForest::read_tree_count(binaryPath.string(), quantised), TestForest::TREE_COUNT);
+  BOOST_CHECK(quantised);
+
+  bf::remove(inputPath);
+  bf::remove(textPath);
+  bf::remove(binaryPath);
+}
+
+BOOST_AUTO_TEST_CASE(round_trip_test)
+{
+  MemoryBlockFactory::instance().set_device_type(ITMLib::ITMLibSettings::DEVICE_CPU);
+
+  RandomNumberGenerator rng(12345);
+
+  const bf::path inputPath = make_temp_path(), textPath = make_temp_path(), binaryPath = make_temp_path(), roundTripPath = make_temp_path();
+  write_random_forest(inputPath.string(), rng);
+
+  // Load the forest from the text format, and save it in both formats.
+  TestForest forest(inputPath.string());
+  forest.save_structure_to_file(textPath.string());
+  forest.save_structure_to_binary_file(binaryPath.string());
+  BOOST_CHECK(TestForest::is_binary_structure_file(binaryPath.string()));
+  BOOST_CHECK(!TestForest::is_binary_structure_file(textPath.string()));
+
+  // Check that the tree count can be read from both files without loading the forest.
+  bool quantised = true;
+  BOOST_CHECK_EQUAL(TestForest::read_tree_count(textPath.string(), quantised), TestForest::TREE_COUNT);
+  BOOST_CHECK(!quantised);
+
+  quantised = true;
+  BOOST_CHECK_EQUAL(TestForest::read_tree_count(binaryPath.string(), quantised), TestForest::TREE_COUNT);
+  BOOST_CHECK(!quantised);
+
+  // Load the forest back from the binary format, and check that it is identical to the original.
+  TestForest binaryForest(binaryPath.string());
+  BOOST_REQUIRE_EQUAL(binaryForest.get_node_count(), forest.get_node_count());
+  BOOST_CHECK(memcmp(binaryForest.get_nodes(), forest.get_nodes(), forest.get_node_count() * sizeof(TestForest::NodeEntry)) == 0);
+  for(uint32_t i = 0; i < TestForest::TREE_COUNT; ++i)
+  {
+    BOOST_CHECK_EQUAL(binaryForest.get_nb_nodes_in_tree(i), forest.get_nb_nodes_in_tree(i));
+    BOOST_CHECK_EQUAL(binaryForest.get_nb_leaves_in_tree(i), forest.get_nb_leaves_in_tree(i));
+  }
+
+  // Save it in the text format again, and check that the result is the same as the first text file.
+  binaryForest.save_structure_to_file(roundTripPath.string());
+  BOOST_CHECK(read_file(roundTripPath) == read_file(textPath));
+
+  bf::remove(inputPath);
+  bf::remove(textPath);
+  bf::remove(binaryPath);
+  bf::remove(roundTripPath);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,320 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include <grove/clustering/cpu/ExampleClusterer_CPU.tpp>
+#include <grove/clustering/interface/ExampleClusterer.tpp>
+#include <grove/clustering/shared/ExampleClusterer_Shared.h>
+#include <grove/keypoints/Keypoint3DColour.h>
+#include <grove/reservoirs/cpu/ExampleReservoirs_CPU.tpp>
+#include <grove/reservoirs/interface/ExampleReservoirs.tpp>
+#include <grove/scoreforests/Keypoint3DColourCluster.h>
+using namespace grove;
+
+#include <itmx/base/MemoryBlockFactory.h>
+using namespace itmx;
+
+#include <tvgutil/numbers/RandomNumberGenerator.h>
+using namespace tvgutil;
+
+//#################### CONSTANTS ####################
+
+const int EXAMPLE_SET_CAPACITY = 256;
+const int EXAMPLE_SET_COUNT = 12;
+const int MAX_CLUSTER_COUNT = 10;
+const int MIN_CLUSTER_SIZE = 5;
+const float SIGMA = 0.1f;
+const float TAU = 0.05f;
+
+//#################### TYPES ####################
+
+typedef Array<Keypoint3DColourCluster,MAX_CLUSTER_COUNT> ClusterContainer;
+typedef ORUtils::MemoryBlock<ClusterContainer> ClusterContainers;
+typedef boost::shared_ptr<ClusterContainers> ClusterContainers_Ptr;
+typedef ORUtils::Image<ORUtils::VectorX<int,1> > ReservoirIndicesImage;
+
+/**
+ * \brief A CPU example clusterer that exposes the intermediate results of the clustering, so that they can be checked.
+ */
+struct TestClusterer : ExampleClusterer_CPU<Keypoint3DColour,Keypoint3DColourCluster,MAX_CLUSTER_COUNT>
+{
+  TestClusterer()
+  : ExampleClusterer_CPU<Keypoint3DColour,Keypoint3DColourCluster,MAX_CLUSTER_COUNT>(SIGMA, TAU, MAX_CLUSTER_COUNT, MIN_CLUSTER_SIZE)
+  {}
+
+  const int *get_cluster_indices() const    { return m_clusterIndices->GetData(MEMORYDEVICE_CPU); }
+  const float *get_densities() const        { return m_densities->GetData(MEMORYDEVICE_CPU); }
+  const int *get_parents() const            { return m_parents->GetData(MEMORYDEVICE_CPU); }
+  const int *get_selected_clusters() const  { return m_selectedClusters->GetData(MEMORYDEVICE_CPU); }
+};
+
+/**
+ * \brief The results of clustering some example sets exhaustively, using the functions shared with the CUDA clusterer.
+ */
+struct ExhaustiveResults
+{
+  std::vector<int> clusterIndices;
+  std::vector<float> densities;
+  std::vector<int> parents;
+  std::vector<int> selectedClusters;
+};
+
+//#################### HELPER FUNCTIONS ####################
+
+/**
+ * \brief Clusters some example sets by comparing every example in each set with every other example in the set.
+ *
+ * \param exampleSets     The example sets (one set per row).
+ * \param exampleSetSizes The number of valid examples in each example set.
+ * \return                The results of the clustering.
+ */
+ExhaustiveResults cluster_exhaustively(const Keypoint3DColour *exampleSets, const int *exampleSetSizes)
+{
+  const int exampleCount = EXAMPLE_SET_COUNT * EXAMPLE_SET_CAPACITY;
+
+  ExhaustiveResults results;
+  results.clusterIndices.resize(exampleCount);
+  results.densities.resize(exampleCount);
+  results.parents.resize(exampleCount);
+  results.selectedClusters.resize(EXAMPLE_SET_COUNT * MAX_CLUSTER_COUNT);
+
+  // Note: The histogram has an extra element at the end, since a cluster can contain every example in the last set.
+  std::vector<int> clusterSizes(exampleCount), clusterSizeHistograms(exampleCount + 1), nbClustersPerExampleSet(EXAMPLE_SET_COUNT);
+
+  for(int exampleSetIdx = 0; exampleSetIdx < EXAMPLE_SET_COUNT; ++exampleSetIdx)
+  {
+    reset_temporaries_for_set(exampleSetIdx, EXAMPLE_SET_CAPACITY, &nbClustersPerExampleSet[0], &clusterSizes[0], &clusterSizeHistograms[0]);
+
+    for(int exampleIdx = 0; exampleIdx < EXAMPLE_SET_CAPACITY; ++exampleIdx)
+    {
+      compute_density(exampleSetIdx, exampleIdx, exampleSets, exampleSetSizes, EXAMPLE_SET_CAPACITY, SIGMA, &results.densities[0]);
+    }
+
+    for(int exampleIdx = 0; exampleIdx < EXAMPLE_SET_CAPACITY; ++exampleIdx)
+    {
+      compute_parent(
+        exampleSetIdx, exampleIdx, exampleSets, EXAMPLE_SET_CAPACITY, exampleSetSizes, &results.densities[0],
+        TAU * TAU, &results.parents[0], &results.clusterIndices[0], &nbClustersPerExampleSet[0]
+      );
+    }
+
+    for(int exampleIdx = 0; exampleIdx < EXAMPLE_SET_CAPACITY; ++exampleIdx)
+    {
+      compute_cluster_index(exampleSetIdx, exampleIdx, EXAMPLE_SET_CAPACITY, &results.parents[0], &results.clusterIndices[0], &clusterSizes[0]);
+    }
+
+    for(int clusterIdx = 0; clusterIdx < nbClustersPerExampleSet[exampleSetIdx]; ++clusterIdx)
+    {
+      update_cluster_size_histogram(exampleSetIdx, clusterIdx, &clusterSizes[0], &clusterSizeHistograms[0], EXAMPLE_SET_CAPACITY);
+    }
+
+    select_clusters_for_set(
+      exampleSetIdx, &clusterSizes[0], &clusterSizeHistograms[0], &nbClustersPerExampleSet[0],
+      EXAMPLE_SET_CAPACITY, MAX_CLUSTER_COUNT, MIN_CLUSTER_SIZE, &results.selectedClusters[0]
+    );
+  }
+
+  return results;
+}
+
+/**
+ * \brief Fills an example set with random examples.
+ *
+ * The examples are drawn from a mixture of tight blobs, a uniform background and exact duplicates of earlier examples,
+ * so that the sets contain dense clusters, isolated examples and examples with tied densities. Occasionally, an example
+ * is placed very far away from the others, which forces the grid used by the CPU clusterer to use larger cells.
+ *
+ * \param exampleSet    The example set.
+ * \param exampleCount  The number of examples to generate.
+ * \param rng           A random number generator.
+ */
+void generate_example_set(Keypoint3DColour *exampleSet, int exampleCount, RandomNumberGenerator& rng)
+{
+  std::vector<Vector3f> blobCentres;
+  for(int i = 0; i < 4; ++i)
+  {
+    blobCentres.push_back(Vector3f(rng.generate_real_from_uniform(-1.0f, 1.0f), rng.generate_real_from_uniform(-1.0f, 1.0f), rng.generate_real_from_uniform(0.0f, 2.0f)));
+  }
+
+  for(int i = 0; i < exampleCount; ++i)
+  {
+    Keypoint3DColour& example = exampleSet[i];
+    const int kind = rng.generate_int_from_uniform(0, 9);
+    if(kind < 6)
+    {
+      const Vector3f& centre = blobCentres[rng.generate_int_from_uniform(0, static_cast<int>(blobCentres.size()) - 1)];
+      example.position = centre + Vector3f(rng.generate_from_gaussian(0.0f, 0.03f), rng.generate_from_gaussian(0.0f, 0.03f), rng.generate_from_gaussian(0.0f, 0.03f));
+    }
+    else if(kind < 8 || i == 0)
+    {
+      example.position = Vector3f(rng.generate_real_from_uniform(-1.0f, 1.0f), rng.generate_real_from_uniform(-1.0f, 1.0f), rng.generate_real_from_uniform(0.0f, 2.0f));
+    }
+    else if(kind < 9 || rng.generate_int_from_uniform(0, 9) > 0)
+    {
+      example.position = exampleSet[rng.generate_int_from_uniform(0, i - 1)].position;
+    }
+    else
+    {
+      example.position = Vector3f(1000.0f, -1000.0f, 1000.0f);
+    }
+
+    example.colour = Vector3u(static_cast<unsigned char>(rng.generate_int_from_uniform(0, 255)), 0, 0);
+    example.valid = true;
+  }
+}
+
+/**
+ * \brief Checks that two sets of cluster containers contain exactly the same clusters.
+ *
+ * \param lhs The first set of cluster containers.
+ * \param rhs The second set of cluster containers.
+ */
+void check_same_clusters(const ClusterContainers_Ptr& lhs, const ClusterContainers_Ptr& rhs)
+{
+  const ClusterContainer *lhsData = lhs->GetData(MEMORYDEVICE_CPU);
+  const ClusterContainer *rhsData = rhs->GetData(MEMORYDEVICE_CPU);
+  for(int exampleSetIdx = 0; exampleSetIdx < EXAMPLE_SET_COUNT; ++exampleSetIdx)
+  {
+    BOOST_REQUIRE_EQUAL(lhsData[exampleSetIdx].size, rhsData[exampleSetIdx].size);
+    for(int clusterIdx = 0; clusterIdx < lhsData[exampleSetIdx].size; ++clusterIdx)
+    {
+      const Keypoint3DColourCluster& l = lhsData[exampleSetIdx].elts[clusterIdx];
+      const Keypoint3DColourCluster& r = rhsData[exampleSetIdx].elts[clusterIdx];
+      BOOST_CHECK_EQUAL(l.nbInliers, r.nbInliers);
+      BOOST_CHECK(l.position == r.position);
+      BOOST_CHECK(l.colour == r.colour);
+      BOOST_CHECK_EQUAL(l.determinant, r.determinant);
+    }
+  }
+}
+
+/**
+ * \brief Adds some random examples to the specified reservoirs.
+ *
+ * \param reservoirs        The reservoirs.
+ * \param reservoirIndices  The indices of the reservoirs to which to add examples.
+ * \param rng               A random number generator.
+ */
+void update_reservoirs(ExampleReservoirs_CPU<Keypoint3DColour>& reservoirs, const std::vector<int>& reservoirIndices, RandomNumberGenerator& rng)
+{
+  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
+
+  // Each row of the examples image contains the examples to add to one of the reservoirs.
+  const Vector2i imgSize(EXAMPLE_SET_CAPACITY / 4, static_cast<int>(reservoirIndices.size()));
+  boost::shared_ptr<ORUtils::Image<Keypoint3DColour> > examples = mbf.make_image<Keypoint3DColour>(imgSize);
+  boost::shared_ptr<ReservoirIndicesImage> examplesReservoirIndices = mbf.make_image<ORUtils::VectorX<int,1> >(imgSize);
+  for(int y = 0; y < imgSize.height; ++y)
+  {
+    generate_example_set(examples->GetData(MEMORYDEVICE_CPU) + y * imgSize.width, imgSize.width, rng);
+    for(int x = 0; x < imgSize.width; ++x)
+    {
+      examplesReservoirIndices->GetData(MEMORYDEVICE_CPU)[y * imgSize.width + x][0] = reservoirIndices[y];
+    }
+  }
+
+  reservoirs.add_examples(examples, examplesReservoirIndices);
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_ExampleClusterer)
+
+BOOST_AUTO_TEST_CASE(cluster_examples_test)
+{
+  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
+  mbf.set_device_type(ITMLib::ITMLibSettings::DEVICE_CPU);
+
+  RandomNumberGenerator rng(12345);
+
+  // Generate some example sets of various sizes (including an empty one). Note that the sets are never quite full, since
+  // the exhaustive cluster selection cannot select a cluster that contains every example in a full set.
+  boost::shared_ptr<ORUtils::Image<Keypoint3DColour> > exampleSets = mbf.make_image<Keypoint3DColour>(Vector2i(EXAMPLE_SET_CAPACITY, EXAMPLE_SET_COUNT));
+  ITMIntMemoryBlock_Ptr exampleSetSizes = mbf.make_block<int>(EXAMPLE_SET_COUNT);
+  Keypoint3DColour *exampleSetsData = exampleSets->GetData(MEMORYDEVICE_CPU);
+  int *exampleSetSizesData = exampleSetSizes->GetData(MEMORYDEVICE_CPU);
+  for(int exampleSetIdx = 0; exampleSetIdx < EXAMPLE_SET_COUNT; ++exampleSetIdx)
+  {
+    exampleSetSizesData[exampleSetIdx] = exampleSetIdx == 0 ? 0 : rng.generate_int_from_uniform(1, EXAMPLE_SET_CAPACITY - 1);
+    generate_example_set(exampleSetsData + exampleSetIdx * EXAMPLE_SET_CAPACITY, exampleSetSizesData[exampleSetIdx], rng);
+  }
+
+  // Cluster the example sets using both the CPU clusterer and the exhaustive approach.
+  TestClusterer clusterer;
+  ClusterContainers_Ptr clusterContainers = mbf.make_block<ClusterContainer>(EXAMPLE_SET_COUNT);
+  clusterer.cluster_examples(exampleSets, exampleSetSizes, 0, EXAMPLE_SET_COUNT, clusterContainers);
+
+  const ExhaustiveResults expected = cluster_exhaustively(exampleSetsData, exampleSetSizesData);
+
+  // Check that the densities (which should be bit-identical), parents and cluster indices are the same.
+  for(int i = 0; i < EXAMPLE_SET_COUNT * EXAMPLE_SET_CAPACITY; ++i)
+  {
+    BOOST_CHECK_EQUAL(clusterer.get_densities()[i], expected.densities[i]);
+    BOOST_CHECK_EQUAL(clusterer.get_parents()[i], expected.parents[i]);
+    BOOST_CHECK_EQUAL(clusterer.get_cluster_indices()[i], expected.clusterIndices[i]);
+  }
+
+  // Check that the same clusters were selected for each example set, in the same order (and that some clusters were selected).
+  int selectedClusterCount = 0;
+  for(int i = 0; i < EXAMPLE_SET_COUNT * MAX_CLUSTER_COUNT; ++i)
+  {
+    BOOST_CHECK_EQUAL(clusterer.get_selected_clusters()[i], expected.selectedClusters[i]);
+    if(expected.selectedClusters[i] >= 0) ++selectedClusterCount;
+  }
+
+  BOOST_CHECK_GT(selectedClusterCount, EXAMPLE_SET_COUNT);
+}
+
+BOOST_AUTO_TEST_CASE(cluster_changed_examples_test)
+{
+  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
+  mbf.set_device_type(ITMLib::ITMLibSettings::DEVICE_CPU);
+
+  RandomNumberGenerator rng(54321);
+
+  // Note: The reservoirs are small enough that they fill up, so that later updates replace existing examples.
+  ExampleReservoirs_CPU<Keypoint3DColour> reservoirs(EXAMPLE_SET_COUNT, EXAMPLE_SET_CAPACITY / 2);
+  TestClusterer incrementalClusterer;
+  ClusterContainers_Ptr incrementalClusterContainers = mbf.make_block<ClusterContainer>(EXAMPLE_SET_COUNT);
+
+  std::vector<int> allReservoirIndices;
+  for(int i = 0; i < EXAMPLE_SET_COUNT; ++i) allReservoirIndices.push_back(i);
+
+  for(int round = 0; round < 8; ++round)
+  {
+    // After the first round, update only a few of the reservoirs. In one round, reset the reservoirs first (which resets
+    // their add call counts, so the versions recorded by the incremental clusterer must be forgotten).
+    std::vector<int> updatedReservoirIndices;
+    if(round == 0) updatedReservoirIndices = allReservoirIndices;
+    else
+    {
+      for(int i = 0; i < EXAMPLE_SET_COUNT; ++i)
+      {
+        if(rng.generate_int_from_uniform(0, 3) == 0) updatedReservoirIndices.push_back(i);
+      }
+    }
+
+    if(round == 5)
+    {
+      reservoirs.reset();
+      incrementalClusterer.forget_example_set_versions();
+    }
+
+    if(!updatedReservoirIndices.empty()) update_reservoirs(reservoirs, updatedReservoirIndices, rng);
+
+    // Recluster the changed reservoirs incrementally, and cluster all of the reservoirs from scratch.
+    const uint32_t reclusteredCount = incrementalClusterer.cluster_changed_examples(
+      reservoirs.get_reservoirs(), reservoirs.get_reservoir_sizes(), reservoirs.get_reservoir_add_calls(), 0, EXAMPLE_SET_COUNT, incrementalClusterContainers
+    );
+
+    TestClusterer clusterer;
+    ClusterContainers_Ptr clusterContainers = mbf.make_block<ClusterContainer>(EXAMPLE_SET_COUNT);
+    clusterer.cluster_examples(reservoirs.get_reservoirs(), reservoirs.get_reservoir_sizes(), 0, EXAMPLE_SET_COUNT, clusterContainers);
+
+    // Check that exactly the changed reservoirs (or all of them, after a reset) were reclustered, and that the results are the same.
+    BOOST_CHECK_EQUAL(reclusteredCount, round == 5 ? EXAMPLE_SET_COUNT : updatedReservoirIndices.size());
+    check_same_clusters(incrementalClusterContainers, clusterContainers);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
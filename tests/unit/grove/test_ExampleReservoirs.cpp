@@ -0,0 +1,137 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#ifdef WITH_OPENMP
+#include <omp.h>
+#endif
+
+#include <grove/keypoints/Keypoint3DColour.h>
+#include <grove/reservoirs/cpu/ExampleReservoirs_CPU.tpp>
+#include <grove/reservoirs/interface/ExampleReservoirs.tpp>
+using namespace grove;
+
+#include <itmx/base/MemoryBlockFactory.h>
+using namespace itmx;
+
+#include <tvgutil/numbers/RandomNumberGenerator.h>
+using namespace tvgutil;
+
+//#################### CONSTANTS ####################
+
+const int RESERVOIR_CAPACITY = 8;
+const int RESERVOIR_COUNT = 300;
+const int RESERVOIR_INDEX_COUNT = 2;
+
+//#################### TYPES ####################
+
+typedef ORUtils::VectorX<int,RESERVOIR_INDEX_COUNT> ReservoirIndices;
+typedef ORUtils::Image<ReservoirIndices> ReservoirIndicesImage;
+typedef boost::shared_ptr<ReservoirIndicesImage> ReservoirIndicesImage_Ptr;
+
+/**
+ * \brief The contents of a set of reservoirs after some examples have been added to them.
+ */
+struct ReservoirContents
+{
+  std::vector<int> addCalls;
+  std::vector<Vector3f> positions;
+  std::vector<int> sizes;
+};
+
+//#################### HELPER FUNCTIONS ####################
+
+/**
+ * \brief Adds several batches of random examples to a set of reservoirs in sharded mode, using the specified number of threads.
+ *
+ * \param threadCount The number of threads to use.
+ * \return            The contents of the reservoirs after all of the examples have been added.
+ */
+ReservoirContents fill_reservoirs(int threadCount)
+{
+  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
+
+#ifdef WITH_OPENMP
+  const int oldThreadCount = omp_get_max_threads();
+  omp_set_num_threads(threadCount);
+#endif
+
+  ExampleReservoirs_CPU<Keypoint3DColour> reservoirs(RESERVOIR_COUNT, RESERVOIR_CAPACITY, 42, ExampleReservoirs_CPU<Keypoint3DColour>::INSERTION_SHARDED);
+
+  // Note: The examples and reservoir indices are generated with a fixed seed, so that they are the same for every call.
+  RandomNumberGenerator rng(12345);
+  const Vector2i imgSize(80, 60);
+  boost::shared_ptr<ORUtils::Image<Keypoint3DColour> > examples = mbf.make_image<Keypoint3DColour>(imgSize);
+  ReservoirIndicesImage_Ptr reservoirIndices = mbf.make_image<ReservoirIndices>(imgSize);
+  Keypoint3DColour *examplesData = examples->GetData(MEMORYDEVICE_CPU);
+  ReservoirIndices *reservoirIndicesData = reservoirIndices->GetData(MEMORYDEVICE_CPU);
+
+  for(int batchIdx = 0; batchIdx < 5; ++batchIdx)
+  {
+    for(int i = 0, size = imgSize.width * imgSize.height; i < size; ++i)
+    {
+      examplesData[i].position = Vector3f(static_cast<float>(batchIdx), static_cast<float>(i), 0.0f);
+      examplesData[i].colour = Vector3u(0, 0, 0);
+      examplesData[i].valid = rng.generate_int_from_uniform(0, 9) > 0;
+
+      // Send most of the examples to a few hot reservoirs, so that they are full and examples have to be replaced.
+      for(int j = 0; j < RESERVOIR_INDEX_COUNT; ++j)
+      {
+        reservoirIndicesData[i][j] = rng.generate_int_from_uniform(0, 1) == 0 ? rng.generate_int_from_uniform(0, 9) : rng.generate_int_from_uniform(0, RESERVOIR_COUNT - 1);
+      }
+    }
+
+    reservoirs.add_examples(examples, reservoirIndices);
+  }
+
+#ifdef WITH_OPENMP
+  omp_set_num_threads(oldThreadCount);
+#endif
+
+  ReservoirContents contents;
+  const int *addCalls = reservoirs.get_reservoir_add_calls()->GetData(MEMORYDEVICE_CPU);
+  const Keypoint3DColour *reservoirData = reservoirs.get_reservoirs()->GetData(MEMORYDEVICE_CPU);
+  const int *sizes = reservoirs.get_reservoir_sizes()->GetData(MEMORYDEVICE_CPU);
+  for(int reservoirIdx = 0; reservoirIdx < RESERVOIR_COUNT; ++reservoirIdx)
+  {
+    contents.addCalls.push_back(addCalls[reservoirIdx]);
+    contents.sizes.push_back(sizes[reservoirIdx]);
+    for(int i = 0; i < sizes[reservoirIdx]; ++i)
+    {
+      contents.positions.push_back(reservoirData[reservoirIdx * RESERVOIR_CAPACITY + i].position);
+    }
+  }
+
+  return contents;
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_ExampleReservoirs)
+
+BOOST_AUTO_TEST_CASE(sharded_insertion_is_independent_of_thread_count_test)
+{
+  MemoryBlockFactory::instance().set_device_type(ITMLib::ITMLibSettings::DEVICE_CPU);
+
+  const ReservoirContents expected = fill_reservoirs(1);
+
+  // Check that some of the reservoirs overflowed, so that the random replacement of examples was actually exercised.
+  BOOST_CHECK_GT(expected.addCalls[0], 10 * RESERVOIR_CAPACITY);
+  BOOST_CHECK_EQUAL(expected.sizes[0], RESERVOIR_CAPACITY);
+
+  const int threadCounts[] = { 2, 3, 8 };
+  for(int i = 0; i < 3; ++i)
+  {
+    const ReservoirContents actual = fill_reservoirs(threadCounts[i]);
+    BOOST_CHECK(actual.addCalls == expected.addCalls);
+    BOOST_CHECK(actual.sizes == expected.sizes);
+    BOOST_REQUIRE_EQUAL(actual.positions.size(), expected.positions.size());
+    for(size_t j = 0, size = expected.positions.size(); j < size; ++j)
+    {
+      BOOST_CHECK(actual.positions[j] == expected.positions[j]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
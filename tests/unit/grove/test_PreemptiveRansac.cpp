@@ -0,0 +1,196 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <vector>
+
+#ifdef WITH_OPENMP
+#include <omp.h>
+#endif
+
+#include <Eigen/Geometry>
+
+#include <grove/ransac/cpu/PreemptiveRansac_CPU.h>
+using namespace grove;
+
+#include <itmx/base/MemoryBlockFactory.h>
+using namespace itmx;
+
+#include <tvgutil/numbers/RandomNumberGenerator.h>
+using namespace tvgutil;
+
+//#################### CONSTANTS ####################
+
+const float MODE_SIGMA = 0.05f;
+
+//#################### TYPES ####################
+
+/**
+ * \brief A synthetic scene, comprising a set of keypoints and the modes predicted for them, together with the pose that relates them.
+ */
+struct Scene
+{
+  Keypoint3DColourImage_Ptr keypointsImage;
+  ScorePredictionsImage_Ptr predictionsImage;
+  Eigen::Matrix4f trueCameraPose;
+};
+
+//#################### HELPER FUNCTIONS ####################
+
+/**
+ * \brief Makes a mode at the specified position.
+ *
+ * \param position  The position of the mode.
+ * \param colour    The colour of the mode.
+ * \param rng       A random number generator (used to choose the number of inliers that support the mode).
+ * \return          The mode.
+ */
+Keypoint3DColourCluster make_mode(const Vector3f& position, const Vector3u& colour, RandomNumberGenerator& rng)
+{
+  Keypoint3DColourCluster mode;
+  mode.colour = colour;
+  mode.determinant = powf(MODE_SIGMA * MODE_SIGMA, 3);
+  mode.nbInliers = rng.generate_int_from_uniform(5, 20);
+  mode.position = position;
+  mode.positionInvCovariance.setZeros();
+  mode.positionInvCovariance.m[0] = mode.positionInvCovariance.m[4] = mode.positionInvCovariance.m[8] = 1.0f / (MODE_SIGMA * MODE_SIGMA);
+  return mode;
+}
+
+/**
+ * \brief Makes a synthetic scene in which most (but not all) of the pixels have a mode that is consistent with a known camera pose.
+ *
+ * \return  The scene.
+ */
+Scene make_scene()
+{
+  MemoryBlockFactory& mbf = MemoryBlockFactory::instance();
+  RandomNumberGenerator rng(12345);
+
+  Scene scene;
+  scene.trueCameraPose = Eigen::Matrix4f::Identity();
+  scene.trueCameraPose.block<3,3>(0, 0) = Eigen::AngleAxisf(0.5f, Eigen::Vector3f(0,1,1).normalized()).toRotationMatrix();
+  scene.trueCameraPose.block<3,1>(0, 3) = Eigen::Vector3f(1.0f, 0.5f, -2.0f);
+
+  const Vector2i imgSize(40, 30);
+  scene.keypointsImage = mbf.make_image<Keypoint3DColour>(imgSize);
+  scene.predictionsImage = mbf.make_image<ScorePrediction>(imgSize);
+  Keypoint3DColour *keypoints = scene.keypointsImage->GetData(MEMORYDEVICE_CPU);
+  ScorePrediction *predictions = scene.predictionsImage->GetData(MEMORYDEVICE_CPU);
+
+  for(int i = 0, size = imgSize.width * imgSize.height; i < size; ++i)
+  {
+    Keypoint3DColour& keypoint = keypoints[i];
+    keypoint.position = Vector3f(rng.generate_real_from_uniform(-1.0f, 1.0f), rng.generate_real_from_uniform(-1.0f, 1.0f), rng.generate_real_from_uniform(1.0f, 3.0f));
+    keypoint.colour = Vector3u(
+      static_cast<unsigned char>(rng.generate_int_from_uniform(0, 255)),
+      static_cast<unsigned char>(rng.generate_int_from_uniform(0, 255)),
+      static_cast<unsigned char>(rng.generate_int_from_uniform(0, 255))
+    );
+    keypoint.valid = rng.generate_int_from_uniform(0, 9) > 0;
+
+    // Give each pixel a few modes. For most pixels, one of the modes is in the right place; for the others, they are all in the wrong place.
+    const Eigen::Vector3f worldPosition = (scene.trueCameraPose * Eigen::Vector4f(keypoint.position.x, keypoint.position.y, keypoint.position.z, 1.0f)).head<3>();
+    const bool hasCorrectMode = rng.generate_int_from_uniform(0, 9) > 2;
+    ScorePrediction& prediction = predictions[i];
+    prediction.size = rng.generate_int_from_uniform(1, 3);
+    const int correctModeIdx = hasCorrectMode ? rng.generate_int_from_uniform(0, prediction.size - 1) : -1;
+    for(int modeIdx = 0; modeIdx < prediction.size; ++modeIdx)
+    {
+      const Vector3f position = modeIdx == correctModeIdx
+        ? Vector3f(worldPosition.x(), worldPosition.y(), worldPosition.z())
+        : Vector3f(rng.generate_real_from_uniform(-2.0f, 2.0f), rng.generate_real_from_uniform(-2.0f, 2.0f), rng.generate_real_from_uniform(-2.0f, 2.0f));
+      prediction.elts[modeIdx] = make_mode(position, keypoint.colour, rng);
+    }
+  }
+
+  return scene;
+}
+
+/**
+ * \brief Makes a preemptive RANSAC instance that runs in deterministic mode.
+ *
+ * \return  The preemptive RANSAC instance.
+ */
+PreemptiveRansac_Ptr make_deterministic_ransac()
+{
+  tvgutil::SettingsContainer_Ptr settings(new tvgutil::SettingsContainer);
+  settings->add_value("PreemptiveRansac.batchSizeRansac", "100");
+  settings->add_value("PreemptiveRansac.deterministic", "1");
+  settings->add_value("PreemptiveRansac.maxPoseCandidates", "256");
+  settings->add_value("PreemptiveRansac.maxPoseCandidatesAfterCull", "32");
+  return PreemptiveRansac_Ptr(new PreemptiveRansac_CPU(settings));
+}
+
+/**
+ * \brief Checks whether or not two lists of pose candidates are bit-identical.
+ *
+ * \param lhs The first list of pose candidates.
+ * \param rhs The second list of pose candidates.
+ * \return    true, if the lists are bit-identical, or false otherwise.
+ */
+bool same_candidates(const std::vector<PoseCandidate>& lhs, const std::vector<PoseCandidate>& rhs)
+{
+  if(lhs.size() != rhs.size()) return false;
+
+  for(size_t i = 0, size = lhs.size(); i < size; ++i)
+  {
+    if(memcmp(lhs[i].cameraPose.m, rhs[i].cameraPose.m, sizeof(lhs[i].cameraPose.m)) != 0) return false;
+    if(memcmp(&lhs[i].energy, &rhs[i].energy, sizeof(float)) != 0) return false;
+  }
+
+  return true;
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_PreemptiveRansac)
+
+BOOST_AUTO_TEST_CASE(deterministic_mode_test)
+{
+  MemoryBlockFactory::instance().set_device_type(ITMLib::ITMLibSettings::DEVICE_CPU);
+  const Scene scene = make_scene();
+
+  // Estimate a pose, and check that it is close to the true pose.
+  PreemptiveRansac_Ptr ransac = make_deterministic_ransac();
+  boost::optional<PoseCandidate> candidate = ransac->estimate_pose(scene.keypointsImage, scene.predictionsImage);
+  BOOST_REQUIRE(candidate);
+
+  const Eigen::Matrix4f estimatedCameraPose = Eigen::Map<const Eigen::Matrix4f>(candidate->cameraPose.m);
+  BOOST_CHECK_SMALL((estimatedCameraPose - scene.trueCameraPose).norm(), 1e-3f);
+
+  std::vector<PoseCandidate> expectedCandidates;
+  ransac->get_best_poses(expectedCandidates, 16);
+  BOOST_CHECK_EQUAL(expectedCandidates.size(), 16);
+
+  // Check that estimating the pose again using the same instance gives exactly the same results, since the random
+  // number generators are reseeded at the start of each call.
+  ransac->estimate_pose(scene.keypointsImage, scene.predictionsImage);
+  std::vector<PoseCandidate> candidates;
+  ransac->get_best_poses(candidates, 16);
+  BOOST_CHECK(same_candidates(candidates, expectedCandidates));
+
+  // Check that a new instance gives exactly the same results, regardless of the number of threads used.
+#ifdef WITH_OPENMP
+  const int oldThreadCount = omp_get_max_threads();
+#endif
+
+  const int threadCounts[] = { 1, 3, 8 };
+  for(int i = 0; i < 3; ++i)
+  {
+#ifdef WITH_OPENMP
+    omp_set_num_threads(threadCounts[i]);
+#endif
+
+    ransac = make_deterministic_ransac();
+    ransac->estimate_pose(scene.keypointsImage, scene.predictionsImage);
+    ransac->get_best_poses(candidates, 16);
+    BOOST_CHECK(same_candidates(candidates, expectedCandidates));
+  }
+
+#ifdef WITH_OPENMP
+  omp_set_num_threads(oldThreadCount);
+#endif
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,160 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+
+#include <ORUtils/SE3Pose.h>
+
+#include <itmx/remotemapping/CompressedRGBDFrameMessage.h>
+#include <itmx/remotemapping/RGBDFrameCompressor.h>
+using namespace itmx;
+
+//#################### HELPER FUNCTIONS ####################
+
+void append_bytes(std::vector<char>& bytes, const void *data, size_t size)
+{
+  const char *begin = reinterpret_cast<const char*>(data);
+  bytes.insert(bytes.end(), begin, begin + size);
+}
+
+/**
+ * \brief Concatenates the contents of a sequence of buffers, as a gather write would.
+ */
+std::vector<char> gather(const std::vector<boost::asio::const_buffer>& buffers)
+{
+  std::vector<char> bytes(boost::asio::buffer_size(buffers));
+  boost::asio::buffer_copy(boost::asio::buffer(bytes), buffers);
+  return bytes;
+}
+
+/**
+ * \brief Makes a frame message with a recognisable pose and images (the depth image contains runs of zeros and non-zero values of both signs).
+ */
+RGBDFrameMessage_Ptr make_frame(const Vector2i& imgSize)
+{
+  RGBDFrameMessage_Ptr msg = RGBDFrameMessage::make(imgSize, imgSize);
+  msg->set_frame_index(1234);
+  msg->set_pose(ORUtils::SE3Pose(0.1f, -0.2f, 0.3f, 0.4f, -0.5f, 0.6f));
+
+  const int pixelCount = imgSize.x * imgSize.y;
+  short *depthData = msg->get_depth_image_data();
+  Vector4u *rgbData = msg->get_rgb_image_data();
+  for(int i = 0; i < pixelCount; ++i)
+  {
+    depthData[i] = i % 7 < 3 ? 0 : static_cast<short>((i * 37) % 5000 - 1000);
+    rgbData[i] = Vector4u(static_cast<uchar>(i), static_cast<uchar>(i * 3), static_cast<uchar>(i * 7), 255);
+  }
+
+  return msg;
+}
+
+/**
+ * \brief Reads a flat sequence of bytes into a sequence of buffers, as a scatter read would.
+ */
+void scatter(const std::vector<char>& bytes, const std::vector<boost::asio::mutable_buffer>& buffers)
+{
+  BOOST_REQUIRE_EQUAL(boost::asio::buffer_size(buffers), bytes.size());
+  boost::asio::buffer_copy(buffers, boost::asio::buffer(bytes));
+}
+
+void check_round_trip(DepthCompressionType depthCompressionType)
+{
+  const Vector2i imgSize(32, 24);
+  const int pixelCount = imgSize.x * imgSize.y;
+  RGBDFrameMessage_Ptr frameMsg = make_frame(imgSize);
+
+  // Compress the frame, and gather the header and frame messages into a single sequence of bytes, as the client does.
+  RGBDFrameCompressor compressor(imgSize, imgSize, RGB_COMPRESSION_NONE, depthCompressionType);
+  CompressedRGBDFrameHeaderMessage headerMsg(MAPPING_PROTOCOL_LATEST);
+  CompressedRGBDFrameMessage compressedMsg(headerMsg);
+  compressor.compress_rgbd_frame(*frameMsg, headerMsg, compressedMsg);
+
+  std::vector<boost::asio::const_buffer> constBuffers;
+  headerMsg.append_const_buffers(constBuffers);
+  compressedMsg.append_const_buffers(constBuffers);
+  const std::vector<char> bytes = gather(constBuffers);
+
+  // Read the bytes back, first into a header message and then into a frame message sized using the header, as the server does.
+  CompressedRGBDFrameHeaderMessage receivedHeaderMsg(MAPPING_PROTOCOL_LATEST);
+  BOOST_REQUIRE_GE(bytes.size(), receivedHeaderMsg.get_size());
+  memcpy(receivedHeaderMsg.get_data_ptr(), &bytes[0], receivedHeaderMsg.get_size());
+  BOOST_CHECK_EQUAL(receivedHeaderMsg.extract_depth_compression_type(), depthCompressionType);
+
+  CompressedRGBDFrameMessage receivedMsg(receivedHeaderMsg);
+  std::vector<boost::asio::mutable_buffer> mutableBuffers;
+  receivedMsg.append_mutable_buffers(mutableBuffers);
+  scatter(std::vector<char>(bytes.begin() + receivedHeaderMsg.get_size(), bytes.end()), mutableBuffers);
+
+  // Uncompress the frame, and check that it matches the original.
+  RGBDFrameCompressor uncompressor(imgSize, imgSize, RGB_COMPRESSION_NONE, receivedHeaderMsg.extract_depth_compression_type());
+  RGBDFrameMessage_Ptr uncompressedMsg = RGBDFrameMessage::make(imgSize, imgSize);
+  uncompressor.uncompress_rgbd_frame(receivedMsg, *uncompressedMsg);
+
+  BOOST_CHECK_EQUAL(uncompressedMsg->extract_frame_index(), frameMsg->extract_frame_index());
+  BOOST_CHECK(memcmp(uncompressedMsg->extract_pose().GetM().m, frameMsg->extract_pose().GetM().m, sizeof(Matrix4f)) == 0);
+  BOOST_CHECK(memcmp(uncompressedMsg->get_depth_image_data(), frameMsg->get_depth_image_data(), pixelCount * sizeof(short)) == 0);
+  BOOST_CHECK(memcmp(uncompressedMsg->get_rgb_image_data(), frameMsg->get_rgb_image_data(), pixelCount * sizeof(Vector4u)) == 0);
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_CompressedRGBDFrameMessage)
+
+BOOST_AUTO_TEST_CASE(layout_test)
+{
+  CompressedRGBDFrameHeaderMessage headerMsg;
+  headerMsg.set_depth_image_size(5);
+  headerMsg.set_rgb_image_size(7);
+
+  CompressedRGBDFrameMessage msg(headerMsg);
+  const ORUtils::SE3Pose pose(1.0f, 2.0f, 3.0f, 0.1f, 0.2f, 0.3f);
+  msg.set_frame_index(42);
+  msg.set_pose(pose);
+
+  const uint8_t depthBytes[] = { 1, 2, 3, 4, 5 };
+  const uint8_t rgbBytes[] = { 10, 20, 30, 40, 50, 60, 70 };
+  msg.set_depth_image_data(std::vector<uint8_t>(depthBytes, depthBytes + sizeof(depthBytes)));
+  msg.set_rgb_image_data(std::vector<uint8_t>(rgbBytes, rgbBytes + sizeof(rgbBytes)));
+
+  // Construct the layout that the message had when it was stored as a single flat buffer.
+  const int frameIndex = 42;
+  std::vector<char> expectedBytes;
+  append_bytes(expectedBytes, &frameIndex, sizeof(int));
+  append_bytes(expectedBytes, &pose.GetM(), sizeof(Matrix4f));
+  append_bytes(expectedBytes, pose.GetParams(), 6 * sizeof(float));
+  append_bytes(expectedBytes, depthBytes, sizeof(depthBytes));
+  append_bytes(expectedBytes, rgbBytes, sizeof(rgbBytes));
+
+  // Gathering the message's buffers should produce exactly the same bytes, so that the wire format is unchanged.
+  std::vector<boost::asio::const_buffer> constBuffers;
+  msg.append_const_buffers(constBuffers);
+  const std::vector<char> bytes = gather(constBuffers);
+  BOOST_CHECK(bytes == expectedBytes);
+
+  // Scattering the bytes into a message sized using the same header should recover the original message.
+  CompressedRGBDFrameMessage receivedMsg(headerMsg);
+  std::vector<boost::asio::mutable_buffer> mutableBuffers;
+  receivedMsg.append_mutable_buffers(mutableBuffers);
+  scatter(bytes, mutableBuffers);
+
+  BOOST_CHECK_EQUAL(receivedMsg.extract_frame_index(), 42);
+  BOOST_CHECK(memcmp(receivedMsg.extract_pose().GetM().m, pose.GetM().m, sizeof(Matrix4f)) == 0);
+  BOOST_CHECK(receivedMsg.get_depth_image_data() == msg.get_depth_image_data());
+  BOOST_CHECK(receivedMsg.get_rgb_image_data() == msg.get_rgb_image_data());
+
+  // Resizing the message for a frame with smaller images should shrink its buffers accordingly.
+  headerMsg.set_depth_image_size(2);
+  headerMsg.set_rgb_image_size(0);
+  receivedMsg.set_compressed_image_sizes(headerMsg);
+  mutableBuffers.clear();
+  receivedMsg.append_mutable_buffers(mutableBuffers);
+  BOOST_CHECK_EQUAL(boost::asio::buffer_size(mutableBuffers), sizeof(int) + sizeof(Matrix4f) + 6 * sizeof(float) + 2);
+}
+
+BOOST_AUTO_TEST_CASE(round_trip_test)
+{
+  check_round_trip(DEPTH_COMPRESSION_NONE);
+  check_round_trip(DEPTH_COMPRESSION_RVL);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -68,6 +68,48 @@ BOOST_AUTO_TEST_CASE(test_estimate_rigid_transform)
   }
 }
 
+BOOST_AUTO_TEST_CASE(test_estimate_rigid_transform_n_points)
+{
+  // Generate a known rigid transformation.
+  const Eigen::Matrix3f trueR = Eigen::AngleAxisf(0.7f, Eigen::Vector3f(1,2,3).normalized()).toRotationMatrix();
+  const Eigen::Vector3f trueT(0.5f, -1.0f, 2.0f);
+
+  // Transform a set of points that includes some collinear and coincident ones, and check that the transformation is recovered.
+  const int pointCount = 20;
+  Eigen::Matrix3Xf P(3, pointCount);
+  for(int i = 0; i < pointCount; ++i)
+  {
+    P.col(i) = Eigen::Vector3f(static_cast<float>(i % 4), static_cast<float>((i * 7) % 5) - 2.0f, 0.25f * (i / 4));
+  }
+
+  const Eigen::Matrix3Xf Q = (trueR * P).colwise() + trueT;
+
+  Eigen::Matrix3f R;
+  Eigen::Vector3f t;
+  GeometryUtil::estimate_rigid_transform(P, Q, R, t);
+
+  BOOST_CHECK_SMALL((R - trueR).norm(), 1e-4f);
+  BOOST_CHECK_SMALL((t - trueT).norm(), 1e-4f);
+
+  // Check that the N-point overload agrees with the three-point overload when given three points.
+  const Eigen::Matrix3f P3 = P.leftCols<3>(), Q3 = Q.leftCols<3>();
+  Eigen::Matrix3f R3;
+  Eigen::Vector3f t3;
+  GeometryUtil::estimate_rigid_transform(P3, Q3, R3, t3);
+  GeometryUtil::estimate_rigid_transform(Eigen::Matrix3Xf(P3), Eigen::Matrix3Xf(Q3), R, t);
+
+  BOOST_CHECK_SMALL((R - R3).norm(), 1e-6f);
+  BOOST_CHECK_SMALL((t - t3).norm(), 1e-6f);
+
+  // Check that reflecting the points does not cause a reflection to be returned in place of a rotation.
+  Eigen::Matrix3Xf reflectedQ = Q;
+  reflectedQ.row(2) *= -1;
+  GeometryUtil::estimate_rigid_transform(P, reflectedQ, R, t);
+
+  BOOST_CHECK_CLOSE(R.determinant(), 1.0f, 1e-3f);
+  BOOST_CHECK_SMALL((R * R.transpose() - Eigen::Matrix3f::Identity()).norm(), 1e-4f);
+}
+
 BOOST_AUTO_TEST_CASE_TEMPLATE(test_find_best_hypothesis, T, TS)
 {
   // Generate increasingly-large clusters of rotated poses around the z axis at 0, PI/2, PI and 3*PI/2 radians.
@@ -0,0 +1,328 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+
+#include <itmx/remotemapping/AckMessage.h>
+#include <itmx/remotemapping/MappingClient.h>
+#include <itmx/remotemapping/MappingServer.h>
+#include <itmx/remotemapping/ProtocolNegotiationMessage.h>
+using namespace itmx;
+using namespace tvgutil;
+using boost::asio::ip::tcp;
+
+//#################### HELPER FUNCTIONS ####################
+
+RGBDCalibrationMessage make_calibration_message(const Vector2i& imgSize)
+{
+  RGBDCalibrationMessage msg;
+  msg.set_depth_compression_type(DEPTH_COMPRESSION_RVL);
+  msg.set_depth_image_size(imgSize);
+  msg.set_rgb_compression_type(RGB_COMPRESSION_NONE);
+  msg.set_rgb_image_size(imgSize);
+  return msg;
+}
+
+/**
+ * \brief Attempts to push a frame onto the frame message queue of a client.
+ *
+ * The index of the frame is stored in the first pixel of its depth image, so that it can be identified by the server.
+ * The frame's images can be given a different size to the one specified in the calibration message, in which case
+ * the client will fail to compress the frame.
+ *
+ * \param client      The client.
+ * \param frameIndex  The index of the frame.
+ * \param imgSize     The size of the frame's images.
+ * \return            true, if the frame was pushed onto the queue, or false if it was discarded.
+ */
+bool push_frame(MappingClient& client, int frameIndex, const Vector2i& imgSize)
+{
+  MappingClient::RGBDFrameMessageQueue::PushHandler_Ptr pushHandler = client.begin_push_frame_message();
+  boost::optional<RGBDFrameMessage_Ptr&> elt = pushHandler->get();
+  if(!elt) return false;
+
+  RGBDFrameMessage_Ptr msg = RGBDFrameMessage::make(imgSize, imgSize);
+  msg->set_frame_index(frameIndex);
+  std::fill(msg->get_depth_image_data(), msg->get_depth_image_data() + imgSize.x * imgSize.y, 0);
+  msg->get_depth_image_data()[0] = static_cast<short>(frameIndex);
+  *elt = msg;
+
+  return true;
+}
+
+/**
+ * \brief Reads the next frame from the specified client of a mapping server.
+ *
+ * \return  The index of the frame, as stored by push_frame.
+ */
+short read_frame(MappingServer& server, int clientID, const Vector2i& imgSize)
+{
+  ITMUChar4Image rgb(imgSize, true, false);
+  ITMShortImage depth(imgSize, true, false);
+  ORUtils::SE3Pose pose;
+  server.get_images(clientID, &rgb, &depth);
+  server.get_pose(clientID, pose);
+  return depth.GetData(MEMORYDEVICE_CPU)[0];
+}
+
+/**
+ * \brief Reads a compressed frame sent by a client using the latest protocol version from a raw socket.
+ *
+ * \param sock       The socket.
+ * \param frameIndex Used to return the index of the frame.
+ * \return           The sequence number of the frame.
+ */
+uint32_t read_raw_frame(tcp::socket& sock, int& frameIndex)
+{
+  CompressedRGBDFrameHeaderMessage headerMsg(MAPPING_PROTOCOL_LATEST);
+  boost::asio::read(sock, boost::asio::buffer(headerMsg.get_data_ptr(), headerMsg.get_size()));
+
+  CompressedRGBDFrameMessage frameMsg(headerMsg);
+  frameMsg.set_compressed_image_sizes(headerMsg);
+  std::vector<boost::asio::mutable_buffer> buffers;
+  frameMsg.append_mutable_buffers(buffers);
+  boost::asio::read(sock, buffers);
+
+  frameIndex = frameMsg.extract_frame_index();
+  return headerMsg.extract_sequence_number();
+}
+
+/**
+ * \brief Emulates a server that accepts a client and acknowledges its calibration message, but never acknowledges any frames.
+ */
+void run_stalled_server(tcp::acceptor& acceptor, tcp::socket& sock)
+{
+  acceptor.accept(sock);
+
+  RGBDCalibrationMessage calibMsg;
+  boost::asio::read(sock, boost::asio::buffer(calibMsg.get_data_ptr(), calibMsg.get_size()));
+
+  // Advertise the stop-and-wait protocol, so that the client will wait for an acknowledgement after sending its first frame.
+  AckMessage ackMsg;
+  ackMsg.set_status_code(MAPPING_PROTOCOL_STOP_AND_WAIT);
+  boost::asio::write(sock, boost::asio::buffer(ackMsg.get_data_ptr(), ackMsg.get_size()));
+}
+
+/**
+ * \brief Emulates a server that accepts a client and agrees to use the latest protocol version with the specified window size.
+ *
+ * \param acceptor              The acceptor to use to accept the client.
+ * \param sock                  The socket to use to communicate with the client.
+ * \param windowSize            The window size to agree to.
+ * \param requestedWindowSize   Used to return the window size requested by the client.
+ */
+void run_windowed_server(tcp::acceptor& acceptor, tcp::socket& sock, uint16_t windowSize, uint16_t& requestedWindowSize)
+{
+  acceptor.accept(sock);
+
+  RGBDCalibrationMessage calibMsg;
+  boost::asio::read(sock, boost::asio::buffer(calibMsg.get_data_ptr(), calibMsg.get_size()));
+
+  AckMessage ackMsg;
+  ackMsg.set_status_code(MAPPING_PROTOCOL_LATEST);
+  boost::asio::write(sock, boost::asio::buffer(ackMsg.get_data_ptr(), ackMsg.get_size()));
+
+  ProtocolNegotiationMessage negotiationMsg;
+  boost::asio::read(sock, boost::asio::buffer(negotiationMsg.get_data_ptr(), negotiationMsg.get_size()));
+  requestedWindowSize = negotiationMsg.has_valid_marker() ? negotiationMsg.extract_window_size() : 0;
+
+  ackMsg.set_status_code(windowSize);
+  boost::asio::write(sock, boost::asio::buffer(ackMsg.get_data_ptr(), ackMsg.get_size()));
+}
+
+/**
+ * \brief Sends a cumulative acknowledgement of the specified number of frames to a client over a raw socket.
+ */
+void send_cumulative_ack(tcp::socket& sock, int32_t framesReceived)
+{
+  AckMessage ackMsg;
+  ackMsg.set_status_code(framesReceived);
+  boost::asio::write(sock, boost::asio::buffer(ackMsg.get_data_ptr(), ackMsg.get_size()));
+}
+
+/**
+ * \brief Waits (for up to a few seconds) for a count to reach an expected value.
+ *
+ * \return  true, if the count reached the expected value, or false otherwise.
+ */
+bool wait_for_count(const boost::function<size_t()>& getCount, size_t expectedCount)
+{
+  for(int i = 0; i < 5000 && getCount() != expectedCount; ++i)
+  {
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+  }
+
+  return getCount() == expectedCount;
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_MappingClient)
+
+BOOST_AUTO_TEST_CASE(destructor_test)
+{
+  const Vector2i imgSize(8, 6);
+  MappingServer server(MappingServer::MSM_MULTI_CLIENT, 7871);
+  server.start();
+
+  // A client that has not yet started its threads.
+  {
+    MappingClient client("localhost", "7871");
+  }
+
+  // A client whose threads are waiting for frames.
+  {
+    MappingClient client("localhost", "7871", pooled_queue::PES_WAIT);
+    client.send_calibration_message(make_calibration_message(imgSize));
+  }
+
+  // A client that is destroyed while it still has frames to compress and send (the server never reads them).
+  {
+    MappingClient client("localhost", "7871", pooled_queue::PES_DISCARD, 4, 2);
+    client.send_calibration_message(make_calibration_message(imgSize));
+    for(int i = 0; i < 20; ++i) push_frame(client, i, imgSize);
+  }
+
+  // If we get here, the destructors have returned rather than deadlocking.
+  BOOST_CHECK(true);
+}
+
+BOOST_AUTO_TEST_CASE(dropped_frame_count_test)
+{
+  const Vector2i imgSize(8, 6);
+
+  // Frames are dropped if the frame message queue is full when they are pushed.
+  {
+    boost::asio::io_service ioService;
+    tcp::acceptor acceptor(ioService, tcp::endpoint(tcp::v4(), 7872));
+    tcp::socket sock(ioService);
+    boost::thread serverThread(boost::bind(&run_stalled_server, boost::ref(acceptor), boost::ref(sock)));
+
+    const size_t compressionThreadCount = 2, slotCount = compressionThreadCount + 1;
+    MappingClient client("localhost", "7872", pooled_queue::PES_DISCARD, 4, compressionThreadCount);
+    client.send_calibration_message(make_calibration_message(imgSize));
+    serverThread.join();
+
+    // Fill the compression slots. The sender will send the first frame and then wait for an acknowledgement that never comes.
+    for(size_t i = 0; i < slotCount; ++i)
+    {
+      BOOST_CHECK(push_frame(client, static_cast<int>(i), imgSize));
+      BOOST_CHECK(wait_for_count(boost::bind(&MappingClient::get_queued_frame_count, &client), 0));
+    }
+
+    BOOST_CHECK_EQUAL(client.get_compressing_frame_count(), slotCount);
+
+    // The next frame should be queued, and the ones after that should be dropped.
+    BOOST_CHECK(push_frame(client, static_cast<int>(slotCount), imgSize));
+    for(int i = 0; i < 6; ++i) BOOST_CHECK(!push_frame(client, static_cast<int>(slotCount) + 1 + i, imgSize));
+
+    BOOST_CHECK_EQUAL(client.get_queued_frame_count(), 1);
+    BOOST_CHECK_EQUAL(client.get_dropped_frame_count(), 6);
+    BOOST_CHECK_EQUAL(client.get_sent_frame_count(), 0);
+  }
+
+  // Frames are also dropped if they cannot be compressed (here, because their images are the wrong size).
+  {
+    MappingServer server(MappingServer::MSM_MULTI_CLIENT, 7873);
+    server.start();
+
+    MappingClient client("localhost", "7873", pooled_queue::PES_WAIT, 4, 3);
+    client.send_calibration_message(make_calibration_message(imgSize));
+
+    // Note: The frames are pushed in batches that are small enough to fit into the server's frame message queue, since the
+    //       server would otherwise drop some of them itself.
+    const Vector2i wrongImgSize(imgSize.x + 1, imgSize.y);
+    const int batchSize = 5, frameCount = 10;
+    for(int i = 0; i < frameCount; i += batchSize)
+    {
+      for(int j = i; j < i + batchSize; ++j) push_frame(client, j, j % 3 == 1 ? wrongImgSize : imgSize);
+
+      // The frames that could be compressed should still arrive in order.
+      for(int j = i; j < i + batchSize; ++j)
+      {
+        if(j % 3 != 1) BOOST_CHECK_EQUAL(read_frame(server, 0, imgSize), j);
+      }
+    }
+
+    BOOST_CHECK(wait_for_count(boost::bind(&MappingClient::get_sent_frame_count, &client), 7));
+    BOOST_CHECK_EQUAL(client.get_dropped_frame_count(), 3);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(frame_order_test)
+{
+  const Vector2i imgSize(64, 48);
+  const int batchSize = 4, frameCount = 200;
+
+  MappingServer server(MappingServer::MSM_MULTI_CLIENT, 7874);
+  server.start();
+
+  MappingClient client("localhost", "7874", pooled_queue::PES_WAIT, 4, 4);
+  client.send_calibration_message(make_calibration_message(imgSize));
+
+  // Although the frames in each batch are compressed concurrently, they should arrive at the server in the order in which they
+  // were pushed. As above, the batches are small enough to fit into the server's frame message queue.
+  for(int i = 0; i < frameCount; i += batchSize)
+  {
+    for(int j = i; j < i + batchSize; ++j) push_frame(client, j, imgSize);
+    for(int j = i; j < i + batchSize; ++j) BOOST_CHECK_EQUAL(read_frame(server, 0, imgSize), j);
+  }
+
+  BOOST_CHECK(wait_for_count(boost::bind(&MappingClient::get_sent_frame_count, &client), frameCount));
+  BOOST_CHECK_EQUAL(client.get_dropped_frame_count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(window_test)
+{
+  const Vector2i imgSize(8, 6);
+
+  boost::asio::io_service ioService;
+  tcp::acceptor acceptor(ioService, tcp::endpoint(tcp::v4(), 7875));
+  tcp::socket sock(ioService);
+
+  // The client asks for a window of 8 frames, but the server only agrees to 3.
+  const uint16_t windowSize = 3;
+  uint16_t requestedWindowSize = 0;
+  boost::thread serverThread(boost::bind(&run_windowed_server, boost::ref(acceptor), boost::ref(sock), windowSize, boost::ref(requestedWindowSize)));
+
+  MappingClient client("localhost", "7875", pooled_queue::PES_WAIT, 8, 2);
+  client.send_calibration_message(make_calibration_message(imgSize));
+  serverThread.join();
+  BOOST_CHECK_EQUAL(requestedWindowSize, 8);
+
+  // Push enough frames to fill the window twice over, and check that the client stops once the window is full.
+  // (The client can hold these without blocking, since sent frames no longer occupy its compression slots.)
+  int frameIndex;
+  for(int i = 0; i < 6; ++i) push_frame(client, i, imgSize);
+  for(int i = 0; i < 3; ++i)
+  {
+    BOOST_CHECK_EQUAL(read_raw_frame(sock, frameIndex), i);
+    BOOST_CHECK_EQUAL(frameIndex, i);
+  }
+
+  boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+  BOOST_CHECK_EQUAL(sock.available(), 0);
+
+  // A single acknowledgement of all of the frames in flight should let the client send a whole window's worth more.
+  send_cumulative_ack(sock, 3);
+  for(int i = 3; i < 6; ++i)
+  {
+    BOOST_CHECK_EQUAL(read_raw_frame(sock, frameIndex), i);
+    BOOST_CHECK_EQUAL(frameIndex, i);
+  }
+
+  // An acknowledgement of only some of the frames in flight should only let the client send that many more.
+  for(int i = 6; i < 8; ++i) push_frame(client, i, imgSize);
+  send_cumulative_ack(sock, 4);
+  BOOST_CHECK_EQUAL(read_raw_frame(sock, frameIndex), 6);
+
+  boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+  BOOST_CHECK_EQUAL(sock.available(), 0);
+
+  send_cumulative_ack(sock, 7);
+  BOOST_CHECK_EQUAL(read_raw_frame(sock, frameIndex), 7);
+
+  BOOST_CHECK(wait_for_count(boost::bind(&MappingClient::get_sent_frame_count, &client), 8));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
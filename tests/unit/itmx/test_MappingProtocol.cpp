@@ -0,0 +1,93 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <stdexcept>
+
+#include <itmx/remotemapping/CompressedRGBDFrameHeaderMessage.h>
+#include <itmx/remotemapping/ProtocolNegotiationMessage.h>
+using namespace itmx;
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_MappingProtocol)
+
+BOOST_AUTO_TEST_CASE(frame_header_test)
+{
+  // Each version of the protocol appends a field to the frame header, leaving the layout of the earlier fields unchanged.
+  CompressedRGBDFrameHeaderMessage stopAndWaitMsg(MAPPING_PROTOCOL_STOP_AND_WAIT);
+  CompressedRGBDFrameHeaderMessage windowedMsg(MAPPING_PROTOCOL_WINDOWED);
+  CompressedRGBDFrameHeaderMessage depthTypeMsg(MAPPING_PROTOCOL_WINDOWED_WITH_DEPTH_COMPRESSION_TYPE);
+
+  BOOST_CHECK_EQUAL(stopAndWaitMsg.get_size(), 8);
+  BOOST_CHECK_EQUAL(windowedMsg.get_size(), 12);
+  BOOST_CHECK_EQUAL(depthTypeMsg.get_size(), 16);
+
+  BOOST_CHECK(!stopAndWaitMsg.has_sequence_number());
+  BOOST_CHECK(!stopAndWaitMsg.has_depth_compression_type());
+  BOOST_CHECK(windowedMsg.has_sequence_number());
+  BOOST_CHECK(!windowedMsg.has_depth_compression_type());
+  BOOST_CHECK(depthTypeMsg.has_sequence_number());
+  BOOST_CHECK(depthTypeMsg.has_depth_compression_type());
+
+  // Fields that are not present in a version of the header can be neither read nor written.
+  BOOST_CHECK_THROW(stopAndWaitMsg.extract_sequence_number(), std::runtime_error);
+  BOOST_CHECK_THROW(stopAndWaitMsg.set_sequence_number(0), std::runtime_error);
+  BOOST_CHECK_THROW(windowedMsg.extract_depth_compression_type(), std::runtime_error);
+  BOOST_CHECK_THROW(windowedMsg.set_depth_compression_type(DEPTH_COMPRESSION_RVL), std::runtime_error);
+
+  // The fields should be stored in the order depth image size, RGB image size, sequence number, depth compression type.
+  depthTypeMsg.set_depth_image_size(1);
+  depthTypeMsg.set_rgb_image_size(2);
+  depthTypeMsg.set_sequence_number(3);
+  depthTypeMsg.set_depth_compression_type(DEPTH_COMPRESSION_RVL);
+
+  const uint32_t expectedFields[] = { 1, 2, 3, DEPTH_COMPRESSION_RVL };
+  BOOST_CHECK(memcmp(depthTypeMsg.get_data_ptr(), expectedFields, sizeof(expectedFields)) == 0);
+
+  BOOST_CHECK_EQUAL(depthTypeMsg.extract_depth_image_size(), 1);
+  BOOST_CHECK_EQUAL(depthTypeMsg.extract_rgb_image_size(), 2);
+  BOOST_CHECK_EQUAL(depthTypeMsg.extract_sequence_number(), 3);
+  BOOST_CHECK_EQUAL(depthTypeMsg.extract_depth_compression_type(), DEPTH_COMPRESSION_RVL);
+
+  // The server checks each sequence number against the number of frames it has received so far, so the full range must be representable.
+  windowedMsg.set_sequence_number(0xFFFFFFFF);
+  BOOST_CHECK_EQUAL(windowedMsg.extract_sequence_number(), 0xFFFFFFFF);
+}
+
+BOOST_AUTO_TEST_CASE(negotiation_test)
+{
+  ProtocolNegotiationMessage negotiationMsg;
+
+  // The server reads the first message after the calibration message into a protocol negotiation message, whatever
+  // its type, so it must be the same size as the first frame header of a client that predates versioning.
+  CompressedRGBDFrameHeaderMessage headerMsg(MAPPING_PROTOCOL_STOP_AND_WAIT);
+  BOOST_CHECK_EQUAL(negotiationMsg.get_size(), headerMsg.get_size());
+
+  BOOST_CHECK(negotiationMsg.has_valid_marker());
+  negotiationMsg.set_protocol_version(MAPPING_PROTOCOL_WINDOWED_WITH_DEPTH_COMPRESSION_TYPE);
+  negotiationMsg.set_window_size(0xFFFF);
+  BOOST_CHECK(negotiationMsg.has_valid_marker());
+  BOOST_CHECK_EQUAL(negotiationMsg.extract_protocol_version(), MAPPING_PROTOCOL_WINDOWED_WITH_DEPTH_COMPRESSION_TYPE);
+  BOOST_CHECK_EQUAL(negotiationMsg.extract_window_size(), 0xFFFF);
+
+  // A real frame header should not be mistaken for a protocol negotiation message, even if its images are empty or enormous.
+  const uint32_t depthImageSizes[] = { 0, 1, 640 * 480 * 2, 0xFFFFFFFE };
+  for(size_t i = 0; i < sizeof(depthImageSizes) / sizeof(uint32_t); ++i)
+  {
+    headerMsg.set_depth_image_size(depthImageSizes[i]);
+    headerMsg.set_rgb_image_size(0xFFFFFFFF);
+
+    ProtocolNegotiationMessage firstMsg;
+    memcpy(firstMsg.get_data_ptr(), headerMsg.get_data_ptr(), headerMsg.get_size());
+    BOOST_CHECK(!firstMsg.has_valid_marker());
+
+    // When the server falls back to treating the message as a frame header, it copies it across, which must preserve the header.
+    CompressedRGBDFrameHeaderMessage copiedHeaderMsg(MAPPING_PROTOCOL_STOP_AND_WAIT);
+    memcpy(copiedHeaderMsg.get_data_ptr(), firstMsg.get_data_ptr(), firstMsg.get_size());
+    BOOST_CHECK_EQUAL(copiedHeaderMsg.extract_depth_image_size(), depthImageSizes[i]);
+    BOOST_CHECK_EQUAL(copiedHeaderMsg.extract_rgb_image_size(), 0xFFFFFFFF);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
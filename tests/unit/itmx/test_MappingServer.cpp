@@ -0,0 +1,374 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+
+#include <itmx/remotemapping/AckMessage.h>
+#include <itmx/remotemapping/MappingClient.h>
+#include <itmx/remotemapping/MappingServer.h>
+#include <itmx/remotemapping/ProtocolNegotiationMessage.h>
+using namespace itmx;
+using namespace tvgutil;
+using boost::asio::ip::tcp;
+
+//#################### HELPER FUNCTIONS ####################
+
+RGBDCalibrationMessage make_calibration_message(const Vector2i& imgSize, DepthCompressionType depthCompressionType)
+{
+  RGBDCalibrationMessage msg;
+  msg.set_depth_compression_type(depthCompressionType);
+  msg.set_depth_image_size(imgSize);
+  msg.set_rgb_compression_type(RGB_COMPRESSION_NONE);
+  msg.set_rgb_image_size(imgSize);
+  return msg;
+}
+
+/**
+ * \brief Makes a frame message whose index is stored in the first pixel of its depth image, so that it can be identified by the server.
+ */
+RGBDFrameMessage_Ptr make_frame(int frameIndex, const Vector2i& imgSize)
+{
+  RGBDFrameMessage_Ptr msg = RGBDFrameMessage::make(imgSize, imgSize);
+  msg->set_frame_index(frameIndex);
+  std::fill(msg->get_depth_image_data(), msg->get_depth_image_data() + imgSize.x * imgSize.y, 0);
+  msg->get_depth_image_data()[0] = static_cast<short>(frameIndex);
+  return msg;
+}
+
+void push_frame(MappingClient& client, int frameIndex, const Vector2i& imgSize)
+{
+  MappingClient::RGBDFrameMessageQueue::PushHandler_Ptr pushHandler = client.begin_push_frame_message();
+  boost::optional<RGBDFrameMessage_Ptr&> elt = pushHandler->get();
+  if(elt) *elt = make_frame(frameIndex, imgSize);
+}
+
+/**
+ * \brief Reads the next frame from the specified client of a mapping server.
+ *
+ * \return  The index of the frame, as stored by make_frame.
+ */
+short read_frame(MappingServer& server, int clientID, const Vector2i& imgSize)
+{
+  ITMUChar4Image rgb(imgSize, true, false);
+  ITMShortImage depth(imgSize, true, false);
+  ORUtils::SE3Pose pose;
+  server.get_images(clientID, &rgb, &depth);
+  server.get_pose(clientID, pose);
+  return depth.GetData(MEMORYDEVICE_CPU)[0];
+}
+
+/**
+ * \brief Pushes batches of frames to a mapping server using a client, reading each batch back from the server before pushing the next.
+ *
+ * \note  The batches are small enough to fit into the server's frame message queue, since the server would otherwise drop some of the frames.
+ *
+ * \param server         The server.
+ * \param client         The client.
+ * \param clientID       The ID of the client on the server.
+ * \param frameCount     The number of frames to push.
+ * \param imgSize        The size of the frames' images.
+ * \param frameIndices   Used to return the indices of the frames read back from the server.
+ */
+void push_and_read_frames(MappingServer& server, MappingClient& client, int clientID, int frameCount, const Vector2i& imgSize, std::vector<short>& frameIndices)
+{
+  const int batchSize = 4;
+  for(int i = 0; i < frameCount; i += batchSize)
+  {
+    for(int j = i; j < i + batchSize; ++j) push_frame(client, j, imgSize);
+    for(int j = i; j < i + batchSize; ++j) frameIndices.push_back(read_frame(server, clientID, imgSize));
+  }
+}
+
+void read_message(tcp::socket& sock, MappingMessage& msg)
+{
+  std::vector<boost::asio::mutable_buffer> buffers;
+  msg.append_mutable_buffers(buffers);
+  boost::asio::read(sock, buffers);
+}
+
+/**
+ * \brief Connects a raw socket to a mapping server, sends it a calibration message, and reads its acknowledgement.
+ *
+ * \return  The status code of the acknowledgement (i.e. the latest protocol version supported by the server).
+ */
+int32_t send_calibration_message(tcp::socket& sock, int port, const Vector2i& imgSize)
+{
+  sock.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), static_cast<unsigned short>(port)));
+
+  RGBDCalibrationMessage calibMsg = make_calibration_message(imgSize, DEPTH_COMPRESSION_NONE);
+  boost::asio::write(sock, boost::asio::buffer(calibMsg.get_data_ptr(), calibMsg.get_size()));
+
+  AckMessage ackMsg;
+  read_message(sock, ackMsg);
+  return ackMsg.extract_status_code();
+}
+
+/**
+ * \brief Compresses a frame and sends it to a mapping server over a raw socket, as a client using the specified protocol version would.
+ */
+void send_frame(tcp::socket& sock, MappingProtocolVersion protocolVersion, int frameIndex, uint32_t sequenceNumber, const Vector2i& imgSize)
+{
+  RGBDFrameCompressor frameCompressor(imgSize, imgSize, RGB_COMPRESSION_NONE, DEPTH_COMPRESSION_NONE);
+  CompressedRGBDFrameHeaderMessage headerMsg(protocolVersion);
+  CompressedRGBDFrameMessage frameMsg(headerMsg);
+  frameCompressor.compress_rgbd_frame(*make_frame(frameIndex, imgSize), headerMsg, frameMsg);
+  if(headerMsg.has_sequence_number()) headerMsg.set_sequence_number(sequenceNumber);
+
+  std::vector<boost::asio::const_buffer> buffers;
+  headerMsg.append_const_buffers(buffers);
+  frameMsg.append_const_buffers(buffers);
+  boost::asio::write(sock, buffers);
+}
+
+/**
+ * \brief Waits (for up to a few seconds) for a condition to become true.
+ *
+ * \return  true, if the condition became true, or false otherwise.
+ */
+bool wait_for(const boost::function<bool()>& condition)
+{
+  for(int i = 0; i < 5000 && !condition(); ++i)
+  {
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+  }
+
+  return condition();
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_MappingServer)
+
+BOOST_AUTO_TEST_CASE(disconnection_test)
+{
+  const Vector2i imgSize(8, 6);
+  const int port = 7884;
+  MappingServer server(MappingServer::MSM_MULTI_CLIENT, port);
+  server.start();
+
+  {
+    boost::asio::io_service ioService;
+    tcp::socket sock(ioService);
+    send_calibration_message(sock, port, imgSize);
+
+    AckMessage ackMsg;
+    for(int i = 0; i < 2; ++i)
+    {
+      send_frame(sock, MAPPING_PROTOCOL_STOP_AND_WAIT, i, 0, imgSize);
+      read_message(sock, ackMsg);
+    }
+
+    BOOST_CHECK_EQUAL(read_frame(server, 0, imgSize), 0);
+    BOOST_CHECK(server.has_more_images(0));
+  }
+
+  // Once the client has disconnected, the server should report that it has no more images, and getting its images
+  // should return straight away, leaving the output images untouched (even though a frame was still on the queue).
+  BOOST_CHECK(wait_for(!boost::bind(&MappingServer::has_more_images, &server, 0)));
+
+  ITMUChar4Image rgb(imgSize, true, false);
+  ITMShortImage depth(imgSize, true, false);
+  depth.GetData(MEMORYDEVICE_CPU)[0] = -1;
+  server.get_images(0, &rgb, &depth);
+  BOOST_CHECK_EQUAL(depth.GetData(MEMORYDEVICE_CPU)[0], -1);
+  BOOST_CHECK(!server.has_more_images(0));
+}
+
+BOOST_AUTO_TEST_CASE(legacy_client_test)
+{
+  const Vector2i imgSize(8, 6);
+  const int port = 7881;
+  MappingServer server(MappingServer::MSM_MULTI_CLIENT, port);
+  server.start();
+
+  // A client that predates versioning ignores the protocol version in the calibration acknowledgement, and sends a
+  // stop-and-wait frame header straight away. The server should treat this as the first frame, not as a negotiation.
+  boost::asio::io_service ioService;
+  tcp::socket sock(ioService);
+  BOOST_CHECK_EQUAL(send_calibration_message(sock, port, imgSize), MAPPING_PROTOCOL_LATEST);
+
+  AckMessage ackMsg;
+  for(int i = 0; i < 10; ++i)
+  {
+    send_frame(sock, MAPPING_PROTOCOL_STOP_AND_WAIT, i, 0, imgSize);
+
+    // Each frame should be individually acknowledged, with the status code that servers that predate versioning use.
+    ackMsg.set_status_code(-1);
+    read_message(sock, ackMsg);
+    BOOST_CHECK_EQUAL(ackMsg.extract_status_code(), 0);
+
+    BOOST_CHECK_EQUAL(read_frame(server, 0, imgSize), i);
+  }
+
+  BOOST_CHECK(server.has_more_images(0));
+}
+
+BOOST_AUTO_TEST_CASE(multiple_clients_test)
+{
+  const Vector2i imgSize(16, 12);
+  const int port = 7885;
+  MappingServer server(MappingServer::MSM_MULTI_CLIENT, port, 2);
+  server.start();
+
+  // Connect more clients than there are I/O threads (the clients are given IDs in the order in which they connect).
+  const int clientCount = 4, frameCount = 40;
+  std::vector<MappingClient_Ptr> clients;
+  for(int i = 0; i < clientCount; ++i)
+  {
+    clients.push_back(MappingClient_Ptr(new MappingClient("localhost", "7885", pooled_queue::PES_WAIT, 4, 2)));
+    clients.back()->send_calibration_message(make_calibration_message(imgSize, DEPTH_COMPRESSION_RVL));
+  }
+
+  // Send frames from all of the clients at once, and check that each client's frames arrive intact and in order.
+  std::vector<std::vector<short> > frameIndices(clientCount);
+  boost::thread_group threads;
+  for(int i = 0; i < clientCount; ++i)
+  {
+    threads.create_thread(boost::bind(&push_and_read_frames, boost::ref(server), boost::ref(*clients[i]), i, frameCount, imgSize, boost::ref(frameIndices[i])));
+  }
+
+  threads.join_all();
+
+  for(int i = 0; i < clientCount; ++i)
+  {
+    BOOST_REQUIRE_EQUAL(frameIndices[i].size(), frameCount);
+    for(int j = 0; j < frameCount; ++j) BOOST_CHECK_EQUAL(frameIndices[i][j], j);
+    BOOST_CHECK(server.has_more_images(i));
+  }
+
+  BOOST_CHECK_EQUAL(server.get_active_clients().size(), clientCount);
+}
+
+BOOST_AUTO_TEST_CASE(sequence_number_test)
+{
+  const Vector2i imgSize(8, 6);
+  const int port = 7882;
+  MappingServer server(MappingServer::MSM_MULTI_CLIENT, port);
+  server.start();
+
+  boost::asio::io_service ioService;
+  AckMessage ackMsg;
+
+  // A windowed client that skips a frame should be disconnected once the frames before the gap have been received.
+  tcp::socket sock(ioService);
+  send_calibration_message(sock, port, imgSize);
+
+  ProtocolNegotiationMessage negotiationMsg;
+  negotiationMsg.set_protocol_version(MAPPING_PROTOCOL_WINDOWED);
+  negotiationMsg.set_window_size(4);
+  boost::asio::write(sock, boost::asio::buffer(negotiationMsg.get_data_ptr(), negotiationMsg.get_size()));
+  read_message(sock, ackMsg);
+  BOOST_CHECK_EQUAL(ackMsg.extract_status_code(), 4);
+
+  send_frame(sock, MAPPING_PROTOCOL_WINDOWED, 0, 0, imgSize);
+  BOOST_CHECK_EQUAL(read_frame(server, 0, imgSize), 0);
+  BOOST_CHECK(server.has_more_images(0));
+
+  send_frame(sock, MAPPING_PROTOCOL_WINDOWED, 1, 2, imgSize);
+  BOOST_CHECK(wait_for(!boost::bind(&MappingServer::has_more_images, &server, 0)));
+
+  // A windowed client whose first frame has the wrong sequence number should be disconnected straight away.
+  tcp::socket sock2(ioService);
+  send_calibration_message(sock2, port, imgSize);
+  boost::asio::write(sock2, boost::asio::buffer(negotiationMsg.get_data_ptr(), negotiationMsg.get_size()));
+  read_message(sock2, ackMsg);
+
+  send_frame(sock2, MAPPING_PROTOCOL_WINDOWED, 0, 1, imgSize);
+  BOOST_CHECK(wait_for(!boost::bind(&MappingServer::has_more_images, &server, 1)));
+}
+
+BOOST_AUTO_TEST_CASE(windowed_client_test)
+{
+  const Vector2i imgSize(16, 12);
+  const int port = 7883;
+
+  // The server only allows two frames in flight at once, so the window the client asks for should be reduced.
+  MappingServer server(MappingServer::MSM_MULTI_CLIENT, port, 2, 10000, 2);
+  server.start();
+
+  MappingClient client("localhost", "7883", pooled_queue::PES_WAIT, 8, 2);
+  client.send_calibration_message(make_calibration_message(imgSize, DEPTH_COMPRESSION_RVL));
+
+  // Note: The frames are pushed in batches that are small enough to fit into the server's frame message queue, since
+  //       the server would otherwise drop some of them.
+  const int batchSize = 4, frameCount = 100;
+  for(int i = 0; i < frameCount; i += batchSize)
+  {
+    for(int j = i; j < i + batchSize; ++j) push_frame(client, j, imgSize);
+    for(int j = i; j < i + batchSize; ++j) BOOST_CHECK_EQUAL(read_frame(server, 0, imgSize), j);
+  }
+
+  BOOST_CHECK(server.has_more_images(0));
+}
+
+BOOST_AUTO_TEST_CASE(termination_test)
+{
+  const Vector2i imgSize(8, 6);
+  const int port = 7886;
+  MappingServer server(MappingServer::MSM_MULTI_CLIENT, port);
+  server.start();
+
+  // Connect a client that starts sending frames, and another that never sends its calibration message.
+  MappingClient client("localhost", "7886", pooled_queue::PES_WAIT);
+  client.send_calibration_message(make_calibration_message(imgSize, DEPTH_COMPRESSION_NONE));
+  push_frame(client, 0, imgSize);
+  BOOST_CHECK_EQUAL(read_frame(server, 0, imgSize), 0);
+
+  boost::asio::io_service ioService;
+  tcp::socket sock(ioService);
+  sock.connect(tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), static_cast<unsigned short>(port)));
+  BOOST_CHECK(wait_for(boost::bind(&std::vector<int>::size, boost::bind(&MappingServer::get_active_clients, &server)) == 2));
+
+  // Start a consumer that blocks waiting for the second client to become ready.
+  ITMUChar4Image rgb(imgSize, true, false);
+  ITMShortImage depth(imgSize, true, false);
+  boost::thread consumer(boost::bind(&MappingServer::get_images, &server, 1, &rgb, &depth));
+  BOOST_CHECK(!consumer.try_join_for(boost::chrono::milliseconds(100)));
+
+  // Terminating the server should return, and should wake the consumer.
+  server.terminate();
+  BOOST_CHECK(consumer.try_join_for(boost::chrono::seconds(5)));
+
+  BOOST_CHECK(!server.has_more_images(0));
+  BOOST_CHECK(!server.has_more_images(1));
+  BOOST_CHECK(server.get_active_clients().empty());
+
+  // Terminating the server again should do nothing.
+  server.terminate();
+}
+
+BOOST_AUTO_TEST_CASE(timeout_test)
+{
+  const Vector2i imgSize(8, 6);
+  const int port = 7887, timeoutMs = 200;
+  MappingServer server(MappingServer::MSM_MULTI_CLIENT, port, 2, timeoutMs);
+  server.start();
+
+  boost::asio::io_service ioService;
+  tcp::socket sock(ioService);
+  send_calibration_message(sock, port, imgSize);
+
+  AckMessage ackMsg;
+  send_frame(sock, MAPPING_PROTOCOL_STOP_AND_WAIT, 0, 0, imgSize);
+  read_message(sock, ackMsg);
+  BOOST_CHECK_EQUAL(read_frame(server, 0, imgSize), 0);
+
+  // A client may wait for as long as it likes between frames without being disconnected.
+  boost::this_thread::sleep_for(boost::chrono::milliseconds(3 * timeoutMs));
+  BOOST_CHECK(server.has_more_images(0));
+
+  // However, a client that stalls part of the way through sending a frame should be disconnected once the timeout expires.
+  CompressedRGBDFrameHeaderMessage headerMsg(MAPPING_PROTOCOL_STOP_AND_WAIT);
+  headerMsg.set_depth_image_size(imgSize.x * imgSize.y * sizeof(short));
+  headerMsg.set_rgb_image_size(imgSize.x * imgSize.y * sizeof(Vector4u));
+  boost::asio::write(sock, boost::asio::buffer(headerMsg.get_data_ptr(), headerMsg.get_size()));
+
+  const std::vector<char> partialFrame(16);
+  boost::asio::write(sock, boost::asio::buffer(partialFrame));
+
+  boost::chrono::steady_clock::time_point stallTime = boost::chrono::steady_clock::now();
+  BOOST_CHECK(wait_for(!boost::bind(&MappingServer::has_more_images, &server, 0)));
+  BOOST_CHECK(boost::chrono::steady_clock::now() - stallTime >= boost::chrono::milliseconds(timeoutMs / 2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
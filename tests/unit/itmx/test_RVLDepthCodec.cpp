@@ -0,0 +1,135 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <climits>
+#include <stdexcept>
+
+#include <itmx/remotemapping/RVLDepthCodec.h>
+using namespace itmx;
+
+//#################### HELPER FUNCTIONS ####################
+
+void check_round_trip(const std::vector<short>& depths)
+{
+  std::vector<uint8_t> compressedData;
+  RVLDepthCodec::compress(depths.empty() ? NULL : &depths[0], depths.size(), compressedData);
+
+  std::vector<short> uncompressedDepths(depths.size(), -1);
+  RVLDepthCodec::uncompress(compressedData, uncompressedDepths.empty() ? NULL : &uncompressedDepths[0], uncompressedDepths.size());
+  BOOST_CHECK(uncompressedDepths == depths);
+}
+
+std::vector<uint8_t> compress(const std::vector<short>& depths)
+{
+  std::vector<uint8_t> compressedData;
+  RVLDepthCodec::compress(&depths[0], depths.size(), compressedData);
+  return compressedData;
+}
+
+/**
+ * \brief Encodes a sequence of raw values using the RVL variable-length code, independently of the codec itself.
+ *
+ * This makes it possible to construct compressed data that the compressor would never produce.
+ */
+std::vector<uint8_t> encode_values(const std::vector<uint32_t>& values)
+{
+  std::vector<uint32_t> nibbles;
+  for(size_t i = 0; i < values.size(); ++i)
+  {
+    uint32_t value = values[i];
+    do
+    {
+      uint32_t nibble = value & 0x7;
+      value >>= 3;
+      if(value) nibble |= 0x8;
+      nibbles.push_back(nibble);
+    }
+    while(value);
+  }
+
+  // Pack the nibbles into 32-bit words, most significant nibble first, and padding the final word with zeros.
+  std::vector<uint8_t> data;
+  for(size_t i = 0; i < nibbles.size(); i += 8)
+  {
+    uint32_t word = 0;
+    for(size_t j = i; j < i + 8; ++j) word = (word << 4) | (j < nibbles.size() ? nibbles[j] : 0);
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&word);
+    data.insert(data.end(), bytes, bytes + sizeof(uint32_t));
+  }
+
+  return data;
+}
+
+std::vector<short> make_test_depths()
+{
+  const short values[] = { 0, 0, 0, 1200, 1201, 1199, 0, -5, SHRT_MAX, -SHRT_MAX, SHRT_MAX, SHRT_MIN, 0, 0, 7, 7, 7, 0 };
+  return std::vector<short>(values, values + sizeof(values) / sizeof(short));
+}
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_RVLDepthCodec)
+
+BOOST_AUTO_TEST_CASE(round_trip_test)
+{
+  // Empty images and images consisting entirely of zero or non-zero pixels.
+  check_round_trip(std::vector<short>());
+  check_round_trip(std::vector<short>(1, 0));
+  check_round_trip(std::vector<short>(1, 1));
+  check_round_trip(std::vector<short>(100, 0));
+  check_round_trip(std::vector<short>(100, 1000));
+
+  // An image with runs of zeros, negative values and the largest possible jumps between successive non-zero pixels.
+  check_round_trip(make_test_depths());
+
+  // A longer image containing every possible value, in an order that exercises both small and large deltas.
+  std::vector<short> depths;
+  for(int i = SHRT_MIN; i <= SHRT_MAX; ++i)
+  {
+    depths.push_back(static_cast<short>(i));
+    depths.push_back(static_cast<short>(-i - 1));
+    if(i % 37 == 0) depths.push_back(0);
+  }
+  check_round_trip(depths);
+}
+
+BOOST_AUTO_TEST_CASE(malformed_data_test)
+{
+  const std::vector<short> depths = make_test_depths();
+  const std::vector<uint8_t> compressedData = compress(depths);
+  std::vector<short> uncompressedDepths(depths.size());
+
+  // Data that is truncated, either to a partial word or to a whole number of words, should be rejected.
+  for(size_t size = 0; size < compressedData.size(); ++size)
+  {
+    const std::vector<uint8_t> truncatedData(compressedData.begin(), compressedData.begin() + size);
+    BOOST_CHECK_THROW(RVLDepthCodec::uncompress(truncatedData, &uncompressedDepths[0], uncompressedDepths.size()), std::runtime_error);
+  }
+
+  // Data with trailing bytes should be rejected.
+  std::vector<uint8_t> overlongData = compressedData;
+  overlongData.resize(overlongData.size() + sizeof(uint32_t), 0);
+  BOOST_CHECK_THROW(RVLDepthCodec::uncompress(overlongData, &uncompressedDepths[0], uncompressedDepths.size()), std::runtime_error);
+
+  // Data that describes more pixels than the destination image contains should be rejected.
+  BOOST_CHECK_THROW(RVLDepthCodec::uncompress(compressedData, &uncompressedDepths[0], uncompressedDepths.size() - 1), std::runtime_error);
+
+  // Data that describes fewer pixels than the destination image contains should be rejected.
+  uncompressedDepths.resize(depths.size() + 1);
+  BOOST_CHECK_THROW(RVLDepthCodec::uncompress(compressedData, &uncompressedDepths[0], uncompressedDepths.size()), std::runtime_error);
+
+  // Deltas that are individually valid, but that take the reconstructed depth outside the range of a short, should be rejected.
+  const uint32_t zigzagMax = 2 * SHRT_MAX;
+  const uint32_t values[] = { 0, 2, zigzagMax, zigzagMax };
+  const std::vector<uint8_t> overflowingData = encode_values(std::vector<uint32_t>(values, values + 4));
+  uncompressedDepths.resize(2);
+  BOOST_CHECK_THROW(RVLDepthCodec::uncompress(overflowingData, &uncompressedDepths[0], uncompressedDepths.size()), std::runtime_error);
+
+  // As a sanity check, the same data with the second delta set to zero should be accepted.
+  const uint32_t validValues[] = { 0, 2, zigzagMax, 0 };
+  RVLDepthCodec::uncompress(encode_values(std::vector<uint32_t>(validValues, validValues + 4)), &uncompressedDepths[0], uncompressedDepths.size());
+  BOOST_CHECK_EQUAL(uncompressedDepths[0], SHRT_MAX);
+  BOOST_CHECK_EQUAL(uncompressedDepths[1], SHRT_MAX);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
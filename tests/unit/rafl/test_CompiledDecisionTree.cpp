@@ -0,0 +1,154 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+
+#include <boost/assign/list_of.hpp>
+using boost::assign::list_of;
+
+#include <rafl/core/RandomForest.h>
+#include <rafl/examples/UnitCircleExampleGenerator.h>
+using namespace rafl;
+
+typedef int Label;
+typedef boost::shared_ptr<const Example<Label> > Example_CPtr;
+typedef DecisionTree<Label> DT;
+typedef RandomForest<Label> RF;
+
+/**
+ * \brief Makes the settings for a decision tree that uses the specified type of decision function generator.
+ *
+ * \param decisionFunctionGeneratorType The type of decision function generator to use.
+ * \return                              The settings.
+ */
+DT::Settings make_settings(const std::string& decisionFunctionGeneratorType)
+{
+  DecisionFunctionGeneratorFactory<Label>::instance().register_rafl_makers();
+
+  std::map<std::string,std::string> properties;
+  properties["candidateCount"] = "64";
+  properties["decisionFunctionGeneratorParams"] = "";
+  properties["decisionFunctionGeneratorType"] = decisionFunctionGeneratorType;
+  properties["gainThreshold"] = "0.0";
+  properties["maxClassSize"] = "1000";
+  properties["maxStoredExamples"] = "0";
+  properties["maxTreeHeight"] = "20";
+  properties["parallelSplitting"] = "0";
+  properties["randomSeed"] = "12345";
+  properties["seenExamplesThreshold"] = "30";
+  properties["splitBinCount"] = "0";
+  properties["splittabilityThreshold"] = "0.5";
+  properties["usePMFReweighting"] = "1";
+  return DT::Settings(properties);
+}
+
+/**
+ * \brief Checks that a compiled forest produces exactly the same PMFs as the forest from which it was compiled.
+ *
+ * \param decisionFunctionGeneratorType The type of decision function generator to use when training the forest.
+ */
+void check_compiled_forest(const std::string& decisionFunctionGeneratorType)
+{
+  UnitCircleExampleGenerator<Label> generator(list_of(1)(2)(3)(4), 1234);
+  RF forest(3, make_settings(decisionFunctionGeneratorType));
+  for(int i = 0; i < 10; ++i)
+  {
+    forest.add_examples(generator.generate_examples(list_of(1)(2)(3)(4), 50));
+    forest.train(5);
+  }
+  BOOST_REQUIRE(forest.get_tree(0)->get_node_count() > 1);
+
+  std::vector<Example_CPtr> testExamples = generator.generate_examples(list_of(1)(2)(3)(4), 100);
+  std::vector<tvgutil::ProbabilityMassFunction<Label> > expectedPMFs;
+  for(size_t i = 0, size = testExamples.size(); i < size; ++i)
+  {
+    expectedPMFs.push_back(forest.calculate_pmf(testExamples[i]->get_descriptor()));
+  }
+
+  forest.compile();
+  BOOST_REQUIRE(forest.is_compiled());
+
+  for(size_t i = 0, size = testExamples.size(); i < size; ++i)
+  {
+    tvgutil::ProbabilityMassFunction<Label> actualPMF = forest.calculate_pmf(testExamples[i]->get_descriptor());
+    BOOST_CHECK(actualPMF.get_masses() == expectedPMFs[i].get_masses());
+  }
+
+  // Check that batch prediction gives exactly the same results as predicting the descriptors one at a time.
+  const size_t featureCount = testExamples[0]->get_descriptor()->size();
+  DescriptorBatch batch(testExamples.size(), featureCount);
+  for(size_t i = 0, size = testExamples.size(); i < size; ++i)
+  {
+    std::copy(testExamples[i]->get_descriptor()->begin(), testExamples[i]->get_descriptor()->end(), batch.get_writable_descriptor(i));
+  }
+
+  BatchPredictions<Label> predictions;
+  forest.predict_batch(batch, predictions);
+  BOOST_REQUIRE_EQUAL(predictions.get_descriptor_count(), testExamples.size());
+  for(size_t i = 0, size = testExamples.size(); i < size; ++i)
+  {
+    BOOST_CHECK_EQUAL(predictions.get_predicted_label(i), expectedPMFs[i].calculate_best_label());
+
+    const std::vector<Label>& labels = predictions.get_labels();
+    const float *masses = predictions.get_masses(i);
+    for(size_t j = 0, labelCount = labels.size(); j < labelCount; ++j)
+    {
+      const tvgutil::ProbabilityMassFunction<Label>::Masses& expectedMasses = expectedPMFs[i].get_masses();
+      tvgutil::ProbabilityMassFunction<Label>::Masses::const_iterator it = expectedMasses.find(labels[j]);
+      BOOST_CHECK_EQUAL(masses[j], it != expectedMasses.end() ? it->second : 0.0f);
+    }
+  }
+
+  // Check that the forest survives a round trip through the flat binary format, both with and without memory-mapping.
+  const std::string path = "test_CompiledDecisionTree-" + decisionFunctionGeneratorType + ".rff";
+  forest.save_compiled(path);
+  for(int useMemoryMapping = 0; useMemoryMapping <= 1; ++useMemoryMapping)
+  {
+    boost::shared_ptr<const CompiledRandomForest<Label> > loadedForest = CompiledRandomForest<Label>::load(path, useMemoryMapping != 0);
+    BOOST_REQUIRE_EQUAL(loadedForest->get_tree_count(), forest.get_tree_count());
+    for(size_t i = 0, size = testExamples.size(); i < size; ++i)
+    {
+      tvgutil::ProbabilityMassFunction<Label> actualPMF = loadedForest->calculate_pmf(testExamples[i]->get_descriptor());
+      BOOST_CHECK(actualPMF.get_masses() == expectedPMFs[i].get_masses());
+    }
+
+    // Check that descriptors that are too short for the loaded forest to test are rejected.
+    BOOST_CHECK(loadedForest->get_feature_count() <= testExamples[0]->get_descriptor()->size());
+    if(loadedForest->get_feature_count() > 0)
+    {
+      Descriptor_Ptr shortDescriptor(new Descriptor(loadedForest->get_feature_count() - 1));
+      BOOST_CHECK_THROW(loadedForest->calculate_pmf(shortDescriptor), std::invalid_argument);
+      BOOST_CHECK_THROW(loadedForest->predict(shortDescriptor), std::invalid_argument);
+    }
+  }
+
+  // Check that a truncated file is rejected.
+  {
+    std::ifstream fs(path.c_str(), std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+    fs.close();
+    std::ofstream os(path.c_str(), std::ios::binary);
+    os.write(contents.data(), contents.size() - 8);
+  }
+  BOOST_CHECK_THROW(CompiledRandomForest<Label>::load(path), std::runtime_error);
+  std::remove(path.c_str());
+
+  // Check that modifying the forest discards the compiled snapshots.
+  forest.add_examples(generator.generate_examples(list_of(1), 1));
+  BOOST_CHECK(!forest.is_compiled());
+}
+
+BOOST_AUTO_TEST_SUITE(test_CompiledDecisionTree)
+
+BOOST_AUTO_TEST_CASE(feature_thresholding_test)
+{
+  check_compiled_forest("FeatureThresholding");
+}
+
+BOOST_AUTO_TEST_CASE(pairwise_op_and_threshold_test)
+{
+  check_compiled_forest("PairwiseOpAndThreshold");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,120 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+
+#include <boost/assign/list_of.hpp>
+using boost::assign::list_of;
+
+#include <rafl/examples/ExampleUtil.h>
+#include <rafl/examples/UnitCircleExampleGenerator.h>
+using namespace rafl;
+
+typedef int Label;
+typedef boost::shared_ptr<const Example<Label> > Example_CPtr;
+
+/**
+ * \brief Writes the specified text to a file.
+ *
+ * \param filename  The name of the file.
+ * \param text      The text to write.
+ */
+void write_file(const std::string& filename, const std::string& text)
+{
+  std::ofstream fs(filename.c_str(), std::ios::binary);
+  fs << text;
+}
+
+/**
+ * \brief Checks that loading examples from the specified text fails with an error message that mentions the specified position.
+ *
+ * \param text      The text from which to try to load examples.
+ * \param position  The expected position of the error (e.g. "line 2, column 5").
+ */
+void check_text_error(const std::string& text, const std::string& position)
+{
+  const std::string filename = "test_ExampleUtil-bad.txt";
+  write_file(filename, text);
+  try
+  {
+    ExampleUtil::load_examples<Label>(filename);
+    BOOST_ERROR("Expected an error at " + position);
+  }
+  catch(std::runtime_error& e)
+  {
+    BOOST_CHECK_MESSAGE(std::string(e.what()).find(position) != std::string::npos, e.what());
+  }
+  std::remove(filename.c_str());
+}
+
+/**
+ * \brief Checks that two sets of examples are identical.
+ *
+ * \param lhs The first set of examples.
+ * \param rhs The second set of examples.
+ */
+void check_examples_equal(const std::vector<Example_CPtr>& lhs, const std::vector<Example_CPtr>& rhs)
+{
+  BOOST_REQUIRE_EQUAL(lhs.size(), rhs.size());
+  for(size_t i = 0, size = lhs.size(); i < size; ++i)
+  {
+    BOOST_CHECK_EQUAL(lhs[i]->get_label(), rhs[i]->get_label());
+    BOOST_CHECK(*lhs[i]->get_descriptor() == *rhs[i]->get_descriptor());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(test_ExampleUtil)
+
+BOOST_AUTO_TEST_CASE(load_text_examples_test)
+{
+  const std::string filename = "test_ExampleUtil.txt";
+  write_file(filename, "1.5, -2, 3\r\n\n  0.25,1e2 ,7\n");
+  std::vector<Example_CPtr> examples = ExampleUtil::load_examples<Label>(filename);
+  std::remove(filename.c_str());
+
+  BOOST_REQUIRE_EQUAL(examples.size(), 2);
+  BOOST_CHECK_EQUAL(examples[0]->get_label(), 3);
+  BOOST_CHECK(*examples[0]->get_descriptor() == list_of(1.5f)(-2.0f));
+  BOOST_CHECK_EQUAL(examples[1]->get_label(), 7);
+  BOOST_CHECK(*examples[1]->get_descriptor() == list_of(0.25f)(100.0f));
+}
+
+BOOST_AUTO_TEST_CASE(text_error_test)
+{
+  check_text_error("1,2,3\n4,x5,6\n", "line 2, column 3");
+  check_text_error("1,2,3\n\n4,5,6.5\n", "line 3, column 5");
+  check_text_error("1,2,3\n4,5\n", "line 2, column 1");
+  check_text_error("1,2,3\n7\n", "line 2, column 1");
+}
+
+BOOST_AUTO_TEST_CASE(conversion_test)
+{
+  UnitCircleExampleGenerator<Label> generator(list_of(1)(2)(3), 1234);
+  std::vector<Example_CPtr> examples = generator.generate_examples(list_of(1)(2)(3), 100);
+
+  // Check that examples survive round trips through both the text and binary formats.
+  const std::string textFilename = "test_ExampleUtil.txt", binaryFilename = "test_ExampleUtil.bin";
+  ExampleUtil::save_text_examples(examples, textFilename);
+  std::vector<Example_CPtr> textExamples = ExampleUtil::load_examples<Label>(textFilename);
+  check_examples_equal(textExamples, examples);
+
+  ExampleUtil::save_binary_examples(textExamples, binaryFilename);
+  BOOST_CHECK(ExampleUtil::is_binary_example_file(binaryFilename));
+  BOOST_CHECK(!ExampleUtil::is_binary_example_file(textFilename));
+  check_examples_equal(ExampleUtil::load_examples<Label>(binaryFilename), examples);
+
+  // Check that a truncated binary file is rejected.
+  {
+    std::ifstream fs(binaryFilename.c_str(), std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+    fs.close();
+    write_file(binaryFilename, contents.substr(0, contents.size() - 1));
+  }
+  BOOST_CHECK_THROW(ExampleUtil::load_examples<Label>(binaryFilename), std::runtime_error);
+
+  std::remove(textFilename.c_str());
+  std::remove(binaryFilename.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
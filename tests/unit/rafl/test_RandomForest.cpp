@@ -0,0 +1,389 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+
+#include <boost/assign/list_of.hpp>
+using boost::assign::list_of;
+
+#include <rafl/core/RandomForest.h>
+#include <rafl/examples/UnitCircleExampleGenerator.h>
+using namespace rafl;
+
+#include <tvgutil/persistence/SerializationUtil.h>
+
+typedef int Label;
+typedef boost::shared_ptr<const Example<Label> > Example_CPtr;
+typedef DecisionTree<Label> DT;
+typedef RandomForest<Label> RF;
+
+/**
+ * \brief Makes the settings for a decision tree.
+ *
+ * \param seed              The seed for the random number generator.
+ * \param splitBinCount     The number of bins to use when searching for splits (0 to evaluate each candidate exactly as generated).
+ * \param parallelSplitting Whether or not to search for the splits of several nodes concurrently.
+ * \param maxStoredExamples The maximum number of examples that may be stored in a forest's reservoirs at any one time (0 for no limit).
+ * \return                  The settings.
+ */
+DT::Settings make_settings(unsigned int seed, size_t splitBinCount = 0, bool parallelSplitting = false, size_t maxStoredExamples = 0)
+{
+  DecisionFunctionGeneratorFactory<Label>::instance().register_rafl_makers();
+
+  std::map<std::string,std::string> properties;
+  properties["candidateCount"] = "64";
+  properties["decisionFunctionGeneratorParams"] = "";
+  properties["decisionFunctionGeneratorType"] = "FeatureThresholding";
+  properties["gainThreshold"] = "0.0";
+  properties["maxClassSize"] = "1000";
+  properties["maxStoredExamples"] = boost::lexical_cast<std::string>(maxStoredExamples);
+  properties["maxTreeHeight"] = "20";
+  properties["parallelSplitting"] = parallelSplitting ? "1" : "0";
+  properties["randomSeed"] = boost::lexical_cast<std::string>(seed);
+  properties["seenExamplesThreshold"] = "30";
+  properties["splitBinCount"] = boost::lexical_cast<std::string>(splitBinCount);
+  properties["splittabilityThreshold"] = "0.5";
+  properties["usePMFReweighting"] = "1";
+  return DT::Settings(properties);
+}
+
+/**
+ * \brief Calculates the proportion of the specified examples that a forest labels correctly.
+ *
+ * \param forest    The forest.
+ * \param examples  The examples.
+ * \return          The proportion of the examples that the forest labels correctly.
+ */
+float calculate_accuracy(const RF& forest, const std::vector<Example_CPtr>& examples)
+{
+  int correctCount = 0;
+  for(size_t i = 0, size = examples.size(); i < size; ++i)
+  {
+    if(forest.predict(examples[i]->get_descriptor()) == examples[i]->get_label()) ++correctCount;
+  }
+  return static_cast<float>(correctCount) / examples.size();
+}
+
+/**
+ * \brief Counts the examples that are currently stored in the reservoirs of all of the trees in a forest.
+ *
+ * \param forest  The forest.
+ * \return        The number of examples that are currently stored in the forest's reservoirs.
+ */
+size_t count_stored_examples(const RF& forest)
+{
+  size_t count = 0;
+  for(size_t i = 0, size = forest.get_tree_count(); i < size; ++i)
+  {
+    count += forest.get_tree(i)->get_stored_example_count();
+  }
+  return count;
+}
+
+/**
+ * \brief Gets a text archive containing a small forest, as written by the original (version 0) serialization code.
+ *
+ * The forest has a single tree, which was trained on examples of classes 1 and 2 from a unit circle example generator
+ * (with maxClassSize = 3, maxTreeHeight = 2 and seenExamplesThreshold = 4), split once, and then given more examples.
+ *
+ * \return The text archive.
+ */
+std::string get_version0_forest_archive()
+{
+  return
+  "22 serialization::archive 18 0 1 0\n"
+  "0 0 0 16 0.000000000e+00 3 2 0 1 3 1 0\n"
+  "1 12345 4 5.000000000e-01 1 0  19 FeatureThresholding 0 0 1 1 0 1 6 1 0\n"
+  "2 1 0\n"
+  "3 0 0 2 0 0 0 1 6 2 6 12 0 0 0 1 1 0 0 2 0 0 0 1 2.000000000e+00 2 2.000000000e+00 1 0 0 3 1 0 1 16 1 0\n"
+  "4 0 1 0 0 6 0 0 0 0 0 1 -1 3 -1 8 2 0 1 21 41 rafl::FeatureThresholdingDecisionFunction 1 0\n"
+  "5 0 0 0 8.848073483e-01 16\n"
+  "6 1 -1 3 1 0 0 0 2 0 0 3 1 0 1 26 1 0\n"
+  "7 0 1 28\n"
+  "8 2 0 -1.761908531e+00 -7.945583761e-02 2 26\n"
+  "9 28\n"
+  "10 2 0 -1.287263155e+00 -1.785108298e-01 2 26 7 7\n"
+  "11 1 0 2 6 6 3 3 1 6 -1 -1 16\n"
+  "12 1 -1 3 1 0 1 3 1 26\n"
+  "13 28\n"
+  "14 2 0 9.227817059e-01 -2.957593501e-01 1 26\n"
+  "15 28\n"
+  "16 2 0 1.239956379e+00 -1.866028458e-01 1 26\n"
+  "17 28\n"
+  "18 2 0 8.848073483e-01 -7.411196083e-02 1 7\n"
+  "19 1 0 1 6 6 3 3 1 6 -1 -1 0 16 0.000000000e+00 3 2 3 1 4 5.000000000e-01 1 0  19 FeatureThresholding 0 0 2 0 1 0 2 1 0 0 2 0 0 0 1 0.000000000e+00 -1 2 0.000000000e+00 -1 1\n";
+}
+
+/**
+ * \brief Trains a forest on examples from the unit circle generator.
+ *
+ * \param forest    The forest to train.
+ * \param generator The generator to use to generate the examples.
+ */
+void train_forest(RF& forest, UnitCircleExampleGenerator<Label>& generator)
+{
+  for(int i = 0; i < 10; ++i)
+  {
+    forest.add_examples(generator.generate_examples(list_of(1)(2)(3)(4), 50));
+    forest.train(20);
+  }
+}
+
+/**
+ * \brief Trains a forest and returns a textual representation of the result.
+ *
+ * \param seed              The seed for the forest's random number generator.
+ * \param parallelTraining  Whether or not to add examples to and train the trees in parallel.
+ * \param splitBinCount     The number of bins to use when searching for splits.
+ * \param maxStoredExamples The maximum number of examples that may be stored in the forest's reservoirs at any one time (0 for no limit).
+ * \return                  A textual representation of the trained forest.
+ */
+std::string train_forest_to_string(unsigned int seed, bool parallelTraining, size_t splitBinCount = 0, size_t maxStoredExamples = 0)
+{
+  UnitCircleExampleGenerator<Label> generator(list_of(1)(2)(3)(4), 1234);
+  RF forest(5, make_settings(seed, splitBinCount, false, maxStoredExamples), parallelTraining);
+  train_forest(forest, generator);
+
+  std::ostringstream oss;
+  forest.output(oss);
+  return oss.str();
+}
+
+BOOST_AUTO_TEST_SUITE(test_RandomForest)
+
+BOOST_AUTO_TEST_CASE(binned_split_test)
+{
+  const size_t splitBinCount = 32;
+
+  // Check that a forest trained using a binned split search fits the data about as well as one trained without it.
+  UnitCircleExampleGenerator<Label> generator(list_of(1)(2)(3)(4), 1234);
+  RF exactForest(3, make_settings(12345));
+  RF binnedForest(3, make_settings(12345, splitBinCount));
+  train_forest(exactForest, generator);
+  train_forest(binnedForest, generator);
+  BOOST_REQUIRE(binnedForest.get_tree(0)->get_node_count() > 1);
+
+  std::vector<Example_CPtr> testExamples = generator.generate_examples(list_of(1)(2)(3)(4), 100);
+  float exactAccuracy = calculate_accuracy(exactForest, testExamples);
+  float binnedAccuracy = calculate_accuracy(binnedForest, testExamples);
+  BOOST_CHECK_GE(binnedAccuracy, exactAccuracy - 0.05f);
+
+  // Check that the binned split search is deterministic when the candidates are evaluated in parallel.
+  BOOST_CHECK_EQUAL(train_forest_to_string(12345, true, splitBinCount), train_forest_to_string(12345, true, splitBinCount));
+}
+
+BOOST_AUTO_TEST_CASE(descriptor_batch_test)
+{
+  UnitCircleExampleGenerator<Label> generator(list_of(1)(2)(3)(4), 1234);
+  RF forest(3, make_settings(12345));
+  train_forest(forest, generator);
+
+  // Copy the descriptors of some test examples into a batch.
+  std::vector<Example_CPtr> testExamples = generator.generate_examples(list_of(1)(2)(3)(4), 25);
+  DescriptorBatch batch(testExamples.size(), 2);
+  for(size_t i = 0, size = testExamples.size(); i < size; ++i)
+  {
+    const Descriptor& descriptor = *testExamples[i]->get_descriptor();
+    std::copy(descriptor.begin(), descriptor.end(), batch.get_writable_descriptor(i));
+  }
+
+  // Check that predicting from the batch (and from a view onto it) gives the same results as predicting from the descriptors.
+  DescriptorBatch view(batch.get_descriptor(0), batch.get_descriptor_count(), batch.get_feature_count());
+  BOOST_CHECK(!view.owns_data());
+  BOOST_CHECK_THROW(view.get_writable_descriptor(0), std::runtime_error);
+
+  for(size_t i = 0, size = testExamples.size(); i < size; ++i)
+  {
+    Label expectedLabel = forest.predict(testExamples[i]->get_descriptor());
+    BOOST_CHECK_EQUAL(forest.predict(batch.get_descriptor(i)), expectedLabel);
+    BOOST_CHECK_EQUAL(forest.predict(view.get_descriptor(i)), expectedLabel);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(forest_budget_test)
+{
+  // Check that a forest that cannot give each of its trees at least one slot of its budget is rejected.
+  BOOST_CHECK_THROW(RF forest(8, make_settings(12345, 0, false, 2)), std::runtime_error);
+
+  // Check that the trees of a forest never store more examples between them than the forest's limit, whether or not the
+  // limit is a multiple of the number of trees, and whether or not the trees are trained in parallel.
+  const size_t limits[] = { 5, 7, 300 };
+  for(size_t i = 0; i < sizeof(limits) / sizeof(size_t); ++i)
+  {
+    for(int parallelTraining = 0; parallelTraining <= 1; ++parallelTraining)
+    {
+      UnitCircleExampleGenerator<Label> generator(list_of(1)(2)(3)(4), 1234);
+      RF forest(5, make_settings(12345, 0, false, limits[i]), parallelTraining != 0);
+      for(int j = 0; j < 10; ++j)
+      {
+        forest.add_examples(generator.generate_examples(list_of(1)(2)(3)(4), 50));
+        BOOST_CHECK_LE(count_stored_examples(forest), limits[i]);
+        forest.train(20);
+        BOOST_CHECK_LE(count_stored_examples(forest), limits[i]);
+      }
+
+      // Since far more examples have been added than the forest can store, its budget should be fully used.
+      BOOST_CHECK_EQUAL(count_stored_examples(forest), limits[i]);
+
+      // Check that resetting a tree and refilling it does not let it exceed its share of the budget.
+      forest.reset_tree(0);
+      forest.add_examples(generator.generate_examples(list_of(1)(2)(3)(4), 50));
+      BOOST_CHECK_EQUAL(count_stored_examples(forest), limits[i]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(legacy_archive_test)
+{
+  // Check that a forest saved in the original format can still be loaded.
+  RF *loadedForest = NULL;
+  {
+    DecisionFunctionGeneratorFactory<Label>::instance().register_rafl_makers();
+    std::istringstream iss(get_version0_forest_archive());
+    boost::archive::text_iarchive ar(iss);
+    ar >> loadedForest;
+  }
+  boost::shared_ptr<RF> forest(loadedForest);
+
+  BOOST_REQUIRE_EQUAL(forest->get_tree_count(), 1);
+  BOOST_CHECK_EQUAL(forest->get_tree(0)->get_node_count(), 3);
+
+  Descriptor_Ptr descriptor(new Descriptor(2));
+  (*descriptor)[0] = 1.5f;
+  (*descriptor)[1] = 0.0f;
+  BOOST_CHECK_EQUAL(forest->predict(descriptor), 1);
+  (*descriptor)[0] = -1.5f;
+  BOOST_CHECK_EQUAL(forest->predict(descriptor), 2);
+
+  // Check that the loaded forest can be trained further, and that it survives a round trip through the current format.
+  UnitCircleExampleGenerator<Label> generator(list_of(1)(2), 1234);
+  forest->add_examples(generator.generate_examples(list_of(1)(2), 10));
+  forest->train(1);
+
+  std::ostringstream oss;
+  {
+    boost::archive::text_oarchive ar(oss);
+    const RF *forestPtr = forest.get();
+    ar << forestPtr;
+  }
+
+  RF *reloadedForest = NULL;
+  {
+    std::istringstream iss(oss.str());
+    boost::archive::text_iarchive ar(iss);
+    ar >> reloadedForest;
+  }
+  boost::shared_ptr<RF> forest2(reloadedForest);
+
+  std::ostringstream oss1, oss2;
+  forest->output(oss1);
+  forest2->output(oss2);
+  BOOST_CHECK_EQUAL(oss1.str(), oss2.str());
+}
+
+BOOST_AUTO_TEST_CASE(parallel_splitting_test)
+{
+  // Check that a forest whose trees search for splits in parallel fits the data about as well as one whose trees do not.
+  UnitCircleExampleGenerator<Label> generator(list_of(1)(2)(3)(4), 1234);
+  RF serialForest(3, make_settings(12345));
+  RF parallelForest1(3, make_settings(12345, 0, true));
+  train_forest(serialForest, generator);
+  train_forest(parallelForest1, generator);
+  BOOST_REQUIRE(parallelForest1.get_tree(0)->get_node_count() > 1);
+
+  std::vector<Example_CPtr> testExamples = generator.generate_examples(list_of(1)(2)(3)(4), 100);
+  BOOST_CHECK_GE(calculate_accuracy(parallelForest1, testExamples), calculate_accuracy(serialForest, testExamples) - 0.05f);
+
+  // Check that searching for splits in parallel with a fixed seed produces the same forest each time.
+  UnitCircleExampleGenerator<Label> generator2(list_of(1)(2)(3)(4), 1234);
+  UnitCircleExampleGenerator<Label> generator3(list_of(1)(2)(3)(4), 1234);
+  RF parallelForest2(3, make_settings(12345, 0, true));
+  RF parallelForest3(3, make_settings(12345, 0, true));
+  train_forest(parallelForest2, generator2);
+  train_forest(parallelForest3, generator3);
+
+  std::ostringstream oss2, oss3;
+  parallelForest2.output(oss2);
+  parallelForest3.output(oss3);
+  BOOST_CHECK_EQUAL(oss2.str(), oss3.str());
+}
+
+BOOST_AUTO_TEST_CASE(parallel_training_test)
+{
+  // Check that training in parallel with a fixed seed produces the same forest each time.
+  std::string forest1 = train_forest_to_string(12345, true);
+  std::string forest2 = train_forest_to_string(12345, true);
+  BOOST_CHECK_EQUAL(forest1, forest2);
+
+  // Check that training in parallel produces the same forest as training serially, even when the forest's reservoirs have a limited budget.
+  BOOST_CHECK_EQUAL(train_forest_to_string(12345, false), forest1);
+  BOOST_CHECK_EQUAL(train_forest_to_string(12345, true, 0, 300), train_forest_to_string(12345, false, 0, 300));
+}
+
+BOOST_AUTO_TEST_CASE(reservoir_budget_test)
+{
+  // Check that reservoirs sharing a budget never store more examples between them than the budget allows.
+  tvgutil::RandomNumberGenerator_Ptr rng(new tvgutil::RandomNumberGenerator(12345));
+  UnitCircleExampleGenerator<Label> generator(list_of(1)(2)(3)(4), 1234);
+  ExampleReservoirBudget_Ptr budget(new ExampleReservoirBudget(15));
+  ExampleReservoir<Label> reservoir1(10, budget), reservoir2(10, budget);
+
+  std::vector<Example_CPtr> examples = generator.generate_examples(list_of(1)(2)(3), 20);
+  for(size_t i = 0, size = examples.size(); i < size; ++i)
+  {
+    reservoir1.add_example(examples[i], *rng);
+    reservoir2.add_example(examples[i], *rng);
+  }
+
+  BOOST_CHECK_EQUAL(reservoir1.current_size() + reservoir2.current_size(), 15);
+  BOOST_CHECK_EQUAL(budget->get_used(), 15);
+  BOOST_CHECK_EQUAL(reservoir1.get_examples().size(), reservoir1.current_size());
+  BOOST_CHECK_EQUAL(reservoir1.seen_examples(), examples.size());
+
+  // Check that the class multipliers only cover the classes that actually have examples in the reservoir.
+  std::map<Label,float> multipliers = reservoir1.get_class_multipliers();
+  size_t exampleCount = 0;
+  for(std::map<Label,float>::const_iterator it = multipliers.begin(), iend = multipliers.end(); it != iend; ++it)
+  {
+    BOOST_CHECK_GE(it->second, 1.0f);
+    exampleCount += static_cast<size_t>(reservoir1.get_histogram()->get_bins().find(it->first)->second / it->second + 0.5f);
+  }
+  BOOST_CHECK_EQUAL(exampleCount, reservoir1.current_size());
+
+  // Check that clearing a reservoir returns its slots to the budget, so that the other reservoir can use them.
+  reservoir1.clear();
+  BOOST_CHECK_EQUAL(budget->get_used(), reservoir2.current_size());
+  for(size_t i = 0, size = examples.size(); i < size; ++i)
+  {
+    reservoir2.add_example(examples[i], *rng);
+  }
+  BOOST_CHECK_EQUAL(reservoir2.current_size(), 15);
+
+  // Check that a forest with a limited budget can still learn the data.
+  RF forest(3, make_settings(12345, 0, false, 300));
+  train_forest(forest, generator);
+  BOOST_CHECK_GE(calculate_accuracy(forest, generator.generate_examples(list_of(1)(2)(3)(4), 100)), 0.8f);
+}
+
+BOOST_AUTO_TEST_CASE(reservoir_entropy_test)
+{
+  // Check that the entropy maintained incrementally by a reservoir matches the entropy of its histogram.
+  tvgutil::RandomNumberGenerator_Ptr rng(new tvgutil::RandomNumberGenerator(12345));
+  UnitCircleExampleGenerator<Label> generator(list_of(1)(2)(3)(4), 1234);
+  ExampleReservoir<Label> reservoir(10);
+  BOOST_CHECK_EQUAL(reservoir.calculate_entropy(), 0.0f);
+
+  std::map<Label,float> multipliers;
+  multipliers[1] = 0.5f;
+  multipliers[3] = 4.0f;
+
+  std::vector<Example_CPtr> examples = generator.generate_examples(list_of(1)(1)(1)(2)(3), 20);
+  for(size_t i = 0, size = examples.size(); i < size; ++i)
+  {
+    reservoir.add_example(examples[i], *rng);
+    BOOST_CHECK_CLOSE(reservoir.calculate_entropy(), ExampleUtil::calculate_entropy(*reservoir.get_histogram()), 1e-3f);
+    BOOST_CHECK_CLOSE(reservoir.calculate_entropy(multipliers), ExampleUtil::calculate_entropy(*reservoir.get_histogram(), multipliers), 1e-3f);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,129 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+
+#include <tvgutil/statistics/ProbabilityMassFunction.h>
+using namespace tvgutil;
+
+//#################### HELPER TYPES ####################
+
+typedef std::map<int,size_t> CountMap;
+typedef DenseLabelMap<int,float,16> DLM;
+typedef std::map<int,float> MassMap;
+typedef Histogram<int,DenseLabelStorage<16> > DenseHistogram;
+typedef Histogram<int,SparseLabelStorage> SparseHistogram;
+typedef ProbabilityMassFunction<int,DenseLabelStorage<16> > DensePMF;
+typedef ProbabilityMassFunction<int,SparseLabelStorage> SparsePMF;
+
+//#################### TESTS ####################
+
+BOOST_AUTO_TEST_SUITE(test_DenseLabelMap)
+
+BOOST_AUTO_TEST_CASE(map_test)
+{
+  DLM m;
+  BOOST_CHECK(m.empty());
+  BOOST_CHECK(m.begin() == m.end());
+
+  m[7] = 3.0f;
+  m[2] += 1.0f;
+  BOOST_CHECK(m.insert(std::make_pair(4, 5.0f)).second);
+  BOOST_CHECK(!m.insert(std::make_pair(4, 6.0f)).second);
+  BOOST_CHECK_EQUAL(m.size(), 3);
+
+  // Check that iteration visits the entries in ascending label order, exactly as for a std::map.
+  MassMap expected;
+  expected[2] = 1.0f;
+  expected[4] = 5.0f;
+  expected[7] = 3.0f;
+  BOOST_CHECK(MassMap(m.begin(), m.end()) == expected);
+  BOOST_CHECK_EQUAL(m.begin()->first, 2);
+  BOOST_CHECK_EQUAL(m.rbegin()->first, 7);
+  BOOST_CHECK_EQUAL(std::distance(m.rbegin(), m.rend()), 3);
+
+  const DLM& cm = m;
+  BOOST_CHECK_EQUAL(cm.count(4), 1);
+  BOOST_CHECK_EQUAL(cm.count(5), 0);
+  BOOST_CHECK_EQUAL(cm.count(100), 0);
+  BOOST_CHECK(cm.find(3) == cm.end());
+  BOOST_CHECK(cm.find(100) == cm.end());
+  BOOST_CHECK_EQUAL(cm.find(7)->second, 3.0f);
+
+  BOOST_CHECK_THROW(m[16], std::out_of_range);
+  BOOST_CHECK_THROW(m[-1], std::out_of_range);
+
+  m.clear();
+  BOOST_CHECK(m.empty());
+  BOOST_CHECK(m.begin() == m.end());
+}
+
+BOOST_AUTO_TEST_CASE(pmf_test)
+{
+  const int labels[] = { 3, 1, 3, 0, 3, 1, 5 };
+  DenseHistogram denseHistogram;
+  SparseHistogram sparseHistogram;
+  for(size_t i = 0; i < sizeof(labels) / sizeof(int); ++i)
+  {
+    denseHistogram.add(labels[i]);
+    sparseHistogram.add(labels[i]);
+  }
+
+  BOOST_CHECK_EQUAL(denseHistogram.get_count(), sparseHistogram.get_count());
+  BOOST_CHECK(CountMap(denseHistogram.get_bins().begin(), denseHistogram.get_bins().end()) == sparseHistogram.get_bins());
+
+  MassMap multipliers;
+  multipliers[3] = 0.5f;
+  DensePMF densePMF(denseHistogram, multipliers);
+  SparsePMF sparsePMF(sparseHistogram, multipliers);
+  BOOST_CHECK_EQUAL(densePMF.calculate_best_label(), sparsePMF.calculate_best_label());
+  BOOST_CHECK_EQUAL(densePMF.calculate_entropy(), sparsePMF.calculate_entropy());
+  BOOST_CHECK(MassMap(densePMF.get_masses().begin(), densePMF.get_masses().end()) == sparsePMF.get_masses());
+
+  std::ostringstream denseOS, sparseOS;
+  denseOS << denseHistogram << ' ' << densePMF;
+  sparseOS << sparseHistogram << ' ' << sparsePMF;
+  BOOST_CHECK_EQUAL(denseOS.str(), sparseOS.str());
+}
+
+BOOST_AUTO_TEST_CASE(serialization_test)
+{
+  DenseHistogram denseHistogram;
+  denseHistogram.add(2);
+  denseHistogram.add(9);
+  denseHistogram.add(2);
+
+  // Check that a dense histogram round-trips correctly.
+  std::stringstream ss;
+  {
+    boost::archive::text_oarchive oa(ss);
+    oa << denseHistogram;
+  }
+
+  DenseHistogram loadedHistogram;
+  {
+    boost::archive::text_iarchive ia(ss);
+    ia >> loadedHistogram;
+  }
+
+  BOOST_CHECK_EQUAL(loadedHistogram.get_count(), 3);
+  BOOST_CHECK(loadedHistogram.get_bins() == denseHistogram.get_bins());
+
+  // Check that dense and sparse histograms are saved identically, so that either can be loaded from the other's archives.
+  SparseHistogram sparseHistogram;
+  sparseHistogram.add(2);
+  sparseHistogram.add(9);
+  sparseHistogram.add(2);
+
+  std::stringstream sparseSS;
+  {
+    boost::archive::text_oarchive oa(sparseSS);
+    oa << sparseHistogram;
+  }
+  BOOST_CHECK_EQUAL(sparseSS.str(), ss.str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
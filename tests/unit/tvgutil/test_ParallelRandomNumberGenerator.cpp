@@ -0,0 +1,76 @@
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include <tvgutil/numbers/ParallelRandomNumberGenerator.h>
+using namespace tvgutil;
+
+BOOST_AUTO_TEST_SUITE(test_ParallelRandomNumberGenerator)
+
+BOOST_AUTO_TEST_CASE(get_stream_test)
+{
+  ParallelRandomNumberGenerator rng(1234, 4);
+  BOOST_CHECK_EQUAL(rng.get_stream_count(), 4);
+  BOOST_CHECK_THROW(rng.get_stream(4), std::runtime_error);
+  BOOST_CHECK_THROW(ParallelRandomNumberGenerator(1234, 0), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(reproducibility_test)
+{
+  ParallelRandomNumberGenerator rng1(1234, 4), rng2(1234, 8);
+
+  // The numbers drawn from a stream should depend only on the seed and the stream index.
+  for(size_t streamIdx = 0; streamIdx < 4; ++streamIdx)
+  {
+    for(int i = 0; i < 100; ++i)
+    {
+      BOOST_CHECK_EQUAL(rng1.get_stream(streamIdx).generate_int_from_uniform(0, 1000000), rng2.get_stream(streamIdx).generate_int_from_uniform(0, 1000000));
+    }
+  }
+
+  // Reseeding should restore the streams to their initial states.
+  rng1.reseed(1234);
+  ParallelRandomNumberGenerator rng3(1234, 4);
+  BOOST_CHECK_EQUAL(rng1.get_stream(2).generate_int_from_uniform(0, 1000000), rng3.get_stream(2).generate_int_from_uniform(0, 1000000));
+}
+
+BOOST_AUTO_TEST_CASE(streams_differ_test)
+{
+  ParallelRandomNumberGenerator rng(1234, 4);
+
+  std::set<std::vector<int> > sequences;
+  for(size_t streamIdx = 0; streamIdx < rng.get_stream_count(); ++streamIdx)
+  {
+    std::vector<int> sequence(16);
+    rng.get_stream(streamIdx).generate_ints_from_uniform(0, 1000000, &sequence[0], sequence.size());
+    sequences.insert(sequence);
+  }
+
+  BOOST_CHECK_EQUAL(sequences.size(), rng.get_stream_count());
+}
+
+BOOST_AUTO_TEST_CASE(batch_test)
+{
+  ParallelRandomNumberGenerator rng1(1234, 1), rng2(1234, 1);
+
+  std::vector<int> ints(100);
+  rng1.get_stream(0).generate_ints_from_uniform(-5, 17, &ints[0], ints.size());
+  for(size_t i = 0, size = ints.size(); i < size; ++i)
+  {
+    BOOST_CHECK_EQUAL(ints[i], rng2.get_stream(0).generate_int_from_uniform(-5, 17));
+    BOOST_CHECK(ints[i] >= -5 && ints[i] <= 17);
+  }
+
+  std::vector<double> reals(100);
+  rng1.get_stream(0).generate_reals_from_uniform(2.0, 3.0, &reals[0], reals.size());
+  for(size_t i = 0, size = reals.size(); i < size; ++i)
+  {
+    BOOST_CHECK_EQUAL(reals[i], rng2.get_stream(0).generate_real_from_uniform(2.0, 3.0));
+    BOOST_CHECK(reals[i] >= 2.0 && reals[i] <= 3.0);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,6 +1,8 @@
 #define BOOST_TEST_MAIN
 #include <boost/test/unit_test.hpp>
 
+#include <vector>
+
 #include <tvgutil/numbers/RandomNumberGenerator.h>
 using namespace tvgutil;
 
@@ -12,4 +14,30 @@ BOOST_AUTO_TEST_CASE(generate_int_from_uniform_test)
   BOOST_CHECK_EQUAL(rng.generate_int_from_uniform(23,23), 23);
 }
 
+BOOST_AUTO_TEST_CASE(generate_ints_from_uniform_test)
+{
+  RandomNumberGenerator rng1(1234), rng2(1234);
+
+  std::vector<int> batch(100);
+  rng1.generate_ints_from_uniform(-5, 17, &batch[0], batch.size());
+
+  for(size_t i = 0, size = batch.size(); i < size; ++i)
+  {
+    BOOST_CHECK_EQUAL(batch[i], rng2.generate_int_from_uniform(-5, 17));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(generate_reals_from_uniform_test)
+{
+  RandomNumberGenerator rng1(1234), rng2(1234);
+
+  std::vector<float> batch(100);
+  rng1.generate_reals_from_uniform(2.0f, 3.0f, &batch[0], batch.size());
+
+  for(size_t i = 0, size = batch.size(); i < size; ++i)
+  {
+    BOOST_CHECK_EQUAL(batch[i], rng2.generate_real_from_uniform(2.0f, 3.0f));
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()